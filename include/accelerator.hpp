@@ -6,11 +6,14 @@
  */
 #ifndef ACCELERATOR_H_
 #define ACCELERATOR_H_
+#include <stddef.h>
 #include "scene.hpp"
 namespace ray {
 class Accelerator: public SceneShape {
 public:
   virtual ~Accelerator();
+  // Bytes held by the structure itself, not counting the objects.
+  virtual size_t GetMemoryUsage() const = 0;
 protected:
   Accelerator();
 };
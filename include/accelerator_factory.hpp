@@ -0,0 +1,83 @@
+/*
+ * accelerator_factory.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef ACCELERATOR_FACTORY_HPP_
+#define ACCELERATOR_FACTORY_HPP_
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "accelerator.hpp"
+#include "kdtree64.hpp"
+#include "mesh.hpp"
+#include "octree64.hpp"
+#include "sah_octree.hpp"
+#include "scene.hpp"
+#include "tree_stats.hpp"
+namespace ray {
+////////
+//
+// AcceleratorFactory
+//
+// Builds the acceleration structure of a Trimesh from a type and its
+// parameters chosen at run time, e.g. on the command line.  The kd-tree
+// takes a split policy, a maximum leaf size and a maximum depth; the
+// octrees have their leaf size and depth fixed at compile time and the
+// SAH octree takes an evaluation policy.
+//
+////////
+class AcceleratorFactory {
+public:
+  enum Type {
+    kNone, kKdtree, kOctree, kSahOctree, kNumTypes
+  };
+  typedef Kdtree64<TrimeshFace> KdtreeType;
+  typedef Octree64<TrimeshFace, 32, 20> OctreeType;
+  typedef SAHOctree<TrimeshFace> SahOctreeType;
+  AcceleratorFactory();
+  Type type() const;
+  void set_type(Type type);
+  KdtreeType::SplitPolicy kdtree_policy() const;
+  void set_kdtree_policy(KdtreeType::SplitPolicy kdtree_policy);
+  SahOctreeType::EvaluationPolicy sah_octree_policy() const;
+  void set_sah_octree_policy(SahOctreeType::EvaluationPolicy policy);
+  uint32_t max_leaf_size() const;
+  void set_max_leaf_size(uint32_t max_leaf_size);
+  uint32_t max_depth() const;
+  void set_max_depth(uint32_t max_depth);
+  // Sets the kd-tree or SAH octree policy called name, as parsed by
+  // ParseKdtreePolicy() or ParseSahOctreePolicy(), for the current type.
+  // Returns false, leaving the factory untouched, if the type has no such
+  // policy.
+  bool SetPolicy(const std::string& name);
+  // Builds an accelerator over the faces of mesh, or returns NULL for
+  // kNone.  The caller owns the result.  If stats is not NULL it receives
+  // the statistics of the build.
+  Accelerator* Create(const Trimesh& mesh, TreeStats* stats = NULL) const;
+  // Builds and sets an accelerator for every Trimesh of scene and appends
+  // them to accelerators, which must outlive their use.
+  void Accelerate(Scene& scene, std::vector<Accelerator*>& accelerators) const;
+  // Names as used on the command line, e.g. "kdtree" or "sah-octree".
+  static const char* GetTypeName(Type type);
+  static bool ParseType(const std::string& name, Type& type);
+  static const char* GetKdtreePolicyName(KdtreeType::SplitPolicy policy);
+  static const char* GetSahOctreePolicyName(
+      SahOctreeType::EvaluationPolicy policy);
+  // "median" or "sah".
+  static bool ParseKdtreePolicy(const std::string& name,
+      KdtreeType::SplitPolicy& policy);
+  // "binned", "centroid", "full", "mixed64" ... "mixed512" or "bounded32"
+  // ... "bounded128".
+  static bool ParseSahOctreePolicy(const std::string& name,
+      SahOctreeType::EvaluationPolicy& policy);
+private:
+  Type type_;
+  KdtreeType::SplitPolicy kdtree_policy_;
+  SahOctreeType::EvaluationPolicy sah_octree_policy_;
+  uint32_t max_leaf_size_;
+  uint32_t max_depth_;
+};
+} // namespace ray
+#endif /* ACCELERATOR_FACTORY_HPP_ */
@@ -0,0 +1,62 @@
+/*
+ * async_image_writer.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef ASYNC_IMAGE_WRITER_HPP_
+#define ASYNC_IMAGE_WRITER_HPP_
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include "image.hpp"
+namespace ray {
+////////
+//
+// AsyncImageWriter
+//
+// Encodes images on a background thread, so that the next frame can be
+// rendered while the last one is compressed.  WriteImage() takes over the
+// pixels of the image it is given and returns at once, unless max_queued
+// images are already waiting, in which case it blocks until the writer
+// catches up.  Flush() waits for every queued image and reports the first
+// failure since the previous Flush().  The destructor writes whatever is
+// still queued; subclasses overriding Encode() must Flush() in their own
+// destructor.
+//
+////////
+class AsyncImageWriter {
+public:
+  explicit AsyncImageWriter(int max_queued);
+  virtual ~AsyncImageWriter();
+  int max_queued() const;
+  // Queues image for file_name and leaves image empty.
+  void WriteImage(const std::string& file_name, Image& image);
+  bool Flush(std::string& status);
+protected:
+  // Called on the writer thread; defaults to ImageStorage::WriteImage().
+  virtual bool Encode(const std::string& file_name, const Image& image,
+      std::string& status);
+private:
+  struct Job {
+    std::string file_name;
+    Image image;
+  };
+  AsyncImageWriter(const AsyncImageWriter&);
+  AsyncImageWriter& operator=(const AsyncImageWriter&);
+  static void* WriterMain(void* arg);
+  void Run();
+  void Finish(Job* job);
+  int max_queued_;
+  std::deque<Job*> queue_;
+  int num_pending_;
+  bool stopping_;
+  bool started_;
+  bool success_;
+  std::string status_;
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t changed_;
+};
+} // namespace ray
+#endif /* ASYNC_IMAGE_WRITER_HPP_ */
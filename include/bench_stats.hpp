@@ -0,0 +1,51 @@
+/*
+ * bench_stats.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef BENCH_STATS_HPP_
+#define BENCH_STATS_HPP_
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "parse_utils.hpp"
+namespace ray {
+// The statistics of bench_compare, which compares repeated runs of
+// ray_bench or micro_bench for two builds.
+
+// The name of a case of a run: its string members, such as scene,
+// accelerator and policy, in order, and the settings it was run with,
+// such as the resolution and the number of threads, which change its
+// rates without changing the build.
+std::string GetCaseName(const JsonValue& result);
+
+// The 97.5% quantile of Student's t distribution for df degrees of freedom,
+// rounded down to a whole number, which errs on the wide side.
+double GetStudentQuantile(double df);
+
+// Welch-Satterthwaite degrees of freedom of the difference of the means of
+// two samples, given the variance and the size of each.
+double GetWelchDegreesOfFreedom(double variance1, size_t size1,
+    double variance2, size_t size2);
+
+struct Comparison {
+  double speedup;
+  // False unless both sides have two or more runs.
+  bool has_interval;
+  // The 95% confidence interval of the speedup, or the speedup itself.
+  double low;
+  double high;
+};
+
+// Speedup of the candidate over the baseline, as the ratio of geometric
+// means, oriented so that above 1 is better.  The interval is Welch's t
+// interval on the difference of the mean logarithms.
+Comparison Compare(const std::vector<double>& baseline,
+    const std::vector<double>& candidate, bool higher_is_better);
+
+// A regression is a speedup below 1 - threshold whose interval, if any,
+// lies below 1 as a whole, so that noise alone does not fail a build.
+bool IsRegression(const Comparison& comparison, double threshold);
+} // namespace ray
+#endif /* BENCH_STATS_HPP_ */
@@ -0,0 +1,77 @@
+/*
+ * build_profile.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef BUILD_PROFILE_HPP_
+#define BUILD_PROFILE_HPP_
+#include <stdint.h>
+#include <time.h>
+#include <ostream>
+#include <string>
+namespace ray {
+////////
+//
+// BuildProfile
+//
+// Time and number of calls per phase of a tree build.  The builders only
+// time their phases when RAY_BUILD_PROFILE is defined, e.g. with
+// cmake -DRAY_BUILD_PROFILE=ON; otherwise kProfileBuild is false and
+// the timers compile away.  Phases may nest: kImageIntegral is part of
+// kEvaluateBinnedCost and the sorting of events is part of
+// kCreateEvents.
+//
+////////
+#ifdef RAY_BUILD_PROFILE
+const bool kProfileBuild = true;
+#else
+const bool kProfileBuild = false;
+#endif
+
+struct BuildProfile {
+  enum Phase {
+    kBounds, kCreateEvents, kFindBestPlane, kDistributeEvents,
+    kEvaluateBinnedCost, kImageIntegral, kDistributeObjects, kEncodeNode,
+    kNumPhases
+  };
+  BuildProfile();
+  void Reset();
+  // Phases with at least one call, one per line.
+  void Print(std::ostream& out) const;
+  // {"<phase name>": {"seconds": s, "calls": n}, ...} for every phase.
+  std::string ToJson() const;
+  // E.g. "create_events".
+  static const char* GetPhaseName(Phase phase);
+  double seconds[kNumPhases];
+  uint64_t calls[kNumPhases];
+};
+
+// Adds the time between its construction and destruction to phase of
+// profile.  Does nothing without RAY_BUILD_PROFILE.
+class ScopedPhaseTimer {
+public:
+  ScopedPhaseTimer(BuildProfile& profile, BuildProfile::Phase phase) :
+      profile_(profile), phase_(phase) {
+    if (kProfileBuild)
+      clock_gettime(CLOCK_MONOTONIC, &start_);
+  }
+
+  ~ScopedPhaseTimer() {
+    if (!kProfileBuild)
+      return;
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    profile_.seconds[phase_] += (end.tv_sec - start_.tv_sec)
+        + 1e-9 * (end.tv_nsec - start_.tv_nsec);
+    ++profile_.calls[phase_];
+  }
+private:
+  ScopedPhaseTimer(const ScopedPhaseTimer&);
+  ScopedPhaseTimer& operator=(const ScopedPhaseTimer&);
+  BuildProfile& profile_;
+  BuildProfile::Phase phase_;
+  timespec start_;
+};
+} // namespace ray
+#endif /* BUILD_PROFILE_HPP_ */
@@ -0,0 +1,66 @@
+/*
+ * framebuffer.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef FRAMEBUFFER_HPP_
+#define FRAMEBUFFER_HPP_
+#include <stdint.h>
+#include <vector>
+#include "image.hpp"
+#include "types.hpp"
+namespace ray {
+// How linear radiance is mapped to 8-bit display values.  exposure
+// scales the radiance first; gamma is the display gamma, so 2.2 encodes
+// with an exponent of 1 / 2.2.  The default maps [0, 1] linearly.
+struct ToneMapping {
+  enum Operator {
+    kClamp, kReinhard, kNumOperators
+  };
+  ToneMapping();
+  ToneMapping(Operator op, float exposure, float gamma);
+  Operator op;
+  float exposure;
+  float gamma;
+};
+
+////////
+//
+// Framebuffer
+//
+// Linear floating point RGB with a per-pixel accumulated sample weight,
+// stored as RGBW quadruples so a pixel fills one SSE register.  Samples
+// are only ever summed here; quantization to 8 bits happens once, in
+// Resolve().
+//
+////////
+class Framebuffer {
+public:
+  Framebuffer();
+  Framebuffer(int width, int height);
+  uint32_t width() const;
+  uint32_t height() const;
+  void Resize(int width, int height);
+  void Clear();
+  // Row i, column j, like Image.
+  void AddSample(int i, int j, const glm::vec3& color, float weight = 1.0f);
+  void SetPixel(int i, int j, const glm::vec3& color);
+  // The weighted mean of the samples, black if there are none.
+  glm::vec3 GetColor(int i, int j) const;
+  float GetWeight(int i, int j) const;
+  const std::vector<float>& data() const;
+  // Divides by the weights, tone maps and gamma encodes into image,
+  // resizing it to match.
+  void Resolve(Image& image, const ToneMapping& tone_mapping) const;
+private:
+  static const int kGammaTableSize = 4096;
+  // Below this table index the gamma curve is too steep for the table and
+  // the darkest values are encoded with pow() instead.
+  static const int kExactGammaSize = 64;
+  std::vector<float> data_;
+  uint32_t width_;
+  uint32_t height_;
+};
+} // namespace ray
+#endif /* FRAMEBUFFER_HPP_ */
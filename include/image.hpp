@@ -23,6 +23,8 @@ public:
     const std::vector<ucvec3>& pixels() const;
     void Resize(int width, int height);
     void Resize();
+    // Exchanges pixels and size with image, without copying.
+    void Swap(Image& image);
 private:
     std::vector<ucvec3> pixels_;
     uint32_t width_;
@@ -0,0 +1,65 @@
+/*
+ * image_compare.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef IMAGE_COMPARE_HPP_
+#define IMAGE_COMPARE_HPP_
+#include <ostream>
+#include <string>
+#include <vector>
+#include "image.hpp"
+namespace ray {
+////////
+//
+// ImageDifference
+//
+// How much an image differs from a reference image of the same size.
+// Errors are absolute differences of 8 bit channels; the error of a pixel
+// is that of its worst channel.  The histogram of the pixel errors tells
+// a few pixels flipping at a silhouette, which any change of rounding in
+// the traversal causes, apart from a slightly different image.
+//
+////////
+class ImageDifference {
+public:
+  ImageDifference();
+  // Returns false, with status, if the sizes differ.
+  bool Compare(const Image& image, const Image& reference,
+      std::string& status);
+  // Reads reference with ImageStorage::ReadImage() and compares image to
+  // it.
+  bool Compare(const Image& image, const std::string& reference,
+      std::string& status);
+  // Root mean square error over every channel of every pixel.
+  double rmse() const;
+  // Peak signal to noise ratio in dB, infinite for identical images.
+  double psnr() const;
+  int max_error() const;
+  int num_pixels() const;
+  // Pixels with an error larger than error.
+  int CountPixelsAbove(int error) const;
+  // An image of the pixel errors, scaled so that the largest is white.
+  void GetErrorImage(Image& image) const;
+private:
+  double rmse_;
+  int width_;
+  int height_;
+  std::vector<int> histogram_;
+  std::vector<unsigned char> errors_;
+};
+std::ostream& operator<<(std::ostream& out, const ImageDifference& difference);
+
+// The quality budget of a fast path: its images must have a PSNR of at
+// least min_psnr, and no pixel error above max_error, except in at most
+// max_outlier_fraction of the pixels.
+struct ImageBudget {
+  ImageBudget(double min_psnr, int max_error, double max_outlier_fraction);
+  bool Accepts(const ImageDifference& difference) const;
+  double min_psnr;
+  int max_error;
+  double max_outlier_fraction;
+};
+} // namespace ray
+#endif /* IMAGE_COMPARE_HPP_ */
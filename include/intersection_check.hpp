@@ -0,0 +1,96 @@
+/*
+ * intersection_check.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef INTERSECTION_CHECK_HPP_
+#define INTERSECTION_CHECK_HPP_
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+#include "accelerator.hpp"
+#include "mesh.hpp"
+#include "ray.hpp"
+#include "ray_capture.hpp"
+#include "shape.hpp"
+namespace ray {
+////////
+//
+// IntersectionChecker
+//
+// Differential test of an accelerator against
+// Trimesh::IntersectUnaccelerated().  Besides uniformly random rays it
+// generates the rays that break traversal code: rays grazing the edges
+// and vertices of the triangles, axis-aligned rays, whose inverse
+// directions are infinite, and rays starting on, or running within, the
+// planes that the kd-trees and octrees split at.  A hit at a distance
+// differing by more than tolerance, relative to the expected distance, is
+// a mismatch just like a hit that should be a miss.  Rays that hit a
+// triangle almost edge-on, or whose brute force result changes when the
+// origin is moved by a tiny fraction of the scene, are counted as
+// ambiguous instead: the intersection test is ill-conditioned there and
+// the brute force itself reports hits or misses at the whim of rounding.
+// Mismatches are reduced to a minimal ray by rounding coordinates for as
+// long as the mismatch persists, which gives test cases that are easy to
+// paste.
+//
+////////
+class IntersectionChecker {
+public:
+  // The kinds of rays generated.
+  enum RayKind {
+    kRandom, kGrazing, kAxisAligned, kSplitPlane, kNumRayKinds
+  };
+  // A ray on which the accelerator and the brute force test of every face
+  // disagree.  minimal_ray is the simplest ray found that still disagrees.
+  struct Mismatch {
+    Mismatch();
+    RayKind kind;
+    Ray ray;
+    Ray minimal_ray;
+    bool hit;
+    float t_hit;
+    bool expected_hit;
+    float expected_t_hit;
+  };
+  IntersectionChecker(const Trimesh& mesh, const Accelerator& accelerator);
+  // Checks num_rays rays, cycling through the kinds, generated from seed.
+  // Returns the number of mismatches.  The first max_mismatches are kept,
+  // reduced to minimal rays.
+  int Run(int num_rays, uint32_t seed, int max_mismatches);
+  // Returns true if the accelerator and brute force agree on ray;
+  // otherwise fills in mismatch, if not NULL, without reducing the ray.
+  bool Check(const Ray& ray, Mismatch* mismatch) const;
+  // True if ray hits a triangle at a grazing angle or if its brute force
+  // result is not stable under small perturbations of the origin.
+  bool IsAmbiguous(const Ray& ray) const;
+  Ray Reduce(const Ray& ray) const;
+  Ray GenerateRay(RayKind kind, RandomSequence& random) const;
+  // Rays and mismatches per kind and the mismatches kept.
+  void Print(std::ostream& out) const;
+  const std::vector<Mismatch>& mismatches() const;
+  // Rays of kind checked, and those of them counted as ambiguous, by Run().
+  int num_rays(RayKind kind) const;
+  int num_ambiguous(RayKind kind) const;
+  float tolerance() const;
+  void set_tolerance(float tolerance);
+  // "random", "grazing", "axis-aligned" or "split-plane".
+  static const char* GetRayKindName(RayKind kind);
+private:
+  IntersectionChecker(const IntersectionChecker&);
+  IntersectionChecker& operator=(const IntersectionChecker&);
+  glm::vec3 GetSplitPoint(RandomSequence& random, int axis) const;
+  const Trimesh& mesh_;
+  const Accelerator& accelerator_;
+  BoundingBox bounds_;
+  float tolerance_;
+  int num_rays_[kNumRayKinds];
+  int num_mismatches_[kNumRayKinds];
+  int num_ambiguous_[kNumRayKinds];
+  std::vector<Mismatch> mismatches_;
+};
+std::ostream& operator<<(std::ostream& out,
+    const IntersectionChecker::Mismatch& mismatch);
+} // namespace ray
+#endif /* INTERSECTION_CHECK_HPP_ */
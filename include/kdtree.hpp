@@ -23,7 +23,8 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
  public:
   enum SplitPolicy {
     kSpatialMedian = 0,
-    kFullSAH = 1
+    kFullSAH = 1,
+    kNumPolicies
   };
   typedef std::vector<const SceneObject*> ObjectVector;
 
@@ -116,6 +117,7 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
   SplitPolicy split_policy_;
 
   void CreateEvents(const ObjectVector& objects, SahWorkInfo& work_info) {
+    ScopedPhaseTimer timer(this->stats_.profile, BuildProfile::kCreateEvents);
     BoundingBox bounds;
     const SceneObject* obj = NULL;
     EventList event_list;
@@ -145,6 +147,8 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
   void DistributeEvents(float value, uint32_t split_dim, uint32_t list_dim,
                         SahWorkInfo* parent_info, SahWorkInfo* left_info,
                         SahWorkInfo* right_info) {
+    ScopedPhaseTimer timer(this->stats_.profile,
+                           BuildProfile::kDistributeEvents);
     EventList* parent_list = &parent_info->events[list_dim];
     EventList* left_list = (left_info ? &left_info->events[list_dim] : NULL);
     EventList* right_list = (right_info ? &right_info->events[list_dim] : NULL);
@@ -155,17 +159,24 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
       e = parent_list->front();
       parent_list->pop_front();
       b = e.obj->GetBounds();
-      bool planar_left =
-          (e.type == Event::kPlanar && e.value == value && is_left);
-      bool planar_right =
-          (e.type == Event::kPlanar && e.value == value && !is_left);
-      if (left_list && (planar_left || b.min()[split_dim] <= value))
+      if (left_list && IsInChild(b, value, split_dim, 0, is_left))
         left_list->push_back(e);
-      if (right_list && (planar_right || b.max()[split_dim] >= value))
+      if (right_list && IsInChild(b, value, split_dim, 1, is_left))
         right_list->push_back(e);
     }
   }
 
+  // Whether an object with bounds b goes to child i of a full SAH split at
+  // value in dim.  As in FindBestPlaneInList(), an object that only touches
+  // the plane goes to the side it lies on, and one lying in the plane to
+  // the side the sweep chose.
+  bool IsInChild(const BoundingBox& b, float value, uint32_t dim, uint32_t i,
+                 bool planar_left) const {
+    bool planar = (b.min()[dim] == value && b.max()[dim] == value);
+    if (0 == i) return b.min()[dim] < value || (planar && planar_left);
+    return b.max()[dim] > value || (planar && !planar_left);
+  }
+
   virtual void ProcessWorkInfo(const Node& node, WorkNodeType& work_node,
                                WorkNodeType* child_work_nodes) {
     if (kFullSAH != split_policy_) return;
@@ -237,17 +248,19 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
                (left_area * left_count + right_area * right_count) / total_area;
   }
 
-  void UpdateCounts(const Event& event, int& right_count, int& left_count,
-                    int& planar_count) const {
+  // Tallies an event into the objects ending at, lying in and starting at
+  // the plane of the event.
+  void UpdateCounts(const Event& event, int& end_count, int& planar_count,
+                    int& start_count) const {
     switch (event.type) {
       case Event::kEnd:
-        --right_count;
+        ++end_count;
         break;
       case Event::kPlanar:
         ++planar_count;
         break;
       case Event::kStart:
-        ++left_count;
+        ++start_count;
         break;
       default:
         break;
@@ -293,20 +306,27 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
                            PlanarSplitSide& best_side) const {
     const float sum_other = 2.0f * (extent0 + extent1);
     const float prod_other = 2.0f * (extent0 * extent1);
-    int left_count = 0, right_count = num_objects, planar_count = 0;
+    int left_count = 0, right_count = num_objects;
+    int end_count = 0, planar_count = 0, start_count = 0;
     best_cost = std::numeric_limits<float>::max();
     best_value = std::numeric_limits<float>::max();
     for (uint32_t i = 0; i < events.size(); ++i) {
       float current_value = glm::clamp(events[i].value, min_val, max_val);
-      UpdateCounts(events[i], left_count, right_count, planar_count);
+      UpdateCounts(events[i], end_count, planar_count, start_count);
       uint32_t next = i + 1;
       bool update_cost =
           (next == events.size() ||
            current_value != glm::clamp(events[next].value, min_val, max_val));
-      if (update_cost)
+      if (update_cost) {
+        // Objects ending at or lying in the plane are no longer to its
+        // right, those starting at it are to the left of the next plane.
+        right_count -= end_count + planar_count;
         UpdateCost(current_value, min_val, max_val, area, sum_other, prod_other,
                    left_count, right_count, planar_count, best_cost, best_value,
                    best_side);
+        left_count += start_count + planar_count;
+        end_count = planar_count = start_count = 0;
+      }
     }
   }
 
@@ -328,10 +348,15 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
     glm::vec3 extents = bounds.max() - bounds.min();
     const uint32_t kOtherIndices[3][2] = {{1, 2}, {0, 2}, {0, 1}};
     for (uint32_t d = 0; d < 3; ++d) {
-      FindBestPlaneInList(info->events[d], extents[kOtherIndices[d][0]],
-                          extents[kOtherIndices[d][1]], bounds.min()[d],
-                          bounds.max()[d], work_node.objects.size(), total_area,
-                          current_cost, current_value, current_side);
+      {
+        ScopedPhaseTimer timer(this->stats_.profile,
+                               BuildProfile::kFindBestPlane);
+        FindBestPlaneInList(info->events[d], extents[kOtherIndices[d][0]],
+                            extents[kOtherIndices[d][1]], bounds.min()[d],
+                            bounds.max()[d], work_node.objects.size(),
+                            total_area, current_cost, current_value,
+                            current_side);
+      }
       if (current_cost < best_cost) {
         best_cost = current_cost;
         split_result = static_cast<SplitResult>(d);
@@ -471,6 +496,7 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
       children[count] = this->GetIthChildOf(node, i);
       child_bounds[count] =
           this->GetChildBounds(node, bounds, children[count].order());
+      CountTraversal(TraversalStats::kBoxesTested);
       if (child_bounds[count].Intersect(ray, t_near, t_far)) {
         h[count] =
             SortHolder(t_near, t_far, children[count], child_bounds[count]);
@@ -527,12 +553,23 @@ class Kdtree : public TreeBase<SceneObject, Node, EncodedNode, NodeFactory> {
     for (uint32_t j = 0; j < 2; ++j)
       child_work_nodes[j] = WorkNodeType(  // initialize child lists
           this->GetChildBounds(node, work_node.bounds, j));
-    while (!work_node.objects.empty()) {
-      const SceneObject* obj = work_node.objects.back();
-      work_node.objects.pop_back();
-      for (uint32_t j = 0; j < 2; ++j)  // distribute to children
-        if (obj->GetBounds().Overlap(child_work_nodes[j].bounds))
-          child_work_nodes[j].objects.push_back(obj);
+    {
+      ScopedPhaseTimer timer(this->stats_.profile,
+                             BuildProfile::kDistributeObjects);
+      // The full SAH split distributes the objects as it counted them.
+      SahWorkInfo* info = reinterpret_cast<SahWorkInfo*>(work_node.work_info);
+      bool by_sah = (kFullSAH == split_policy_ && NULL != info);
+      float value = node.split_value();
+      uint32_t dim = static_cast<uint32_t>(node.type());
+      while (!work_node.objects.empty()) {
+        const SceneObject* obj = work_node.objects.back();
+        work_node.objects.pop_back();
+        for (uint32_t j = 0; j < 2; ++j)  // distribute to children
+          if (by_sah ? IsInChild(obj->GetBounds(), value, dim, j,
+                                 kPlanarLeft == info->split_side)
+                     : obj->GetBounds().Overlap(child_work_nodes[j].bounds))
+            child_work_nodes[j].objects.push_back(obj);
+      }
     }
     ProcessWorkInfo(node, work_node, &child_work_nodes[0]);
     int num_children = 0;
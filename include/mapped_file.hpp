@@ -0,0 +1,47 @@
+/*
+ * mapped_file.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+#include <stddef.h>
+#include <string>
+namespace ray {
+////////
+//
+// MappedFile
+//
+// A read-only, private memory mapping of a whole file.  The mapping is
+// released by Close() or the destructor.  An empty file opens fine and
+// maps to a NULL data pointer with size 0.  With kPreload the whole file
+// is read ahead; with kOnDemand only the pages that are touched are read,
+// without read-ahead, and the kernel may drop them again under memory
+// pressure, so that files larger than memory can be mapped.
+//
+////////
+class MappedFile {
+public:
+  enum Access {
+    kPreload, kOnDemand
+  };
+  MappedFile();
+  ~MappedFile();
+  // Opens file_name with kPreload.
+  bool Open(const std::string& file_name, std::string& status);
+  bool Open(const std::string& file_name, Access access,
+      std::string& status);
+  void Close();
+  bool is_open() const;
+  const char* data() const;
+  size_t size() const;
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+  const char* data_;
+  size_t size_;
+  bool is_open_;
+};
+} // namespace ray
+#endif /* MAPPED_FILE_HPP_ */
@@ -6,8 +6,11 @@
  */
 #ifndef MESH_HPP_
 #define MESH_HPP_
+#include <string>
 #include <vector>
+#include <boost/shared_ptr.hpp>
 #include "geometry.hpp"
+#include "mesh_array.hpp"
 #include "octree_base.hpp"
 #include "scene.hpp"
 #include "shape.hpp"
@@ -16,7 +19,11 @@
 namespace ray {
 class Trimesh;
 
-class TrimeshFace: public SceneShape {
+// A triangle of a Trimesh: the mesh and three vertex indices.  Faces are
+// plain values without a vtable, 24 bytes each, because every face of
+// every mesh is held in memory for the accelerators to point at; a hit
+// records the mesh as its object and the mesh's material.
+class TrimeshFace {
 public:
   TrimeshFace();
   TrimeshFace(const TrimeshFace& face);
@@ -28,11 +35,12 @@ public:
   const Trimesh* mesh() const;
   void set_mesh(Trimesh* mesh);
   const int* vertices() const;
-  virtual void Print(std::ostream& out) const;
+  void Print(std::ostream& out) const;
 private:
   Trimesh* mesh_;
   int vertices_[3];
 };
+std::ostream& operator<<(std::ostream& out, const TrimeshFace& face);
 
 class Trimesh: public SceneShape {
 public:
@@ -40,31 +48,98 @@ public:
   const std::vector<TrimeshFace>& faces() const;
   int num_faces() const;
   int num_vertices() const;
-  const std::vector<glm::vec3>& vertices() const;
+  const MeshArray<glm::vec3>& vertices() const;
+  const MeshArray<glm::vec3>& normals() const;
+  const MeshArray<TexCoord>& tex_coords() const;
   void AddVertex(const glm::vec3& vertex);
   void AddNormal(const glm::vec3& vertex);
   void AddFace(int i, int j, int k);
   void AddTexCoord(const TexCoord& tex_coord);
+  // Reads the vertex attributes from num_vertices elements at vertices,
+  // normals and tex_coords without copying them; owner keeps that memory
+  // alive.  normals and tex_coords may be NULL.
+  void MapVertices(const glm::vec3* vertices, const glm::vec3* normals,
+      const TexCoord* tex_coords, int num_vertices,
+      const boost::shared_ptr<const void>& owner);
+  // Bulk construction.  The vectors are swapped in, not copied, so the
+  // arguments are left with the mesh's previous contents.
+  void SetVertices(std::vector<glm::vec3>& vertices);
+  void SetNormals(std::vector<glm::vec3>& normals);
+  void SetTexCoords(std::vector<TexCoord>& tex_coords);
+  // Replaces the faces by the index triples in indices and computes the
+  // bounds in one pass over the vertices.  Returns false, leaving the
+  // faces untouched, if indices is not a whole number of triples or names
+  // a vertex the mesh does not have.
+  bool SetFaces(const std::vector<int32_t>& indices);
+  // Replaces the faces by the num_faces index triples at indices.  bounds
+  // must be the bounds of those faces, which is not checked.
+  void SetFaces(const int32_t* indices, int num_faces,
+      const BoundingBox& bounds);
+  // The bounds of num_vertices points.
+  static BoundingBox ComputeBounds(const glm::vec3* vertices,
+      size_t num_vertices);
+  // Sorts the faces by the Morton code of their centroids and renumbers
+  // the vertices in the order the sorted faces first use them, so that
+  // faces close in space, e.g. in one kd-tree leaf, are close in memory
+  // and share cache lines of vertex data.  Unused vertices go last.
+  void ImproveLocality();
+  // Compact vertex storage: positions are quantized to 16 bits per
+  // coordinate within the bounds of the vertices, normals octahedral
+  // encoded in 32 bits and texture coordinates stored as two half floats
+  // (their third coordinate is dropped), 14 instead of 36 bytes per
+  // vertex.  The attributes are decoded on the fly, vertices() and friends
+  // are empty afterwards and the mesh must not be modified any more.
+  void Compact();
+  bool is_compact() const;
+  // The attributes of vertex i, decoded if the mesh is compact.
+  glm::vec3 GetVertex(int i) const;
+  glm::vec3 GetNormal(int i) const;
+  TexCoord GetTexCoord(int i) const;
+  bool has_normals() const;
+  bool has_tex_coords() const;
   Triangle GetPatch(const TrimeshFace& face) const;
   Triangle GetPatch(int face_index) const;
   glm::vec3 InterpolateNormal(const TrimeshFace& face,
       const glm::vec3& bary) const;
   glm::vec3 InterpolateNormal(int i, const glm::vec3& bary) const;
   virtual bool Intersect(const Ray& ray, Isect& isect) const;
+  // Tests every face, ignoring the accelerator; the reference the
+  // accelerators are checked against.
+  bool IntersectUnaccelerated(const Ray& ray, Isect& isect) const;
   BoundingBox GetBounds();
+  // Bytes of memory held by the faces and the vertex attributes, not
+  // counting mapped attributes or the accelerator.
+  size_t GetMemoryUsage() const;
   void GenNormals();
   virtual void Print(std::ostream& out) const;
   void set_accelerator(Accelerator* accelerator);
+  // Also sets the trace flag of the accelerator.
+  virtual void set_trace(bool trace);
   Accelerator* const & accelerator() const;
 protected:
   bool IntersectAccelerated(const Ray& ray, Isect& isect) const;
-  bool IntersectUnaccelerated(const Ray& ray, Isect& isect) const;
-  std::vector<glm::vec3> vertices_;
-  std::vector<glm::vec3> normals_;
-  std::vector<TexCoord> tex_coords_;
+  MeshArray<glm::vec3> vertices_;
+  MeshArray<glm::vec3> normals_;
+  MeshArray<TexCoord> tex_coords_;
   std::vector<TrimeshFace> faces_;
   BoundingBox bounds_;
   Accelerator* accelerator_;
+  bool compact_;
+  std::vector<uint16_t> compact_vertices_;
+  std::vector<uint32_t> compact_normals_;
+  std::vector<uint32_t> compact_tex_coords_;
+  glm::vec3 compact_origin_;
+  glm::vec3 compact_scale_;
+};
+
+// Takes the meshes of a scene one at a time as a loader builds them, so
+// that they need not all be in memory at once, see MeshCache::Writer.
+class MeshSink {
+public:
+  virtual ~MeshSink();
+  // mesh stays with the caller.  Returns false, with status set, to stop
+  // the load.
+  virtual bool AddMesh(Trimesh& mesh, std::string& status) = 0;
 };
 } // namespace ray
 #endif /* MESH_HPP_ */
@@ -0,0 +1,155 @@
+/*
+ * mesh_array.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef MESH_ARRAY_HPP_
+#define MESH_ARRAY_HPP_
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+namespace ray {
+////////
+//
+// MeshArray
+//
+// An array of per-vertex mesh data that either owns its elements in a
+// std::vector or points at memory owned by someone else, e.g. a mapped
+// MeshCache file.  Mapped memory is kept alive by the owner handle passed
+// to Map().  Reads never copy; the first call to a mutating member copies
+// mapped elements into the vector, so mapped memory is never written.
+//
+////////
+template<typename T>
+class MeshArray {
+public:
+  MeshArray() :
+      elements_(), data_(NULL), size_(0), owner_() {
+  }
+
+  MeshArray(const MeshArray& array) :
+      elements_(array.elements_), data_(NULL), size_(array.size_),
+          owner_(array.owner_) {
+    data_ = (is_mapped() ? array.data_ : GetElementData());
+  }
+
+  MeshArray& operator=(const MeshArray& array) {
+    if (this != &array) {
+      elements_ = array.elements_;
+      size_ = array.size_;
+      owner_ = array.owner_;
+      data_ = (is_mapped() ? array.data_ : GetElementData());
+    }
+    return *this;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return 0 == size_;
+  }
+
+  bool is_mapped() const {
+    return NULL != owner_.get();
+  }
+
+  // Bytes of memory held by the array itself; mapped elements do not count.
+  size_t GetMemoryUsage() const {
+    return elements_.capacity() * sizeof(T);
+  }
+
+  const T* data() const {
+    return data_;
+  }
+
+  const T& operator[](size_t i) const {
+    return data_[i];
+  }
+
+  T& operator[](size_t i) {
+    Detach();
+    return elements_[i];
+  }
+
+  bool operator==(const MeshArray& array) const {
+    return size_ == array.size_
+        && (data_ == array.data_ || std::equal(data_, data_ + size_,
+            array.data_));
+  }
+
+  bool operator!=(const MeshArray& array) const {
+    return !(*this == array);
+  }
+
+  void push_back(const T& element) {
+    Detach();
+    elements_.push_back(element);
+    Update();
+  }
+
+  void reserve(size_t size) {
+    Detach();
+    elements_.reserve(size);
+    Update();
+  }
+
+  void resize(size_t size, const T& element = T()) {
+    Detach();
+    elements_.resize(size, element);
+    Update();
+  }
+
+  void clear() {
+    owner_.reset();
+    elements_.clear();
+    Update();
+  }
+
+  // Exchanges the elements with elements, which gets the old elements if
+  // the array owned them and is left empty if it was mapped.
+  void Swap(std::vector<T>& elements) {
+    if (is_mapped()) {
+      owner_.reset();
+      elements_.clear();
+    }
+    elements_.swap(elements);
+    Update();
+  }
+
+  // Points the array at size elements at data, which owner keeps alive.
+  void Map(const T* data, size_t size,
+      const boost::shared_ptr<const void>& owner) {
+    std::vector<T>().swap(elements_);
+    owner_ = owner;
+    data_ = data;
+    size_ = size;
+  }
+private:
+  const T* GetElementData() const {
+    return (elements_.empty() ? NULL : &elements_[0]);
+  }
+
+  void Update() {
+    data_ = GetElementData();
+    size_ = elements_.size();
+  }
+
+  void Detach() {
+    if (is_mapped()) {
+      elements_.assign(data_, data_ + size_);
+      owner_.reset();
+      Update();
+    }
+  }
+
+  std::vector<T> elements_;
+  const T* data_;
+  size_t size_;
+  boost::shared_ptr<const void> owner_;
+};
+} // namespace ray
+#endif /* MESH_ARRAY_HPP_ */
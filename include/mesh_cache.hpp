@@ -0,0 +1,118 @@
+/*
+ * mesh_cache.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef MESH_CACHE_HPP_
+#define MESH_CACHE_HPP_
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "scene.hpp"
+#include "types.hpp"
+namespace ray {
+////////
+//
+// MeshCache
+//
+// A binary snapshot of an imported scene: cameras, lights, materials and
+// every Trimesh with its vertices, normals, texture coordinates, index
+// triples, material ID and bounds.  All arrays are stored 4-byte aligned
+// in native byte order, so Load() maps the file and hands the vertex
+// arrays to the meshes without copying them; only the faces, which are
+// objects, get built from the indices.  The cache records the size and
+// modification time of the file it was made from and is rejected as
+// stale once those change.  Loaded with MappedFile::kOnDemand, the vertex
+// arrays stay on disk and are paged in as rays touch them; meshes reordered
+// by Trimesh::ImproveLocality() keep nearby triangles on the same pages.
+// A Writer streams the meshes into the file one at a time, so that a
+// scene never has to be in memory as a whole to be cached.
+//
+////////
+class MeshCache {
+public:
+  class Writer;
+  // How much of a scene there was before a file was imported into it.
+  struct SceneStart {
+    SceneStart();
+    explicit SceneStart(const Scene& scene);
+    size_t num_cameras;
+    size_t num_lights;
+    size_t num_materials;
+    size_t num_shapes;
+  };
+  // The cache file used for the scene in file_name.
+  static std::string GetCacheFileName(const std::string& file_name);
+  // Writes scene, imported from source_file, to cache_file.  Only scenes
+  // whose shapes are all Trimeshes can be cached.
+  static bool Write(const std::string& cache_file,
+      const std::string& source_file, const Scene& scene,
+      std::string& status);
+  // Writes only what source_file added to scene after start, so that the
+  // cache does not pick up scenes loaded before it.
+  static bool Write(const std::string& cache_file,
+      const std::string& source_file, const Scene& scene,
+      const SceneStart& start, std::string& status);
+  // Adds the scene in cache_file to scene, provided it is a valid cache of
+  // source_file.  scene is left untouched on failure.  The file is mapped
+  // with MappedFile::kPreload.
+  static bool Load(const std::string& cache_file,
+      const std::string& source_file, Scene& scene, std::string& status);
+  static bool Load(const std::string& cache_file,
+      const std::string& source_file, MappedFile::Access access,
+      Scene& scene, std::string& status);
+private:
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t num_cameras;
+    uint32_t num_lights;
+    uint32_t num_materials;
+    uint32_t num_meshes;
+  };
+  struct MeshHeader;
+  class Reader;
+  static bool GetSourceStamp(const std::string& source_file,
+      uint64_t& size, int64_t& mtime);
+};
+
+// Writes a cache as its meshes come in.  The cameras, lights and materials
+// that scene gained after start are written along with the first mesh, so
+// a loader has to add them before its meshes; the meshes must use
+// materials of scene.  The file only replaces cache_file once Close()
+// succeeds and is removed if the writer goes away before that.
+class MeshCache::Writer: public MeshSink {
+public:
+  Writer();
+  ~Writer();
+  bool Open(const std::string& cache_file, const std::string& source_file,
+      const Scene& scene, const SceneStart& start, std::string& status);
+  // Writes mesh, which the caller keeps and may free right away.
+  virtual bool AddMesh(Trimesh& mesh, std::string& status);
+  bool Close(std::string& status);
+private:
+  Writer(const Writer&);
+  Writer& operator=(const Writer&);
+  void WriteScene();
+  std::string cache_file_;
+  std::string temp_file_;
+  std::ofstream out_;
+  FileHeader header_;
+  const Scene* scene_;
+  SceneStart start_;
+  bool is_open_;
+  bool wrote_scene_;
+  std::vector<int32_t> indices_;
+  std::vector<glm::vec3> decoded_vertices_;
+  std::vector<glm::vec3> decoded_normals_;
+  std::vector<TexCoord> decoded_tex_coords_;
+};
+} // namespace ray
+#endif /* MESH_CACHE_HPP_ */
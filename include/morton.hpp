@@ -0,0 +1,26 @@
+/*
+ * morton.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef MORTON_HPP_
+#define MORTON_HPP_
+#include <stdint.h>
+namespace ray {
+// Space filling curves over a 2D grid.  Both map (x, y) to a position
+// along the curve such that cells close on the curve are close in the
+// grid; the Hilbert curve additionally never jumps between neighbours.
+
+// Interleaves the low 16 bits of x and y, x in the even bits.
+uint32_t MortonEncode2(uint32_t x, uint32_t y);
+void MortonDecode2(uint32_t code, uint32_t& x, uint32_t& y);
+// Interleaves the low 10 bits of x, y and z, x in the lowest bit.
+uint32_t MortonEncode3(uint32_t x, uint32_t y, uint32_t z);
+// Position of (x, y) on the Hilbert curve filling a 2^order x 2^order
+// grid, order <= 16.
+uint32_t HilbertEncode2(uint32_t order, uint32_t x, uint32_t y);
+// Smallest order such that a 2^order x 2^order grid holds size x size.
+uint32_t GetCurveOrder(uint32_t size);
+} // namespace ray
+#endif /* MORTON_HPP_ */
@@ -0,0 +1,66 @@
+/*
+ * obj_loader.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef OBJ_LOADER_HPP_
+#define OBJ_LOADER_HPP_
+#include <string>
+#include <vector>
+#include "material.hpp"
+#include "mesh.hpp"
+#include "scene.hpp"
+#include "types.hpp"
+namespace ray {
+////////
+//
+// ObjLoader
+//
+// Loads Wavefront OBJ files, and the MTL libraries they reference,
+// without going through Assimp.  The file is memory mapped and split into
+// chunks at line boundaries.  A first parallel pass counts the v, vt and
+// vn records of every chunk, so that a second parallel pass can parse
+// each chunk straight into its slice of the shared attribute arrays and
+// resolve relative (negative) indices on the spot.  Polygons are
+// triangulated as fans.  Every material gets one Trimesh, whose vertices
+// are the distinct v/vt/vn combinations its faces use; the meshes are
+// built in parallel too.  Meshes without normals get generated ones.  The
+// meshes can also be streamed to a MeshSink instead of the scene.
+//
+////////
+class ObjLoader {
+public:
+  ObjLoader();
+  int num_threads() const;
+  void set_num_threads(int num_threads);
+  bool Load(const std::string& file_name, Scene& scene, std::string& status);
+  // Adds the materials to scene but hands the meshes to sink, a few at a
+  // time, instead of adding them.
+  bool Load(const std::string& file_name, Scene& scene, MeshSink& sink,
+      std::string& status);
+  // Parses the MTL library file_name into materials and their names.
+  static bool LoadMaterials(const std::string& file_name,
+      std::vector<std::string>& names, std::vector<Material>& materials,
+      std::string& status);
+  static Material GetDefaultMaterial();
+private:
+  struct Chunk;
+  struct Corner;
+  struct MaterialSwitch;
+  struct Attributes;
+  struct Group;
+  class CountTask;
+  class ParseTask;
+  class BuildTask;
+  bool Load(const std::string& file_name, Scene& scene, MeshSink* sink,
+      std::string& status);
+  static void CountChunk(Chunk& chunk);
+  static void ParseChunk(Chunk& chunk, Attributes& attributes);
+  static bool BuildGroup(const Group& group, const Attributes& attributes,
+      const std::vector<Chunk>& chunks, Trimesh* trimesh,
+      std::string& status);
+  int num_threads_;
+};
+} // namespace ray
+#endif /* OBJ_LOADER_HPP_ */
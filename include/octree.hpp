@@ -15,6 +15,7 @@
 #include <vector>
 #include "octree_base.hpp"
 #include "shape.hpp"
+#include "tree_stats.hpp"
 namespace ray {
 template<class SceneObject, class OctNode, class EncodedNode,
     class OctNodeFactory, int max_leaf_size, int max_depth>
@@ -26,7 +27,7 @@ public:
   Octree() :
           OctreeBase<OctNode, EncodedNode, OctNodeFactory, max_leaf_size,
               max_depth>::OctreeBase(), nodes_(), scene_objects_(), bounds_(),
-          num_internal_nodes_(0), num_leaves_(0) {
+          num_internal_nodes_(0), num_leaves_(0), stats_() {
   }
 
   virtual ~Octree() {
@@ -38,18 +39,31 @@ public:
     return bounds_;
   }
 
-  void Build(const ObjectVector& objects) {
+  virtual size_t GetMemoryUsage() const {
+    return nodes_.capacity() * sizeof(EncodedNode)
+        + scene_objects_.capacity() * sizeof(const SceneObject*);
+  }
+
+  // Returns the statistics of the new tree, see stats().
+  const TreeStats& Build(const ObjectVector& objects) {
     bounds_ = BoundingBox();
     scene_objects_.clear();
     nodes_.clear();
     BuildTree(objects);
+    return stats_;
   }
 
-  void Build(const std::vector<SceneObject>& objects) {
+  const TreeStats& Build(const std::vector<SceneObject>& objects) {
     bounds_ = BoundingBox();
     scene_objects_.clear();
     nodes_.clear();
     BuildTree(objects);
+    return stats_;
+  }
+
+  // The statistics of the last build; print them with TreeStats::Print().
+  const TreeStats& stats() const {
+    return stats_;
   }
 
   virtual OctNode GetIthChildOf(const OctNode& node, uint32_t index) const {
@@ -103,12 +117,14 @@ protected:
   BoundingBox bounds_;
   uint32_t num_internal_nodes_;
   uint32_t num_leaves_;
+  TreeStats stats_;
 
   OctNode DecodeNode(const EncodedNode& encoded) const {
     return this->GetNodeFactory().CreateOctNode(encoded);
   }
 
-  EncodedNode EncodeNode(const OctNode& node) const {
+  EncodedNode EncodeNode(const OctNode& node) {
+    ScopedPhaseTimer timer(stats_.profile, BuildProfile::kEncodeNode);
     return this->GetNodeFactory().CreateEncodedNode(node);
   }
 
@@ -128,12 +144,15 @@ protected:
     Isect best;
     best.t_hit = std::numeric_limits<float>::max();
     const SceneObject* const * objects = &scene_objects_[leaf.offset()];
-    for (uint32_t i = 0; i < leaf.size(); ++i)
-      if (objects[i]->Intersect(ray, current) && current.t_hit >= t_near
-          && current.t_hit <= t_far + 10e-6 && current.t_hit < best.t_hit) {
+    for (uint32_t i = 0; i < leaf.size(); ++i) {
+      CountTraversal(TraversalStats::kPrimitivesTested);
+      if (objects[i]->Intersect(ray, current)
+          && current.t_hit >= t_near - 10e-6 && current.t_hit <= t_far + 10e-6
+          && current.t_hit < best.t_hit) {
         best = current;
         hit = true;
       }
+    }
     if (hit)
       isect = best;
     return hit;
@@ -164,12 +183,15 @@ protected:
     for (uint32_t j = 0; j < 8; ++j)
       child_work_nodes[j] = WorkNode( // initialize child lists
           this->GetChildBounds(node, work_node.bounds, j));
-    while (!work_node.objects.empty()) {
-      const SceneObject* obj = work_node.objects.back();
-      work_node.objects.pop_back();
-      for (uint32_t j = 0; j < 8; ++j)  // distribute to children
-        if (obj->GetBounds().Overlap(child_work_nodes[j].bounds))
-          child_work_nodes[j].objects.push_back(obj);
+    {
+      ScopedPhaseTimer timer(stats_.profile, BuildProfile::kDistributeObjects);
+      while (!work_node.objects.empty()) {
+        const SceneObject* obj = work_node.objects.back();
+        work_node.objects.pop_back();
+        for (uint32_t j = 0; j < 8; ++j)  // distribute to children
+          if (obj->GetBounds().Overlap(child_work_nodes[j].bounds))
+            child_work_nodes[j].objects.push_back(obj);
+      }
     }
     for (uint32_t j = 0; j < 8; ++j) {
       // If a child has a non-empty object list, process it.
@@ -188,47 +210,34 @@ protected:
     }
   }
 
-  void UpdateMeanVar(int value, int num_samples, float& mean, float& variance) {
-    float delta = value - mean;
-    mean += delta / num_samples;
-    variance += delta * (value - mean);
-  }
-
   void BuildLevel(WorkList& work_list, WorkList& next_list, uint32_t depth) {
-    float mean_objects = 0.0f, variance_objects = 0.0f;
-    float mean_children = 0.0f, variance_children = 0.0f;
-    int num_nodes = 0, num_internal = 0, num_leaves = 0;
+    float root_area = bounds_.GetArea();
     while (!work_list.empty()) {
       WorkNode work_node = work_list.back();
       work_list.pop_back();
-      // calculate some stats
-      UpdateMeanVar(work_node.objects.size(), ++num_nodes, mean_objects,
-          variance_objects);
+      uint32_t num_objects = work_node.objects.size();
+      float area_ratio = (root_area > 0.0f ?
+          work_node.bounds.GetArea() / root_area : 1.0f);
       OctNode node = DecodeNode(nodes_[work_node.node_index]);
       if (node.IsLeaf()) {
         BuildLeaf(node, work_node);
-        ++num_leaves;
+        stats_.AddLeaf(depth, num_objects, area_ratio);
       } else {
         BuildInternal(node, work_node, next_list, depth);
-        UpdateMeanVar(node.size(), ++num_internal, mean_children,
-            variance_children);
+        stats_.AddInternal(depth, num_objects, node.size(), area_ratio);
       }
       nodes_[work_node.node_index] = EncodeNode(node);
     }
-    variance_objects /= num_nodes;
-    variance_children /= num_internal;
-    std::cout << " internal: " << num_internal << " num_leaves = "
-        << num_leaves;
-    std::cout << " mean obj: " << round(mean_objects) << " stdev: "
-        << round(100.0f * sqrt(variance_objects)) / 100.0f;
-    std::cout << " mean child: " << round(mean_children) << " stdev: "
-        << round(100.0f * sqrt(variance_children)) / 100.0f;
   }
 
   void BuildTree(WorkNode& work_root) {
-    // compute bounds
-    for (uint32_t i = 0; i < work_root.objects.size(); ++i)
-      bounds_ = bounds_.Join(work_root.objects[i]->GetBounds());
+    stats_.Reset();
+    stats_.num_objects = work_root.objects.size();
+    { // compute bounds
+      ScopedPhaseTimer timer(stats_.profile, BuildProfile::kBounds);
+      for (uint32_t i = 0; i < work_root.objects.size(); ++i)
+        bounds_ = bounds_.Join(work_root.objects[i]->GetBounds());
+    }
     std::vector<WorkNode> work_list;
     std::vector<WorkNode> next_list;
     int depth = 0;
@@ -243,15 +252,11 @@ protected:
     // and next_list.  The work_list gets swapped when empty while next_list
     // fills up. Each time this happens, one level has been completed.
     while (!work_list.empty()) {
-      std::cout << "level = " << depth << " ";
       BuildLevel(work_list, next_list, depth);
       work_list.swap(next_list);
-      std::cout << std::endl;
       ++depth;
     }
-    std::cout << "num internal nodes = " << num_internal_nodes() << std::endl;
-    std::cout << "num leaves = " << num_leaves() << std::endl;
-    std::cout << "num object refs = " << scene_objects_.size() << std::endl;
+    stats_.memory_bytes = GetMemoryUsage();
   }
 
   void BuildTree(const std::vector<SceneObject>& objects) {
@@ -12,6 +12,7 @@
 #include "accelerator.hpp"
 #include "scene.hpp"
 #include "shape.hpp"
+#include "traversal_stats.hpp"
 namespace ray {
 template<class OctNode, class EncodedNode, class OctNodeFactory,
     int max_leaf_size = 32, int max_depth = 8>
@@ -77,19 +78,37 @@ protected:
     if (depth > max_depth) // check depth first
       return false;
     float t_near, t_far;
+    CountTraversal(TraversalStats::kBoxesTested);
     if (!bounds.Intersect(ray, t_near, t_far)) // check bounds next
       return false;
+    CountTraversal(TraversalStats::kNodesVisited);
     if (node.IsLeaf()) { // is this a leaf?
       bool hit = IntersectLeaf(node, ray, t_near, t_far, isect);
       return hit;
     }
-    OctNode children[4];    // can hit at most four children
-    BoundingBox child_bounds[4];
+    // A ray hits at most four children, unless it runs within a split
+    // plane and touches the children on both sides of it.
+    OctNode children[8];
+    BoundingBox child_bounds[8];
     uint32_t count = 0;
     IntersectChildren(node, bounds, ray, &children[0], &child_bounds[0], count);
+    // The children come in the order the ray enters them, but a ray that
+    // enters several at once, through an edge or a corner of the split
+    // planes, may hit farther in the first than in the next; look on while
+    // the next child starts before the hit.
     bool hit = false;
-    for (uint32_t i = 0; i < count && !hit; ++i)
-      hit = Traverse(children[i], child_bounds[i], ray, isect, depth + 1);
+    for (uint32_t i = 0; i < count; ++i) {
+      float t_child_near, t_child_far;
+      if (hit && (!child_bounds[i].Intersect(ray, t_child_near, t_child_far)
+          || t_child_near > isect.t_hit))
+        break;
+      Isect child_isect;
+      if (Traverse(children[i], child_bounds[i], ray, child_isect, depth + 1)
+          && (!hit || child_isect.t_hit < isect.t_hit)) {
+        isect = child_isect;
+        hit = true;
+      }
+    }
     return hit;
   }
 
@@ -135,12 +154,13 @@ protected:
       uint32_t& count) const {
     float t_near;
     float t_far;
-    SortHolder h[4];
+    SortHolder h[8];
     count = 0;
-    for (uint32_t i = 0; count < 4 && i < node.size(); ++i) {
+    for (uint32_t i = 0; count < 8 && i < node.size(); ++i) {
       children[count] = GetIthChildOf(node, i);
       child_bounds[count] = GetChildBounds(node, bounds,
           children[count].octant());
+      CountTraversal(TraversalStats::kBoxesTested);
       if (child_bounds[count].Intersect(ray, t_near, t_far)) {
         h[count] = SortHolder(t_near, t_far, children[count],
             child_bounds[count]);
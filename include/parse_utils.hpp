@@ -6,7 +6,34 @@
  */
 #ifndef PARSE_UTILS_HPP_
 #define PARSE_UTILS_HPP_
+#include <string>
+#include <vector>
 namespace ray {
 bool ParseInt(const char* str, int* value);
+
+// A value read by ParseJson().  Only the members for type are set: the
+// elements of an array, or the values of the members of an object, with
+// their names, in the order of the text.
+struct JsonValue {
+    enum Type {
+        kNull, kBool, kNumber, kString, kArray, kObject
+    };
+    JsonValue();
+    // The value of the member called name of an object, or NULL.
+    const JsonValue* Find(const std::string& name) const;
+    Type type;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::string> names;
+};
+
+// Parses the JSON values of text, which may hold several one after the
+// other, as when the output of repeated runs is appended to one file.
+// Returns false, with the position of the error in status, on malformed
+// text.
+bool ParseJson(const std::string& text, std::vector<JsonValue>& values,
+        std::string& status);
 } // namespace ray
 #endif /* PARSE_UTILS_HPP_ */
@@ -0,0 +1,49 @@
+/*
+ * perf_counters.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef PERF_COUNTERS_HPP_
+#define PERF_COUNTERS_HPP_
+#include <stdint.h>
+#include <ostream>
+namespace ray {
+////////
+//
+// PerfCounters
+//
+// Hardware counters of the calling thread and of the threads it creates
+// while counting, read through Linux perf_event_open(2).  Events the
+// kernel or the machine does not support (e.g. in a VM, or with
+// perf_event_paranoid set) are simply reported as unavailable.  Generic
+// perf events have no L2 cache event, so the last level cache stands in
+// for it.
+//
+////////
+class PerfCounters {
+public:
+  enum Event {
+    kCycles, kInstructions, kL1DReads, kL1DMisses, kLLCReads, kLLCMisses,
+    kNumEvents
+  };
+  PerfCounters();
+  ~PerfCounters();
+  void Start();
+  void Stop();
+  bool available(Event event) const;
+  uint64_t value(Event event) const;
+  // Hit rate of a cache in [0, 1], or a negative value if unavailable.
+  float L1DHitRate() const;
+  float LLCHitRate() const;
+  void Print(std::ostream& out) const;
+  static const char* GetEventName(Event event);
+private:
+  PerfCounters(const PerfCounters&);
+  PerfCounters& operator=(const PerfCounters&);
+  float HitRate(Event reads, Event misses) const;
+  int fds_[kNumEvents];
+  uint64_t values_[kNumEvents];
+};
+} // namespace ray
+#endif /* PERF_COUNTERS_HPP_ */
@@ -0,0 +1,24 @@
+/*
+ * quantize.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef QUANTIZE_HPP_
+#define QUANTIZE_HPP_
+#include <stdint.h>
+#include "types.hpp"
+namespace ray {
+// Compact encodings of vertex attributes.
+
+// IEEE 754 half precision, rounding to nearest even.  Values too large
+// for a half become infinity; NaN stays NaN.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+// Unit vector mapped onto an octahedron unfolded into a square, stored as
+// two 16 bit signed normalized coordinates, x in the low half.  The
+// decoded vector is normalized; the angular error is below 0.01 degrees.
+uint32_t EncodeOctahedral(const glm::vec3& normal);
+glm::vec3 DecodeOctahedral(uint32_t code);
+} // namespace ray
+#endif /* QUANTIZE_HPP_ */
@@ -0,0 +1,95 @@
+/*
+ * ray_capture.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef RAY_CAPTURE_HPP_
+#define RAY_CAPTURE_HPP_
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ray.hpp"
+#include "shape.hpp"
+namespace ray {
+// xorshift32.  Its sequence is the same on every platform, so that ray
+// sets generated from a seed are reproducible.
+class RandomSequence {
+public:
+  explicit RandomSequence(uint32_t seed);
+  // Uniform in [0, 1).
+  float Next();
+  // Uniform in [0, n).
+  uint32_t Next(uint32_t n);
+  glm::vec3 NextDirection();
+private:
+  uint32_t state_;
+};
+
+// A ray as recorded for replay, with what it was traced for.
+struct CapturedRay {
+  enum Type {
+    kPrimary, kShadow, kIncoherent, kNumTypes
+  };
+  CapturedRay();
+  CapturedRay(const Ray& ray, Type type);
+  Ray GetRay() const;
+  glm::vec3 origin;
+  glm::vec3 direction;
+  uint32_t type;
+};
+
+////////
+//
+// RayCapture
+//
+// Records the rays a RayTracer traces, see RayTracer::set_ray_capture(),
+// so that the same workload can be replayed through every accelerator.
+// Every render thread appends to its own cache line aligned buffer,
+// without locks; GetRays() and Write() concatenate the buffers by thread,
+// so the order of the rays differs from run to run.  Ray files hold a
+// small header and the rays as 28 byte records of origin, direction and
+// type, in native byte order.
+//
+////////
+class RayCapture {
+public:
+  RayCapture();
+  ~RayCapture();
+  // Called by the RayTracer before a render traced by num_threads
+  // threads.  Keeps the rays recorded so far.
+  void Start(int num_threads);
+  // Called by render thread thread_index, which must be below the
+  // num_threads of the last Start().
+  void Record(int thread_index, const Ray& ray, CapturedRay::Type type);
+  void Clear();
+  // Replaces rays with the rays of every thread.
+  void GetRays(std::vector<CapturedRay>& rays) const;
+  bool Write(const std::string& file_name, std::string& status) const;
+  static bool Write(const std::string& file_name,
+      const std::vector<CapturedRay>& rays, std::string& status);
+  // Replaces rays with those of file_name.  rays is left untouched on
+  // failure.
+  static bool Read(const std::string& file_name,
+      std::vector<CapturedRay>& rays, std::string& status);
+  // Appends num_rays rays with origins uniformly distributed in bounds and
+  // uniformly distributed directions: the worst case for the coherence of
+  // the traversal.  The same seed gives the same rays.
+  static void GenerateIncoherent(const BoundingBox& bounds, int num_rays,
+      uint32_t seed, std::vector<CapturedRay>& rays);
+  // "primary", "shadow" or "incoherent".
+  static const char* GetTypeName(CapturedRay::Type type);
+private:
+  RayCapture(const RayCapture&);
+  RayCapture& operator=(const RayCapture&);
+  struct ThreadBuffer {
+    std::vector<CapturedRay> rays;
+    char padding[64 - sizeof(std::vector<CapturedRay>)];
+  };
+  // Allocated cache line aligned, one buffer per line.
+  ThreadBuffer* threads_;
+  int num_threads_;
+};
+} // namespace ray
+#endif /* RAY_CAPTURE_HPP_ */
@@ -7,37 +7,215 @@
 
 #ifndef RAYTRACER_HPP_
 #define RAYTRACER_HPP_
+#include <stdint.h>
+#include <sys/time.h>
+#include <utility>
+#include <vector>
 #include "scene.hpp"
 #include "camera.hpp"
+#include "framebuffer.hpp"
 #include "image.hpp"
+#include "ray_capture.hpp"
+#include "render_metrics.hpp"
 #include "transform.hpp"
+#include "traversal_stats.hpp"
 #include "types.hpp"
+#include "worker_pool.hpp"
 namespace ray {
+// A rectangular block of pixels of one view.  view indexes the camera
+// (and image) of a multi-view render and is 0 for a single view.
+struct RenderTile {
+  RenderTile();
+  RenderTile(int view, int x, int y, int width, int height);
+  int view;
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// Which pixels of a tile a pass traces; see RayTracer::TraceTile().
+struct RenderPass {
+  RenderPass(int stride, bool first, bool accumulate);
+  int stride;
+  bool first;
+  bool accumulate;
+};
+
+struct RenderStats {
+  RenderStats();
+  void Reset();
+  void AtomicAdd(const RenderStats& stats);
+  // Summed over a whole render, which may take more than 2^31 samples.
+  int64_t hits;
+  int64_t misses;
+};
+
+// Receives notifications while a RayTracer renders.  OnProgress() is
+// called from the worker threads; OnPassComplete() is called between the
+// passes of a progressive render, when no worker is running.
+class RenderCallback {
+public:
+  virtual ~RenderCallback();
+  virtual void OnProgress(int percent);
+  virtual void OnPassComplete(const Image& image, int pass, int num_passes);
+};
+
+// Receives the tiles of RayTracer::Render(TileSink&) as they are finished,
+// in no particular order.  WriteTile() is called from the worker threads,
+// concurrently for different tiles.  framebuffer holds just the tile, with
+// its pixel (0, 0) at (tile.x, tile.y) of the image, and is reused once
+// WriteTile() returns.  Returning false stops the render.
+class TileSink {
+public:
+  virtual ~TileSink();
+  virtual bool WriteTile(const RenderTile& tile,
+      const Framebuffer& framebuffer) = 0;
+};
+
 class RayTracer {
 public:
+  // Order in which the tiles of a view are handed to the workers.  With
+  // kMorton and kHilbert the pixels of a tile are traced in Morton order
+  // too, so consecutive rays stay close on screen and reuse the tree
+  // nodes and triangles the previous rays pulled into the cache.
+  enum PixelOrder {
+    kRowMajor, kMorton, kHilbert, kNumPixelOrders
+  };
   RayTracer();
   RayTracer(Scene* scene, Camera* camera);
   void Render(Image& image);
+  // Render image and, into heatmap, how much tree traversal work the rays
+  // of each pixel took, as counted by heatmap_counter(): a false color
+  // scale from blue for none to red for the largest count of the image.
+  // The trees only count when built with RAY_TRAVERSAL_STATS; see
+  // traversal_stats.hpp.
+  void Render(Image& image, Image& heatmap);
+  // Render every camera into its own image in one job.  Tiles of all views
+  // are interleaved on the worker pool.  images is resized to match.
+  void Render(const std::vector<Camera*>& cameras, std::vector<Image>& images);
+  // Render into sink tile by tile, without an image of the full size.
+  // Returns false if the sink failed.
+  bool Render(TileSink& sink);
+  // Render only the pixels of region, clipped to the camera.  Every pixel
+  // comes out the same whichever region, tile size or pixel order it is
+  // rendered with, so that regions rendered separately, e.g. by several
+  // processes, merge into exactly the full render.
+  bool Render(TileSink& sink, const RenderTile& region);
+  // The band of rows shard, out of num_shards, of a width x height image
+  // covers.  The bands are as even as possible and cover the image.
+  static RenderTile GetShard(int shard, int num_shards, int width,
+      int height);
+  // Render all, or the selected, cameras of the scene at width x height.
+  void RenderSceneCameras(int width, int height, std::vector<Image>& images);
+  void RenderSceneCameras(const std::vector<int>& camera_indices, int width,
+      int height, std::vector<Image>& images);
+  // Render in passes of decreasing pixel stride, each pass filling the
+  // pixels it traced as blocks, until every pixel is traced or deadline
+  // (wall-clock, as from gettimeofday) expires.  The image always holds
+  // the best result so far.  Returns true if the image is complete.
+  bool RenderProgressive(Image& image, const timeval& deadline);
+  // Add one jittered sample to every pixel of framebuffer, resizing it to
+  // the camera first if needed.  Repeated calls converge to a supersampled
+  // image; Framebuffer::Resolve() converts it for display.
+  void Accumulate(Framebuffer& framebuffer);
   const glm::vec3& background_color() const;
   void set_background_color(const glm::vec3& background_color);
   bool display_progress() const;
   void set_display_progress(bool display_progress);
   bool display_stats() const;
   void set_display_stats(bool display_stats);
+  int num_threads() const;
+  void set_num_threads(int num_threads);
+  int tile_size() const;
+  void set_tile_size(int tile_size);
+  // Adaptive antialiasing.  Every pixel gets at least min_samples rays;
+  // more are added, up to max_samples, until the standard error of the
+  // pixel's mean color (on a 0..1 scale) is below error_threshold in
+  // every channel.  max_samples <= 1, the default, traces a single ray
+  // through the pixel center.
+  void set_antialiasing(int min_samples, int max_samples,
+      float error_threshold);
+  int min_samples() const;
+  int max_samples() const;
+  float error_threshold() const;
+  TraversalStats::Counter heatmap_counter() const;
+  void set_heatmap_counter(TraversalStats::Counter heatmap_counter);
+  PixelOrder pixel_order() const;
+  void set_pixel_order(PixelOrder pixel_order);
+  // Applied when the radiance of Render() and RenderProgressive() is
+  // converted to 8 bits.  The default truncates 255 * color.
+  const ToneMapping& tone_mapping() const;
+  void set_tone_mapping(const ToneMapping& tone_mapping);
+  RenderCallback* render_callback() const;
+  void set_render_callback(RenderCallback* render_callback);
+  // If not NULL, every ray traced is recorded to ray_capture.  The tracer
+  // only casts primary rays, one or, with antialiasing, several per pixel.
+  RayCapture* ray_capture() const;
+  void set_ray_capture(RayCapture* ray_capture);
+  // If not NULL, every render counts its tiles, rays and the time each
+  // thread spends tracing into render_metrics, for a MetricsExporter.
+  RenderMetrics* render_metrics() const;
+  void set_render_metrics(RenderMetrics* render_metrics);
+  // The color of isect, lit by every light of the scene, without tracing
+  // any further rays.
+  glm::vec3 Shade(const Isect& isect) const;
+  const RenderStats& stats() const;
   void set_scene(Scene* scene);
   void set_camera(Camera* camera);
 private:
+  class TileTask;
+  static const int kMaxProgressiveStride = 16;
+  void RenderViews(const std::vector<const Camera*>& cameras,
+      const std::vector<Image*>& images);
+  void CreateTiles(const std::vector<const Camera*>& cameras,
+      std::vector<RenderTile>& tiles) const;
+  bool RunTiles(const std::vector<const Camera*>& cameras,
+      const std::vector<Framebuffer*>& framebuffers,
+      const std::vector<RenderTile>& tiles, const RenderPass& pass,
+      const timeval* deadline, int num_pixels);
+  void TraceTile(const Camera& camera, const RenderTile& tile,
+      const RenderPass& pass, Framebuffer& framebuffer, int origin_x,
+      int origin_y, int thread_index, RenderStats& stats) const;
+  void UpdateProgress(int pixels_done, int num_pixels);
+  void StartMetrics(int num_tiles, int num_pixels);
+  void FinishMetrics();
+  static bool CompareTileKeys(const std::pair<uint32_t, RenderTile>& a,
+      const std::pair<uint32_t, RenderTile>& b);
+  static bool IsExpired(const timeval* deadline);
+  static glm::vec2 SampleOffset(int sample);
+  static float RadicalInverse(int base, int index);
+  static glm::vec3 HeatmapColor(float t);
   float Diffuse(const Isect& isect, const Light& light) const;
   float Specular(const Isect& isect, const Light& light) const;
   float Attenuate(const Isect& isect, const Light& light) const;
-  glm::vec3 Shade(const Isect& isect) const;
-  glm::vec3 TraceRay(int pixel_x, int pixel_y) const;
-  glm::vec3 TraceRay(const Ray& ray) const;
+  glm::vec3 TraceRay(const Camera& camera, int pixel_x, int pixel_y,
+      int thread_index, RenderStats& stats) const;
+  glm::vec3 TraceRay(const Ray& ray, int thread_index,
+      RenderStats& stats) const;
   Scene* scene_;
   Camera* camera_;
   glm::vec3 background_color_;
   bool display_progress_;
   bool display_stats_;
+  int num_threads_;
+  int tile_size_;
+  PixelOrder pixel_order_;
+  int min_samples_;
+  int max_samples_;
+  float error_threshold_;
+  ToneMapping tone_mapping_;
+  RenderCallback* render_callback_;
+  TraversalStats::Counter heatmap_counter_;
+  // Traversal counts per pixel while Render() makes a heatmap, or NULL.
+  uint32_t* heatmap_counts_;
+  RayCapture* ray_capture_;
+  RenderMetrics* render_metrics_;
+  volatile int current_progress_;
+  RenderStats stats_;
+  // Kept between renders, so that rendering frames of the same size does
+  // not allocate.
+  std::vector<Framebuffer> framebuffers_;
 };
 } // namespace ray
 #endif /* RAYTRACER_HPP_ */
@@ -0,0 +1,121 @@
+/*
+ * render_metrics.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef RENDER_METRICS_HPP_
+#define RENDER_METRICS_HPP_
+#include <pthread.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+namespace ray {
+// The state of a render at one point in time.
+struct MetricsSnapshot {
+  MetricsSnapshot();
+  bool running;
+  double elapsed_seconds;
+  int64_t num_tiles;
+  int64_t tiles_done;
+  // Pixels of the tiles; a progressive render counts every pass.
+  int64_t num_pixels;
+  int64_t pixels_done;
+  int64_t hits;
+  int64_t misses;
+  // Pixel samples, hits and misses, per second since the render started.
+  double samples_per_second;
+  // Seconds left at the rate so far, or negative before the first tile.
+  double eta_seconds;
+  // Resident set size of the process, or 0 if unknown.
+  int64_t resident_bytes;
+  // Fraction of the elapsed time each render thread spent tracing tiles.
+  std::vector<double> thread_utilization;
+};
+
+////////
+//
+// RenderMetrics
+//
+// Live counters of a render, see RayTracer::set_render_metrics(), for
+// watching long renders from another thread.  Every render thread adds
+// atomically to its own cache line sized slot, without locks or shared
+// writes, after each tile; GetSnapshot() sums the slots.  The slots are
+// only allocated, under a mutex the render threads never take, when a
+// render starts.
+//
+////////
+class RenderMetrics {
+public:
+  RenderMetrics();
+  ~RenderMetrics();
+  // Called by the RayTracer before the tiles of a render are traced.
+  void Start(int num_tiles, int num_pixels, int num_threads);
+  void Finish();
+  // Called by render thread thread_index after tracing a tile.
+  void AddTile(int thread_index, int num_pixels, int64_t hits,
+      int64_t misses, int64_t microseconds);
+  void GetSnapshot(MetricsSnapshot& snapshot) const;
+  static int64_t GetMicroseconds();
+  static int64_t GetResidentBytes();
+private:
+  struct ThreadCounters {
+    int64_t tiles;
+    int64_t pixels;
+    int64_t hits;
+    int64_t misses;
+    int64_t busy_microseconds;
+    char padding[64 - 5 * sizeof(int64_t)];
+  };
+  RenderMetrics(const RenderMetrics&);
+  RenderMetrics& operator=(const RenderMetrics&);
+  ThreadCounters* threads_;
+  int num_threads_;
+  int64_t num_tiles_;
+  int64_t num_pixels_;
+  volatile int64_t start_microseconds_;
+  volatile int64_t finish_microseconds_;
+  mutable pthread_mutex_t mutex_;
+};
+// As JSON, or in the Prometheus text format.
+void WriteJson(std::ostream& out, const MetricsSnapshot& snapshot);
+void WritePrometheus(std::ostream& out, const MetricsSnapshot& snapshot);
+
+////////
+//
+// MetricsExporter
+//
+// Rewrites a file with a snapshot of a RenderMetrics every interval
+// seconds on a background thread, and once more when stopped.  Files
+// ending in .prom are written in the Prometheus text format, e.g. for the
+// textfile collector of node_exporter, others as JSON.  Each snapshot is
+// written to a temporary file that is then renamed over the file, so a
+// reader never sees a partial one.
+//
+////////
+class MetricsExporter {
+public:
+  MetricsExporter(const RenderMetrics& metrics, const std::string& file_name,
+      double interval_seconds);
+  ~MetricsExporter();
+  bool Start(std::string& status);
+  // Stops the thread and writes the final snapshot.
+  bool Stop(std::string& status);
+  bool Write(std::string& status) const;
+private:
+  MetricsExporter(const MetricsExporter&);
+  MetricsExporter& operator=(const MetricsExporter&);
+  static void* ExporterMain(void* arg);
+  void Run();
+  const RenderMetrics& metrics_;
+  std::string file_name_;
+  double interval_seconds_;
+  bool stopping_;
+  bool started_;
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t changed_;
+};
+} // namespace ray
+#endif /* RENDER_METRICS_HPP_ */
@@ -179,6 +179,8 @@ protected:
 
   void EvaluateBinnedCost(const ObjectVector& objects,
       const BoundingBox& bounds, float& cost, glm::vec3& split) {
+    ScopedPhaseTimer timer(this->stats_.profile,
+        BuildProfile::kEvaluateBinnedCost);
     int k = floor(pow(objects.size() / 2.0, 1.0f / 3.0f)) + 1;
     if ((kMixed64 == evaluation_policy_ && objects.size() < 64)
         || (kMixed128 == evaluation_policy_ && objects.size() < 128)
@@ -224,9 +226,13 @@ protected:
     }
 
     //  sample each counting function using image integral
-    for (uint32_t octant = 0; octant < 8; ++octant)
-      image_integrals[octant].OrientedImageIntegral(
-          OctantToOrientation(octant));
+    {
+      ScopedPhaseTimer timer(this->stats_.profile,
+          BuildProfile::kImageIntegral);
+      for (uint32_t octant = 0; octant < 8; ++octant)
+        image_integrals[octant].OrientedImageIntegral(
+            OctantToOrientation(octant));
+    }
 
     // find lowest cost vertex
     float area = 0.0f;
@@ -311,21 +317,26 @@ protected:
     for (uint32_t j = 0; j < 8; ++j)
       child_work_nodes[j] = WorkNodeType( // initialize child lists
           this->GetChildBounds(node, work_node.bounds, j));
-    while (!work_node.objects.empty()) {
-      const SceneObject* obj = work_node.objects.back();
-      work_node.objects.pop_back();
-      for (uint32_t j = 0; j < 8; ++j) { // distribute to children
-        //if (child_work_nodes[j].bounds.GetVolume() > 0.0f
-        //    && obj->GetBounds().Overlap(child_work_nodes[j].bounds))
-        //  child_work_nodes[j].objects.push_back(obj);
-        BoundingBox result_bounds;
-        BoundingBox child_bounds = child_work_nodes[j].bounds;
-        //bool overlap = child_bounds.GetVolume() > 0.0f
-        //    && child_bounds.Intersect(obj->GetBounds(), result_bounds)
-        //    && result_bounds.GetVolume();
-        bool overlap = child_bounds.Intersect(obj->GetBounds(), result_bounds);
-        if (overlap)
-          child_work_nodes[j].objects.push_back(obj);
+    {
+      ScopedPhaseTimer timer(this->stats_.profile,
+          BuildProfile::kDistributeObjects);
+      while (!work_node.objects.empty()) {
+        const SceneObject* obj = work_node.objects.back();
+        work_node.objects.pop_back();
+        for (uint32_t j = 0; j < 8; ++j) { // distribute to children
+          //if (child_work_nodes[j].bounds.GetVolume() > 0.0f
+          //    && obj->GetBounds().Overlap(child_work_nodes[j].bounds))
+          //  child_work_nodes[j].objects.push_back(obj);
+          BoundingBox result_bounds;
+          BoundingBox child_bounds = child_work_nodes[j].bounds;
+          //bool overlap = child_bounds.GetVolume() > 0.0f
+          //    && child_bounds.Intersect(obj->GetBounds(), result_bounds)
+          //    && result_bounds.GetVolume();
+          bool overlap = child_bounds.Intersect(obj->GetBounds(),
+              result_bounds);
+          if (overlap)
+            child_work_nodes[j].objects.push_back(obj);
+        }
       }
     }
     for (uint32_t j = 0; j < 8; ++j) {
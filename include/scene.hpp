@@ -18,7 +18,8 @@ public:
   Material* const & material() const;
   void set_material(Material* const & material);
   bool trace() const;
-  void set_trace(bool trace);
+  // Set before rendering, not while the shape is intersected.
+  virtual void set_trace(bool trace);
 protected:
   SceneShape();
   SceneShape(Material* const & material);
@@ -50,6 +51,8 @@ public:
   const std::vector<SceneShape*>& scene_objects() const;
   bool Intersect(const Ray& ray, Isect& isect);
   bool trace() const;
+  // Sets the trace flag of every shape.  Intersect() only reads it, so
+  // the render threads can share the scene.
   void set_trace(bool trace);
 private:
   std::vector<Camera> cameras_;
@@ -9,6 +9,7 @@
 #define SCENE_UTILS_HPP_
 #include <assimp/scene.h>
 #include <assimp/camera.h>
+#include "mesh.hpp"
 #include "scene.hpp"
 #include "types.hpp"
 namespace ray {
@@ -20,13 +21,56 @@ public:
             const std::string& file_name,
             Scene& scene,
             std::string& status);
+    // With this on, OBJ files are read by ObjLoader rather than Assimp.
+    // ObjLoader is faster but skips Assimp's FindDegenerates and
+    // FixInfacingNormals steps, and fails on a missing MTL file.  Off by
+    // default.
+    bool use_native_obj() const;
+    void set_use_native_obj(bool use_native_obj);
+    // With the mesh cache on, a scene is loaded from its MeshCache file
+    // when that is up to date, and the cache is written after every other
+    // successful import.  The cache file lives next to the scene file.
+    bool use_mesh_cache() const;
+    void set_use_mesh_cache(bool use_mesh_cache);
+    // Loaded meshes are switched to compact vertex storage, see
+    // Trimesh::Compact().  Off by default.
+    bool compact_meshes() const;
+    void set_compact_meshes(bool compact_meshes);
+    // Imported meshes are sorted along a Morton curve, see
+    // Trimesh::ImproveLocality(), which changes the order of their faces
+    // and vertices.  Off by default; the tools that trace rays turn it on.
+    bool reorder_meshes() const;
+    void set_reorder_meshes(bool reorder_meshes);
+    // Out-of-core meshes: the vertices are left in the mesh cache and
+    // paged in on demand, see MeshCache.  A missing or stale cache is
+    // written first, streaming the meshes into it as they are imported, so
+    // the directory of the scene must be writable; otherwise the scene is
+    // loaded into memory.  Compaction copies the vertices back into
+    // memory.  Off by default.
+    bool page_meshes() const;
+    void set_page_meshes(bool page_meshes);
 private:
     SceneLoader();
     SceneLoader(const SceneLoader&);
+    class PagedSink;
     void ImportCamera(Scene& scene, const aiCamera* const camera);
     void ImportLight(Scene& scene, const aiLight* const light);
     void ImportMaterial(Scene& scene, const aiMaterial* const material);
-    void ImportMesh(Scene& scene, const aiMesh* const mesh);
+    bool ImportMesh(Scene& scene, const aiMesh* const mesh, MeshSink* sink,
+            std::string& status);
+    // Adds the meshes to scene, or hands them to sink if that is not NULL.
+    bool Import(const std::string& file_name, Scene& scene, MeshSink* sink,
+            std::string& status);
+    bool ImportPaged(const std::string& file_name,
+            const std::string& cache_file, Scene& scene);
+    bool use_native_obj_;
+    bool use_mesh_cache_;
+    bool compact_meshes_;
+    bool reorder_meshes_;
+    bool page_meshes_;
 };
+// A perspective camera looking down -z at the bounds of the Trimeshes of
+// scene, for scenes that come without one.
+Camera FrameScene(const Scene& scene, int width, int height);
 }
 #endif /* SCENE_UTILS_HPP_ */
@@ -0,0 +1,73 @@
+/*
+ * tile_writer.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef TILE_WRITER_HPP_
+#define TILE_WRITER_HPP_
+#include <stddef.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include "framebuffer.hpp"
+#include "raytracer.hpp"
+namespace ray {
+////////
+//
+// TileWriter
+//
+// Streams the tiles of a render straight into a binary PPM (8 bit, tone
+// mapped) or PFM (32 bit float radiance) file.  Both formats are a short
+// header followed by fixed size pixels, so Open() sizes the whole file up
+// front and every row of a tile is written at its final offset with
+// pwrite().  Tiles can therefore arrive in any order and from several
+// threads at once, and the memory used is that of the tiles in flight,
+// whatever the size of the image.  Rendering one shard (see
+// RayTracer::GetShard()) per process into its own file leaves the other
+// rows as holes; Merge() then copies each shard's rows into one file.
+//
+////////
+class TileWriter: public TileSink {
+public:
+  enum Format {
+    kPPM, kPFM, kNumFormats
+  };
+  TileWriter();
+  virtual ~TileWriter();
+  // The format is chosen by the extension of file_name, .ppm or .pfm.
+  bool Open(const std::string& file_name, int width, int height,
+      std::string& status);
+  bool Open(const std::string& file_name, int width, int height,
+      Format format, std::string& status);
+  bool Close(std::string& status);
+  bool is_open() const;
+  // Used to convert the radiance of PPM files to 8 bits.
+  const ToneMapping& tone_mapping() const;
+  void set_tone_mapping(const ToneMapping& tone_mapping);
+  virtual bool WriteTile(const RenderTile& tile,
+      const Framebuffer& framebuffer);
+  // Assembles file_name from shard_files, where shard_files[i] holds the
+  // rows of shard i of shard_files.size().  The shards must agree on the
+  // format and size.
+  static bool Merge(const std::vector<std::string>& shard_files,
+      const std::string& file_name, std::string& status);
+private:
+  TileWriter(const TileWriter&);
+  TileWriter& operator=(const TileWriter&);
+  static bool ReadHeader(int fd, Format& format, int& width, int& height,
+      size_t& header_size);
+  off_t GetOffset(int row, int x) const;
+  bool WriteRow(const void* data, size_t size, int row, int x);
+  int fd_;
+  std::string file_name_;
+  Format format_;
+  int width_;
+  int height_;
+  size_t header_size_;
+  size_t pixel_size_;
+  ToneMapping tone_mapping_;
+  volatile bool failed_;
+};
+} // namespace ray
+#endif /* TILE_WRITER_HPP_ */
@@ -0,0 +1,52 @@
+/*
+ * tool_utils.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef TOOL_UTILS_HPP_
+#define TOOL_UTILS_HPP_
+#include <fstream>
+#include <ios>
+#include <string>
+namespace ray {
+// Helpers shared by the command line tools: ray_bench, ray_replay,
+// micro_bench, bench_compare and image_diff.
+
+// Wall clock time in seconds.
+double GetSeconds();
+// Sets the usage string Die() prints; call first in main().
+void SetUsage(const char* usage);
+// Prints message and the usage string to std::cerr and exits.
+void Die(const std::string& message);
+// The value of str, or dies if it is not a positive integer.
+int ParsePositive(const char* str);
+// The value of str, or dies if it is not a number in [min, max].
+double ParseNumber(const char* str, double min, double max);
+
+////////
+//
+// CoutSilencer
+//
+// The loaders and trees print diagnostics to std::cout, and change its
+// format.  While muted std::cout writes to /dev/null, so that a tool can
+// keep them out of its report; Restore(), or the destructor, brings back
+// the buffer and the format std::cout had at construction.
+//
+////////
+class CoutSilencer {
+public:
+  CoutSilencer();
+  ~CoutSilencer();
+  void Mute();
+  void Restore();
+private:
+  CoutSilencer(const CoutSilencer&);
+  CoutSilencer& operator=(const CoutSilencer&);
+  std::ofstream null_stream_;
+  std::ios format_;
+  std::streambuf* buffer_;
+  bool muted_;
+};
+} // namespace ray
+#endif /* TOOL_UTILS_HPP_ */
@@ -0,0 +1,47 @@
+/*
+ * traversal_stats.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef TRAVERSAL_STATS_HPP_
+#define TRAVERSAL_STATS_HPP_
+#include <stdint.h>
+namespace ray {
+////////
+//
+// TraversalStats
+//
+// Running counts of the work the trees do for the rays of one thread:
+// nodes whose box a ray entered, ray / box tests and ray / object tests.
+// The trees only count when RAY_TRAVERSAL_STATS is defined, e.g. with
+// cmake -DRAY_TRAVERSAL_STATS=ON; otherwise kCountTraversal is false and
+// the counting compiles away.  The counts never reset, so the work of a
+// ray is the difference of the counts before and after it.
+//
+////////
+#ifdef RAY_TRAVERSAL_STATS
+const bool kCountTraversal = true;
+#else
+const bool kCountTraversal = false;
+#endif
+
+struct TraversalStats {
+  enum Counter {
+    kNodesVisited, kBoxesTested, kPrimitivesTested, kNumCounters
+  };
+  uint32_t counts[kNumCounters];
+};
+
+// The counts of the calling thread, zero when it starts.
+inline TraversalStats& GetThreadTraversalStats() {
+  static __thread TraversalStats stats;
+  return stats;
+}
+
+inline void CountTraversal(TraversalStats::Counter counter) {
+  if (kCountTraversal)
+    ++GetThreadTraversalStats().counts[counter];
+}
+} // namespace ray
+#endif /* TRAVERSAL_STATS_HPP_ */
@@ -12,6 +12,8 @@
 #include <sys/types.h>
 #include "scene.hpp"
 #include "shape.hpp"
+#include "traversal_stats.hpp"
+#include "tree_stats.hpp"
 namespace ray {
 template<class SceneObject, class Node, class EncodedNode, class NodeFactory>
 class TreeBase: public Accelerator {
@@ -20,7 +22,7 @@ public:
 
   TreeBase() :
       Accelerator(), max_leaf_size_(0), max_depth_(0), num_internal_nodes_(0),
-          num_leaves_(0), nodes_(), scene_objects_(), bounds_() {
+          num_leaves_(0), nodes_(), scene_objects_(), bounds_(), stats_() {
   }
 
   virtual ~TreeBase() {
@@ -28,18 +30,26 @@ public:
     scene_objects_.clear();
   }
 
-  void Build(const ObjectVector& objects) {
+  // Returns the statistics of the new tree, see stats().
+  const TreeStats& Build(const ObjectVector& objects) {
     bounds_ = BoundingBox();
     scene_objects_.clear();
     nodes_.clear();
     BuildTree(objects);
+    return stats_;
   }
 
-  void Build(const std::vector<SceneObject>& objects) {
+  const TreeStats& Build(const std::vector<SceneObject>& objects) {
     bounds_ = BoundingBox();
     scene_objects_.clear();
     nodes_.clear();
     BuildTree(objects);
+    return stats_;
+  }
+
+  // The statistics of the last build; print them with TreeStats::Print().
+  const TreeStats& stats() const {
+    return stats_;
   }
 
   virtual bool Intersect(const Ray& ray, Isect& isect) const {
@@ -79,6 +89,11 @@ public:
     return bounds_;
   }
 
+  virtual size_t GetMemoryUsage() const {
+    return nodes_.capacity() * sizeof(EncodedNode)
+        + scene_objects_.capacity() * sizeof(const SceneObject*);
+  }
+
   uint32_t max_leaf_size() const {
     return max_leaf_size_;
   }
@@ -119,6 +134,7 @@ protected:
   std::vector<EncodedNode> nodes_;
   ObjectVector scene_objects_;
   BoundingBox bounds_;
+  TreeStats stats_;
 
   ////////
   //
@@ -190,7 +206,8 @@ protected:
     return this->GetNodeFactory().CreateNode(encoded);
   }
 
-  EncodedNode EncodeNode(const Node& node) const {
+  EncodedNode EncodeNode(const Node& node) {
+    ScopedPhaseTimer timer(stats_.profile, BuildProfile::kEncodeNode);
     return this->GetNodeFactory().CreateEncodedNode(node);
   }
 
@@ -212,13 +229,14 @@ protected:
       std::cout << "IntersectLeaf: ";
     const SceneObject* const * objects = &scene_objects_[leaf.offset()];
     for (uint32_t i = 0; i < leaf.num_objects(); ++i) {
+      CountTraversal(TraversalStats::kPrimitivesTested);
       bool obj_hit = objects[i]->Intersect(ray, current);
       if (obj_hit && this->trace_)
         std::cout << std::setprecision(9) << current.t_hit << " "
             << " t_near = " << t_near << " t_far =" << t_far << " best = "
             << best.t_hit << std::endl;
-      if (obj_hit && current.t_hit >= t_near && current.t_hit <= t_far + 10e-6
-          && current.t_hit < best.t_hit) {
+      if (obj_hit && current.t_hit >= t_near - 10e-6
+          && current.t_hit <= t_far + 10e-6 && current.t_hit < best.t_hit) {
         best = current;
         hit = true;
       }
@@ -235,8 +253,10 @@ protected:
     if (depth > max_depth_) // check depth first
       return false;
     float t_near, t_far;
+    CountTraversal(TraversalStats::kBoxesTested);
     if (!bounds.Intersect(ray, t_near, t_far)) // check bounds next
       return false;
+    CountTraversal(TraversalStats::kNodesVisited);
     if (node.IsLeaf()) // is this a leaf?
       return IntersectLeaf(node, ray, t_near, t_far, isect);
     Node* children = new Node[node.num_children()];
@@ -246,9 +266,23 @@ protected:
       std::cout << ray << std::endl;
     IntersectChildren(node, bounds, ray, t_near, t_far, &children[0],
         &child_bounds[0], count);
+    // The children come in the order the ray enters them, but a ray that
+    // enters two at once, through an edge of the split plane, may hit
+    // farther in the first than in the second; look on while the next
+    // child starts before the hit.
     bool hit = false;
-    for (uint32_t i = 0; i < count && !hit; ++i)
-      hit = Traverse(children[i], child_bounds[i], ray, isect, depth + 1);
+    for (uint32_t i = 0; i < count; ++i) {
+      float t_child_near, t_child_far;
+      if (hit && (!child_bounds[i].Intersect(ray, t_child_near, t_child_far)
+          || t_child_near > isect.t_hit))
+        break;
+      Isect child_isect;
+      if (Traverse(children[i], child_bounds[i], ray, child_isect, depth + 1)
+          && (!hit || child_isect.t_hit < isect.t_hit)) {
+        isect = child_isect;
+        hit = true;
+      }
+    }
     delete[] children;
     delete[] child_bounds;
     return hit;
@@ -265,49 +299,36 @@ protected:
     out << node << " " << bbox << "\n";
   }
 
-  void UpdateMeanVar(int value, int num_samples, float& mean, float& variance) {
-    float delta = value - mean;
-    mean += delta / num_samples;
-    variance += delta * (value - mean);
-  }
-
   void BuildLevel(WorkList& work_list, WorkList& next_list, uint32_t depth) {
-    float mean_objects = 0.0f, variance_objects = 0.0f;
-    float mean_children = 0.0f, variance_children = 0.0f;
-    int num_nodes = 0, num_internal = 0, num_leaves = 0;
+    float root_area = bounds_.GetArea();
     while (!work_list.empty()) {
       WorkNode work_node = work_list.back();
       work_list.pop_back();
-      // calculate some stats
-      UpdateMeanVar(work_node.objects.size(), ++num_nodes, mean_objects,
-          variance_objects);
+      uint32_t num_objects = work_node.objects.size();
+      float area_ratio = (root_area > 0.0f ?
+          work_node.bounds.GetArea() / root_area : 1.0f);
       Node node = DecodeNode(nodes_[work_node.node_index]);
       if (node.IsLeaf()) {
         BuildLeaf(node, work_node);
-        ++num_leaves;
+        stats_.AddLeaf(depth, num_objects, area_ratio);
       } else {
         BuildInternal(node, work_node, next_list, depth);
-        UpdateMeanVar(node.num_children(), ++num_internal, mean_children,
-            variance_children);
+        stats_.AddInternal(depth, num_objects, node.num_children(),
+            area_ratio);
       }
       nodes_[work_node.node_index] = EncodeNode(node);
       work_node.objects.clear();
     }
-    variance_objects /= num_nodes;
-    variance_children /= num_internal;
-    std::cout << std::setprecision(2) << std::fixed;
-    std::cout << " internal: " << num_internal << " num_leaves = "
-        << num_leaves;
-    std::cout << " mean obj: " << mean_objects << " stdev: "
-        << variance_objects;
-    std::cout << " mean child: " << mean_children << " stdev: "
-        << sqrt(variance_children);
   }
 
   void BuildTree(WorkNode& work_root) {
-    // compute bounds
-    for (uint32_t i = 0; i < work_root.objects.size(); ++i)
-      bounds_ = bounds_.Join(work_root.objects[i]->GetBounds());
+    stats_.Reset();
+    stats_.num_objects = work_root.objects.size();
+    { // compute bounds
+      ScopedPhaseTimer timer(stats_.profile, BuildProfile::kBounds);
+      for (uint32_t i = 0; i < work_root.objects.size(); ++i)
+        bounds_ = bounds_.Join(work_root.objects[i]->GetBounds());
+    }
     std::vector<WorkNode> work_list;
     std::vector<WorkNode> next_list;
     int depth = 0;
@@ -322,15 +343,11 @@ protected:
     // and next_list.  The work_list gets swapped when empty while next_list
     // fills up. Each time this happens, one level has been completed.
     while (!work_list.empty()) {
-      std::cout << "level = " << depth << " ";
       BuildLevel(work_list, next_list, depth);
       work_list.swap(next_list);
-      std::cout << std::endl;
       ++depth;
     }
-    std::cout << "num internal nodes = " << num_internal_nodes() << std::endl;
-    std::cout << "num leaves = " << num_leaves() << std::endl;
-    std::cout << "num object refs = " << scene_objects_.size() << std::endl;
+    stats_.memory_bytes = GetMemoryUsage();
   }
 
   void BuildTree(const std::vector<SceneObject>& objects) {
@@ -0,0 +1,76 @@
+/*
+ * tree_stats.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef TREE_STATS_HPP_
+#define TREE_STATS_HPP_
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "build_profile.hpp"
+namespace ray {
+// Nodes of one level of a tree.  Every node counts towards the objects
+// statistics, only internal nodes towards the children statistics.
+struct TreeLevelStats {
+  TreeLevelStats();
+  float GetMeanObjects() const;
+  float GetStdevObjects() const;
+  float GetMeanChildren() const;
+  float GetStdevChildren() const;
+  uint32_t num_internal_nodes;
+  uint32_t num_leaves;
+  double sum_objects;
+  double sum_objects_squared;
+  double sum_children;
+  double sum_children_squared;
+};
+
+////////
+//
+// TreeStats
+//
+// The quality of a built tree, as filled in by the tree builders: nodes
+// per level, a histogram of leaf sizes, how often objects are referenced
+// by more than one leaf, the share of empty leaves, the depth reached,
+// the SAH cost and the memory used.  The SAH cost is that of the builders,
+// with traversal and intersection costs of 1, relative to the surface
+// area of the root.  profile holds the time the build spent per phase
+// if the builders were compiled with RAY_BUILD_PROFILE.
+//
+////////
+struct TreeStats {
+  TreeStats();
+  void Reset();
+  // Called by the builders for every node at depth, with the surface area
+  // of its bounds relative to that of the root.
+  void AddLeaf(uint32_t depth, uint32_t num_objects, float area_ratio);
+  void AddInternal(uint32_t depth, uint32_t num_objects,
+      uint32_t num_children, float area_ratio);
+  // Object references per object, 1 if no object is referenced twice.
+  float GetDuplicationFactor() const;
+  float GetEmptyLeafRatio() const;
+  // The deepest level, 0 for a tree of just a root.
+  uint32_t GetMaxDepth() const;
+  // Per level statistics, in the format the builders used to print.
+  void Print(std::ostream& out) const;
+  std::string ToJson() const;
+  // Bin 0 counts empty leaves and bin i > 0 leaves of 2^(i - 1) up to
+  // 2^i - 1 objects.
+  static uint32_t GetHistogramBin(uint32_t num_objects);
+  std::vector<TreeLevelStats> levels;
+  std::vector<uint32_t> leaf_size_histogram;
+  uint32_t num_objects;
+  uint32_t num_internal_nodes;
+  uint32_t num_leaves;
+  uint32_t num_empty_leaves;
+  uint32_t num_object_refs;
+  float sah_cost;
+  size_t memory_bytes;
+  BuildProfile profile;
+};
+} // namespace ray
+#endif /* TREE_STATS_HPP_ */
@@ -0,0 +1,64 @@
+/*
+ * worker_pool.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifndef WORKER_POOL_HPP_
+#define WORKER_POOL_HPP_
+#include <pthread.h>
+#include <stdint.h>
+namespace ray {
+////////
+//
+// WorkerTask
+//
+// A batch of independent work items, e.g. image tiles.  Execute() is
+// called exactly once for every item in [0, num_items) and may be called
+// concurrently from different threads, so implementations must only
+// write to state owned by the item.  thread_index is in
+// [0, num_threads) and can be used to index per-thread scratch space.
+//
+////////
+class WorkerTask {
+public:
+  virtual ~WorkerTask();
+  virtual void Execute(int item, int thread_index) = 0;
+};
+
+////////
+//
+// WorkerPool
+//
+// Runs a WorkerTask on num_threads threads.  Items are handed out in
+// increasing order through a shared atomic counter, so the order in which
+// a task lists its items is the order in which they get started.  The
+// calling thread takes part in the work and Run() only returns once every
+// item has been executed.
+//
+////////
+class WorkerPool {
+public:
+  WorkerPool();
+  explicit WorkerPool(int num_threads);
+  ~WorkerPool();
+  int num_threads() const;
+  void set_num_threads(int num_threads);
+  void Run(WorkerTask& task, int num_items);
+  static int GetNumProcessors();
+private:
+  struct WorkerInfo {
+    WorkerPool* pool;
+    int thread_index;
+  };
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+  static void* WorkerMain(void* arg);
+  void Work(int thread_index);
+  int num_threads_;
+  WorkerTask* task_;
+  int num_items_;
+  volatile int next_item_;
+};
+} // namespace ray
+#endif /* WORKER_POOL_HPP_ */
@@ -0,0 +1,172 @@
+/*
+ * accelerator_factory.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <string>
+#include <vector>
+#include "accelerator_factory.hpp"
+namespace ray {
+static const char* kTypeNames[AcceleratorFactory::kNumTypes] = { "none",
+    "kdtree", "octree", "sah-octree" };
+static const char* kKdtreePolicyNames[
+    AcceleratorFactory::KdtreeType::kNumPolicies] = { "median", "sah" };
+static const char* kSahOctreePolicyNames[
+    AcceleratorFactory::SahOctreeType::kNumPolicies] = { "binned", "centroid",
+    "full", "mixed64", "mixed128", "mixed256", "mixed512", "bounded32",
+    "bounded64", "bounded128" };
+
+// The index of name in names, or -1.
+static int FindName(const std::string& name, const char* const * names,
+    int num_names) {
+  for (int i = 0; i < num_names; ++i)
+    if (name == names[i])
+      return i;
+  return -1;
+}
+
+AcceleratorFactory::AcceleratorFactory() :
+    type_(kKdtree), kdtree_policy_(KdtreeType::kSpatialMedian),
+        sah_octree_policy_(SahOctreeType::kCentroid), max_leaf_size_(8),
+        max_depth_(15) {
+}
+
+AcceleratorFactory::Type AcceleratorFactory::type() const {
+  return type_;
+}
+
+void AcceleratorFactory::set_type(Type type) {
+  type_ = type;
+}
+
+AcceleratorFactory::KdtreeType::SplitPolicy
+AcceleratorFactory::kdtree_policy() const {
+  return kdtree_policy_;
+}
+
+void AcceleratorFactory::set_kdtree_policy(
+    KdtreeType::SplitPolicy kdtree_policy) {
+  kdtree_policy_ = kdtree_policy;
+}
+
+AcceleratorFactory::SahOctreeType::EvaluationPolicy
+AcceleratorFactory::sah_octree_policy() const {
+  return sah_octree_policy_;
+}
+
+void AcceleratorFactory::set_sah_octree_policy(
+    SahOctreeType::EvaluationPolicy policy) {
+  sah_octree_policy_ = policy;
+}
+
+uint32_t AcceleratorFactory::max_leaf_size() const {
+  return max_leaf_size_;
+}
+
+void AcceleratorFactory::set_max_leaf_size(uint32_t max_leaf_size) {
+  max_leaf_size_ = max_leaf_size;
+}
+
+uint32_t AcceleratorFactory::max_depth() const {
+  return max_depth_;
+}
+
+void AcceleratorFactory::set_max_depth(uint32_t max_depth) {
+  max_depth_ = max_depth;
+}
+
+bool AcceleratorFactory::SetPolicy(const std::string& name) {
+  KdtreeType::SplitPolicy kdtree_policy;
+  SahOctreeType::EvaluationPolicy sah_octree_policy;
+  if (kKdtree == type_ && ParseKdtreePolicy(name, kdtree_policy))
+    kdtree_policy_ = kdtree_policy;
+  else if (kSahOctree == type_ && ParseSahOctreePolicy(name, sah_octree_policy))
+    sah_octree_policy_ = sah_octree_policy;
+  else
+    return false;
+  return true;
+}
+
+Accelerator* AcceleratorFactory::Create(const Trimesh& mesh,
+    TreeStats* stats) const {
+  TreeStats unused;
+  TreeStats& build_stats = (NULL != stats ? *stats : unused);
+  switch (type_) {
+  case kKdtree: {
+    KdtreeType* kdtree = new KdtreeType();
+    kdtree->set_split_policy(kdtree_policy_);
+    kdtree->set_max_leaf_size(max_leaf_size_);
+    kdtree->set_max_depth(max_depth_);
+    build_stats = kdtree->Build(mesh.faces());
+    return kdtree;
+  }
+  case kOctree: {
+    OctreeType* octree = new OctreeType();
+    build_stats = octree->Build(mesh.faces());
+    return octree;
+  }
+  case kSahOctree: {
+    SahOctreeType* octree = new SahOctreeType();
+    octree->set_evaluation_policy(sah_octree_policy_);
+    build_stats = octree->Build(mesh.faces());
+    return octree;
+  }
+  default:
+    return NULL;
+  }
+}
+
+void AcceleratorFactory::Accelerate(Scene& scene,
+    std::vector<Accelerator*>& accelerators) const {
+  const std::vector<SceneShape*>& shapes = scene.scene_objects();
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    Accelerator* accelerator = (NULL != trimesh ? Create(*trimesh) : NULL);
+    if (NULL != accelerator) {
+      trimesh->set_accelerator(accelerator);
+      accelerators.push_back(accelerator);
+    }
+  }
+}
+
+const char* AcceleratorFactory::GetTypeName(Type type) {
+  return (type >= 0 && type < kNumTypes ? kTypeNames[type] : "unknown");
+}
+
+bool AcceleratorFactory::ParseType(const std::string& name, Type& type) {
+  int index = FindName(name, kTypeNames, kNumTypes);
+  if (index >= 0)
+    type = static_cast<Type>(index);
+  return index >= 0;
+}
+
+const char* AcceleratorFactory::GetKdtreePolicyName(
+    KdtreeType::SplitPolicy policy) {
+  return (policy >= 0 && policy < KdtreeType::kNumPolicies ?
+      kKdtreePolicyNames[policy] : "unknown");
+}
+
+const char* AcceleratorFactory::GetSahOctreePolicyName(
+    SahOctreeType::EvaluationPolicy policy) {
+  return (policy >= 0 && policy < SahOctreeType::kNumPolicies ?
+      kSahOctreePolicyNames[policy] : "unknown");
+}
+
+bool AcceleratorFactory::ParseKdtreePolicy(const std::string& name,
+    KdtreeType::SplitPolicy& policy) {
+  int index = FindName(name, kKdtreePolicyNames, KdtreeType::kNumPolicies);
+  if (index >= 0)
+    policy = static_cast<KdtreeType::SplitPolicy>(index);
+  return index >= 0;
+}
+
+bool AcceleratorFactory::ParseSahOctreePolicy(const std::string& name,
+    SahOctreeType::EvaluationPolicy& policy) {
+  int index = FindName(name, kSahOctreePolicyNames,
+      SahOctreeType::kNumPolicies);
+  if (index >= 0)
+    policy = static_cast<SahOctreeType::EvaluationPolicy>(index);
+  return index >= 0;
+}
+} // namespace ray
@@ -0,0 +1,114 @@
+/*
+ * async_image_writer.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include "async_image_writer.hpp"
+#include "image.hpp"
+namespace ray {
+AsyncImageWriter::AsyncImageWriter(int max_queued) :
+    max_queued_(max_queued > 0 ? max_queued : 1), queue_(), num_pending_(0),
+        stopping_(false), started_(false), success_(true), status_("OK"),
+        thread_() {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&changed_, NULL);
+  // Initialize the storage here rather than on the writer thread.
+  ImageStorage::GetInstance();
+}
+
+AsyncImageWriter::~AsyncImageWriter() {
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&changed_);
+  pthread_mutex_unlock(&mutex_);
+  if (started_)
+    pthread_join(thread_, NULL);
+  pthread_cond_destroy(&changed_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+int AsyncImageWriter::max_queued() const {
+  return max_queued_;
+}
+
+void AsyncImageWriter::WriteImage(const std::string& file_name,
+    Image& image) {
+  Job* job = new Job();
+  job->file_name = file_name;
+  job->image.Swap(image);
+  pthread_mutex_lock(&mutex_);
+  if (!started_)
+    started_ = (pthread_create(&thread_, NULL, &AsyncImageWriter::WriterMain,
+        this) == 0);
+  ++num_pending_;
+  if (!started_) {
+    // Without a writer thread, write synchronously.
+    pthread_mutex_unlock(&mutex_);
+    Finish(job);
+    return;
+  }
+  while (static_cast<int>(queue_.size()) >= max_queued_)
+    pthread_cond_wait(&changed_, &mutex_);
+  queue_.push_back(job);
+  pthread_cond_broadcast(&changed_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+bool AsyncImageWriter::Flush(std::string& status) {
+  pthread_mutex_lock(&mutex_);
+  while (num_pending_ > 0)
+    pthread_cond_wait(&changed_, &mutex_);
+  bool success = success_;
+  status = status_;
+  success_ = true;
+  status_ = "OK";
+  pthread_mutex_unlock(&mutex_);
+  return success;
+}
+
+bool AsyncImageWriter::Encode(const std::string& file_name,
+    const Image& image, std::string& status) {
+  return ImageStorage::GetInstance().WriteImage(file_name, image, status);
+}
+
+void* AsyncImageWriter::WriterMain(void* arg) {
+  static_cast<AsyncImageWriter*>(arg)->Run();
+  return NULL;
+}
+
+void AsyncImageWriter::Run() {
+  pthread_mutex_lock(&mutex_);
+  for (;;) {
+    while (queue_.empty() && !stopping_)
+      pthread_cond_wait(&changed_, &mutex_);
+    if (queue_.empty())
+      break;
+    Job* job = queue_.front();
+    queue_.pop_front();
+    pthread_cond_broadcast(&changed_);
+    pthread_mutex_unlock(&mutex_);
+    Finish(job);
+    pthread_mutex_lock(&mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+// Encodes job outside of the lock, then records the result.
+void AsyncImageWriter::Finish(Job* job) {
+  std::string status;
+  bool success = Encode(job->file_name, job->image, status);
+  delete job;
+  pthread_mutex_lock(&mutex_);
+  if (!success && success_) {
+    success_ = false;
+    status_ = status;
+  }
+  --num_pending_;
+  pthread_cond_broadcast(&changed_);
+  pthread_mutex_unlock(&mutex_);
+}
+} // namespace ray
@@ -0,0 +1,173 @@
+/*
+ * bench_compare.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <getopt.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_stats.hpp"
+#include "parse_utils.hpp"
+#include "tool_utils.hpp"
+namespace ray {
+static const char* kUsageString = "Usage:\n"
+    "  bench_compare [options] <baseline.json> <candidate.json>\n"
+    "Compares the JSON output of ray_bench or micro_bench for two builds.\n"
+    "Each file may hold several runs appended one after the other; with\n"
+    "two or more runs on both sides the speedups come with 95% confidence\n"
+    "intervals.  A case regresses when its speedup is below 1 - threshold\n"
+    "and, if there is an interval, the whole interval is below 1.  Exits\n"
+    "with 1 if any case regressed.\n"
+    "Options:\n"
+    "  -t, --threshold <percent>  for rays per second and kernel times (5)\n"
+    "      --build-threshold <percent>  for build times (10)\n";
+
+enum MetricKind {
+  kThroughput, kBuild
+};
+
+struct Metric {
+  const char* name;
+  // True for rates, false for times.
+  bool higher_is_better;
+  MetricKind kind;
+};
+
+static const Metric kMetrics[] = {
+    { "primary_rays_per_second", true, kThroughput },
+    { "secondary_rays_per_second", true, kThroughput },
+    { "build_seconds", false, kBuild },
+    { "median_ns", false, kThroughput } };
+static const int kNumMetrics = sizeof(kMetrics) / sizeof(Metric);
+
+// The runs of one case, e.g. a scene and accelerator of ray_bench or a
+// kernel of micro_bench, per metric.
+struct Samples {
+  std::vector<double> values[kNumMetrics];
+};
+
+typedef std::map<std::string, Samples> CaseMap;
+
+static double ParsePercent(const char* str) {
+  double value = ParseNumber(str, 0.0, 100.0);
+  if (value >= 100.0)
+    Die(std::string("Invalid percentage: ") + str);
+  return 0.01 * value;
+}
+
+static bool ReadRuns(const std::string& file_name, CaseMap& cases,
+    std::string& status) {
+  std::ifstream in(file_name.c_str());
+  if (!in) {
+    status = "Cannot open " + file_name;
+    return false;
+  }
+  std::stringstream text;
+  text << in.rdbuf();
+  std::vector<JsonValue> runs;
+  if (!ParseJson(text.str(), runs, status)) {
+    status = file_name + ": " + status;
+    return false;
+  }
+  for (size_t i = 0; i < runs.size(); ++i) {
+    for (size_t j = 0; j < runs[i].elements.size(); ++j) {
+      const JsonValue& result = runs[i].elements[j];
+      if (result.type != JsonValue::kObject)
+        continue;
+      Samples& samples = cases[GetCaseName(result)];
+      for (int k = 0; k < kNumMetrics; ++k) {
+        const JsonValue* value = result.Find(kMetrics[k].name);
+        // Rates and times of zero, as of a case that took no measurable
+        // time, do not compare.
+        if (NULL != value && value->type == JsonValue::kNumber
+            && value->number > 0.0)
+          samples.values[k].push_back(value->number);
+      }
+    }
+  }
+  status = "OK";
+  return true;
+}
+} // namespace ray
+
+int main(int argc, char** argv) {
+  ray::SetUsage(ray::kUsageString);
+  enum {
+    kBuildThresholdOption = 256
+  };
+  static const option kOptions[] = {
+      { "threshold", required_argument, NULL, 't' },
+      { "build-threshold", required_argument, NULL, kBuildThresholdOption },
+      { NULL, 0, NULL, 0 } };
+  double thresholds[2] = { 0.05, 0.10 };
+  int c = 0;
+  while ((c = getopt_long(argc, argv, "t:", kOptions, NULL)) != -1) {
+    switch (c) {
+    case 't':
+      thresholds[ray::kThroughput] = ray::ParsePercent(optarg);
+      break;
+    case kBuildThresholdOption:
+      thresholds[ray::kBuild] = ray::ParsePercent(optarg);
+      break;
+    default:
+      ray::Die("");
+    }
+  }
+  if (argc - optind != 2)
+    ray::Die("");
+  ray::CaseMap baseline;
+  ray::CaseMap candidate;
+  std::string status;
+  if (!ray::ReadRuns(argv[optind], baseline, status)
+      || !ray::ReadRuns(argv[optind + 1], candidate, status)) {
+    std::cerr << status << std::endl;
+    return -1;
+  }
+
+  int num_compared = 0;
+  int num_regressions = 0;
+  std::cout << std::fixed << std::setprecision(3);
+  for (ray::CaseMap::const_iterator i = baseline.begin(); i != baseline.end();
+      ++i) {
+    ray::CaseMap::const_iterator j = candidate.find(i->first);
+    if (j == candidate.end()) {
+      std::cerr << "Not in the candidate: " << i->first << std::endl;
+      continue;
+    }
+    for (int k = 0; k < ray::kNumMetrics; ++k) {
+      const std::vector<double>& before = i->second.values[k];
+      const std::vector<double>& after = j->second.values[k];
+      if (before.empty() || after.empty())
+        continue;
+      const ray::Metric& metric = ray::kMetrics[k];
+      ray::Comparison comparison = ray::Compare(before, after,
+          metric.higher_is_better);
+      bool regressed = ray::IsRegression(comparison,
+          thresholds[metric.kind]);
+      ++num_compared;
+      num_regressions += regressed;
+      std::cout << i->first << " " << metric.name << ": speedup "
+          << comparison.speedup;
+      if (comparison.has_interval)
+        std::cout << " [" << comparison.low << ", " << comparison.high << "]";
+      std::cout << " (" << before.size() << " vs " << after.size()
+          << " runs)" << (regressed ? " REGRESSION" : "") << "\n";
+    }
+  }
+  for (ray::CaseMap::const_iterator i = candidate.begin();
+      i != candidate.end(); ++i)
+    if (baseline.find(i->first) == baseline.end())
+      std::cerr << "Not in the baseline: " << i->first << std::endl;
+  std::cout << num_compared << " compared, " << num_regressions
+      << " regressed\n";
+  return (num_regressions > 0 ? 1 : 0);
+}
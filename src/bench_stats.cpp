@@ -0,0 +1,96 @@
+/*
+ * bench_stats.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include "bench_stats.hpp"
+
+#include <cmath>
+#include <sstream>
+namespace ray {
+// Numeric members that are settings of a run rather than measurements.
+static const char* kSettings[] = { "width", "height", "threads" };
+static const int kNumSettings = sizeof(kSettings) / sizeof(kSettings[0]);
+
+std::string GetCaseName(const JsonValue& result) {
+  std::ostringstream name;
+  for (size_t i = 0; i < result.elements.size(); ++i) {
+    if (result.elements[i].type != JsonValue::kString)
+      continue;
+    if (name.tellp() > 0)
+      name << " ";
+    name << result.elements[i].string;
+  }
+  for (int i = 0; i < kNumSettings; ++i) {
+    const JsonValue* value = result.Find(kSettings[i]);
+    if (NULL != value && value->type == JsonValue::kNumber)
+      name << " " << kSettings[i] << "=" << value->number;
+  }
+  return name.str();
+}
+
+double GetStudentQuantile(double df) {
+  static const double kQuantiles[] = { 12.706, 4.303, 3.182, 2.776, 2.571,
+      2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+      2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060,
+      2.056, 2.052, 2.048, 2.045, 2.042 };
+  int n = static_cast<int>(floor(df));
+  if (n < 1)
+    n = 1;
+  if (n <= 30)
+    return kQuantiles[n - 1];
+  return (n <= 60 ? 2.000 : (n <= 120 ? 1.980 : 1.960));
+}
+
+double GetWelchDegreesOfFreedom(double variance1, size_t size1,
+    double variance2, size_t size2) {
+  double term1 = variance1 / size1;
+  double term2 = variance2 / size2;
+  return (term1 + term2) * (term1 + term2)
+      / (term1 * term1 / (size1 - 1) + term2 * term2 / (size2 - 1));
+}
+
+static void GetLogMoments(const std::vector<double>& values, double& mean,
+    double& variance) {
+  mean = 0.0;
+  for (size_t i = 0; i < values.size(); ++i)
+    mean += log(values[i]);
+  mean /= values.size();
+  variance = 0.0;
+  for (size_t i = 0; i < values.size(); ++i)
+    variance += (log(values[i]) - mean) * (log(values[i]) - mean);
+  variance = (values.size() > 1 ? variance / (values.size() - 1) : 0.0);
+}
+
+Comparison Compare(const std::vector<double>& baseline,
+    const std::vector<double>& candidate, bool higher_is_better) {
+  double baseline_mean, baseline_variance;
+  double candidate_mean, candidate_variance;
+  GetLogMoments(baseline, baseline_mean, baseline_variance);
+  GetLogMoments(candidate, candidate_mean, candidate_variance);
+  double difference = candidate_mean - baseline_mean;
+  if (!higher_is_better)
+    difference = -difference;
+  Comparison comparison;
+  comparison.speedup = exp(difference);
+  comparison.has_interval = (baseline.size() > 1 && candidate.size() > 1);
+  comparison.low = comparison.high = comparison.speedup;
+  if (!comparison.has_interval)
+    return comparison;
+  double error = sqrt(baseline_variance / baseline.size()
+      + candidate_variance / candidate.size());
+  if (error > 0.0) {
+    double df = GetWelchDegreesOfFreedom(baseline_variance, baseline.size(),
+        candidate_variance, candidate.size());
+    double margin = GetStudentQuantile(df) * error;
+    comparison.low = exp(difference - margin);
+    comparison.high = exp(difference + margin);
+  }
+  return comparison;
+}
+
+bool IsRegression(const Comparison& comparison, double threshold) {
+  return comparison.speedup < 1.0 - threshold && comparison.high < 1.0;
+}
+} // namespace ray
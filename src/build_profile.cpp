@@ -0,0 +1,48 @@
+/*
+ * build_profile.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "build_profile.hpp"
+namespace ray {
+BuildProfile::BuildProfile() {
+  Reset();
+}
+
+void BuildProfile::Reset() {
+  for (int i = 0; i < kNumPhases; ++i) {
+    seconds[i] = 0.0;
+    calls[i] = 0;
+  }
+}
+
+void BuildProfile::Print(std::ostream& out) const {
+  for (int i = 0; i < kNumPhases; ++i)
+    if (calls[i] > 0)
+      out << GetPhaseName(static_cast<Phase>(i)) << ": " << seconds[i]
+          << " s, " << calls[i] << " calls\n";
+}
+
+std::string BuildProfile::ToJson() const {
+  std::ostringstream out;
+  out << "{";
+  for (int i = 0; i < kNumPhases; ++i)
+    out << (i > 0 ? ", " : "") << "\"" << GetPhaseName(static_cast<Phase>(i))
+        << "\": {\"seconds\": " << seconds[i] << ", \"calls\": " << calls[i]
+        << "}";
+  out << "}";
+  return out.str();
+}
+
+const char* BuildProfile::GetPhaseName(Phase phase) {
+  static const char* kPhaseNames[kNumPhases] = { "bounds", "create_events",
+      "find_best_plane", "distribute_events", "evaluate_binned_cost",
+      "image_integral", "distribute_objects", "encode_node" };
+  return (phase >= 0 && phase < kNumPhases ? kPhaseNames[phase] : "unknown");
+}
+} // namespace ray
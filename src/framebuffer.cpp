@@ -0,0 +1,161 @@
+/*
+ * framebuffer.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "framebuffer.hpp"
+namespace ray {
+ToneMapping::ToneMapping() :
+    op(kClamp), exposure(1.0f), gamma(1.0f) {
+}
+
+ToneMapping::ToneMapping(Operator op, float exposure, float gamma) :
+    op(op), exposure(exposure), gamma(gamma) {
+}
+
+Framebuffer::Framebuffer() :
+    width_(0), height_(0) {
+}
+
+Framebuffer::Framebuffer(int width, int height) :
+    width_(width), height_(height) {
+  data_.resize(4 * width_ * height_, 0.0f);
+}
+
+uint32_t Framebuffer::width() const {
+  return width_;
+}
+
+uint32_t Framebuffer::height() const {
+  return height_;
+}
+
+void Framebuffer::Resize(int width, int height) {
+  width_ = width;
+  height_ = height;
+  data_.resize(4 * width_ * height_);
+  Clear();
+}
+
+void Framebuffer::Clear() {
+  std::fill(data_.begin(), data_.end(), 0.0f);
+}
+
+void Framebuffer::AddSample(int i, int j, const glm::vec3& color,
+    float weight) {
+  float* pixel = &data_[4 * (i * width_ + j)];
+  pixel[0] += weight * color[0];
+  pixel[1] += weight * color[1];
+  pixel[2] += weight * color[2];
+  pixel[3] += weight;
+}
+
+void Framebuffer::SetPixel(int i, int j, const glm::vec3& color) {
+  float* pixel = &data_[4 * (i * width_ + j)];
+  pixel[0] = color[0];
+  pixel[1] = color[1];
+  pixel[2] = color[2];
+  pixel[3] = 1.0f;
+}
+
+glm::vec3 Framebuffer::GetColor(int i, int j) const {
+  const float* pixel = &data_[4 * (i * width_ + j)];
+  if (pixel[3] <= 0.0f)
+    return glm::vec3(0.0f);
+  return glm::vec3(pixel[0], pixel[1], pixel[2]) / pixel[3];
+}
+
+float Framebuffer::GetWeight(int i, int j) const {
+  return data_[4 * (i * width_ + j) + 3];
+}
+
+const std::vector<float>& Framebuffer::data() const {
+  return data_;
+}
+
+// 255 * value^(1 / gamma), rounded.
+static unsigned char EncodeGamma(float value, float inverse_gamma) {
+  return static_cast<unsigned char>(255.0f * powf(value, inverse_gamma)
+      + 0.5f);
+}
+
+// Each pixel is normalized, exposed, tone mapped and clamped to [0, 1] as
+// one vector.  Without gamma the result is scaled to [0, 255] and
+// truncated, matching a plain conversion of 255 * color; with gamma the
+// value is rounded to the nearest entry of a table of encoded bytes
+// instead of calling pow() per channel.  Only the darkest values, where
+// the curve is steeper than the table resolves, call pow().
+void Framebuffer::Resolve(Image& image, const ToneMapping& tone_mapping) const {
+  image.Resize(width_, height_);
+  bool use_gamma = (tone_mapping.gamma != 1.0f && tone_mapping.gamma > 0.0f);
+  float inverse_gamma = (use_gamma ? 1.0f / tone_mapping.gamma : 1.0f);
+  unsigned char gamma_table[kGammaTableSize];
+  if (use_gamma)
+    for (int k = 0; k < kGammaTableSize; ++k)
+      gamma_table[k] = EncodeGamma(
+          k / static_cast<float>(kGammaTableSize - 1), inverse_gamma);
+  float scale = (use_gamma ? kGammaTableSize - 1 : 255.0f);
+  float rounding = (use_gamma ? 0.5f : 0.0f);
+  bool reinhard = (ToneMapping::kReinhard == tone_mapping.op);
+  uint32_t num_pixels = width_ * height_;
+  const float* pixel = (num_pixels > 0 ? &data_[0] : NULL);
+  ucvec3* out = (num_pixels > 0 ? &image(0, 0) : NULL);
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 exposure = _mm_set1_ps(tone_mapping.exposure);
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128 rounding4 = _mm_set1_ps(rounding);
+  for (uint32_t p = 0; p < num_pixels; ++p, pixel += 4) {
+    __m128 rgbw = _mm_loadu_ps(pixel);
+    __m128 weight = _mm_shuffle_ps(rgbw, rgbw, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 has_weight = _mm_cmpgt_ps(weight, zero);
+    // Pixels without samples divide by one and are then masked to black.
+    __m128 divisor = _mm_or_ps(_mm_and_ps(has_weight, weight),
+        _mm_andnot_ps(has_weight, one));
+    __m128 color = _mm_and_ps(has_weight,
+        _mm_div_ps(_mm_mul_ps(rgbw, exposure), divisor));
+    if (reinhard)
+      color = _mm_div_ps(color, _mm_add_ps(one, color));
+    color = _mm_min_ps(_mm_max_ps(color, zero), one);
+    int32_t values[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values),
+        _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(color, scale4), rounding4)));
+    if (!use_gamma) {
+      for (int c = 0; c < 3; ++c)
+        out[p][c] = values[c];
+      continue;
+    }
+    float colors[4];
+    _mm_storeu_ps(colors, color);
+    for (int c = 0; c < 3; ++c)
+      out[p][c] = (values[c] < kExactGammaSize ?
+          EncodeGamma(colors[c], inverse_gamma) : gamma_table[values[c]]);
+  }
+#else
+  for (uint32_t p = 0; p < num_pixels; ++p, pixel += 4) {
+    float weight = pixel[3];
+    for (int c = 0; c < 3; ++c) {
+      float value = (weight > 0.0f ?
+          tone_mapping.exposure * pixel[c] / weight : 0.0f);
+      if (reinhard)
+        value = value / (1.0f + value);
+      value = std::min(std::max(value, 0.0f), 1.0f);
+      int index = static_cast<int>(value * scale + rounding);
+      if (!use_gamma)
+        out[p][c] = index;
+      else
+        out[p][c] = (index < kExactGammaSize ?
+            EncodeGamma(value, inverse_gamma) : gamma_table[index]);
+    }
+  }
+#endif
+}
+} // namespace ray
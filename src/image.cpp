@@ -4,6 +4,7 @@
  *  Created on: Sep 11, 2013
  *      Author: agrippa
  */
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <Magick++.h>
@@ -44,6 +45,12 @@ void Image::Resize() {
     pixels_.resize(width_ * height_);
 }
 
+void Image::Swap(Image& image) {
+    pixels_.swap(image.pixels_);
+    std::swap(width_, image.width_);
+    std::swap(height_, image.height_);
+}
+
 ucvec3& Image::operator()(int i, int j) {
     return pixels_[i * width_ + j];
 }
@@ -0,0 +1,121 @@
+/*
+ * image_compare.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "image_compare.hpp"
+namespace ray {
+ImageDifference::ImageDifference() :
+    rmse_(0.0), width_(0), height_(0), histogram_(256, 0), errors_() {
+}
+
+bool ImageDifference::Compare(const Image& image, const Image& reference,
+    std::string& status) {
+  if (image.width() != reference.width()
+      || image.height() != reference.height()) {
+    std::ostringstream message;
+    message << "Size " << image.width() << "x" << image.height()
+        << " differs from the reference " << reference.width() << "x"
+        << reference.height();
+    status = message.str();
+    return false;
+  }
+  width_ = image.width();
+  height_ = image.height();
+  histogram_.assign(256, 0);
+  errors_.resize(image.pixels().size());
+  double sum = 0.0;
+  for (size_t i = 0; i < image.pixels().size(); ++i) {
+    int error = 0;
+    for (int c = 0; c < 3; ++c) {
+      int difference = abs(static_cast<int>(image.pixels()[i][c])
+          - static_cast<int>(reference.pixels()[i][c]));
+      sum += difference * difference;
+      error = std::max(error, difference);
+    }
+    errors_[i] = error;
+    ++histogram_[error];
+  }
+  rmse_ = (errors_.empty() ? 0.0 : sqrt(sum / (3.0 * errors_.size())));
+  status = "OK";
+  return true;
+}
+
+bool ImageDifference::Compare(const Image& image, const std::string& reference,
+    std::string& status) {
+  Image reference_image;
+  if (!ImageStorage::GetInstance().ReadImage(reference, reference_image,
+      status))
+    return false;
+  return Compare(image, reference_image, status);
+}
+
+double ImageDifference::rmse() const {
+  return rmse_;
+}
+
+double ImageDifference::psnr() const {
+  if (rmse_ == 0.0)
+    return std::numeric_limits<double>::infinity();
+  return 20.0 * log10(255.0 / rmse_);
+}
+
+int ImageDifference::max_error() const {
+  int error = 255;
+  while (error > 0 && histogram_[error] == 0)
+    --error;
+  return error;
+}
+
+int ImageDifference::num_pixels() const {
+  return width_ * height_;
+}
+
+int ImageDifference::CountPixelsAbove(int error) const {
+  int count = 0;
+  for (int i = std::max(error + 1, 0); i < 256; ++i)
+    count += histogram_[i];
+  return count;
+}
+
+void ImageDifference::GetErrorImage(Image& image) const {
+  image.Resize(width_, height_);
+  int scale = std::max(max_error(), 1);
+  for (int i = 0; i < height_; ++i) {
+    for (int j = 0; j < width_; ++j) {
+      unsigned char value = 255 * errors_[i * width_ + j] / scale;
+      image(i, j) = ucvec3(value, value, value);
+    }
+  }
+}
+
+std::ostream& operator<<(std::ostream& out,
+    const ImageDifference& difference) {
+  out << "rmse = " << difference.rmse() << " psnr = " << difference.psnr()
+      << " dB max error = " << difference.max_error() << " pixels differing = "
+      << difference.CountPixelsAbove(0) << " of " << difference.num_pixels();
+  return out;
+}
+
+ImageBudget::ImageBudget(double min_psnr, int max_error,
+    double max_outlier_fraction) :
+    min_psnr(min_psnr), max_error(max_error),
+        max_outlier_fraction(max_outlier_fraction) {
+}
+
+bool ImageBudget::Accepts(const ImageDifference& difference) const {
+  return difference.psnr() >= min_psnr
+      && difference.CountPixelsAbove(max_error)
+          <= max_outlier_fraction * difference.num_pixels();
+}
+} // namespace ray
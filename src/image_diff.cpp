@@ -0,0 +1,86 @@
+/*
+ * image_diff.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <getopt.h>
+
+#include <iostream>
+#include <string>
+
+#include "image.hpp"
+#include "image_compare.hpp"
+#include "tool_utils.hpp"
+namespace ray {
+static const char* kUsageString = "Usage:\n"
+    "  image_diff [options] <image> <reference>\n"
+    "Compares an image, such as one rendered with a fast path, to a\n"
+    "reference image and prints the RMSE, PSNR and largest pixel error.\n"
+    "Exits with 1 if the image is not within the budget.\n"
+    "Options:\n"
+    "      --min-psnr <dB>         smallest PSNR accepted (40)\n"
+    "      --max-error <n>         largest pixel error accepted, 0 to 255"
+    " (8)\n"
+    "      --max-outliers <percent>  pixels allowed above the largest error"
+    " (0.2)\n"
+    "  -o, --output <file>         write an image of the pixel errors\n";
+} // namespace ray
+
+int main(int argc, char** argv) {
+  ray::SetUsage(ray::kUsageString);
+  enum {
+    kMinPsnrOption = 256, kMaxErrorOption, kMaxOutliersOption
+  };
+  static const option kOptions[] = {
+      { "min-psnr", required_argument, NULL, kMinPsnrOption },
+      { "max-error", required_argument, NULL, kMaxErrorOption },
+      { "max-outliers", required_argument, NULL, kMaxOutliersOption },
+      { "output", required_argument, NULL, 'o' },
+      { NULL, 0, NULL, 0 } };
+  ray::ImageBudget budget(40.0, 8, 0.002);
+  std::string output_file;
+  int c = 0;
+  while ((c = getopt_long(argc, argv, "o:", kOptions, NULL)) != -1) {
+    switch (c) {
+    case kMinPsnrOption:
+      budget.min_psnr = ray::ParseNumber(optarg, 0.0, 1000.0);
+      break;
+    case kMaxErrorOption:
+      budget.max_error = static_cast<int>(ray::ParseNumber(optarg, 0.0,
+          255.0));
+      break;
+    case kMaxOutliersOption:
+      budget.max_outlier_fraction = 0.01 * ray::ParseNumber(optarg, 0.0,
+          100.0);
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    default:
+      ray::Die("");
+    }
+  }
+  if (argc - optind != 2)
+    ray::Die("");
+  ray::ImageStorage& storage = ray::ImageStorage::GetInstance();
+  ray::Image image;
+  std::string status;
+  ray::ImageDifference difference;
+  if (!storage.ReadImage(argv[optind], image, status)
+      || !difference.Compare(image, argv[optind + 1], status)) {
+    std::cerr << status << std::endl;
+    return -1;
+  }
+  if (!output_file.empty()) {
+    ray::Image error_image;
+    difference.GetErrorImage(error_image);
+    if (!storage.WriteImage(output_file, error_image, status)) {
+      std::cerr << status << std::endl;
+      return -1;
+    }
+  }
+  bool accepted = budget.Accepts(difference);
+  std::cout << difference << (accepted ? "" : " OVER BUDGET") << "\n";
+  return (accepted ? 0 : 1);
+}
@@ -0,0 +1,289 @@
+/*
+ * intersection_check.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include "geometry.hpp"
+#include "intersection_check.hpp"
+#include "io_utils.hpp"
+namespace ray {
+IntersectionChecker::Mismatch::Mismatch() :
+    kind(kRandom), ray(), minimal_ray(), hit(false), t_hit(0.0f),
+        expected_hit(false), expected_t_hit(0.0f) {
+}
+
+std::ostream& operator<<(std::ostream& out,
+    const IntersectionChecker::Mismatch& mismatch) {
+  std::streamsize precision = out.precision();
+  // Enough digits to reproduce every float exactly.
+  out << std::setprecision(9)
+      << IntersectionChecker::GetRayKindName(mismatch.kind) << " ray "
+      << mismatch.ray << " minimal " << mismatch.minimal_ray << ": ";
+  if (mismatch.hit)
+    out << "hit at t = " << mismatch.t_hit;
+  else
+    out << "miss";
+  out << ", expected ";
+  if (mismatch.expected_hit)
+    out << "hit at t = " << mismatch.expected_t_hit;
+  else
+    out << "miss";
+  out.precision(precision);
+  return out;
+}
+
+IntersectionChecker::IntersectionChecker(const Trimesh& mesh,
+    const Accelerator& accelerator) :
+    mesh_(mesh), accelerator_(accelerator), bounds_(), tolerance_(1e-4f),
+        mismatches_() {
+  for (int i = 0; i < mesh.num_faces(); ++i)
+    bounds_ = bounds_.Join(mesh.GetPatch(i).GetBounds());
+  for (int i = 0; i < kNumRayKinds; ++i) {
+    num_rays_[i] = 0;
+    num_mismatches_[i] = 0;
+    num_ambiguous_[i] = 0;
+  }
+}
+
+int IntersectionChecker::Run(int num_rays, uint32_t seed,
+    int max_mismatches) {
+  RandomSequence random(seed);
+  int num_mismatches = 0;
+  for (int i = 0; i < num_rays; ++i) {
+    RayKind kind = static_cast<RayKind>(i % kNumRayKinds);
+    Mismatch mismatch;
+    ++num_rays_[kind];
+    Ray ray = GenerateRay(kind, random);
+    if (Check(ray, &mismatch))
+      continue;
+    if (IsAmbiguous(ray)) {
+      ++num_ambiguous_[kind];
+      continue;
+    }
+    ++num_mismatches;
+    ++num_mismatches_[kind];
+    if (static_cast<int>(mismatches_.size()) < max_mismatches) {
+      mismatch.kind = kind;
+      mismatch.minimal_ray = Reduce(mismatch.ray);
+      mismatches_.push_back(mismatch);
+    }
+  }
+  return num_mismatches;
+}
+
+bool IntersectionChecker::Check(const Ray& ray,
+    Mismatch* mismatch) const {
+  Isect isect;
+  Isect expected;
+  bool hit = accelerator_.Intersect(ray, isect);
+  bool expected_hit = mesh_.IntersectUnaccelerated(ray, expected);
+  if (hit == expected_hit
+      && (!hit
+          || fabs(isect.t_hit - expected.t_hit)
+              <= tolerance_ * expected.t_hit))
+    return true;
+  if (mismatch) {
+    mismatch->ray = ray;
+    mismatch->minimal_ray = ray;
+    mismatch->hit = hit;
+    mismatch->t_hit = (hit ? isect.t_hit : 0.0f);
+    mismatch->expected_hit = expected_hit;
+    mismatch->expected_t_hit = (expected_hit ? expected.t_hit : 0.0f);
+  }
+  return false;
+}
+
+bool IntersectionChecker::IsAmbiguous(const Ray& ray) const {
+  // The cosine of the angle between ray and the plane of the triangle.
+  const float kMinCosine = 1e-4f;
+  // How far, relative to the diagonal of the bounds, the origin is moved.
+  const float kPerturbation = 1e-5f;
+  glm::vec3 direction = glm::normalize(ray.direction());
+  for (int i = 0; i < mesh_.num_faces(); ++i) {
+    Triangle triangle = mesh_.GetPatch(i);
+    Isect isect;
+    if (triangle.Intersect(ray, isect)
+        && fabs(glm::dot(direction, isect.normal)) < kMinCosine)
+      return true;
+  }
+  // A ray that only touches the mesh, at a vertex or an edge on the
+  // silhouette, hits or misses depending on rounding.
+  Isect expected;
+  bool expected_hit = mesh_.IntersectUnaccelerated(ray, expected);
+  float offset = kPerturbation * glm::length(bounds_.max() - bounds_.min());
+  for (int i = 0; i < 6; ++i) {
+    glm::vec3 origin = ray.origin();
+    origin[i / 2] += (i % 2 == 0 ? offset : -offset);
+    Isect isect;
+    bool hit = mesh_.IntersectUnaccelerated(Ray(origin, ray.direction()),
+        isect);
+    if (hit != expected_hit
+        || (hit && fabs(isect.t_hit - expected.t_hit)
+            > tolerance_ * expected.t_hit))
+      return true;
+  }
+  return false;
+}
+
+// Rounds one coordinate at a time, first to whole numbers and then to one
+// more decimal at a time, and keeps the coarsest value that still
+// mismatches, until no coordinate can be simplified any more.
+Ray IntersectionChecker::Reduce(const Ray& ray) const {
+  const int kMaxDecimals = 6;
+  float values[6];
+  for (int d = 0; d < 3; ++d) {
+    values[d] = ray.origin()[d];
+    values[3 + d] = ray.direction()[d];
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int k = 0; k < 6; ++k) {
+      for (int decimals = 0; decimals <= kMaxDecimals; ++decimals) {
+        float scale = pow(10.0f, decimals);
+        float rounded = floor(values[k] * scale + 0.5f) / scale;
+        if (rounded == values[k])
+          break;
+        float original = values[k];
+        values[k] = rounded;
+        Ray candidate(glm::vec3(values[0], values[1], values[2]),
+            glm::vec3(values[3], values[4], values[5]));
+        if (glm::length(candidate.direction()) > 0.0f
+            && !Check(candidate, NULL) && !IsAmbiguous(candidate)) {
+          changed = true;
+          break;
+        }
+        values[k] = original;
+      }
+    }
+  }
+  return Ray(glm::vec3(values[0], values[1], values[2]),
+      glm::vec3(values[3], values[4], values[5]));
+}
+
+// A point with the coordinate axis on a plane an octree or median kd-tree
+// splits at, min + k / 2^level of the extent, or on a plane through a
+// vertex, where the SAH kd-tree splits.  The other coordinates are random
+// within the bounds.
+glm::vec3 IntersectionChecker::GetSplitPoint(RandomSequence& random,
+    int axis) const {
+  glm::vec3 extent = bounds_.max() - bounds_.min();
+  glm::vec3 point;
+  for (int d = 0; d < 3; ++d)
+    point[d] = bounds_.min()[d] + random.Next() * extent[d];
+  if (random.Next(2) == 0) {
+    uint32_t num_cells = 1u << random.Next(9);
+    point[axis] = bounds_.min()[axis]
+        + extent[axis] * random.Next(num_cells + 1) / num_cells;
+  } else {
+    Triangle triangle = mesh_.GetPatch(random.Next(mesh_.num_faces()));
+    point[axis] = triangle[random.Next(3)][axis];
+  }
+  return point;
+}
+
+Ray IntersectionChecker::GenerateRay(RayKind kind,
+    RandomSequence& random) const {
+  glm::vec3 extent = bounds_.max() - bounds_.min();
+  float diagonal = glm::length(extent);
+  switch (kind) {
+  case kGrazing: {
+    // Through a point on an edge, or a vertex, of a triangle, half of the
+    // time within the plane of the triangle.
+    Triangle triangle = mesh_.GetPatch(random.Next(mesh_.num_faces()));
+    int i = random.Next(3);
+    float u = (random.Next(4) == 0 ? 0.0f : random.Next());
+    glm::vec3 point = triangle[i] + u * (triangle[(i + 1) % 3] - triangle[i]);
+    glm::vec3 direction = random.NextDirection();
+    glm::vec3 normal = glm::cross(triangle[1] - triangle[0],
+        triangle[2] - triangle[0]);
+    if (random.Next(2) == 0 && glm::length(normal) > 0.0f) {
+      normal = glm::normalize(normal);
+      glm::vec3 in_plane = direction - glm::dot(direction, normal) * normal;
+      if (glm::length(in_plane) > 0.0f)
+        direction = glm::normalize(in_plane);
+    }
+    return Ray(point - (0.1f + random.Next()) * diagonal * direction,
+        direction);
+  }
+  case kAxisAligned: {
+    // At a vertex or a random point, from inside or outside the bounds.
+    int axis = random.Next(3);
+    glm::vec3 direction(0.0f);
+    direction[axis] = (random.Next(2) == 0 ? 1.0f : -1.0f);
+    glm::vec3 target;
+    if (random.Next(2) == 0) {
+      Triangle triangle = mesh_.GetPatch(random.Next(mesh_.num_faces()));
+      target = triangle[random.Next(3)];
+    } else {
+      for (int d = 0; d < 3; ++d)
+        target[d] = bounds_.min()[d] + random.Next() * extent[d];
+    }
+    return Ray(target - 1.2f * random.Next() * extent[axis] * direction,
+        direction);
+  }
+  case kSplitPlane: {
+    // Starting on a split plane, half of the time running within it.
+    int axis = random.Next(3);
+    glm::vec3 direction = random.NextDirection();
+    if (random.Next(2) == 0) {
+      direction[axis] = 0.0f;
+      if (glm::length(direction) > 0.0f)
+        direction = glm::normalize(direction);
+      else
+        direction[(axis + 1) % 3] = 1.0f;
+    }
+    return Ray(GetSplitPoint(random, axis), direction);
+  }
+  default: {
+    glm::vec3 origin;
+    for (int d = 0; d < 3; ++d)
+      origin[d] = bounds_.min()[d] + (1.2f * random.Next() - 0.1f) * extent[d];
+    return Ray(origin, random.NextDirection());
+  }
+  }
+}
+
+void IntersectionChecker::Print(std::ostream& out) const {
+  for (int i = 0; i < kNumRayKinds; ++i)
+    out << GetRayKindName(static_cast<RayKind>(i)) << ": " << num_rays_[i]
+        << " rays, " << num_mismatches_[i] << " mismatches, "
+        << num_ambiguous_[i] << " ambiguous\n";
+  for (size_t i = 0; i < mismatches_.size(); ++i)
+    out << mismatches_[i] << "\n";
+}
+
+const std::vector<IntersectionChecker::Mismatch>&
+IntersectionChecker::mismatches() const {
+  return mismatches_;
+}
+
+int IntersectionChecker::num_rays(RayKind kind) const {
+  return num_rays_[kind];
+}
+
+int IntersectionChecker::num_ambiguous(RayKind kind) const {
+  return num_ambiguous_[kind];
+}
+
+float IntersectionChecker::tolerance() const {
+  return tolerance_;
+}
+
+void IntersectionChecker::set_tolerance(float tolerance) {
+  tolerance_ = tolerance;
+}
+
+const char* IntersectionChecker::GetRayKindName(RayKind kind) {
+  static const char* kRayKindNames[kNumRayKinds] = { "random", "grazing",
+      "axis-aligned", "split-plane" };
+  return (kind >= 0 && kind < kNumRayKinds ? kRayKindNames[kind] : "unknown");
+}
+} // namespace ray
@@ -1,44 +1,405 @@
-#include <iostream>
-#include <string>
+#include <getopt.h>
 #include <cstring>
 #include <cstdlib>
-#include "parse_utils.hpp"
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "accelerator_factory.hpp"
+#include "async_image_writer.hpp"
+#include "camera.hpp"
 #include "image.hpp"
+#include "light.hpp"
+#include "mesh.hpp"
+#include "parse_utils.hpp"
+#include "ray_capture.hpp"
+#include "raytracer.hpp"
+#include "render_metrics.hpp"
+#include "scene.hpp"
+#include "scene_utils.hpp"
+#include "tile_writer.hpp"
+#include "tool_utils.hpp"
+#include "transform.hpp"
+#include "traversal_stats.hpp"
 namespace ray {
-const char* kUsageString = "Usage:\n."
-        "/ray <input-file> <output-file>\n."
-        "/ray <width> <height> <input-file> <output-file>\n";
+const char* kUsageString = "Usage:\n"
+        "  ray [options] <input-file> <output-file>\n"
+        "  ray [options] <width> <height> <input-file> <output-file>\n"
+        "  ray --merge <output-file> <shard-file>...\n"
+        "Options:\n"
+        "  -w, --width <n>          image width (640)\n"
+        "  -h, --height <n>         image height (480)\n"
+        "  -a, --accelerator <type> none, kdtree, octree or sah-octree"
+        " (kdtree)\n"
+        "  -p, --policy <name>      kd-tree split policy: median or sah"
+        " (median);\n"
+        "                           SAH octree evaluation policy: binned,"
+        " centroid,\n"
+        "                           full, mixed64, mixed128, mixed256,"
+        " mixed512,\n"
+        "                           bounded32, bounded64 or bounded128"
+        " (centroid)\n"
+        "  -l, --max-leaf-size <n>  kd-tree leaf size (8)\n"
+        "  -d, --max-depth <n>      kd-tree depth (15)\n"
+        "  -t, --threads <n>        render threads (one per processor)\n"
+        "  -s, --samples <n>        samples per pixel (1)\n"
+        "  -c, --camera <n>         scene camera to render (0); scenes"
+        " without\n"
+        "                           cameras are framed automatically\n"
+        "      --all-cameras        render every scene camera, camera i to"
+        " the\n"
+        "                           output file with _i before its"
+        " extension\n"
+        "      --native-obj         read .obj files with the built-in loader\n"
+        "      --mesh-cache         load from and write the mesh cache\n"
+        "      --page-meshes        page mesh vertices from the mesh cache\n"
+        "      --compact-meshes     store mesh vertices compactly\n"
+        "  -q, --quiet              no progress or statistics\n"
+        "      --shard <i>/<n>      render only shard i of n, a band of rows\n"
+        "      --merge              merge the shards of an image\n"
+        "      --heatmap <file>     also write the tree traversal work per"
+        " pixel\n"
+        "      --heatmap-count <c>  nodes, boxes or primitives (nodes)\n"
+        "      --capture-rays <file> record every ray traced for ray_replay\n"
+        "      --metrics <file>     rewrite file with the progress, rays per"
+        " second,\n"
+        "                           memory, thread utilization and ETA of the"
+        " render;\n"
+        "                           Prometheus text for .prom files, else"
+        " JSON\n"
+        "      --metrics-interval <seconds>  how often (5)\n"
+        "Output files ending in .ppm or .pfm are written tile by tile.  Shards"
+        " must\nbe written to such files and merge into exactly the full"
+        " render.\n"
+        "Heatmaps need a build with RAY_TRAVERSAL_STATS and an output file"
+        " not\nwritten tile by tile.\n";
 
-void VerifyOrDie(bool check, const char* message) {
-    if (!check) {
-        if (message)
-            std::cerr << message;
-        exit(-1);
-    }
+// Parses "<i>/<n>" with 0 <= i < n or dies.
+void ParseShard(const char* str, int* shard, int* num_shards) {
+    std::string s(str);
+    size_t slash = s.find('/');
+    if (slash == std::string::npos
+            || !ParseInt(s.substr(0, slash).c_str(), shard)
+            || !ParseInt(s.substr(slash + 1).c_str(), num_shards)
+            || *num_shards <= 0 || *shard < 0 || *shard >= *num_shards)
+        Die(std::string("Invalid shard: ") + str);
+}
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size()
+            && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// file_name with "_<camera_index>" before its extension, if any.
+std::string GetCameraFileName(const std::string& file_name,
+        int camera_index) {
+    size_t slash = file_name.find_last_of('/');
+    size_t dot = file_name.find_last_of('.');
+    if (dot == std::string::npos
+            || (slash != std::string::npos && dot < slash))
+        dot = file_name.size();
+    std::ostringstream name;
+    name << file_name.substr(0, dot) << "_" << camera_index
+            << file_name.substr(dot);
+    return name.str();
 }
 } // namespace ray
 int main(int argc, char** argv) {
+    ray::SetUsage(ray::kUsageString);
+    enum {
+        kNativeObjOption = 256, kMeshCacheOption, kPageMeshesOption,
+        kCompactMeshesOption, kShardOption, kMergeOption, kHeatmapOption,
+        kHeatmapCountOption, kCaptureRaysOption, kMetricsOption,
+        kMetricsIntervalOption, kAllCamerasOption
+    };
+    static const option kOptions[] = {
+            { "width", required_argument, NULL, 'w' },
+            { "height", required_argument, NULL, 'h' },
+            { "accelerator", required_argument, NULL, 'a' },
+            { "policy", required_argument, NULL, 'p' },
+            { "max-leaf-size", required_argument, NULL, 'l' },
+            { "max-depth", required_argument, NULL, 'd' },
+            { "threads", required_argument, NULL, 't' },
+            { "samples", required_argument, NULL, 's' },
+            { "camera", required_argument, NULL, 'c' },
+            { "all-cameras", no_argument, NULL, kAllCamerasOption },
+            { "native-obj", no_argument, NULL, kNativeObjOption },
+            { "mesh-cache", no_argument, NULL, kMeshCacheOption },
+            { "page-meshes", no_argument, NULL, kPageMeshesOption },
+            { "compact-meshes", no_argument, NULL, kCompactMeshesOption },
+            { "quiet", no_argument, NULL, 'q' },
+            { "shard", required_argument, NULL, kShardOption },
+            { "merge", no_argument, NULL, kMergeOption },
+            { "heatmap", required_argument, NULL, kHeatmapOption },
+            { "heatmap-count", required_argument, NULL, kHeatmapCountOption },
+            { "capture-rays", required_argument, NULL, kCaptureRaysOption },
+            { "metrics", required_argument, NULL, kMetricsOption },
+            { "metrics-interval", required_argument, NULL,
+                    kMetricsIntervalOption },
+            { NULL, 0, NULL, 0 } };
     std::string input;
     std::string output;
     int width = 640;
     int height = 480;
-    int i = -1;
-
+    int num_threads = 0;
+    int num_samples = 1;
+    int camera_index = 0;
+    bool all_cameras = false;
+    bool quiet = false;
+    int shard = 0;
+    int num_shards = 1;
+    bool merge = false;
+    std::string heatmap_file;
+    std::string capture_file;
+    std::string metrics_file;
+    int metrics_interval = 5;
+    ray::TraversalStats::Counter heatmap_counter =
+            ray::TraversalStats::kNodesVisited;
+    std::string policy;
+    ray::AcceleratorFactory factory;
+    ray::SceneLoader& loader = ray::SceneLoader::GetInstance();
+    loader.set_reorder_meshes(true);
+    int c = 0;
+    while ((c = getopt_long(argc, argv, "w:h:a:p:l:d:t:s:c:q", kOptions, NULL))
+            != -1) {
+        switch (c) {
+        case 'w':
+            width = ray::ParsePositive(optarg);
+            break;
+        case 'h':
+            height = ray::ParsePositive(optarg);
+            break;
+        case 'a': {
+            ray::AcceleratorFactory::Type type;
+            if (!ray::AcceleratorFactory::ParseType(optarg, type))
+                ray::Die(std::string("Unknown accelerator: ") + optarg);
+            factory.set_type(type);
+            break;
+        }
+        case 'p':
+            policy = optarg;
+            break;
+        case 'l':
+            factory.set_max_leaf_size(ray::ParsePositive(optarg));
+            break;
+        case 'd':
+            factory.set_max_depth(ray::ParsePositive(optarg));
+            break;
+        case 't':
+            num_threads = ray::ParsePositive(optarg);
+            break;
+        case 's':
+            num_samples = ray::ParsePositive(optarg);
+            break;
+        case 'c':
+            if (!ray::ParseInt(optarg, &camera_index))
+                ray::Die(std::string("Invalid camera: ") + optarg);
+            break;
+        case kAllCamerasOption:
+            all_cameras = true;
+            break;
+        case kNativeObjOption:
+            loader.set_use_native_obj(true);
+            break;
+        case kMeshCacheOption:
+            loader.set_use_mesh_cache(true);
+            break;
+        case kPageMeshesOption:
+            loader.set_page_meshes(true);
+            break;
+        case kCompactMeshesOption:
+            loader.set_compact_meshes(true);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case kShardOption:
+            ray::ParseShard(optarg, &shard, &num_shards);
+            break;
+        case kMergeOption:
+            merge = true;
+            break;
+        case kHeatmapOption:
+            heatmap_file = optarg;
+            break;
+        case kHeatmapCountOption: {
+            std::string count(optarg);
+            if ("nodes" != count && "boxes" != count
+                    && "primitives" != count)
+                ray::Die("Unknown heatmap count: " + count);
+            heatmap_counter = ("nodes" == count ?
+                    ray::TraversalStats::kNodesVisited :
+                    ("boxes" == count ? ray::TraversalStats::kBoxesTested :
+                            ray::TraversalStats::kPrimitivesTested));
+            break;
+        }
+        case kCaptureRaysOption:
+            capture_file = optarg;
+            break;
+        case kMetricsOption:
+            metrics_file = optarg;
+            break;
+        case kMetricsIntervalOption:
+            metrics_interval = ray::ParsePositive(optarg);
+            break;
+        default:
+            ray::Die("");
+        }
+    }
+    int num_args = argc - optind;
+    if (merge) {
+        if (num_args < 2)
+            ray::Die("");
+        output = std::string(argv[optind++]);
+        std::vector<std::string> shard_files(argv + optind, argv + argc);
+        std::string status = "";
+        if (!ray::TileWriter::Merge(shard_files, output, status)) {
+            std::cerr << status << std::endl;
+            return -1;
+        }
+        return 0;
+    }
     // 2 or 4 arguments allowed
-    ray::VerifyOrDie(argc != 2 && argc != 4, ray::kUsageString);
-
-    // get width if argc > 2 and verify width
-    ray::VerifyOrDie(2 == argc && ray::ParseInt(argv[++i], &width),
-            ray::kUsageString);
-
-    // get height if argc > 2 and verify height
-    ray::VerifyOrDie(2 == argc && ray::ParseInt(argv[++i], &height),
-            ray::kUsageString);
+    if (2 != num_args && 4 != num_args)
+        ray::Die("");
+    if (4 == num_args) {
+        width = ray::ParsePositive(argv[optind++]);
+        height = ray::ParsePositive(argv[optind++]);
+    }
+    input = std::string(argv[optind++]);
+    output = std::string(argv[optind++]);
+    bool tiled = ray::EndsWith(output, ".ppm") || ray::EndsWith(output, ".pfm");
+    if (!tiled && num_shards > 1)
+        ray::Die("Shards must be written to .ppm or .pfm files");
+    if (tiled && !heatmap_file.empty())
+        ray::Die("Heatmaps need an output file not written tile by tile");
+    if (all_cameras && (tiled || !heatmap_file.empty()))
+        ray::Die("All cameras need an output file not written tile by tile,"
+                " and no heatmap");
+    if (!heatmap_file.empty() && !ray::kCountTraversal)
+        std::cerr << "Built without RAY_TRAVERSAL_STATS, the heatmap is empty"
+                << std::endl;
+    if (!policy.empty() && !factory.SetPolicy(policy))
+        ray::Die("Unknown policy: " + policy);
 
-    input = std::string(argv[++i]);
-    output = std::string(argv[++i]);
+    std::cout << "w=" << width << " h=" << height << " input=" << input
+            << " output=" << output << " accelerator="
+            << ray::AcceleratorFactory::GetTypeName(factory.type())
+            << std::endl;
+    double start = ray::GetSeconds();
+    ray::Scene scene;
+    std::string status = "";
+    if (!loader.LoadScene(input, scene, status)) {
+        std::cerr << "Cannot load " << input << ": " << status << std::endl;
+        return -1;
+    }
+    double loaded = ray::GetSeconds();
+    std::vector<ray::Accelerator*> accelerators;
+    factory.Accelerate(scene, accelerators);
+    double built = ray::GetSeconds();
 
-    std::cout << "w=" << width << " h=" << height << "input=" << input
-            << " output=" << output << std::endl;
+    if (all_cameras && scene.cameras().empty())
+        ray::Die("The scene has no cameras");
+    if (all_cameras)
+        camera_index = 0;
+    ray::Camera camera;
+    if (scene.cameras().empty()) {
+        camera = ray::FrameScene(scene, width, height);
+    } else {
+        if (camera_index < 0
+                || camera_index >= static_cast<int>(scene.cameras().size()))
+            ray::Die("No such camera");
+        camera = scene.cameras()[camera_index];
+        camera.Resize(width, height);
+    }
+    if (scene.lights().empty()) {
+        // A headlight, so that unlit scenes show up.
+        ray::Light light;
+        light.ka = light.kd = light.ks = glm::vec3(1.0f);
+        light.ray = ray::Ray(glm::vec3(0.0f),
+                camera.GenerateRay(0.5f * width, 0.5f * height).direction());
+        light.type = ray::Light::kDirectional;
+        scene.AddLight(light);
+    }
+    ray::RayTracer ray_tracer(&scene, &camera);
+    ray_tracer.set_display_progress(!quiet);
+    ray_tracer.set_display_stats(!quiet);
+    if (num_threads > 0)
+        ray_tracer.set_num_threads(num_threads);
+    if (num_samples > 1)
+        ray_tracer.set_antialiasing(num_samples, num_samples, 0.0f);
+    ray::RayCapture ray_capture;
+    if (!capture_file.empty())
+        ray_tracer.set_ray_capture(&ray_capture);
+    ray::RenderMetrics metrics;
+    ray::MetricsExporter exporter(metrics, metrics_file, metrics_interval);
+    if (!metrics_file.empty()) {
+        ray_tracer.set_render_metrics(&metrics);
+        if (!exporter.Start(status)) {
+            std::cerr << status << std::endl;
+            return -1;
+        }
+    }
+    bool success = false;
+    if (tiled) {
+        ray::TileWriter writer;
+        success = writer.Open(output, width, height, status);
+        if (success) {
+            // A failed render leaves the status of Close(), which names the
+            // file it could not write.
+            success = ray_tracer.Render(writer,
+                    ray::RayTracer::GetShard(shard, num_shards, width, height));
+            success = writer.Close(status) && success;
+        }
+    } else if (all_cameras) {
+        // Each image is encoded on the writer thread while the next camera
+        // renders; the ray tracer keeps pointing at camera.
+        ray::AsyncImageWriter writer(2);
+        for (size_t i = 0; i < scene.cameras().size(); ++i) {
+            camera = scene.cameras()[i];
+            camera.Resize(width, height);
+            ray::Image image;
+            image.Resize(width, height);
+            ray_tracer.Render(image);
+            writer.WriteImage(ray::GetCameraFileName(output, i), image);
+        }
+        success = writer.Flush(status);
+    } else {
+        ray::Image image;
+        image.Resize(width, height);
+        ray::Image heatmap;
+        if (heatmap_file.empty()) {
+            ray_tracer.Render(image);
+        } else {
+            ray_tracer.set_heatmap_counter(heatmap_counter);
+            ray_tracer.Render(image, heatmap);
+        }
+        success = ray::ImageStorage::GetInstance().WriteImage(output, image,
+                status);
+        if (success && !heatmap_file.empty()) {
+            output = heatmap_file;
+            success = ray::ImageStorage::GetInstance().WriteImage(output,
+                    heatmap, status);
+        }
+    }
+    double rendered = ray::GetSeconds();
+    if (success && !metrics_file.empty()) {
+        output = metrics_file;
+        success = exporter.Stop(status);
+    }
+    if (success && !capture_file.empty()) {
+        output = capture_file;
+        success = ray_capture.Write(capture_file, status);
+    }
+    for (size_t i = 0; i < accelerators.size(); ++i)
+        delete accelerators[i];
+    if (!success) {
+        std::cerr << "Cannot write " << output << ": " << status << std::endl;
+        return -1;
+    }
+    std::cout << std::fixed << std::setprecision(3) << "\nload "
+            << loaded - start << " s, build " << built - loaded
+            << " s, render " << rendered - built << " s" << std::endl;
     return 0;
 }
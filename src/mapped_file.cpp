@@ -0,0 +1,83 @@
+/*
+ * mapped_file.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include "mapped_file.hpp"
+namespace ray {
+MappedFile::MappedFile() :
+    data_(NULL), size_(0), is_open_(false) {
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::string& file_name, std::string& status) {
+  return Open(file_name, kPreload, status);
+}
+
+bool MappedFile::Open(const std::string& file_name, Access access,
+    std::string& status) {
+  Close();
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    status = "Cannot open " + file_name + ": " + strerror(errno);
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    status = "Cannot stat " + file_name + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  size_ = info.st_size;
+  if (size_ > 0) {
+    void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == data) {
+      status = "Cannot map " + file_name + ": " + strerror(errno);
+      close(fd);
+      size_ = 0;
+      return false;
+    }
+    // Preloaded files are about to be read whole, in parallel, so ask for
+    // all of it up front rather than relying on sequential read-ahead.
+    madvise(data, size_, (kPreload == access ? MADV_WILLNEED : MADV_RANDOM));
+    data_ = static_cast<const char*>(data);
+  }
+  close(fd);
+  is_open_ = true;
+  status = "OK";
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+  data_ = NULL;
+  size_ = 0;
+  is_open_ = false;
+}
+
+bool MappedFile::is_open() const {
+  return is_open_;
+}
+
+const char* MappedFile::data() const {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
+} // namespace ray
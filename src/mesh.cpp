@@ -4,29 +4,38 @@
  *  Created on: Oct 1, 2013
  *      Author: agrippa
  */
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
 #include "geometry.hpp"
 #include "io_utils.hpp"
 #include "mesh.hpp"
+#include "morton.hpp"
+#include "quantize.hpp"
 #include "scene.hpp"
 #include "shape.hpp"
 #include "types.hpp"
 namespace ray {
 TrimeshFace::TrimeshFace() :
-    SceneShape(), mesh_(NULL) {
+    mesh_(NULL) {
 }
 
 TrimeshFace::TrimeshFace(const TrimeshFace& face) :
-    SceneShape(), mesh_(face.mesh_) {
+    mesh_(face.mesh_) {
   for (int i = 0; i < 3; ++i) {
     vertices_[i] = face.vertices_[i];
   }
 }
 
 TrimeshFace::TrimeshFace(Trimesh* mesh, int i, int j, int k) :
-    SceneShape(), mesh_(mesh) {
+    mesh_(mesh) {
   vertices_[0] = i;
   vertices_[1] = j;
   vertices_[2] = k;
@@ -51,9 +60,9 @@ void TrimeshFace::set_mesh(Trimesh* mesh) {
 bool TrimeshFace::Intersect(const Ray& ray, Isect& isect) const {
   bool hit = mesh_ != NULL && mesh_->GetPatch(*this).Intersect(ray, isect);
   if (hit) {
-    isect.obj = static_cast<const Shape*>(this);
+    isect.obj = static_cast<const Shape*>(mesh_);
     isect.normal = mesh_->InterpolateNormal(*this, isect.bary);
-    isect.mat = material_;
+    isect.mat = mesh_->material();
   }
   return hit;
 }
@@ -70,9 +79,16 @@ void TrimeshFace::Print(std::ostream& out) const {
   out << "TrimeshFace:" << mesh_->GetPatch(*this);
 }
 
+std::ostream& operator<<(std::ostream& out, const TrimeshFace& face) {
+  face.Print(out);
+  return out;
+}
+
 Trimesh::Trimesh() :
     SceneShape(), vertices_(), normals_(), tex_coords_(), faces_(), bounds_(),
-        accelerator_(NULL) {
+        accelerator_(NULL), compact_(false), compact_vertices_(),
+        compact_normals_(), compact_tex_coords_(), compact_origin_(0.0f),
+        compact_scale_(0.0f) {
 }
 
 const std::vector<TrimeshFace>& Trimesh::faces() const {
@@ -84,13 +100,21 @@ int Trimesh::num_faces() const {
 }
 
 int Trimesh::num_vertices() const {
-  return vertices_.size();
+  return (compact_ ? compact_vertices_.size() / 3 : vertices_.size());
 }
 
-const std::vector<glm::vec3>& Trimesh::vertices() const {
+const MeshArray<glm::vec3>& Trimesh::vertices() const {
   return vertices_;
 }
 
+const MeshArray<glm::vec3>& Trimesh::normals() const {
+  return normals_;
+}
+
+const MeshArray<TexCoord>& Trimesh::tex_coords() const {
+  return tex_coords_;
+}
+
 void Trimesh::AddVertex(const glm::vec3& vertex) {
   vertices_.push_back(vertex);
 }
@@ -109,7 +133,261 @@ void Trimesh::AddTexCoord(const TexCoord& tex_coord) {
   tex_coords_.push_back(tex_coord);
 }
 
+void Trimesh::MapVertices(const glm::vec3* vertices, const glm::vec3* normals,
+    const TexCoord* tex_coords, int num_vertices,
+    const boost::shared_ptr<const void>& owner) {
+  vertices_.Map(vertices, num_vertices, owner);
+  if (NULL != normals)
+    normals_.Map(normals, num_vertices, owner);
+  else
+    normals_.clear();
+  if (NULL != tex_coords)
+    tex_coords_.Map(tex_coords, num_vertices, owner);
+  else
+    tex_coords_.clear();
+}
+
+void Trimesh::SetVertices(std::vector<glm::vec3>& vertices) {
+  vertices_.Swap(vertices);
+}
+
+void Trimesh::SetNormals(std::vector<glm::vec3>& normals) {
+  normals_.Swap(normals);
+}
+
+void Trimesh::SetTexCoords(std::vector<TexCoord>& tex_coords) {
+  tex_coords_.Swap(tex_coords);
+}
+
+bool Trimesh::SetFaces(const std::vector<int32_t>& indices) {
+  if (indices.size() % 3 != 0)
+    return false;
+  int num_faces = indices.size() / 3;
+  const int32_t* index = (indices.empty() ? NULL : &indices[0]);
+  // The bounds of the faces are those of the vertices they use.  Usually
+  // that is every vertex, which allows a straight pass over the array.
+  std::vector<bool> used(vertices_.size(), false);
+  size_t num_used = 0;
+  for (int i = 0; i < 3 * num_faces; ++i) {
+    if (static_cast<uint32_t>(index[i]) >= vertices_.size())
+      return false;
+    if (!used[index[i]]) {
+      used[index[i]] = true;
+      ++num_used;
+    }
+  }
+  BoundingBox bounds;
+  if (num_used == vertices_.size()) {
+    bounds = ComputeBounds(vertices_.data(), vertices_.size());
+  } else {
+    for (size_t i = 0; i < used.size(); ++i) {
+      if (used[i]) {
+        bounds.min() = glm::min(bounds.min(), vertices_[i]);
+        bounds.max() = glm::max(bounds.max(), vertices_[i]);
+      }
+    }
+  }
+  SetFaces(index, num_faces, bounds);
+  return true;
+}
+
+void Trimesh::SetFaces(const int32_t* indices, int num_faces,
+    const BoundingBox& bounds) {
+  faces_.clear();
+  faces_.reserve(num_faces);
+  for (int i = 0; i < num_faces; ++i, indices += 3)
+    faces_.push_back(TrimeshFace(this, indices[0], indices[1], indices[2]));
+  bounds_ = bounds;
+}
+
+BoundingBox Trimesh::ComputeBounds(const glm::vec3* vertices,
+    size_t num_vertices) {
+  BoundingBox bounds;
+  size_t i = 0;
+#ifdef __SSE__
+  // Four vertices are twelve floats, i.e. three registers holding the
+  // components xyzx, yzxy and zxyz, which are reduced independently.
+  const float* v = reinterpret_cast<const float*>(vertices);
+  __m128 min[3];
+  __m128 max[3];
+  for (int r = 0; r < 3; ++r) {
+    min[r] = _mm_set1_ps(std::numeric_limits<float>::max());
+    max[r] = _mm_set1_ps(-std::numeric_limits<float>::max());
+  }
+  for (; i + 4 <= num_vertices; i += 4, v += 12) {
+    for (int r = 0; r < 3; ++r) {
+      __m128 values = _mm_loadu_ps(v + 4 * r);
+      min[r] = _mm_min_ps(min[r], values);
+      max[r] = _mm_max_ps(max[r], values);
+    }
+  }
+  float mins[12];
+  float maxs[12];
+  for (int r = 0; r < 3; ++r) {
+    _mm_storeu_ps(mins + 4 * r, min[r]);
+    _mm_storeu_ps(maxs + 4 * r, max[r]);
+  }
+  for (int k = 0; k < 12; ++k) {
+    bounds.min()[k % 3] = std::min(bounds.min()[k % 3], mins[k]);
+    bounds.max()[k % 3] = std::max(bounds.max()[k % 3], maxs[k]);
+  }
+#endif
+  for (; i < num_vertices; ++i) {
+    bounds.min() = glm::min(bounds.min(), vertices[i]);
+    bounds.max() = glm::max(bounds.max(), vertices[i]);
+  }
+  return bounds;
+}
+
+// Reorders elements, groups of size consecutive values each, so that the
+// group at k moves to the group of old_index[k].
+template<typename T>
+static void PermuteGroups(std::vector<T>& elements, int size,
+    const std::vector<int>& old_index) {
+  if (elements.empty())
+    return;
+  std::vector<T> permuted;
+  permuted.reserve(elements.size());
+  for (size_t k = 0; k < old_index.size(); ++k)
+    for (int c = 0; c < size; ++c)
+      permuted.push_back(elements[size * old_index[k] + c]);
+  elements.swap(permuted);
+}
+
+template<typename T>
+static void PermuteArray(MeshArray<T>& elements,
+    const std::vector<int>& old_index) {
+  if (elements.empty())
+    return;
+  std::vector<T> permuted;
+  permuted.reserve(elements.size());
+  for (size_t k = 0; k < old_index.size(); ++k)
+    permuted.push_back(elements[old_index[k]]);
+  elements.Swap(permuted);
+}
+
+void Trimesh::ImproveLocality() {
+  int num_vertices = this->num_vertices();
+  glm::vec3 origin = bounds_.min();
+  glm::vec3 extent = bounds_.max() - bounds_.min();
+  glm::vec3 scale(0.0f);
+  for (int k = 0; k < 3; ++k)
+    if (extent[k] > 0.0f)
+      scale[k] = 1023.0f / extent[k];
+  // Ties keep the original order.
+  std::vector<std::pair<uint32_t, int> > keys(faces_.size());
+  for (size_t i = 0; i < faces_.size(); ++i) {
+    const TrimeshFace& face = faces_[i];
+    glm::vec3 centroid = (GetVertex(face[0]) + GetVertex(face[1])
+        + GetVertex(face[2])) / 3.0f;
+    uint32_t q[3];
+    for (int k = 0; k < 3; ++k)
+      q[k] = static_cast<uint32_t>(std::min(
+          std::max((centroid[k] - origin[k]) * scale[k], 0.0f), 1023.0f));
+    keys[i] = std::make_pair(MortonEncode3(q[0], q[1], q[2]),
+        static_cast<int>(i));
+  }
+  std::sort(keys.begin(), keys.end());
+  std::vector<int> new_index(num_vertices, -1);
+  std::vector<int> old_index;
+  old_index.reserve(num_vertices);
+  std::vector<TrimeshFace> faces;
+  faces.reserve(faces_.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    TrimeshFace face = faces_[keys[i].second];
+    for (int j = 0; j < 3; ++j) {
+      if (new_index[face[j]] < 0) {
+        new_index[face[j]] = old_index.size();
+        old_index.push_back(face[j]);
+      }
+      face[j] = new_index[face[j]];
+    }
+    faces.push_back(face);
+  }
+  for (int i = 0; i < num_vertices; ++i)
+    if (new_index[i] < 0)
+      old_index.push_back(i);
+  faces_.swap(faces);
+  PermuteArray(vertices_, old_index);
+  PermuteArray(normals_, old_index);
+  PermuteArray(tex_coords_, old_index);
+  PermuteGroups(compact_vertices_, 3, old_index);
+  PermuteGroups(compact_normals_, 1, old_index);
+  PermuteGroups(compact_tex_coords_, 1, old_index);
+}
+
+void Trimesh::Compact() {
+  if (compact_)
+    return;
+  size_t num_vertices = vertices_.size();
+  BoundingBox vertex_bounds = ComputeBounds(vertices_.data(), num_vertices);
+  compact_origin_ = vertex_bounds.min();
+  compact_scale_ = glm::vec3(0.0f);
+  glm::vec3 extent = vertex_bounds.max() - vertex_bounds.min();
+  for (int k = 0; k < 3; ++k)
+    if (num_vertices > 0 && extent[k] > 0.0f)
+      compact_scale_[k] = extent[k] / 65535.0f;
+  compact_vertices_.resize(3 * num_vertices);
+  for (size_t i = 0; i < num_vertices; ++i)
+    for (int k = 0; k < 3; ++k) {
+      float q = (compact_scale_[k] > 0.0f ?
+          (vertices_[i][k] - compact_origin_[k]) / compact_scale_[k] : 0.0f);
+      compact_vertices_[3 * i + k] = static_cast<uint16_t>(std::min(
+          std::max(floorf(q + 0.5f), 0.0f), 65535.0f));
+    }
+  compact_normals_.resize(normals_.size());
+  for (size_t i = 0; i < normals_.size(); ++i)
+    compact_normals_[i] = EncodeOctahedral(normals_[i]);
+  compact_tex_coords_.resize(tex_coords_.size());
+  for (size_t i = 0; i < tex_coords_.size(); ++i)
+    compact_tex_coords_[i] = FloatToHalf(tex_coords_[i].coords[0])
+        | (static_cast<uint32_t>(FloatToHalf(tex_coords_[i].coords[1])) << 16);
+  vertices_.clear();
+  normals_.clear();
+  tex_coords_.clear();
+  compact_ = true;
+  // Quantized vertices can move by half a step, so the bounds are redone.
+  bounds_ = BoundingBox();
+  for (size_t i = 0; i < faces_.size(); ++i)
+    bounds_ = bounds_.Join(GetPatch(faces_[i]).GetBounds());
+}
+
+bool Trimesh::is_compact() const {
+  return compact_;
+}
+
+glm::vec3 Trimesh::GetVertex(int i) const {
+  if (!compact_)
+    return vertices_[i];
+  const uint16_t* q = &compact_vertices_[3 * i];
+  return compact_origin_
+      + compact_scale_ * glm::vec3(q[0], q[1], q[2]);
+}
+
+glm::vec3 Trimesh::GetNormal(int i) const {
+  return (compact_ ? DecodeOctahedral(compact_normals_[i]) : normals_[i]);
+}
+
+TexCoord Trimesh::GetTexCoord(int i) const {
+  if (!compact_)
+    return tex_coords_[i];
+  uint32_t code = compact_tex_coords_[i];
+  return TexCoord(glm::vec3(HalfToFloat(code & 0xffff),
+      HalfToFloat(code >> 16), 0.0f));
+}
+
+bool Trimesh::has_normals() const {
+  return (compact_ ? !compact_normals_.empty() : !normals_.empty());
+}
+
+bool Trimesh::has_tex_coords() const {
+  return (compact_ ? !compact_tex_coords_.empty() : !tex_coords_.empty());
+}
+
 Triangle Trimesh::GetPatch(const TrimeshFace& face) const {
+  if (compact_)
+    return Triangle(GetVertex(face[0]), GetVertex(face[1]),
+        GetVertex(face[2]));
   Triangle result = Triangle(vertices_[face[0]], vertices_[face[1]],
       vertices_[face[2]]);
   return result;
@@ -122,6 +400,11 @@ Triangle Trimesh::GetPatch(int face_index) const {
 glm::vec3 Trimesh::InterpolateNormal(const TrimeshFace& face,
     const glm::vec3& bary) const {
   glm::vec3 N = glm::vec3(0.0f);
+  if (compact_) {
+    for (int j = 0; j < 3; ++j)
+      N += DecodeOctahedral(compact_normals_[face[j]]) * bary[j];
+    return glm::normalize(N);
+  }
   for (int j = 0; j < 3; ++j) {
     N += normals_[face[j]] * bary[j];
   }
@@ -133,7 +416,6 @@ glm::vec3 Trimesh::InterpolateNormal(int i, const glm::vec3& bary) const {
 }
 
 bool Trimesh::IntersectAccelerated(const Ray& ray, Isect& isect) const {
-  accelerator_->set_trace(trace_);
   return accelerator_->Intersect(ray, isect);
 }
 
@@ -169,19 +451,6 @@ bool Trimesh::Intersect(const Ray& ray, Isect& isect) const {
           << hit << std::endl;
   } else
     hit = IntersectUnaccelerated(ray, isect);
-  /**if (accelerator_) {
-   Isect isect2;
-   bool hit2 = IntersectUnaccelerated(ray, isect2);
-   if (hit != hit2 || !(isect == isect2)) {
-   std::cout << "\nIntersect Mismatch\n";
-   std::cout << "hit = " << hit << "\nhit2 = " << hit2;
-   std::cout << "\nisect = " << isect << "\nisect2 = " << isect2;
-   accelerator_->set_trace(true);
-   IntersectAccelerated(ray, isect);
-   }
-   assert(hit == hit2);
-   assert(isect2 == isect);
-   }**/
   if (hit && !isect.mat)
     isect.mat = material_;
   return hit;
@@ -206,13 +475,21 @@ BoundingBox Trimesh::GetBounds() {
   return bounds_;
 }
 
+size_t Trimesh::GetMemoryUsage() const {
+  return faces_.capacity() * sizeof(TrimeshFace) + vertices_.GetMemoryUsage()
+      + normals_.GetMemoryUsage() + tex_coords_.GetMemoryUsage()
+      + compact_vertices_.capacity() * sizeof(uint16_t)
+      + (compact_normals_.capacity() + compact_tex_coords_.capacity())
+          * sizeof(uint32_t);
+}
+
 void Trimesh::Print(std::ostream& out) const {
   out << "[Trimesh, ";
   out << " v:[";
-  PrintVector(out, vertices_, ",");
+  PrintArray(out, vertices_.data(), vertices_.size(), ",");
   out << "]\n";
   out << " n:[";
-  PrintVector(out, normals_, ",");
+  PrintArray(out, normals_.data(), normals_.size(), ",");
   out << "]\n";
   out << " f:[";
   PrintVector(out, faces_, ",");
@@ -221,9 +498,20 @@ void Trimesh::Print(std::ostream& out) const {
 
 void Trimesh::set_accelerator(Accelerator* accelerator) {
   accelerator_ = accelerator;
+  if (accelerator_)
+    accelerator_->set_trace(trace_);
+}
+
+void Trimesh::set_trace(bool trace) {
+  SceneShape::set_trace(trace);
+  if (accelerator_)
+    accelerator_->set_trace(trace);
 }
 
 Accelerator* const & Trimesh::accelerator() const {
   return accelerator_;
 }
+
+MeshSink::~MeshSink() {
+}
 } // namespace ray
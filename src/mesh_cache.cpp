@@ -0,0 +1,504 @@
+/*
+ * mesh_cache.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "scene.hpp"
+#include "types.hpp"
+namespace ray {
+// The mapped arrays are reinterpreted as these types.
+typedef char Vec3SizeCheck[sizeof(glm::vec3) == 3 * sizeof(float) ? 1 : -1];
+typedef char TexCoordSizeCheck[
+    sizeof(TexCoord) == 3 * sizeof(float) ? 1 : -1];
+
+static const char kMagic[8] = { 'R', 'T', 'M', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t kVersion = 1;
+static const uint32_t kByteOrderMark = 0x01020304;
+static const uint32_t kHasNormals = 1;
+static const uint32_t kHasTexCoords = 2;
+
+struct MeshCache::MeshHeader {
+  int32_t material;
+  uint32_t num_vertices;
+  uint32_t num_faces;
+  uint32_t flags;
+  float bounds[6];
+};
+
+// Reads values from the mapped file, failing, instead of reading past its
+// end, on truncated files.
+class MeshCache::Reader {
+public:
+  Reader(const char* data, size_t size) :
+      data_(data), end_(data + size), ok_(true) {
+  }
+
+  bool ok() const {
+    return ok_;
+  }
+
+  const char* Skip(size_t size) {
+    if (!ok_ || size > static_cast<size_t>(end_ - data_)) {
+      ok_ = false;
+      return NULL;
+    }
+    const char* result = data_;
+    data_ += size;
+    return result;
+  }
+
+  template<typename T>
+  T Read() {
+    T value = T();
+    const char* data = Skip(sizeof(T));
+    if (NULL != data)
+      memcpy(&value, data, sizeof(T));
+    return value;
+  }
+
+  template<typename T>
+  const T* ReadArray(size_t count) {
+    if (count > static_cast<size_t>(end_ - data_) / sizeof(T)) {
+      ok_ = false;
+      return NULL;
+    }
+    return reinterpret_cast<const T*>(Skip(count * sizeof(T)));
+  }
+
+  std::string ReadString() {
+    uint32_t length = Read<uint32_t>();
+    const char* data = Skip((length + 3) & ~3u);
+    return (NULL != data ? std::string(data, length) : std::string());
+  }
+
+  glm::vec3 ReadVec3() {
+    glm::vec3 v;
+    for (int i = 0; i < 3; ++i)
+      v[i] = Read<float>();
+    return v;
+  }
+
+  glm::mat4x4 ReadMat4() {
+    glm::mat4x4 m;
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j)
+        m[i][j] = Read<float>();
+    return m;
+  }
+private:
+  const char* data_;
+  const char* end_;
+  bool ok_;
+};
+
+template<typename T>
+static void WriteValue(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void WriteString(std::ostream& out, const std::string& s) {
+  static const char kPadding[4] = { 0, 0, 0, 0 };
+  WriteValue(out, static_cast<uint32_t>(s.size()));
+  out.write(s.data(), s.size());
+  out.write(kPadding, (4 - s.size() % 4) % 4);
+}
+
+static void WriteVec3(std::ostream& out, const glm::vec3& v) {
+  for (int i = 0; i < 3; ++i)
+    WriteValue(out, v[i]);
+}
+
+static void WriteMat4(std::ostream& out, const glm::mat4x4& m) {
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      WriteValue(out, m[i][j]);
+}
+
+std::string MeshCache::GetCacheFileName(const std::string& file_name) {
+  return file_name + ".rtcache";
+}
+
+bool MeshCache::GetSourceStamp(const std::string& source_file,
+    uint64_t& size, int64_t& mtime) {
+  struct stat info;
+  if (stat(source_file.c_str(), &info) != 0)
+    return false;
+  size = info.st_size;
+  mtime = info.st_mtime;
+  return true;
+}
+
+MeshCache::SceneStart::SceneStart() : num_cameras(0), num_lights(0),
+    num_materials(0), num_shapes(0) {
+}
+
+MeshCache::SceneStart::SceneStart(const Scene& scene) :
+    num_cameras(scene.cameras().size()), num_lights(scene.lights().size()),
+    num_materials(scene.material_list().materials.size()),
+    num_shapes(scene.scene_objects().size()) {
+}
+
+bool MeshCache::Write(const std::string& cache_file,
+    const std::string& source_file, const Scene& scene, std::string& status) {
+  return Write(cache_file, source_file, scene, SceneStart(), status);
+}
+
+bool MeshCache::Write(const std::string& cache_file,
+    const std::string& source_file, const Scene& scene,
+    const SceneStart& start, std::string& status) {
+  const std::vector<SceneShape*>& shapes = scene.scene_objects();
+  std::vector<Trimesh*> meshes;
+  for (size_t i = start.num_shapes; i < shapes.size(); ++i) {
+    meshes.push_back(dynamic_cast<Trimesh*>(shapes[i]));
+    if (NULL == meshes.back()) {
+      status = "Only triangle meshes can be cached";
+      return false;
+    }
+  }
+  Writer writer;
+  if (!writer.Open(cache_file, source_file, scene, start, status))
+    return false;
+  for (size_t i = 0; i < meshes.size(); ++i)
+    if (!writer.AddMesh(*meshes[i], status))
+      return false;
+  return writer.Close(status);
+}
+
+MeshCache::Writer::Writer() :
+    cache_file_(), temp_file_(), out_(), header_(), scene_(NULL), start_(),
+        is_open_(false), wrote_scene_(false) {
+}
+
+MeshCache::Writer::~Writer() {
+  if (is_open_) {
+    out_.close();
+    remove(temp_file_.c_str());
+  }
+}
+
+bool MeshCache::Writer::Open(const std::string& cache_file,
+    const std::string& source_file, const Scene& scene,
+    const SceneStart& start, std::string& status) {
+  if (is_open_) {
+    status = "Cache already open";
+    return false;
+  }
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, kMagic, sizeof(kMagic));
+  header_.version = kVersion;
+  header_.byte_order = kByteOrderMark;
+  if (!GetSourceStamp(source_file, header_.source_size,
+      header_.source_mtime)) {
+    status = "Cannot stat " + source_file;
+    return false;
+  }
+  if (start.num_cameras > scene.cameras().size()
+      || start.num_lights > scene.lights().size()
+      || start.num_materials > scene.material_list().materials.size()
+      || start.num_shapes > scene.scene_objects().size()) {
+    status = "Scene is smaller than its start";
+    return false;
+  }
+  // Write to a private file and rename it, so that concurrent loads never
+  // see a partially written cache.
+  std::ostringstream temp_file;
+  temp_file << cache_file << ".tmp" << getpid();
+  out_.open(temp_file.str().c_str(),
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out_) {
+    status = "Cannot create " + temp_file.str();
+    return false;
+  }
+  cache_file_ = cache_file;
+  temp_file_ = temp_file.str();
+  scene_ = &scene;
+  start_ = start;
+  is_open_ = true;
+  wrote_scene_ = false;
+  // The counts are filled in by Close().
+  WriteValue(out_, header_);
+  status = "OK";
+  return true;
+}
+
+// The cameras, lights and materials go first, once the loader has added
+// them all to the scene.
+void MeshCache::Writer::WriteScene() {
+  const Scene& scene = *scene_;
+  const MaterialList& material_list = scene.material_list();
+  const std::vector<Material>& materials = material_list.materials;
+  header_.num_cameras = scene.cameras().size() - start_.num_cameras;
+  header_.num_lights = scene.lights().size() - start_.num_lights;
+  header_.num_materials = materials.size() - start_.num_materials;
+  for (size_t i = start_.num_cameras; i < scene.cameras().size(); ++i) {
+    const Camera& camera = scene.cameras()[i];
+    WriteValue(out_, static_cast<int32_t>(camera.screen_width()));
+    WriteValue(out_, static_cast<int32_t>(camera.screen_height()));
+    WriteMat4(out_, camera.projection());
+    WriteMat4(out_, camera.view());
+  }
+  for (size_t i = start_.num_lights; i < scene.lights().size(); ++i) {
+    const Light& light = scene.lights()[i];
+    WriteString(out_, light.name);
+    WriteValue(out_, static_cast<int32_t>(light.type));
+    WriteVec3(out_, light.spot_coefficients);
+    WriteVec3(out_, light.attenuation_coefficients);
+    WriteVec3(out_, light.ka);
+    WriteVec3(out_, light.kd);
+    WriteVec3(out_, light.ks);
+    WriteVec3(out_, light.ray.origin());
+    WriteVec3(out_, light.ray.direction());
+  }
+  for (size_t i = start_.num_materials; i < materials.size(); ++i) {
+    const Material& material = materials[i];
+    boost::unordered_map<int, std::string>::const_iterator name =
+        material_list.id_to_name_lookup.find(material.id);
+    WriteString(out_,
+        (name != material_list.id_to_name_lookup.end() ?
+            name->second : std::string()));
+    WriteVec3(out_, material.kd);
+    WriteVec3(out_, material.ks);
+    WriteVec3(out_, material.ka);
+    WriteVec3(out_, material.ke);
+    WriteValue(out_, material.kr);
+    WriteValue(out_, material.kt);
+    WriteValue(out_, material.tr);
+    WriteValue(out_, material.ns);
+  }
+  wrote_scene_ = true;
+}
+
+bool MeshCache::Writer::AddMesh(Trimesh& mesh, std::string& status) {
+  if (!is_open_) {
+    status = "Cache not open";
+    return false;
+  }
+  if (!wrote_scene_)
+    WriteScene();
+  const std::vector<Material>& materials = scene_->material_list().materials;
+  MeshHeader mesh_header;
+  memset(&mesh_header, 0, sizeof(mesh_header));
+  mesh_header.material = -1;
+  const Material* material = mesh.material();
+  if (NULL != material && start_.num_materials < materials.size()
+      && material >= &materials[start_.num_materials]
+      && material < &materials[0] + materials.size())
+    mesh_header.material = material - &materials[start_.num_materials];
+  int num_vertices = mesh.num_vertices();
+  mesh_header.num_vertices = num_vertices;
+  mesh_header.num_faces = mesh.num_faces();
+  const glm::vec3* vertex_data = mesh.vertices().data();
+  const glm::vec3* normal_data = mesh.normals().data();
+  const TexCoord* tex_coord_data = mesh.tex_coords().data();
+  bool has_normals = mesh.has_normals();
+  bool has_tex_coords = mesh.has_tex_coords();
+  if (mesh.is_compact()) {
+    // Compact meshes are cached decoded.
+    decoded_vertices_.clear();
+    decoded_normals_.clear();
+    decoded_tex_coords_.clear();
+    for (int j = 0; j < num_vertices; ++j) {
+      decoded_vertices_.push_back(mesh.GetVertex(j));
+      if (has_normals)
+        decoded_normals_.push_back(mesh.GetNormal(j));
+      if (has_tex_coords)
+        decoded_tex_coords_.push_back(mesh.GetTexCoord(j));
+    }
+    vertex_data = (num_vertices > 0 ? &decoded_vertices_[0] : NULL);
+    normal_data = (has_normals ? &decoded_normals_[0] : NULL);
+    tex_coord_data = (has_tex_coords ? &decoded_tex_coords_[0] : NULL);
+  } else {
+    has_normals = mesh.normals().size() == mesh.vertices().size();
+    has_tex_coords = mesh.tex_coords().size() == mesh.vertices().size();
+  }
+  mesh_header.flags = (has_normals ? kHasNormals : 0)
+      | (has_tex_coords ? kHasTexCoords : 0);
+  BoundingBox bounds = mesh.GetBounds();
+  for (int j = 0; j < 3; ++j) {
+    mesh_header.bounds[j] = bounds.min()[j];
+    mesh_header.bounds[j + 3] = bounds.max()[j];
+  }
+  WriteValue(out_, mesh_header);
+  size_t vec3_bytes = num_vertices * sizeof(glm::vec3);
+  out_.write(reinterpret_cast<const char*>(vertex_data), vec3_bytes);
+  if (has_normals)
+    out_.write(reinterpret_cast<const char*>(normal_data), vec3_bytes);
+  if (has_tex_coords)
+    out_.write(reinterpret_cast<const char*>(tex_coord_data), vec3_bytes);
+  const std::vector<TrimeshFace>& faces = mesh.faces();
+  indices_.resize(3 * faces.size());
+  for (size_t j = 0; j < faces.size(); ++j)
+    for (int k = 0; k < 3; ++k)
+      indices_[3 * j + k] = faces[j][k];
+  if (!indices_.empty())
+    out_.write(reinterpret_cast<const char*>(&indices_[0]),
+        indices_.size() * sizeof(int32_t));
+  ++header_.num_meshes;
+  if (!out_) {
+    status = "Cannot write " + cache_file_;
+    return false;
+  }
+  status = "OK";
+  return true;
+}
+
+bool MeshCache::Writer::Close(std::string& status) {
+  if (!is_open_) {
+    status = "Cache not open";
+    return false;
+  }
+  if (!wrote_scene_)
+    WriteScene();
+  out_.seekp(0);
+  WriteValue(out_, header_);
+  out_.close();
+  is_open_ = false;
+  if (!out_ || rename(temp_file_.c_str(), cache_file_.c_str()) != 0) {
+    remove(temp_file_.c_str());
+    status = "Cannot write " + cache_file_;
+    return false;
+  }
+  status = "OK";
+  return true;
+}
+
+bool MeshCache::Load(const std::string& cache_file,
+    const std::string& source_file, Scene& scene, std::string& status) {
+  return Load(cache_file, source_file, MappedFile::kPreload, scene, status);
+}
+
+bool MeshCache::Load(const std::string& cache_file,
+    const std::string& source_file, MappedFile::Access access, Scene& scene,
+    std::string& status) {
+  boost::shared_ptr<MappedFile> file(new MappedFile());
+  if (!file->Open(cache_file, access, status))
+    return false;
+  Reader reader(file->data(), file->size());
+  FileHeader header = reader.Read<FileHeader>();
+  if (!reader.ok() || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kVersion || header.byte_order != kByteOrderMark) {
+    status = "Not a mesh cache: " + cache_file;
+    return false;
+  }
+  uint64_t source_size = 0;
+  int64_t source_mtime = 0;
+  if (!GetSourceStamp(source_file, source_size, source_mtime)
+      || source_size != header.source_size
+      || source_mtime != header.source_mtime) {
+    status = "Stale mesh cache: " + cache_file;
+    return false;
+  }
+  // Everything is read and checked before the scene is touched.
+  std::vector<Camera> cameras;
+  for (uint32_t i = 0; i < header.num_cameras && reader.ok(); ++i) {
+    int32_t width = reader.Read<int32_t>();
+    int32_t height = reader.Read<int32_t>();
+    glm::mat4x4 projection = reader.ReadMat4();
+    glm::mat4x4 view = reader.ReadMat4();
+    cameras.push_back(Camera(width, height, projection, view));
+  }
+  std::vector<Light> lights;
+  for (uint32_t i = 0; i < header.num_lights && reader.ok(); ++i) {
+    Light light;
+    light.name = reader.ReadString();
+    light.type = static_cast<Light::LightType>(reader.Read<int32_t>());
+    light.spot_coefficients = reader.ReadVec3();
+    light.attenuation_coefficients = reader.ReadVec3();
+    light.ka = reader.ReadVec3();
+    light.kd = reader.ReadVec3();
+    light.ks = reader.ReadVec3();
+    glm::vec3 origin = reader.ReadVec3();
+    glm::vec3 direction = reader.ReadVec3();
+    light.ray = Ray(origin, direction);
+    lights.push_back(light);
+  }
+  std::vector<std::string> material_names;
+  std::vector<Material> materials;
+  for (uint32_t i = 0; i < header.num_materials && reader.ok(); ++i) {
+    material_names.push_back(reader.ReadString());
+    Material material;
+    material.kd = reader.ReadVec3();
+    material.ks = reader.ReadVec3();
+    material.ka = reader.ReadVec3();
+    material.ke = reader.ReadVec3();
+    material.kr = reader.Read<float>();
+    material.kt = reader.Read<float>();
+    material.tr = reader.Read<float>();
+    material.ns = reader.Read<float>();
+    materials.push_back(material);
+  }
+  std::vector<MeshHeader> mesh_headers;
+  std::vector<const glm::vec3*> vertices;
+  std::vector<const glm::vec3*> normals;
+  std::vector<const TexCoord*> tex_coords;
+  std::vector<const int32_t*> indices;
+  bool valid = true;
+  for (uint32_t i = 0; i < header.num_meshes && reader.ok() && valid; ++i) {
+    MeshHeader mesh_header = reader.Read<MeshHeader>();
+    uint32_t num_vertices = mesh_header.num_vertices;
+    vertices.push_back(reader.ReadArray<glm::vec3>(num_vertices));
+    normals.push_back(
+        (mesh_header.flags & kHasNormals) ?
+            reader.ReadArray<glm::vec3>(num_vertices) : NULL);
+    tex_coords.push_back(
+        (mesh_header.flags & kHasTexCoords) ?
+            reader.ReadArray<TexCoord>(num_vertices) : NULL);
+    const int32_t* mesh_indices = NULL;
+    if (mesh_header.num_faces <= (~0u) / 3)
+      mesh_indices = reader.ReadArray<int32_t>(3 * mesh_header.num_faces);
+    else
+      valid = false;
+    for (uint32_t j = 0; reader.ok() && valid
+        && j < 3 * mesh_header.num_faces; ++j)
+      valid = static_cast<uint32_t>(mesh_indices[j]) < num_vertices;
+    valid = valid && mesh_header.material >= -1
+        && mesh_header.material < static_cast<int32_t>(header.num_materials);
+    mesh_headers.push_back(mesh_header);
+    indices.push_back(mesh_indices);
+  }
+  if (!reader.ok() || !valid) {
+    status = "Corrupt mesh cache: " + cache_file;
+    return false;
+  }
+  for (size_t i = 0; i < cameras.size(); ++i)
+    scene.AddCamera(cameras[i]);
+  for (size_t i = 0; i < lights.size(); ++i)
+    scene.AddLight(lights[i]);
+  size_t first_material = scene.material_list().materials.size();
+  for (size_t i = 0; i < materials.size(); ++i)
+    scene.AddMaterial(material_names[i], materials[i]);
+  boost::shared_ptr<const void> owner = file;
+  for (size_t i = 0; i < mesh_headers.size(); ++i) {
+    const MeshHeader& mesh_header = mesh_headers[i];
+    Trimesh* trimesh = new Trimesh();
+    trimesh->MapVertices(vertices[i], normals[i], tex_coords[i],
+        mesh_header.num_vertices, owner);
+    const float* b = mesh_header.bounds;
+    trimesh->SetFaces(indices[i], mesh_header.num_faces,
+        BoundingBox(glm::vec3(b[0], b[1], b[2]), glm::vec3(b[3], b[4], b[5])));
+    if (mesh_header.material >= 0)
+      trimesh->set_material(
+          &scene.material_list().materials[first_material
+              + mesh_header.material]);
+    scene.AddSceneShape(static_cast<SceneShape*>(trimesh));
+  }
+  status = "OK";
+  return true;
+}
+} // namespace ray
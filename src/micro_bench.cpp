@@ -0,0 +1,516 @@
+/*
+ * micro_bench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "accelerator_factory.hpp"
+#include "camera.hpp"
+#include "geometry.hpp"
+#include "grid.hpp"
+#include "kdnode64.hpp"
+#include "mesh.hpp"
+#include "octnode64.hpp"
+#include "ray_capture.hpp"
+#include "raytracer.hpp"
+#include "sah_octnode.hpp"
+#include "scene.hpp"
+#include "scene_utils.hpp"
+#include "tool_utils.hpp"
+namespace ray {
+static const char* kUsageString = "Usage:\n"
+    "  micro_bench [options] [<scene-file>]\n"
+    "Times the innermost kernels of the tracer and the trees, one at a time\n"
+    "on a single thread, over data taken from the scene, bunny.obj from the\n"
+    "assets directory by default.  Every kernel is run for repetitions\n"
+    "samples of at least min-time each; the report gives the median time per\n"
+    "call and the median absolute deviation of the samples.  A change in the\n"
+    "median larger than a few deviations of both runs is not noise.\n"
+    "Options:\n"
+    "      --assets <dir>       assets directory (assets)\n"
+    "  -k, --kernel <text>      only kernels whose name contains text\n"
+    "  -r, --repetitions <n>    samples per kernel (10)\n"
+    "  -m, --min-time <ms>      minimum duration of a sample (100)\n"
+    "  -f, --format <format>    csv or json (csv)\n";
+
+// Size of every data set; a power of two, so that the kernels pick their
+// input with a mask rather than a division.
+static const int kDataSize = 4096;
+static const int kDataMask = kDataSize - 1;
+
+// The inputs of the kernels.  Element i of rays, boxes, triangles and
+// spheres go together: the ray is aimed at the plane of the triangle near
+// it, so that about half of the tests hit.
+struct KernelData {
+  std::vector<Ray> rays;
+  std::vector<BoundingBox> boxes;
+  std::vector<Triangle> triangles;
+  std::vector<Sphere> spheres;
+  std::vector<glm::vec2> pixels;
+  std::vector<Isect> isects;
+  std::vector<KdNode64> kd_nodes;
+  std::vector<EncodedKdNode64> encoded_kd_nodes;
+  std::vector<OctNode64> oct_nodes;
+  std::vector<EncodedNode64> encoded_oct_nodes;
+  std::vector<SAHOctNode> sah_nodes;
+  std::vector<SAHEncodedNode> encoded_sah_nodes;
+  // The counts the SAH octree integrates at the root, and the grid they
+  // are integrated in.
+  SummableGrid<int> counts;
+  SummableGrid<int> integral;
+  Camera camera;
+  RayTracer* ray_tracer;
+};
+
+// Runs a kernel iterations times and returns a value depending on every
+// result, so that the compiler cannot drop the calls.
+typedef float (*KernelFunction)(KernelData& data, int iterations);
+
+struct Kernel {
+  const char* name;
+  KernelFunction function;
+};
+
+struct Result {
+  std::string kernel;
+  int iterations;
+  int repetitions;
+  double median_ns;
+  double min_ns;
+  double deviation_ns;
+};
+
+// Keeps the results of the kernels alive.
+static volatile float sink = 0.0f;
+
+// Exposes the nodes of a kd-tree, which the tree keeps to itself.
+class NodeKdtree: public AcceleratorFactory::KdtreeType {
+public:
+  void GetNodes(std::vector<KdNode64>& nodes) const {
+    nodes.push_back(GetRoot());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      KdNode64 node = nodes[i];
+      if (node.IsInternal())
+        for (uint32_t j = 0; j < node.num_children(); ++j)
+          nodes.push_back(GetIthChildOf(node, j));
+    }
+  }
+};
+
+template<class Octree, class OctNode>
+static void GetOctreeNodes(const Octree& octree, std::vector<OctNode>& nodes) {
+  nodes.push_back(octree.GetRoot());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    OctNode node = nodes[i];
+    if (node.IsInternal())
+      for (uint32_t j = 0; j < node.size(); ++j)
+        nodes.push_back(octree.GetIthChildOf(node, j));
+  }
+}
+
+// Repeats items, e.g. the nodes of a tree in breadth first order, up to
+// kDataSize.
+template<class Item>
+static void Repeat(std::vector<Item>& items) {
+  size_t num_items = items.size();
+  items.resize(kDataSize);
+  for (size_t i = num_items; i < items.size(); ++i)
+    items[i] = items[i - num_items];
+}
+
+static float IntersectBoxes(KernelData& data, int iterations) {
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i) {
+    float t_near = 0.0f;
+    float t_far = 0.0f;
+    if (data.boxes[i & kDataMask].Intersect(data.rays[i & kDataMask], t_near,
+        t_far))
+      sum += t_near;
+  }
+  return sum;
+}
+
+static float IntersectTriangles(KernelData& data, int iterations) {
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i) {
+    Isect isect;
+    if (data.triangles[i & kDataMask].Intersect(data.rays[i & kDataMask],
+        isect))
+      sum += isect.t_hit;
+  }
+  return sum;
+}
+
+static float IntersectSpheres(KernelData& data, int iterations) {
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i) {
+    Isect isect;
+    if (data.spheres[i & kDataMask].Intersect(data.rays[i & kDataMask], isect))
+      sum += isect.t_hit;
+  }
+  return sum;
+}
+
+static float GenerateRays(KernelData& data, int iterations) {
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i) {
+    const glm::vec2& pixel = data.pixels[i & kDataMask];
+    sum += data.camera.GenerateRay(pixel[0], pixel[1]).direction()[0];
+  }
+  return sum;
+}
+
+static float EncodeKdNodes(KernelData& data, int iterations) {
+  const KdNode64Factory& factory = KdNode64Factory::GetInstance();
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i)
+    sum += factory.CreateEncodedNode(data.kd_nodes[i & kDataMask]).data[0];
+  return sum;
+}
+
+static float DecodeKdNodes(KernelData& data, int iterations) {
+  const KdNode64Factory& factory = KdNode64Factory::GetInstance();
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i)
+    sum += factory.CreateNode(data.encoded_kd_nodes[i & kDataMask]).offset();
+  return sum;
+}
+
+static float EncodeOctNodes(KernelData& data, int iterations) {
+  const OctNodeFactory64& factory = OctNodeFactory64::GetInstance();
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i)
+    sum += factory.CreateEncodedNode(data.oct_nodes[i & kDataMask]).data[0];
+  return sum;
+}
+
+static float DecodeOctNodes(KernelData& data, int iterations) {
+  const OctNodeFactory64& factory = OctNodeFactory64::GetInstance();
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i)
+    sum += factory.CreateOctNode(data.encoded_oct_nodes[i & kDataMask])
+        .offset();
+  return sum;
+}
+
+static float EncodeSahNodes(KernelData& data, int iterations) {
+  const SAHOctNodeFactory& factory = SAHOctNodeFactory::GetInstance();
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i)
+    sum += factory.CreateEncodedNode(data.sah_nodes[i & kDataMask]).data[0];
+  return sum;
+}
+
+static float DecodeSahNodes(KernelData& data, int iterations) {
+  const SAHOctNodeFactory& factory = SAHOctNodeFactory::GetInstance();
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i)
+    sum += factory.CreateOctNode(data.encoded_sah_nodes[i & kDataMask])
+        .point()[0];
+  return sum;
+}
+
+// One call integrates the whole grid, in the orientation of one of the
+// eight octants, after restoring the counts.  Restoring is a plain copy,
+// cheap next to the integral.
+static float IntegrateImages(KernelData& data, int iterations) {
+  float sum = 0.0f;
+  int grid_size = data.counts.grid_size();
+  for (int i = 0; i < iterations; ++i) {
+    for (int n = 0; n < grid_size; ++n)
+      data.integral[n] = data.counts[n];
+    glm::ivec3 bits((i & 0x1), (i & 0x2) >> 1, (i & 0x4) >> 2);
+    data.integral.OrientedImageIntegral(1 - 2 * bits);
+    sum += data.integral[grid_size - 1];
+  }
+  return sum;
+}
+
+static float ShadeHits(KernelData& data, int iterations) {
+  float sum = 0.0f;
+  for (int i = 0; i < iterations; ++i)
+    sum += data.ray_tracer->Shade(data.isects[i & kDataMask])[0];
+  return sum;
+}
+
+static const Kernel kKernels[] = {
+    { "BoundingBox::Intersect", IntersectBoxes },
+    { "Triangle::Intersect", IntersectTriangles },
+    { "Sphere::Intersect", IntersectSpheres },
+    { "Camera::GenerateRay", GenerateRays },
+    { "EncodedKdNode64::Encode", EncodeKdNodes },
+    { "EncodedKdNode64::Decode", DecodeKdNodes },
+    { "EncodedNode64::Encode", EncodeOctNodes },
+    { "EncodedNode64::Decode", DecodeOctNodes },
+    { "SAHEncodedNode::Encode", EncodeSahNodes },
+    { "SAHEncodedNode::Decode", DecodeSahNodes },
+    { "SummableGrid::OrientedImageIntegral", IntegrateImages },
+    { "RayTracer::Shade", ShadeHits } };
+
+// Fills data from the meshes of scene, which gains a kd-tree for tracing
+// the hits to shade and, if it has none, a headlight.
+static void CreateKernelData(Scene& scene, KernelData& data) {
+  const int kWidth = 512;
+  const int kHeight = 512;
+  std::vector<Trimesh*> meshes;
+  BoundingBox bounds;
+  const std::vector<SceneShape*>& shapes = scene.scene_objects();
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    if (NULL != trimesh && trimesh->num_faces() > 0) {
+      meshes.push_back(trimesh);
+      bounds = bounds.Join(trimesh->GetBounds());
+    }
+  }
+  if (meshes.empty())
+    Die("The scene has no triangles");
+  glm::vec3 extent = bounds.max() - bounds.min();
+
+  RandomSequence random(1);
+  for (int i = 0; i < kDataSize; ++i) {
+    const Trimesh& mesh = *meshes[random.Next(meshes.size())];
+    Triangle triangle = mesh.GetPatch(random.Next(mesh.num_faces()));
+    BoundingBox box = triangle.GetBounds();
+    data.triangles.push_back(triangle);
+    data.boxes.push_back(box);
+    data.spheres.push_back(
+        Sphere(box.GetCenter(), 0.5f * glm::length(box.max() - box.min())));
+    // Barycentric coordinates summing to over one miss the triangle.
+    glm::vec3 target = triangle[0] + random.Next() * (triangle[1] - triangle[0])
+        + random.Next() * (triangle[2] - triangle[0]);
+    glm::vec3 origin;
+    for (int d = 0; d < 3; ++d)
+      origin[d] = bounds.min()[d] + (1.2f * random.Next() - 0.1f) * extent[d];
+    glm::vec3 direction = target - origin;
+    data.rays.push_back(
+        Ray(origin, glm::length(direction) > 0.0f ?
+            glm::normalize(direction) : random.NextDirection()));
+  }
+
+  data.camera = FrameScene(scene, kWidth, kHeight);
+  for (int i = 0; i < kDataSize; ++i)
+    data.pixels.push_back(
+        glm::vec2(kWidth * random.Next(), kHeight * random.Next()));
+
+  // The trees of the first mesh, built the way AcceleratorFactory does.
+  Trimesh& mesh = *meshes[0];
+  NodeKdtree kdtree;
+  kdtree.set_max_leaf_size(8);
+  kdtree.set_max_depth(15);
+  kdtree.Build(mesh.faces());
+  kdtree.GetNodes(data.kd_nodes);
+  AcceleratorFactory::OctreeType octree;
+  octree.Build(mesh.faces());
+  GetOctreeNodes(octree, data.oct_nodes);
+  AcceleratorFactory::SahOctreeType sah_octree;
+  sah_octree.set_evaluation_policy(
+      AcceleratorFactory::SahOctreeType::kBinnedSAH);
+  sah_octree.Build(mesh.faces());
+  GetOctreeNodes(sah_octree, data.sah_nodes);
+  Repeat(data.kd_nodes);
+  Repeat(data.oct_nodes);
+  Repeat(data.sah_nodes);
+  for (int i = 0; i < kDataSize; ++i) {
+    data.encoded_kd_nodes.push_back(
+        KdNode64Factory::GetInstance().CreateEncodedNode(data.kd_nodes[i]));
+    data.encoded_oct_nodes.push_back(
+        OctNodeFactory64::GetInstance().CreateEncodedNode(data.oct_nodes[i]));
+    data.encoded_sah_nodes.push_back(
+        SAHOctNodeFactory::GetInstance().CreateEncodedNode(
+            data.sah_nodes[i]));
+  }
+
+  // The corners of the bounds of every face, counted on the grid the
+  // binned SAH octree evaluates at the root of the mesh.
+  int k = floor(pow(mesh.num_faces() / 2.0, 1.0f / 3.0f)) + 1;
+  int num_samples = (k % 2 == 0 ? k + 1 : k + 2);
+  glm::ivec3 size(num_samples - 1);
+  UniformGridSampler sampler(glm::ivec3(num_samples), mesh.GetBounds());
+  data.counts.set_size(size);
+  data.counts.Init();
+  data.counts.AssignToAll(0);
+  data.integral.set_size(size);
+  data.integral.Init();
+  for (int i = 0; i < mesh.num_faces(); ++i) {
+    BoundingBox face_bounds = mesh.GetPatch(i).GetBounds();
+    for (uint32_t octant = 0; octant < 8; ++octant) {
+      glm::vec3 point;
+      for (int d = 0; d < 3; ++d)
+        point[d] = ((octant >> d) & 0x1 ?
+            face_bounds.max()[d] : face_bounds.min()[d]);
+      glm::ivec3 index;
+      if (sampler.PointToCellIndex(point, index))
+        ++data.counts(index);
+    }
+  }
+
+  if (scene.lights().empty()) {
+    Light light;
+    light.ka = light.kd = light.ks = glm::vec3(1.0f);
+    light.ray = Ray(glm::vec3(0.0f),
+        data.camera.GenerateRay(0.5f * kWidth, 0.5f * kHeight).direction());
+    light.type = Light::kDirectional;
+    scene.AddLight(light);
+  }
+  std::vector<Accelerator*> accelerators;
+  AcceleratorFactory().Accelerate(scene, accelerators);
+  for (int i = 0; i < 64 * kDataSize
+      && static_cast<int>(data.isects.size()) < kDataSize; ++i) {
+    Isect isect;
+    if (scene.Intersect(
+        data.camera.GenerateRay(kWidth * random.Next(),
+            kHeight * random.Next()), isect))
+      data.isects.push_back(isect);
+  }
+  if (data.isects.empty())
+    Die("The camera sees nothing of the scene");
+  Repeat(data.isects);
+}
+
+// The time per call, in nanoseconds, of iterations calls.
+static double RunSample(const Kernel& kernel, KernelData& data,
+    int iterations) {
+  double start = GetSeconds();
+  sink = sink + kernel.function(data, iterations);
+  return 1e9 * (GetSeconds() - start) / iterations;
+}
+
+static Result RunKernel(const Kernel& kernel, KernelData& data,
+    int repetitions, double min_seconds) {
+  Result result;
+  result.kernel = kernel.name;
+  result.repetitions = repetitions;
+  // Double the iterations until a sample takes long enough; that also
+  // warms up the caches and the branch predictors.
+  int iterations = 1;
+  while (iterations < (1 << 30)) {
+    double start = GetSeconds();
+    sink = sink + kernel.function(data, iterations);
+    if (GetSeconds() - start >= min_seconds)
+      break;
+    iterations *= 2;
+  }
+  result.iterations = iterations;
+  std::vector<double> samples;
+  for (int i = 0; i < repetitions; ++i)
+    samples.push_back(RunSample(kernel, data, iterations));
+  std::sort(samples.begin(), samples.end());
+  result.median_ns = samples[samples.size() / 2];
+  result.min_ns = samples[0];
+  std::vector<double> deviations;
+  for (size_t i = 0; i < samples.size(); ++i)
+    deviations.push_back(fabs(samples[i] - result.median_ns));
+  std::sort(deviations.begin(), deviations.end());
+  result.deviation_ns = deviations[deviations.size() / 2];
+  return result;
+}
+
+static void WriteCsv(std::ostream& out, const std::vector<Result>& results) {
+  out << "kernel,iterations,repetitions,median_ns,min_ns,deviation_ns\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    out << r.kernel << "," << r.iterations << "," << r.repetitions << ","
+        << r.median_ns << "," << r.min_ns << "," << r.deviation_ns << "\n";
+  }
+}
+
+static void WriteJson(std::ostream& out, const std::vector<Result>& results) {
+  out << "[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    out << (i > 0 ? ",\n " : "\n ") << "{\"kernel\": \"" << r.kernel
+        << "\", \"iterations\": " << r.iterations << ", \"repetitions\": "
+        << r.repetitions << ", \"median_ns\": " << r.median_ns
+        << ", \"min_ns\": " << r.min_ns << ", \"deviation_ns\": "
+        << r.deviation_ns << "}";
+  }
+  out << "\n]\n";
+}
+} // namespace ray
+
+int main(int argc, char** argv) {
+  ray::SetUsage(ray::kUsageString);
+  enum {
+    kAssetsOption = 256
+  };
+  static const option kOptions[] = {
+      { "assets", required_argument, NULL, kAssetsOption },
+      { "kernel", required_argument, NULL, 'k' },
+      { "repetitions", required_argument, NULL, 'r' },
+      { "min-time", required_argument, NULL, 'm' },
+      { "format", required_argument, NULL, 'f' },
+      { NULL, 0, NULL, 0 } };
+  std::string assets = "assets";
+  std::string kernel_filter;
+  int repetitions = 10;
+  int min_milliseconds = 100;
+  std::string format = "csv";
+  int c = 0;
+  while ((c = getopt_long(argc, argv, "k:r:m:f:", kOptions, NULL)) != -1) {
+    switch (c) {
+    case kAssetsOption:
+      assets = optarg;
+      break;
+    case 'k':
+      kernel_filter = optarg;
+      break;
+    case 'r':
+      repetitions = ray::ParsePositive(optarg);
+      break;
+    case 'm':
+      min_milliseconds = ray::ParsePositive(optarg);
+      break;
+    case 'f':
+      format = optarg;
+      if ("csv" != format && "json" != format)
+        ray::Die("Unknown format: " + format);
+      break;
+    default:
+      ray::Die("");
+    }
+  }
+  if (argc - optind > 1)
+    ray::Die("");
+  std::string scene_file = (argc - optind == 1 ?
+      argv[optind] : assets + "/bunny.obj");
+
+  ray::CoutSilencer silencer;
+  silencer.Mute();
+  ray::SceneLoader& loader = ray::SceneLoader::GetInstance();
+  loader.set_reorder_meshes(true);
+  ray::Scene scene;
+  std::string status = "";
+  if (!loader.LoadScene(scene_file, scene, status)) {
+    silencer.Restore();
+    std::cerr << "Cannot load " << scene_file << ": " << status << std::endl;
+    return -1;
+  }
+  ray::KernelData data;
+  ray::CreateKernelData(scene, data);
+  ray::RayTracer ray_tracer(&scene, &data.camera);
+  data.ray_tracer = &ray_tracer;
+
+  std::vector<ray::Result> results;
+  for (size_t i = 0; i < sizeof(ray::kKernels) / sizeof(ray::Kernel); ++i) {
+    const ray::Kernel& kernel = ray::kKernels[i];
+    if (std::string(kernel.name).find(kernel_filter) == std::string::npos)
+      continue;
+    std::cerr << kernel.name << std::endl;
+    results.push_back(
+        ray::RunKernel(kernel, data, repetitions, 1e-3 * min_milliseconds));
+  }
+  silencer.Restore();
+  if ("json" == format)
+    ray::WriteJson(std::cout, results);
+  else
+    ray::WriteCsv(std::cout, results);
+  return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * morton.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include "morton.hpp"
+namespace ray {
+static uint32_t SpreadBits(uint32_t x) {
+  x &= 0x0000ffff;
+  x = (x | (x << 8)) & 0x00ff00ff;
+  x = (x | (x << 4)) & 0x0f0f0f0f;
+  x = (x | (x << 2)) & 0x33333333;
+  x = (x | (x << 1)) & 0x55555555;
+  return x;
+}
+
+static uint32_t CompactBits(uint32_t x) {
+  x &= 0x55555555;
+  x = (x | (x >> 1)) & 0x33333333;
+  x = (x | (x >> 2)) & 0x0f0f0f0f;
+  x = (x | (x >> 4)) & 0x00ff00ff;
+  x = (x | (x >> 8)) & 0x0000ffff;
+  return x;
+}
+
+// Spreads the low 10 bits of x two bits apart.
+static uint32_t SpreadBits3(uint32_t x) {
+  x &= 0x000003ff;
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+uint32_t MortonEncode2(uint32_t x, uint32_t y) {
+  return SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+void MortonDecode2(uint32_t code, uint32_t& x, uint32_t& y) {
+  x = CompactBits(code);
+  y = CompactBits(code >> 1);
+}
+
+uint32_t MortonEncode3(uint32_t x, uint32_t y, uint32_t z) {
+  return SpreadBits3(x) | (SpreadBits3(y) << 1) | (SpreadBits3(z) << 2);
+}
+
+// Walks the quadrants from the most significant bit down, rotating and
+// reflecting the remaining coordinates into the frame of each quadrant.
+uint32_t HilbertEncode2(uint32_t order, uint32_t x, uint32_t y) {
+  uint32_t code = 0;
+  for (uint32_t s = (order > 0 ? 1u << (order - 1) : 0); s > 0; s >>= 1) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    code += s * s * ((3 * rx) ^ ry);
+    if (0 == ry) {
+      if (1 == rx) {
+        x = s - 1 - (x & (s - 1));
+        y = s - 1 - (y & (s - 1));
+      }
+      uint32_t t = x;
+      x = y;
+      y = t;
+    }
+  }
+  return code;
+}
+
+uint32_t GetCurveOrder(uint32_t size) {
+  uint32_t order = 0;
+  while ((1u << order) < size)
+    ++order;
+  return order;
+}
+} // namespace ray
@@ -0,0 +1,696 @@
+/*
+ * obj_loader.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "mapped_file.hpp"
+#include "material.hpp"
+#include "mesh.hpp"
+#include "obj_loader.hpp"
+#include "scene.hpp"
+#include "texture.hpp"
+#include "types.hpp"
+#include "worker_pool.hpp"
+namespace ray {
+// Chunks smaller than this are not worth a work item of their own.
+static const size_t kMinChunkSize = 1 << 18;
+
+static const double kPowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+    1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+    1e19, 1e20, 1e21, 1e22 };
+
+static bool IsSpace(char c) {
+  return ' ' == c || '\t' == c || '\r' == c;
+}
+
+static const char* SkipSpace(const char* p, const char* end) {
+  while (p < end && IsSpace(*p))
+    ++p;
+  return p;
+}
+
+static const char* SkipToken(const char* p, const char* end) {
+  while (p < end && !IsSpace(*p))
+    ++p;
+  return p;
+}
+
+static bool IsKeyword(const char* p, const char* end, const char* keyword) {
+  size_t length = strlen(keyword);
+  return static_cast<size_t>(end - p) >= length
+      && 0 == strncmp(p, keyword, length)
+      && (p + length == end || IsSpace(p[length]));
+}
+
+// Parses a decimal float of the form [+-]digits[.digits][(e|E)[+-]digits].
+// Anything else, such as nan or inf, is handed to strtod.  Returns the
+// position after the number, or NULL if there is none.
+static const char* ParseFloat(const char* p, const char* end, float& value) {
+  const char* start = p;
+  bool negative = false;
+  if (p < end && ('-' == *p || '+' == *p))
+    negative = ('-' == *p++);
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int num_digits = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; ++p, ++num_digits) {
+    if (mantissa < 1000000000000000000ull)
+      mantissa = 10 * mantissa + (*p - '0');
+    else
+      ++exponent;
+  }
+  if (p < end && '.' == *p) {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++num_digits) {
+      if (mantissa < 1000000000000000000ull) {
+        mantissa = 10 * mantissa + (*p - '0');
+        --exponent;
+      }
+    }
+  }
+  if (0 == num_digits) {
+    const char* token_end = SkipToken(start, end);
+    char buffer[64];
+    size_t length = token_end - start;
+    if (0 == length || length >= sizeof(buffer))
+      return NULL;
+    memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    char* parsed_end = NULL;
+    value = strtod(buffer, &parsed_end);
+    return (parsed_end == buffer + length ? token_end : NULL);
+  }
+  if (p < end && ('e' == *p || 'E' == *p)) {
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && ('-' == *q || '+' == *q))
+      negative_exponent = ('-' == *q++);
+    int explicit_exponent = 0;
+    if (q < end && *q >= '0' && *q <= '9') {
+      for (; q < end && *q >= '0' && *q <= '9'; ++q)
+        if (explicit_exponent < 10000)
+          explicit_exponent = 10 * explicit_exponent + (*q - '0');
+      exponent += (negative_exponent ? -explicit_exponent : explicit_exponent);
+      p = q;
+    }
+  }
+  double result = static_cast<double>(mantissa);
+  if (exponent > 22 || exponent < -22)
+    result *= pow(10.0, exponent);
+  else if (exponent >= 0)
+    result *= kPowersOfTen[exponent];
+  else
+    result /= kPowersOfTen[-exponent];
+  value = static_cast<float>(negative ? -result : result);
+  return p;
+}
+
+static const char* ParseInt(const char* p, const char* end, int& value) {
+  bool negative = false;
+  if (p < end && ('-' == *p || '+' == *p))
+    negative = ('-' == *p++);
+  if (p == end || *p < '0' || *p > '9')
+    return NULL;
+  int result = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; ++p)
+    result = 10 * result + (*p - '0');
+  value = (negative ? -result : result);
+  return p;
+}
+
+// Parses up to max_values floats, leaving the others untouched.
+static int ParseFloats(const char* p, const char* end, float* values,
+    int max_values) {
+  int num_values = 0;
+  p = SkipSpace(p, end);
+  while (num_values < max_values && p < end && '#' != *p) {
+    p = ParseFloat(p, end, values[num_values]);
+    if (NULL == p)
+      break;
+    ++num_values;
+    p = SkipSpace(p, end);
+  }
+  return num_values;
+}
+
+// v[/[vt][/vn]] indices of one polygon corner, made 0-based.  -1 marks an
+// absent index.
+struct ObjLoader::Corner {
+  int v;
+  int vt;
+  int vn;
+  bool operator==(const Corner& corner) const {
+    return v == corner.v && vt == corner.vt && vn == corner.vn;
+  }
+  struct Hash {
+    size_t operator()(const Corner& corner) const {
+      size_t seed = 0;
+      boost::hash_combine(seed, corner.v);
+      boost::hash_combine(seed, corner.vt);
+      boost::hash_combine(seed, corner.vn);
+      return seed;
+    }
+  };
+};
+
+struct ObjLoader::MaterialSwitch {
+  MaterialSwitch(uint32_t first_triangle, const std::string& name) :
+      first_triangle(first_triangle), name(name) {
+  }
+  uint32_t first_triangle;
+  std::string name;
+};
+
+struct ObjLoader::Chunk {
+  Chunk() :
+      begin(NULL), end(NULL), num_positions(0), num_tex_coords(0),
+          num_normals(0), position_base(0), tex_coord_base(0),
+          normal_base(0), success(true) {
+  }
+  const char* begin;
+  const char* end;
+  int num_positions;
+  int num_tex_coords;
+  int num_normals;
+  int position_base;
+  int tex_coord_base;
+  int normal_base;
+  std::vector<Corner> corners;
+  std::vector<MaterialSwitch> switches;
+  std::vector<std::string> material_libraries;
+  bool success;
+  std::string status;
+};
+
+struct ObjLoader::Attributes {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> tex_coords;
+  std::vector<glm::vec3> normals;
+};
+
+// The triangles of one material, as ranges [first, last) of the
+// triangles of a chunk.
+struct ObjLoader::Group {
+  struct Range {
+    Range(int chunk, uint32_t first, uint32_t last) :
+        chunk(chunk), first(first), last(last) {
+    }
+    int chunk;
+    uint32_t first;
+    uint32_t last;
+  };
+  Group() :
+      material(-1) {
+  }
+  int material;
+  std::vector<Range> ranges;
+};
+
+class ObjLoader::CountTask: public WorkerTask {
+public:
+  CountTask(std::vector<Chunk>& chunks) :
+      chunks_(chunks) {
+  }
+  virtual void Execute(int item, int) {
+    CountChunk(chunks_[item]);
+  }
+private:
+  std::vector<Chunk>& chunks_;
+};
+
+class ObjLoader::ParseTask: public WorkerTask {
+public:
+  ParseTask(std::vector<Chunk>& chunks, Attributes& attributes) :
+      chunks_(chunks), attributes_(attributes) {
+  }
+  virtual void Execute(int item, int) {
+    ParseChunk(chunks_[item], attributes_);
+  }
+private:
+  std::vector<Chunk>& chunks_;
+  Attributes& attributes_;
+};
+
+class ObjLoader::BuildTask: public WorkerTask {
+public:
+  BuildTask(const std::vector<Group>& groups, const Attributes& attributes,
+      const std::vector<Chunk>& chunks, std::vector<Trimesh*>& trimeshes,
+      std::vector<std::string>& statuses) :
+      groups_(groups), attributes_(attributes), chunks_(chunks),
+          trimeshes_(trimeshes), statuses_(statuses) {
+  }
+  virtual void Execute(int item, int) {
+    if (!BuildGroup(groups_[item], attributes_, chunks_, trimeshes_[item],
+        statuses_[item])) {
+      delete trimeshes_[item];
+      trimeshes_[item] = NULL;
+    }
+  }
+private:
+  const std::vector<Group>& groups_;
+  const Attributes& attributes_;
+  const std::vector<Chunk>& chunks_;
+  std::vector<Trimesh*>& trimeshes_;
+  std::vector<std::string>& statuses_;
+};
+
+ObjLoader::ObjLoader() :
+    num_threads_(WorkerPool::GetNumProcessors()) {
+}
+
+int ObjLoader::num_threads() const {
+  return num_threads_;
+}
+
+void ObjLoader::set_num_threads(int num_threads) {
+  num_threads_ = (num_threads > 0 ? num_threads : 1);
+}
+
+// The same defaults Assimp's OBJ importer uses.
+Material ObjLoader::GetDefaultMaterial() {
+  Material material;
+  material.kd = glm::vec3(0.6f, 0.6f, 0.6f);
+  material.tr = 1.0f;
+  material.kt = 1.0f;
+  return material;
+}
+
+bool ObjLoader::Load(const std::string& file_name, Scene& scene,
+    std::string& status) {
+  return Load(file_name, scene, NULL, status);
+}
+
+bool ObjLoader::Load(const std::string& file_name, Scene& scene,
+    MeshSink& sink, std::string& status) {
+  return Load(file_name, scene, &sink, status);
+}
+
+bool ObjLoader::Load(const std::string& file_name, Scene& scene,
+    MeshSink* sink, std::string& status) {
+  MappedFile file;
+  if (!file.Open(file_name, status))
+    return false;
+
+  // Split at line boundaries into about four chunks per thread.
+  size_t num_chunks = file.size() / kMinChunkSize;
+  num_chunks = std::max(static_cast<size_t>(1),
+      std::min(num_chunks, static_cast<size_t>(4 * num_threads_)));
+  std::vector<Chunk> chunks(num_chunks);
+  const char* data = file.data();
+  const char* data_end = file.data() + file.size();
+  const char* begin = data;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    const char* end = data + (i + 1) * file.size() / num_chunks;
+    if (i + 1 == num_chunks)
+      end = data_end;
+    if (end < begin)
+      end = begin;
+    if (end < data_end) {
+      const char* newline = static_cast<const char*>(memchr(end, '\n',
+          data_end - end));
+      end = (NULL == newline ? data_end : newline + 1);
+    }
+    chunks[i].begin = begin;
+    chunks[i].end = end;
+    begin = end;
+  }
+
+  WorkerPool pool(num_threads_);
+  CountTask count_task(chunks);
+  pool.Run(count_task, chunks.size());
+  int num_positions = 0;
+  int num_tex_coords = 0;
+  int num_normals = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    chunks[i].position_base = num_positions;
+    chunks[i].tex_coord_base = num_tex_coords;
+    chunks[i].normal_base = num_normals;
+    num_positions += chunks[i].num_positions;
+    num_tex_coords += chunks[i].num_tex_coords;
+    num_normals += chunks[i].num_normals;
+  }
+  Attributes attributes;
+  attributes.positions.resize(num_positions);
+  attributes.tex_coords.resize(num_tex_coords, glm::vec3(0.0f));
+  attributes.normals.resize(num_normals);
+  ParseTask parse_task(chunks, attributes);
+  pool.Run(parse_task, chunks.size());
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (!chunks[i].success) {
+      status = chunks[i].status + " in " + file_name;
+      return false;
+    }
+  }
+
+  // Materials of all referenced libraries, in the order they are defined.
+  std::string directory = "";
+  size_t slash = file_name.find_last_of('/');
+  if (slash != std::string::npos)
+    directory = file_name.substr(0, slash + 1);
+  std::vector<std::string> names;
+  std::vector<Material> materials;
+  for (size_t i = 0; i < chunks.size(); ++i)
+    for (size_t j = 0; j < chunks[i].material_libraries.size(); ++j)
+      if (!LoadMaterials(directory + chunks[i].material_libraries[j], names,
+          materials, status))
+        return false;
+  boost::unordered_map<std::string, int> material_ids;
+  for (size_t i = 0; i < names.size(); ++i)
+    material_ids[names[i]] = i;
+
+  // Faces before the first usemtl, or naming an unknown material, use the
+  // default material, which is listed last.
+  int default_material = names.size();
+  std::vector<Group> groups(names.size() + 1);
+  int material = default_material;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    uint32_t num_triangles = chunks[i].corners.size() / 3;
+    uint32_t first = 0;
+    for (size_t j = 0; j <= chunks[i].switches.size(); ++j) {
+      uint32_t last = (j < chunks[i].switches.size() ?
+          chunks[i].switches[j].first_triangle : num_triangles);
+      if (last > first)
+        groups[material].ranges.push_back(Group::Range(i, first, last));
+      if (j < chunks[i].switches.size()) {
+        boost::unordered_map<std::string, int>::const_iterator iter =
+            material_ids.find(chunks[i].switches[j].name);
+        material = (iter == material_ids.end() ?
+            default_material : iter->second);
+      }
+      first = last;
+    }
+  }
+  for (size_t i = 0; i < groups.size(); ++i)
+    groups[i].material = i;
+
+  // Materials have to be in place before taking pointers to them.
+  int material_base = scene.material_list().materials.size();
+  for (size_t i = 0; i < names.size(); ++i)
+    scene.AddMaterial(names[i], materials[i]);
+  if (!groups[default_material].ranges.empty())
+    scene.AddMaterial("DefaultMaterial", GetDefaultMaterial());
+
+  std::vector<Group> used_groups;
+  for (size_t i = 0; i < groups.size(); ++i)
+    if (!groups[i].ranges.empty())
+      used_groups.push_back(groups[i]);
+  // A sink gets the meshes in batches of one per thread, each freed once
+  // the sink has it; otherwise all meshes are built at once.
+  size_t batch_size = (NULL == sink ? used_groups.size() : num_threads_);
+  status = "OK";
+  for (size_t first = 0; first < used_groups.size(); first += batch_size) {
+    std::vector<Group> batch(used_groups.begin() + first,
+        used_groups.begin() + std::min(first + batch_size,
+            used_groups.size()));
+    std::vector<Trimesh*> trimeshes(batch.size(), NULL);
+    std::vector<std::string> statuses(batch.size(), "OK");
+    for (size_t i = 0; i < batch.size(); ++i)
+      trimeshes[i] = new Trimesh();
+    BuildTask build_task(batch, attributes, chunks, trimeshes, statuses);
+    pool.Run(build_task, batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+      if (NULL == trimeshes[i])
+        status = statuses[i] + " in " + file_name;
+    for (size_t i = 0; i < batch.size() && "OK" == status; ++i) {
+      trimeshes[i]->set_material(
+          &scene.material_list().materials[material_base
+              + batch[i].material]);
+      if (NULL != sink && !sink->AddMesh(*trimeshes[i], status))
+        break;
+    }
+    if (NULL == sink && "OK" == status) {
+      for (size_t i = 0; i < batch.size(); ++i)
+        scene.AddSceneShape(static_cast<SceneShape*>(trimeshes[i]));
+    } else {
+      for (size_t i = 0; i < trimeshes.size(); ++i)
+        delete trimeshes[i];
+    }
+    if (status != "OK")
+      return false;
+  }
+  return true;
+}
+
+// Only looks at the keyword of every line, with the same test as
+// ParseChunk(), so that the records parsed never outnumber the slots
+// reserved for them.
+void ObjLoader::CountChunk(Chunk& chunk) {
+  const char* p = chunk.begin;
+  while (p < chunk.end) {
+    const char* line_end = static_cast<const char*>(memchr(p, '\n',
+        chunk.end - p));
+    if (NULL == line_end)
+      line_end = chunk.end;
+    p = SkipSpace(p, line_end);
+    if (p < line_end && 'v' == p[0]) {
+      if (IsKeyword(p, line_end, "v"))
+        ++chunk.num_positions;
+      else if (IsKeyword(p, line_end, "vt"))
+        ++chunk.num_tex_coords;
+      else if (IsKeyword(p, line_end, "vn"))
+        ++chunk.num_normals;
+    }
+    p = line_end + 1;
+  }
+}
+
+void ObjLoader::ParseChunk(Chunk& chunk, Attributes& attributes) {
+  int num_positions = 0;
+  int num_tex_coords = 0;
+  int num_normals = 0;
+  std::vector<Corner> polygon;
+  const char* p = chunk.begin;
+  while (p < chunk.end && chunk.success) {
+    const char* line_end = static_cast<const char*>(memchr(p, '\n',
+        chunk.end - p));
+    if (NULL == line_end)
+      line_end = chunk.end;
+    p = SkipSpace(p, line_end);
+    if (p == line_end || '#' == *p) {
+      // Blank line or comment.
+    } else if (IsKeyword(p, line_end, "v")) {
+      float values[3] = { 0.0f, 0.0f, 0.0f };
+      if (ParseFloats(p + 1, line_end, values, 3) < 3) {
+        chunk.success = false;
+        chunk.status = "Malformed vertex";
+      } else {
+        attributes.positions[chunk.position_base + num_positions++] =
+            glm::vec3(values[0], values[1], values[2]);
+      }
+    } else if (IsKeyword(p, line_end, "vt")) {
+      float values[3] = { 0.0f, 0.0f, 0.0f };
+      ParseFloats(p + 2, line_end, values, 3);
+      attributes.tex_coords[chunk.tex_coord_base + num_tex_coords++] =
+          glm::vec3(values[0], values[1], values[2]);
+    } else if (IsKeyword(p, line_end, "vn")) {
+      float values[3] = { 0.0f, 0.0f, 0.0f };
+      if (ParseFloats(p + 2, line_end, values, 3) < 3) {
+        chunk.success = false;
+        chunk.status = "Malformed normal";
+      } else {
+        attributes.normals[chunk.normal_base + num_normals++] = glm::vec3(
+            values[0], values[1], values[2]);
+      }
+    } else if (IsKeyword(p, line_end, "f")) {
+      // Relative indices count back from the records read so far, which
+      // the first pass lets us know in every chunk.
+      polygon.clear();
+      const char* q = SkipSpace(p + 1, line_end);
+      while (chunk.success && q < line_end && '#' != *q) {
+        Corner corner = { -1, -1, -1 };
+        int* indices[3] = { &corner.v, &corner.vt, &corner.vn };
+        int bases[3] = { chunk.position_base + num_positions,
+            chunk.tex_coord_base + num_tex_coords, chunk.normal_base
+                + num_normals };
+        for (int k = 0; k < 3 && q < line_end && !IsSpace(*q); ++k) {
+          int index = 0;
+          if (k > 0) {
+            if ('/' != *q) {
+              q = NULL;
+            } else if (++q == line_end || IsSpace(*q) || '/' == *q) {
+              continue;
+            }
+          }
+          if (q)
+            q = ParseInt(q, line_end, index);
+          if (NULL == q || 0 == index) {
+            chunk.success = false;
+            chunk.status = "Malformed face";
+            break;
+          }
+          *indices[k] = (index > 0 ? index - 1 : bases[k] + index);
+        }
+        polygon.push_back(corner);
+        if (q)
+          q = SkipSpace(q, line_end);
+      }
+      if (chunk.success && polygon.size() < 3) {
+        chunk.success = false;
+        chunk.status = "Face with less than three vertices";
+      }
+      for (size_t k = 2; chunk.success && k < polygon.size(); ++k) {
+        chunk.corners.push_back(polygon[0]);
+        chunk.corners.push_back(polygon[k - 1]);
+        chunk.corners.push_back(polygon[k]);
+      }
+    } else if (IsKeyword(p, line_end, "usemtl")) {
+      const char* name = SkipSpace(p + 6, line_end);
+      const char* name_end = line_end;
+      while (name_end > name && IsSpace(name_end[-1]))
+        --name_end;
+      chunk.switches.push_back(
+          MaterialSwitch(chunk.corners.size() / 3,
+              std::string(name, name_end)));
+    } else if (IsKeyword(p, line_end, "mtllib")) {
+      const char* q = SkipSpace(p + 6, line_end);
+      while (q < line_end) {
+        const char* name_end = SkipToken(q, line_end);
+        chunk.material_libraries.push_back(std::string(q, name_end));
+        q = SkipSpace(name_end, line_end);
+      }
+    }
+    // Groups, objects, smoothing groups, lines and points are ignored.
+    p = line_end + 1;
+  }
+}
+
+// Corners that repeat the same v/vt/vn triple share a vertex.  Without
+// texture coordinates and normals the triple is just the position index,
+// which a flat table resolves faster than a hash map.
+bool ObjLoader::BuildGroup(const Group& group, const Attributes& attributes,
+    const std::vector<Chunk>& chunks, Trimesh* trimesh, std::string& status) {
+  int num_positions = attributes.positions.size();
+  int num_tex_coords = attributes.tex_coords.size();
+  int num_normals = attributes.normals.size();
+  bool has_tex_coords = true;
+  bool has_normals = true;
+  for (size_t r = 0; r < group.ranges.size(); ++r) {
+    const Group::Range& range = group.ranges[r];
+    const std::vector<Corner>& corners = chunks[range.chunk].corners;
+    for (uint32_t c = 3 * range.first; c < 3 * range.last; ++c) {
+      const Corner& corner = corners[c];
+      if (corner.v < 0 || corner.v >= num_positions
+          || corner.vt >= num_tex_coords || corner.vn >= num_normals
+          || (corner.vt < 0 && corner.vt != -1)
+          || (corner.vn < 0 && corner.vn != -1)) {
+        status = "Index out of range";
+        return false;
+      }
+      has_tex_coords &= (corner.vt >= 0);
+      has_normals &= (corner.vn >= 0);
+    }
+  }
+  std::vector<int> position_table;
+  boost::unordered_map<Corner, int, Corner::Hash> corner_table;
+  bool use_position_table = !has_tex_coords && !has_normals;
+  if (use_position_table)
+    position_table.resize(num_positions, -1);
+  std::vector<glm::vec3> vertices;
+  std::vector<glm::vec3> normals;
+  std::vector<TexCoord> tex_coords;
+  std::vector<int32_t> indices;
+  for (size_t r = 0; r < group.ranges.size(); ++r)
+    indices.reserve(indices.size()
+        + 3 * (group.ranges[r].last - group.ranges[r].first));
+  int num_vertices = 0;
+  for (size_t r = 0; r < group.ranges.size(); ++r) {
+    const Group::Range& range = group.ranges[r];
+    const std::vector<Corner>& corners = chunks[range.chunk].corners;
+    for (uint32_t c = 3 * range.first; c < 3 * range.last; ++c) {
+      Corner corner = corners[c];
+      if (!has_tex_coords)
+        corner.vt = -1;
+      if (!has_normals)
+        corner.vn = -1;
+      int* vertex = NULL;
+      if (use_position_table) {
+        vertex = &position_table[corner.v];
+      } else {
+        std::pair<boost::unordered_map<Corner, int, Corner::Hash>::iterator,
+            bool> result = corner_table.insert(std::make_pair(corner, -1));
+        vertex = &result.first->second;
+      }
+      if (*vertex < 0) {
+        *vertex = num_vertices++;
+        vertices.push_back(attributes.positions[corner.v]);
+        if (has_normals)
+          normals.push_back(attributes.normals[corner.vn]);
+        if (has_tex_coords)
+          tex_coords.push_back(TexCoord(attributes.tex_coords[corner.vt]));
+      }
+      indices.push_back(*vertex);
+    }
+  }
+  trimesh->SetVertices(vertices);
+  trimesh->SetNormals(normals);
+  trimesh->SetTexCoords(tex_coords);
+  if (!trimesh->SetFaces(indices)) {
+    status = "Index out of range";
+    return false;
+  }
+  if (!has_normals)
+    trimesh->GenNormals();
+  return true;
+}
+
+bool ObjLoader::LoadMaterials(const std::string& file_name,
+    std::vector<std::string>& names, std::vector<Material>& materials,
+    std::string& status) {
+  MappedFile file;
+  if (!file.Open(file_name, status))
+    return false;
+  const char* p = file.data();
+  const char* end = file.data() + file.size();
+  Material* material = NULL;
+  while (p < end) {
+    const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (NULL == line_end)
+      line_end = end;
+    p = SkipSpace(p, line_end);
+    const char* keyword_end = SkipToken(p, line_end);
+    std::string keyword(p, keyword_end);
+    float values[3] = { 0.0f, 0.0f, 0.0f };
+    int num_values = ParseFloats(keyword_end, line_end, values, 3);
+    glm::vec3 color(values[0], values[1], values[2]);
+    if ("newmtl" == keyword) {
+      const char* name = SkipSpace(keyword_end, line_end);
+      const char* name_end = line_end;
+      while (name_end > name && IsSpace(name_end[-1]))
+        --name_end;
+      names.push_back(std::string(name, name_end));
+      materials.push_back(GetDefaultMaterial());
+      material = &materials.back();
+    } else if (NULL == material || 0 == num_values) {
+      // Comments, texture maps and statements outside of a material.
+    } else if ("Kd" == keyword) {
+      material->kd = color;
+    } else if ("Ks" == keyword) {
+      material->ks = color;
+    } else if ("Ka" == keyword) {
+      material->ka = color;
+    } else if ("Ke" == keyword) {
+      material->ke = color;
+    } else if ("Ns" == keyword) {
+      material->ns = values[0];
+    } else if ("Ni" == keyword) {
+      material->kt = values[0];
+    } else if ("d" == keyword) {
+      material->tr = values[0];
+    } else if ("Tr" == keyword) {
+      material->tr = 1.0f - values[0];
+    }
+    p = line_end + 1;
+  }
+  status = "OK";
+  return true;
+}
+} // namespace ray
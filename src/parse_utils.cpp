@@ -4,11 +4,25 @@
  *  Created on: Sep 5, 2013
  *      Author: agrippa
  */
+#include <cstdlib>
 #include <cstring>
 #include <climits>
 #include <ctype.h>
+#include <sstream>
+#include <string>
+#include <vector>
 #include "parse_utils.hpp"
 namespace ray {
+// The <ctype.h> functions take the value of an unsigned char, which a
+// plain char above 0x7f is not.
+static bool IsDigit(char c) {
+    return isdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+static bool IsHexDigit(char c) {
+    return isxdigit(static_cast<unsigned char>(c)) != 0;
+}
+
 bool ParseInt(const char* str, int* value) {
     int base = 10;
     int offset = 1;
@@ -17,7 +31,7 @@ bool ParseInt(const char* str, int* value) {
     bool success = (pos > 0);
     bool overflow = false;
     *value = 0;
-    while (--pos >= 0 && (success = !overflow && isdigit(str[pos]))) {
+    while (--pos >= 0 && (success = !overflow && IsDigit(str[pos]))) {
         digit = static_cast<int>(str[pos] - '0');
         overflow |= (pos > 0 && digit != 0) && (offset > INT_MAX / digit);
         overflow |= (pos > 0 && digit != 0)
@@ -28,4 +42,253 @@ bool ParseInt(const char* str, int* value) {
     }
     return success;
 }
+
+JsonValue::JsonValue() :
+        type(kNull), boolean(false), number(0.0), string(), elements(),
+        names() {
+}
+
+const JsonValue* JsonValue::Find(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); ++i)
+        if (names[i] == name)
+            return &elements[i];
+    return NULL;
+}
+
+// Recursive descent over the grammar of RFC 7159.
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) :
+            text_(text), pos_(0), error_() {
+    }
+
+    bool Parse(std::vector<JsonValue>& values) {
+        SkipSpace();
+        while (pos_ < text_.size()) {
+            values.push_back(JsonValue());
+            if (!ParseValue(values.back(), 0))
+                return false;
+            SkipSpace();
+        }
+        return true;
+    }
+
+    std::string GetStatus() const {
+        if (error_.empty())
+            return "OK";
+        std::ostringstream status;
+        status << error_ << " at offset " << pos_;
+        return status.str();
+    }
+private:
+    // Deeper nesting is rejected rather than risking the stack.
+    static const int kMaxDepth = 256;
+
+    bool Fail(const char* error) {
+        error_ = error;
+        return false;
+    }
+
+    void SkipSpace() {
+        while (pos_ < text_.size() && (text_[pos_] == ' '
+                || text_[pos_] == '\t' || text_[pos_] == '\n'
+                || text_[pos_] == '\r'))
+            ++pos_;
+    }
+
+    bool Accept(char c) {
+        SkipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool AcceptWord(const char* word) {
+        size_t length = strlen(word);
+        if (text_.compare(pos_, length, word) != 0)
+            return false;
+        pos_ += length;
+        return true;
+    }
+
+    bool ParseValue(JsonValue& value, int depth) {
+        if (depth > kMaxDepth)
+            return Fail("Nested too deeply");
+        SkipSpace();
+        if (pos_ >= text_.size())
+            return Fail("Unexpected end");
+        char c = text_[pos_];
+        if ('{' == c)
+            return ParseObject(value, depth);
+        if ('[' == c)
+            return ParseArray(value, depth);
+        if ('"' == c) {
+            value.type = JsonValue::kString;
+            return ParseString(value.string);
+        }
+        if ('-' == c || IsDigit(c))
+            return ParseNumber(value);
+        if (AcceptWord("true") || AcceptWord("false")) {
+            value.type = JsonValue::kBool;
+            value.boolean = ('t' == c);
+            return true;
+        }
+        if (AcceptWord("null"))
+            return true;
+        return Fail("Unexpected character");
+    }
+
+    bool ParseObject(JsonValue& value, int depth) {
+        value.type = JsonValue::kObject;
+        ++pos_;
+        if (Accept('}'))
+            return true;
+        do {
+            SkipSpace();
+            std::string name;
+            if (pos_ >= text_.size() || text_[pos_] != '"')
+                return Fail("Expected a member name");
+            if (!ParseString(name))
+                return false;
+            if (!Accept(':'))
+                return Fail("Expected ':'");
+            value.names.push_back(name);
+            value.elements.push_back(JsonValue());
+            if (!ParseValue(value.elements.back(), depth + 1))
+                return false;
+        } while (Accept(','));
+        return Accept('}') || Fail("Expected ',' or '}'");
+    }
+
+    bool ParseArray(JsonValue& value, int depth) {
+        value.type = JsonValue::kArray;
+        ++pos_;
+        if (Accept(']'))
+            return true;
+        do {
+            value.elements.push_back(JsonValue());
+            if (!ParseValue(value.elements.back(), depth + 1))
+                return false;
+        } while (Accept(','));
+        return Accept(']') || Fail("Expected ',' or ']'");
+    }
+
+    bool ParseNumber(JsonValue& value) {
+        size_t start = pos_;
+        if ('-' == text_[pos_])
+            ++pos_;
+        if (pos_ >= text_.size() || !IsDigit(text_[pos_]))
+            return Fail("Expected a digit");
+        if ('0' == text_[pos_])
+            ++pos_;
+        else
+            SkipDigits();
+        if (pos_ < text_.size() && '.' == text_[pos_]) {
+            ++pos_;
+            if (pos_ >= text_.size() || !IsDigit(text_[pos_]))
+                return Fail("Expected a digit");
+            SkipDigits();
+        }
+        if (pos_ < text_.size() && ('e' == text_[pos_] || 'E' == text_[pos_])) {
+            ++pos_;
+            if (pos_ < text_.size() && ('+' == text_[pos_]
+                    || '-' == text_[pos_]))
+                ++pos_;
+            if (pos_ >= text_.size() || !IsDigit(text_[pos_]))
+                return Fail("Expected a digit");
+            SkipDigits();
+        }
+        value.type = JsonValue::kNumber;
+        value.number = strtod(text_.substr(start, pos_ - start).c_str(), NULL);
+        return true;
+    }
+
+    void SkipDigits() {
+        while (pos_ < text_.size() && IsDigit(text_[pos_]))
+            ++pos_;
+    }
+
+    // Escapes are decoded to UTF-8; surrogate pairs are not combined.
+    bool ParseString(std::string& str) {
+        ++pos_;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (static_cast<unsigned char>(c) < 0x20)
+                return Fail("Control character in string");
+            if (c != '\\') {
+                str += c;
+                continue;
+            }
+            if (pos_ >= text_.size())
+                break;
+            c = text_[pos_++];
+            switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                str += c;
+                break;
+            case 'b':
+                str += '\b';
+                break;
+            case 'f':
+                str += '\f';
+                break;
+            case 'n':
+                str += '\n';
+                break;
+            case 'r':
+                str += '\r';
+                break;
+            case 't':
+                str += '\t';
+                break;
+            case 'u': {
+                unsigned int code = 0;
+                for (int i = 0; i < 4; ++i, ++pos_) {
+                    if (pos_ >= text_.size() || !IsHexDigit(text_[pos_]))
+                        return Fail("Expected a hex digit");
+                    char h = tolower(static_cast<unsigned char>(text_[pos_]));
+                    code = 16 * code + (IsDigit(h) ? h - '0' : h - 'a' + 10);
+                }
+                AppendUtf8(code, str);
+                break;
+            }
+            default:
+                return Fail("Unknown escape");
+            }
+        }
+        if (pos_ >= text_.size())
+            return Fail("Unterminated string");
+        ++pos_;
+        return true;
+    }
+
+    static void AppendUtf8(unsigned int code, std::string& str) {
+        if (code < 0x80) {
+            str += static_cast<char>(code);
+        } else if (code < 0x800) {
+            str += static_cast<char>(0xc0 | (code >> 6));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            str += static_cast<char>(0xe0 | (code >> 12));
+            str += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
+    const std::string& text_;
+    size_t pos_;
+    std::string error_;
+};
+
+bool ParseJson(const std::string& text, std::vector<JsonValue>& values,
+        std::string& status) {
+    JsonParser parser(text);
+    bool success = parser.Parse(values);
+    status = parser.GetStatus();
+    return success;
+}
 } // namespace ray
@@ -0,0 +1,117 @@
+/*
+ * perf_counters.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <ostream>
+
+#include "perf_counters.hpp"
+namespace ray {
+static uint64_t CacheConfig(uint64_t cache, uint64_t result) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+static int OpenEvent(uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters() {
+  fds_[kCycles] = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  fds_[kInstructions] = OpenEvent(PERF_TYPE_HARDWARE,
+      PERF_COUNT_HW_INSTRUCTIONS);
+  fds_[kL1DReads] = OpenEvent(PERF_TYPE_HW_CACHE,
+      CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+  fds_[kL1DMisses] = OpenEvent(PERF_TYPE_HW_CACHE,
+      CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS));
+  fds_[kLLCReads] = OpenEvent(PERF_TYPE_HW_CACHE,
+      CacheConfig(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+  fds_[kLLCMisses] = OpenEvent(PERF_TYPE_HW_CACHE,
+      CacheConfig(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS));
+  for (int i = 0; i < kNumEvents; ++i)
+    values_[i] = 0;
+}
+
+PerfCounters::~PerfCounters() {
+  for (int i = 0; i < kNumEvents; ++i)
+    if (fds_[i] >= 0)
+      close(fds_[i]);
+}
+
+void PerfCounters::Start() {
+  for (int i = 0; i < kNumEvents; ++i) {
+    values_[i] = 0;
+    if (fds_[i] >= 0) {
+      ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void PerfCounters::Stop() {
+  for (int i = 0; i < kNumEvents; ++i) {
+    if (fds_[i] < 0)
+      continue;
+    ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t value = 0;
+    if (read(fds_[i], &value, sizeof(value)) == sizeof(value))
+      values_[i] = value;
+  }
+}
+
+bool PerfCounters::available(Event event) const {
+  return fds_[event] >= 0;
+}
+
+uint64_t PerfCounters::value(Event event) const {
+  return values_[event];
+}
+
+float PerfCounters::L1DHitRate() const {
+  return HitRate(kL1DReads, kL1DMisses);
+}
+
+float PerfCounters::LLCHitRate() const {
+  return HitRate(kLLCReads, kLLCMisses);
+}
+
+float PerfCounters::HitRate(Event reads, Event misses) const {
+  if (!available(reads) || !available(misses) || 0 == values_[reads])
+    return -1.0f;
+  return 1.0f
+      - static_cast<float>(values_[misses])
+          / static_cast<float>(values_[reads]);
+}
+
+void PerfCounters::Print(std::ostream& out) const {
+  for (int i = 0; i < kNumEvents; ++i) {
+    out << GetEventName(static_cast<Event>(i)) << " = ";
+    if (available(static_cast<Event>(i)))
+      out << values_[i];
+    else
+      out << "n/a";
+    out << (i + 1 < kNumEvents ? " " : "");
+  }
+}
+
+const char* PerfCounters::GetEventName(Event event) {
+  static const char* kEventNames[kNumEvents] = { "cycles", "instructions",
+      "l1d_reads", "l1d_misses", "llc_reads", "llc_misses" };
+  return kEventNames[event];
+}
+} // namespace ray
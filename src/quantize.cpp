@@ -0,0 +1,113 @@
+/*
+ * quantize.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "quantize.hpp"
+namespace ray {
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x007fffff;
+  if (((bits >> 23) & 0xff) == 0xff)
+    return sign | 0x7c00 | (mantissa ? 0x0200 : 0);
+  if (exponent >= 31)
+    return sign | 0x7c00;
+  if (exponent <= 0) {
+    // Subnormal half, or zero.
+    if (exponent < -10)
+      return sign;
+    mantissa |= 0x00800000;
+    uint32_t shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1)))
+      ++half;
+    return sign | half;
+  }
+  uint32_t half = (exponent << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  // A carry out of the mantissa correctly bumps the exponent.
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    ++half;
+  return sign | half;
+}
+
+float HalfToFloat(uint16_t half) {
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x03ff;
+  uint32_t bits = 0;
+  if (0 == exponent) {
+    if (0 == mantissa) {
+      bits = sign;
+    } else {
+      // Normalize the subnormal half.
+      exponent = 127 - 15 + 1;
+      while (!(mantissa & 0x0400)) {
+        mantissa <<= 1;
+        --exponent;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x03ff) << 13);
+    }
+  } else if (0x1f == exponent) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static float SignNotZero(float value) {
+  return (value >= 0.0f ? 1.0f : -1.0f);
+}
+
+static uint32_t EncodeSnorm16(float value) {
+  float clamped = std::min(std::max(value, -1.0f), 1.0f);
+  int32_t snorm = static_cast<int32_t>(floorf(clamped * 32767.0f + 0.5f));
+  return static_cast<uint16_t>(static_cast<int16_t>(snorm));
+}
+
+static float DecodeSnorm16(uint32_t bits) {
+  int16_t snorm = static_cast<int16_t>(static_cast<uint16_t>(bits));
+  return std::max(snorm / 32767.0f, -1.0f);
+}
+
+uint32_t EncodeOctahedral(const glm::vec3& normal) {
+  float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+  if (length <= 0.0f)
+    return EncodeSnorm16(0.0f) | (EncodeSnorm16(0.0f) << 16);
+  float x = normal[0] / length;
+  float y = normal[1] / length;
+  if (normal[2] < 0.0f) {
+    // Fold the lower hemisphere over the diagonals.
+    float folded_x = (1.0f - fabsf(y)) * SignNotZero(x);
+    float folded_y = (1.0f - fabsf(x)) * SignNotZero(y);
+    x = folded_x;
+    y = folded_y;
+  }
+  return EncodeSnorm16(x) | (EncodeSnorm16(y) << 16);
+}
+
+glm::vec3 DecodeOctahedral(uint32_t code) {
+  float x = DecodeSnorm16(code & 0xffff);
+  float y = DecodeSnorm16(code >> 16);
+  float z = 1.0f - fabsf(x) - fabsf(y);
+  if (z < 0.0f) {
+    float unfolded_x = (1.0f - fabsf(y)) * SignNotZero(x);
+    float unfolded_y = (1.0f - fabsf(x)) * SignNotZero(y);
+    x = unfolded_x;
+    y = unfolded_y;
+  }
+  return glm::normalize(glm::vec3(x, y, z));
+}
+} // namespace ray
@@ -0,0 +1,381 @@
+/*
+ * ray_bench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "accelerator_factory.hpp"
+#include "camera.hpp"
+#include "mesh.hpp"
+#include "scene.hpp"
+#include "scene_utils.hpp"
+#include "tool_utils.hpp"
+#include "tree_stats.hpp"
+#include "worker_pool.hpp"
+namespace ray {
+static const char* kUsageString = "Usage:\n"
+    "  ray_bench [options] [<scene-file>...]\n"
+    "Renders every scene with every accelerator variant and reports build\n"
+    "time, memory and rays per second: primary rays, and secondary rays\n"
+    "from the hits towards a light.  The default scenes are sphere, bunny,\n"
+    "dragon and CornellBox-Original from the assets directory.\n"
+    "Options:\n"
+    "      --assets <dir>       assets directory (assets)\n"
+    "  -a, --accelerator <type> only kdtree, octree or sah-octree\n"
+    "  -f, --format <format>    csv or json (csv)\n"
+    "  -w, --width <n>          image width (256)\n"
+    "  -h, --height <n>         image height (256)\n"
+    "  -t, --threads <n>        threads (one per processor)\n";
+
+static const char* kDefaultScenes[] = { "sphere.obj", "bunny.obj",
+    "dragon.obj", "CornellBox-Original.obj" };
+
+struct Variant {
+  AcceleratorFactory::Type type;
+  int policy;
+  std::string policy_name;
+};
+
+struct Result {
+  std::string scene;
+  std::string accelerator;
+  std::string policy;
+  int width;
+  int height;
+  int num_threads;
+  int num_faces;
+  double build_seconds;
+  size_t memory_bytes;
+  // Summed, or for the depth the maximum, over the meshes of the scene.
+  float sah_cost;
+  uint32_t num_object_refs;
+  uint32_t max_depth;
+  int num_primary_rays;
+  int num_hits;
+  double primary_rays_per_second;
+  int num_secondary_rays;
+  int num_occluded;
+  double secondary_rays_per_second;
+};
+
+// Every kd-tree split policy, the octree and every SAH octree evaluation
+// policy.
+static std::vector<Variant> GetVariants() {
+  std::vector<Variant> variants;
+  for (int i = 0; i < AcceleratorFactory::KdtreeType::kNumPolicies; ++i) {
+    Variant variant = { AcceleratorFactory::kKdtree, i,
+        AcceleratorFactory::GetKdtreePolicyName(
+            static_cast<AcceleratorFactory::KdtreeType::SplitPolicy>(i)) };
+    variants.push_back(variant);
+  }
+  Variant octree = { AcceleratorFactory::kOctree, 0, "" };
+  variants.push_back(octree);
+  for (int i = 0; i < AcceleratorFactory::SahOctreeType::kNumPolicies; ++i) {
+    Variant variant = { AcceleratorFactory::kSahOctree, i,
+        AcceleratorFactory::GetSahOctreePolicyName(
+            static_cast<AcceleratorFactory::SahOctreeType::EvaluationPolicy>(
+                i)) };
+    variants.push_back(variant);
+  }
+  return variants;
+}
+
+// Traces the primary rays of a row of pixels.  hits[i] holds the hit
+// point and hit[i][3] is 1 if pixel i hit anything.
+class PrimaryTask: public WorkerTask {
+public:
+  PrimaryTask(Scene* scene, const Camera* camera, std::vector<glm::vec4>* hits,
+      std::vector<glm::vec3>* normals) :
+      scene_(scene), camera_(camera), hits_(hits), normals_(normals) {
+  }
+
+  virtual void Execute(int item, int) {
+    int width = camera_->screen_width();
+    for (int x = 0; x < width; ++x) {
+      Ray ray = camera_->GenerateRay(x + 0.5f, item + 0.5f);
+      Isect isect;
+      glm::vec4 hit(0.0f);
+      if (scene_->Intersect(ray, isect)) {
+        hit = glm::vec4(ray(isect.t_hit), 1.0f);
+        (*normals_)[item * width + x] = isect.normal;
+      }
+      (*hits_)[item * width + x] = hit;
+    }
+  }
+private:
+  Scene* scene_;
+  const Camera* camera_;
+  std::vector<glm::vec4>* hits_;
+  std::vector<glm::vec3>* normals_;
+};
+
+// Traces a ray from every hit of a row towards light.  occluded[item]
+// counts the ones that hit something before the light.  These are the rays
+// of a shadow test, but traced with the closest hit Scene::Intersect(), as
+// the tracer has no any hit query, so they are timed as secondary rays.
+class SecondaryTask: public WorkerTask {
+public:
+  SecondaryTask(Scene* scene, int width, const glm::vec3& light,
+      const std::vector<glm::vec4>* hits,
+      const std::vector<glm::vec3>* normals, float offset,
+      std::vector<int>* occluded) :
+      scene_(scene), width_(width), light_(light), hits_(hits),
+          normals_(normals), offset_(offset), occluded_(occluded) {
+  }
+
+  virtual void Execute(int item, int) {
+    int occluded = 0;
+    for (int x = 0; x < width_; ++x) {
+      const glm::vec4& hit = (*hits_)[item * width_ + x];
+      if (hit[3] == 0.0f)
+        continue;
+      glm::vec3 normal = (*normals_)[item * width_ + x];
+      glm::vec3 to_light = light_ - glm::vec3(hit);
+      // Start off the surface, on the side of the light.
+      glm::vec3 origin = glm::vec3(hit)
+          + (glm::dot(normal, to_light) < 0.0f ? -offset_ : offset_) * normal;
+      Ray ray(origin, glm::normalize(light_ - origin));
+      Isect isect;
+      if (scene_->Intersect(ray, isect)
+          && isect.t_hit < glm::length(light_ - origin))
+        ++occluded;
+    }
+    (*occluded_)[item] = occluded;
+  }
+private:
+  Scene* scene_;
+  int width_;
+  glm::vec3 light_;
+  const std::vector<glm::vec4>* hits_;
+  const std::vector<glm::vec3>* normals_;
+  float offset_;
+  std::vector<int>* occluded_;
+};
+
+static Result RunVariant(const std::string& scene_name, Scene& scene,
+    const Variant& variant, int width, int height, int num_threads) {
+  Result result;
+  result.scene = scene_name;
+  result.accelerator = AcceleratorFactory::GetTypeName(variant.type);
+  result.policy = variant.policy_name;
+  result.width = width;
+  result.height = height;
+  result.num_threads = num_threads;
+  result.num_faces = 0;
+  BoundingBox bounds;
+  const std::vector<SceneShape*>& shapes = scene.scene_objects();
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    if (NULL != trimesh) {
+      result.num_faces += trimesh->num_faces();
+      bounds = bounds.Join(trimesh->GetBounds());
+    }
+  }
+
+  AcceleratorFactory factory;
+  factory.set_type(variant.type);
+  if (AcceleratorFactory::kKdtree == variant.type)
+    factory.set_kdtree_policy(
+        static_cast<AcceleratorFactory::KdtreeType::SplitPolicy>(
+            variant.policy));
+  else if (AcceleratorFactory::kSahOctree == variant.type)
+    factory.set_sah_octree_policy(
+        static_cast<AcceleratorFactory::SahOctreeType::EvaluationPolicy>(
+            variant.policy));
+  std::vector<Accelerator*> accelerators;
+  result.build_seconds = 0.0;
+  result.memory_bytes = 0;
+  result.sah_cost = 0.0f;
+  result.num_object_refs = 0;
+  result.max_depth = 0;
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    if (NULL == trimesh)
+      continue;
+    TreeStats stats;
+    double start = GetSeconds();
+    Accelerator* accelerator = factory.Create(*trimesh, &stats);
+    result.build_seconds += GetSeconds() - start;
+    trimesh->set_accelerator(accelerator);
+    accelerators.push_back(accelerator);
+    result.memory_bytes += stats.memory_bytes;
+    result.sah_cost += stats.sah_cost;
+    result.num_object_refs += stats.num_object_refs;
+    result.max_depth = std::max(result.max_depth, stats.GetMaxDepth());
+  }
+
+  Camera camera = FrameScene(scene, width, height);
+  WorkerPool pool(num_threads);
+  std::vector<glm::vec4> hits(width * height);
+  std::vector<glm::vec3> normals(width * height);
+  PrimaryTask primary_task(&scene, &camera, &hits, &normals);
+  double start = GetSeconds();
+  pool.Run(primary_task, height);
+  double seconds = GetSeconds() - start;
+  result.num_primary_rays = width * height;
+  result.num_hits = 0;
+  for (size_t i = 0; i < hits.size(); ++i)
+    result.num_hits += (hits[i][3] != 0.0f);
+  result.primary_rays_per_second = result.num_primary_rays / seconds;
+
+  // A point light above and in front of the scene.
+  glm::vec3 extent = bounds.max() - bounds.min();
+  glm::vec3 light = bounds.GetCenter()
+      + glm::vec3(0.25f * extent[0], extent[1], extent[2]);
+  std::vector<int> occluded(height, 0);
+  SecondaryTask secondary_task(&scene, width, light, &hits, &normals,
+      1e-4f * glm::length(extent), &occluded);
+  start = GetSeconds();
+  pool.Run(secondary_task, height);
+  seconds = GetSeconds() - start;
+  result.num_secondary_rays = result.num_hits;
+  result.num_occluded = 0;
+  for (int i = 0; i < height; ++i)
+    result.num_occluded += occluded[i];
+  result.secondary_rays_per_second = result.num_secondary_rays / seconds;
+
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    if (NULL != trimesh)
+      trimesh->set_accelerator(NULL);
+  }
+  for (size_t i = 0; i < accelerators.size(); ++i)
+    delete accelerators[i];
+  return result;
+}
+
+static void WriteCsv(std::ostream& out, const std::vector<Result>& results) {
+  out << "scene,accelerator,policy,width,height,threads,faces,"
+      << "build_seconds,memory_bytes,sah_cost,object_refs,max_depth,"
+      << "primary_rays,hits,primary_rays_per_second,secondary_rays,"
+      << "occluded,secondary_rays_per_second\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    out << r.scene << "," << r.accelerator << "," << r.policy << ","
+        << r.width << "," << r.height << "," << r.num_threads << ","
+        << r.num_faces << "," << r.build_seconds << "," << r.memory_bytes
+        << "," << r.sah_cost << "," << r.num_object_refs << ","
+        << r.max_depth << "," << r.num_primary_rays << "," << r.num_hits << ","
+        << r.primary_rays_per_second << "," << r.num_secondary_rays << ","
+        << r.num_occluded << "," << r.secondary_rays_per_second << "\n";
+  }
+}
+
+static void WriteJson(std::ostream& out, const std::vector<Result>& results) {
+  out << "[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    out << (i > 0 ? ",\n " : "\n ") << "{\"scene\": \"" << r.scene
+        << "\", \"accelerator\": \"" << r.accelerator << "\", \"policy\": \""
+        << r.policy << "\", \"width\": " << r.width << ", \"height\": "
+        << r.height << ", \"threads\": " << r.num_threads
+        << ", \"faces\": " << r.num_faces
+        << ", \"build_seconds\": " << r.build_seconds
+        << ", \"memory_bytes\": " << r.memory_bytes << ", \"sah_cost\": "
+        << r.sah_cost << ", \"object_refs\": " << r.num_object_refs
+        << ", \"max_depth\": " << r.max_depth << ", \"primary_rays\": "
+        << r.num_primary_rays << ", \"hits\": " << r.num_hits
+        << ", \"primary_rays_per_second\": " << r.primary_rays_per_second
+        << ", \"secondary_rays\": " << r.num_secondary_rays
+        << ", \"occluded\": " << r.num_occluded
+        << ", \"secondary_rays_per_second\": "
+        << r.secondary_rays_per_second << "}";
+  }
+  out << "\n]\n";
+}
+} // namespace ray
+
+int main(int argc, char** argv) {
+  ray::SetUsage(ray::kUsageString);
+  enum {
+    kAssetsOption = 256
+  };
+  static const option kOptions[] = {
+      { "assets", required_argument, NULL, kAssetsOption },
+      { "accelerator", required_argument, NULL, 'a' },
+      { "format", required_argument, NULL, 'f' },
+      { "width", required_argument, NULL, 'w' },
+      { "height", required_argument, NULL, 'h' },
+      { "threads", required_argument, NULL, 't' },
+      { NULL, 0, NULL, 0 } };
+  std::string assets = "assets";
+  std::string format = "csv";
+  bool all_types = true;
+  ray::AcceleratorFactory::Type only_type = ray::AcceleratorFactory::kNone;
+  int width = 256;
+  int height = 256;
+  int num_threads = ray::WorkerPool::GetNumProcessors();
+  int c = 0;
+  while ((c = getopt_long(argc, argv, "a:f:w:h:t:", kOptions, NULL)) != -1) {
+    switch (c) {
+    case kAssetsOption:
+      assets = optarg;
+      break;
+    case 'a':
+      if (!ray::AcceleratorFactory::ParseType(optarg, only_type))
+        ray::Die(std::string("Unknown accelerator: ") + optarg);
+      all_types = false;
+      break;
+    case 'f':
+      format = optarg;
+      if ("csv" != format && "json" != format)
+        ray::Die("Unknown format: " + format);
+      break;
+    case 'w':
+      width = ray::ParsePositive(optarg);
+      break;
+    case 'h':
+      height = ray::ParsePositive(optarg);
+      break;
+    case 't':
+      num_threads = ray::ParsePositive(optarg);
+      break;
+    default:
+      ray::Die("");
+    }
+  }
+  std::vector<std::string> scene_files(argv + optind, argv + argc);
+  if (scene_files.empty())
+    for (size_t i = 0; i < sizeof(ray::kDefaultScenes) / sizeof(char*); ++i)
+      scene_files.push_back(assets + "/" + ray::kDefaultScenes[i]);
+  std::vector<ray::Variant> variants = ray::GetVariants();
+  std::vector<ray::Result> results;
+  ray::SceneLoader& loader = ray::SceneLoader::GetInstance();
+  loader.set_reorder_meshes(true);
+  ray::CoutSilencer silencer;
+  silencer.Mute();
+  for (size_t i = 0; i < scene_files.size(); ++i) {
+    ray::Scene scene;
+    std::string status = "";
+    if (!loader.LoadScene(scene_files[i], scene, status)) {
+      std::cerr << "Cannot load " << scene_files[i] << ": " << status
+          << std::endl;
+      return -1;
+    }
+    std::string name = scene_files[i].substr(
+        scene_files[i].find_last_of('/') + 1);
+    for (size_t j = 0; j < variants.size(); ++j) {
+      if (!all_types && variants[j].type != only_type)
+        continue;
+      std::cerr << name << " " << ray::AcceleratorFactory::GetTypeName(
+          variants[j].type) << " " << variants[j].policy_name << std::endl;
+      results.push_back(
+          ray::RunVariant(name, scene, variants[j], width, height,
+              num_threads));
+    }
+  }
+  silencer.Restore();
+  if ("json" == format)
+    ray::WriteJson(std::cout, results);
+  else
+    ray::WriteCsv(std::cout, results);
+  return 0;
+}
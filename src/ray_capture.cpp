@@ -0,0 +1,215 @@
+/*
+ * ray_capture.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ray_capture.hpp"
+namespace ray {
+static const int kCacheLineSize = 64;
+
+// The rays are written and read as one array of records.
+typedef char CapturedRaySizeCheck[
+    sizeof(CapturedRay) == 7 * sizeof(float) ? 1 : -1];
+
+struct RayFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t num_rays;
+};
+
+static const char kMagic[8] = { 'R', 'T', 'R', 'A', 'Y', 'S', 0, 0 };
+static const uint32_t kVersion = 1;
+static const uint32_t kByteOrderMark = 0x01020304;
+
+RandomSequence::RandomSequence(uint32_t seed) :
+    state_(0 == seed ? 0x9e3779b9u : seed) {
+}
+
+float RandomSequence::Next() {
+  state_ ^= state_ << 13;
+  state_ ^= state_ >> 17;
+  state_ ^= state_ << 5;
+  return (state_ >> 8) * (1.0f / 16777216.0f);
+}
+
+uint32_t RandomSequence::Next(uint32_t n) {
+  return std::min(static_cast<uint32_t>(Next() * n), n - 1);
+}
+
+// Uniform on the unit sphere.
+glm::vec3 RandomSequence::NextDirection() {
+  float z = 1.0f - 2.0f * Next();
+  float r = sqrt(std::max(0.0f, 1.0f - z * z));
+  float phi = 2.0f * static_cast<float>(M_PI) * Next();
+  return glm::vec3(r * cos(phi), r * sin(phi), z);
+}
+
+CapturedRay::CapturedRay() :
+    origin(0.0f), direction(0.0f), type(kPrimary) {
+}
+
+CapturedRay::CapturedRay(const Ray& ray, Type type) :
+    origin(ray.origin()), direction(ray.direction()), type(type) {
+}
+
+Ray CapturedRay::GetRay() const {
+  return Ray(origin, direction);
+}
+
+RayCapture::RayCapture() :
+    threads_(NULL), num_threads_(0) {
+}
+
+RayCapture::~RayCapture() {
+  Clear();
+}
+
+// Each buffer starts a cache line of its own, so the render threads never
+// write to the same line when they append.  The rays recorded so far move
+// to the new buffers.  Throws std::bad_alloc, as growing a vector would.
+void RayCapture::Start(int num_threads) {
+  if (num_threads <= num_threads_)
+    return;
+  void* memory = NULL;
+  if (posix_memalign(&memory, kCacheLineSize,
+      num_threads * sizeof(ThreadBuffer)) != 0)
+    throw std::bad_alloc();
+  ThreadBuffer* threads = static_cast<ThreadBuffer*>(memory);
+  for (int i = 0; i < num_threads; ++i) {
+    new (&threads[i]) ThreadBuffer();
+    if (i < num_threads_)
+      threads[i].rays.swap(threads_[i].rays);
+  }
+  Clear();
+  threads_ = threads;
+  num_threads_ = num_threads;
+}
+
+void RayCapture::Record(int thread_index, const Ray& ray,
+    CapturedRay::Type type) {
+  threads_[thread_index].rays.push_back(CapturedRay(ray, type));
+}
+
+void RayCapture::Clear() {
+  for (int i = 0; i < num_threads_; ++i)
+    threads_[i].~ThreadBuffer();
+  free(threads_);
+  threads_ = NULL;
+  num_threads_ = 0;
+}
+
+void RayCapture::GetRays(std::vector<CapturedRay>& rays) const {
+  size_t num_rays = 0;
+  for (int i = 0; i < num_threads_; ++i)
+    num_rays += threads_[i].rays.size();
+  rays.clear();
+  rays.reserve(num_rays);
+  for (int i = 0; i < num_threads_; ++i)
+    rays.insert(rays.end(), threads_[i].rays.begin(), threads_[i].rays.end());
+}
+
+bool RayCapture::Write(const std::string& file_name,
+    std::string& status) const {
+  std::vector<CapturedRay> rays;
+  GetRays(rays);
+  return Write(file_name, rays, status);
+}
+
+bool RayCapture::Write(const std::string& file_name,
+    const std::vector<CapturedRay>& rays, std::string& status) {
+  RayFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrderMark;
+  header.num_rays = rays.size();
+  std::ofstream out(file_name.c_str(),
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!rays.empty())
+    out.write(reinterpret_cast<const char*>(&rays[0]),
+        rays.size() * sizeof(CapturedRay));
+  out.close();
+  if (!out) {
+    status = "Cannot write " + file_name;
+    return false;
+  }
+  status = "OK";
+  return true;
+}
+
+bool RayCapture::Read(const std::string& file_name,
+    std::vector<CapturedRay>& rays, std::string& status) {
+  std::ifstream in(file_name.c_str(), std::ios::in | std::ios::binary);
+  if (!in) {
+    status = "Cannot open " + file_name;
+    return false;
+  }
+  RayFileHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kVersion || header.byte_order != kByteOrderMark) {
+    status = "Not a ray file: " + file_name;
+    return false;
+  }
+  // Check the size before allocating what a corrupt header asks for.
+  std::streampos start = in.tellg();
+  in.seekg(0, std::ios::end);
+  std::streamoff size = in.tellg() - start;
+  in.seekg(start);
+  if (size < 0 || static_cast<uint64_t>(size)
+      != header.num_rays * sizeof(CapturedRay)) {
+    status = "Corrupt ray file: " + file_name;
+    return false;
+  }
+  std::vector<CapturedRay> file_rays(header.num_rays);
+  if (!file_rays.empty())
+    in.read(reinterpret_cast<char*>(&file_rays[0]),
+        file_rays.size() * sizeof(CapturedRay));
+  if (!in) {
+    status = "Cannot read " + file_name;
+    return false;
+  }
+  for (size_t i = 0; i < file_rays.size(); ++i) {
+    if (file_rays[i].type >= CapturedRay::kNumTypes) {
+      status = "Corrupt ray file: " + file_name;
+      return false;
+    }
+  }
+  rays.swap(file_rays);
+  status = "OK";
+  return true;
+}
+
+void RayCapture::GenerateIncoherent(const BoundingBox& bounds, int num_rays,
+    uint32_t seed, std::vector<CapturedRay>& rays) {
+  RandomSequence random(seed);
+  glm::vec3 extent = bounds.max() - bounds.min();
+  for (int i = 0; i < num_rays; ++i) {
+    glm::vec3 origin;
+    for (int d = 0; d < 3; ++d)
+      origin[d] = bounds.min()[d] + random.Next() * extent[d];
+    rays.push_back(
+        CapturedRay(Ray(origin, random.NextDirection()),
+            CapturedRay::kIncoherent));
+  }
+}
+
+const char* RayCapture::GetTypeName(CapturedRay::Type type) {
+  static const char* kTypeNames[CapturedRay::kNumTypes] = { "primary",
+      "shadow", "incoherent" };
+  return (type >= 0 && type < CapturedRay::kNumTypes ?
+      kTypeNames[type] : "unknown");
+}
+} // namespace ray
@@ -0,0 +1,267 @@
+/*
+ * ray_replay.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "accelerator_factory.hpp"
+#include "mesh.hpp"
+#include "ray_capture.hpp"
+#include "scene.hpp"
+#include "scene_utils.hpp"
+#include "tool_utils.hpp"
+#include "worker_pool.hpp"
+namespace ray {
+static const char* kUsageString = "Usage:\n"
+    "  ray_replay [options] <scene-file> <ray-file>\n"
+    "  ray_replay [options] -n <count> <scene-file>\n"
+    "Traces the rays of a ray file, as recorded by ray --capture-rays, or a\n"
+    "set of incoherent rays through the scene and reports rays per second.\n"
+    "With a reference accelerator the rays are traced through both and the\n"
+    "hits compared.\n"
+    "Options:\n"
+    "  -a, --accelerator <type> none, kdtree, octree or sah-octree (kdtree)\n"
+    "  -p, --policy <name>      split or evaluation policy of the"
+    " accelerator\n"
+    "  -r, --reference <type>   accelerator to compare the hits with\n"
+    "      --reference-policy <name>  policy of the reference\n"
+    "  -n, --incoherent <n>     trace n rays with random origins in the"
+    " scene\n"
+    "                           bounds and random directions\n"
+    "      --seed <n>           seed of the incoherent rays (1)\n"
+    "  -o, --output <file>      write the rays traced to a ray file\n"
+    "  -t, --threads <n>        threads (one per processor)\n";
+
+// Rays per work item; small enough to balance the threads, large enough
+// to keep the pool overhead out of the measurement.
+static const int kChunkSize = 4096;
+
+struct Replay {
+  double build_seconds;
+  double seconds;
+  // Distance to the hit of every ray, or -1 for a miss.
+  std::vector<float> t_hits;
+};
+
+// Sets the type of factory and, if not empty, its policy.
+static void ConfigureFactory(const char* type_name, const std::string& policy,
+    AcceleratorFactory& factory) {
+  AcceleratorFactory::Type type;
+  if (!AcceleratorFactory::ParseType(type_name, type))
+    Die(std::string("Unknown accelerator: ") + type_name);
+  factory.set_type(type);
+  if (!policy.empty() && !factory.SetPolicy(policy))
+    Die("Unknown policy: " + policy);
+}
+
+class ReplayTask: public WorkerTask {
+public:
+  ReplayTask(Scene* scene, const std::vector<CapturedRay>* rays,
+      std::vector<float>* t_hits) :
+      scene_(scene), rays_(rays), t_hits_(t_hits) {
+  }
+
+  virtual void Execute(int item, int) {
+    size_t end = std::min(rays_->size(),
+        static_cast<size_t>(item + 1) * kChunkSize);
+    for (size_t i = static_cast<size_t>(item) * kChunkSize; i < end; ++i) {
+      Isect isect;
+      bool hit = scene_->Intersect((*rays_)[i].GetRay(), isect);
+      (*t_hits_)[i] = (hit ? isect.t_hit : -1.0f);
+    }
+  }
+private:
+  Scene* scene_;
+  const std::vector<CapturedRay>* rays_;
+  std::vector<float>* t_hits_;
+};
+
+// Builds the accelerators of factory for scene, traces rays through it and
+// takes the accelerators down again.
+static Replay RunReplay(Scene& scene, const AcceleratorFactory& factory,
+    const std::vector<CapturedRay>& rays, int num_threads) {
+  Replay replay;
+  std::vector<Accelerator*> accelerators;
+  double start = GetSeconds();
+  factory.Accelerate(scene, accelerators);
+  replay.build_seconds = GetSeconds() - start;
+  replay.t_hits.resize(rays.size());
+  WorkerPool pool(num_threads);
+  ReplayTask task(&scene, &rays, &replay.t_hits);
+  start = GetSeconds();
+  pool.Run(task, (rays.size() + kChunkSize - 1) / kChunkSize);
+  replay.seconds = GetSeconds() - start;
+  const std::vector<SceneShape*>& shapes = scene.scene_objects();
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    if (NULL != trimesh)
+      trimesh->set_accelerator(NULL);
+  }
+  for (size_t i = 0; i < accelerators.size(); ++i)
+    delete accelerators[i];
+  return replay;
+}
+
+static void PrintReplay(const std::string& name,
+    const std::vector<CapturedRay>& rays, const Replay& replay) {
+  std::vector<int> num_rays(CapturedRay::kNumTypes, 0);
+  std::vector<int> num_hits(CapturedRay::kNumTypes, 0);
+  for (size_t i = 0; i < rays.size(); ++i) {
+    ++num_rays[rays[i].type];
+    num_hits[rays[i].type] += (replay.t_hits[i] >= 0.0f);
+  }
+  std::cout << name << ": build " << replay.build_seconds << " s, trace "
+      << replay.seconds << " s, "
+      << (replay.seconds > 0.0 ? rays.size() / replay.seconds : 0.0)
+      << " rays/s\n";
+  for (int i = 0; i < CapturedRay::kNumTypes; ++i)
+    if (num_rays[i] > 0)
+      std::cout << "  " << RayCapture::GetTypeName(
+          static_cast<CapturedRay::Type>(i)) << ": " << num_rays[i]
+          << " rays, " << num_hits[i] << " hits\n";
+}
+
+// Rays that hit in one replay and miss in the other, and hits further
+// apart than tolerance, relative to the reference distance.
+static void PrintDifferences(const Replay& replay, const Replay& reference) {
+  const float kTolerance = 1e-4f;
+  int num_hit_mismatches = 0;
+  int num_distance_mismatches = 0;
+  float max_difference = 0.0f;
+  for (size_t i = 0; i < replay.t_hits.size(); ++i) {
+    float t = replay.t_hits[i];
+    float t_reference = reference.t_hits[i];
+    if ((t >= 0.0f) != (t_reference >= 0.0f)) {
+      ++num_hit_mismatches;
+    } else if (t >= 0.0f) {
+      float difference = fabs(t - t_reference);
+      max_difference = std::max(max_difference, difference);
+      if (difference > kTolerance * std::max(1.0f, t_reference))
+        ++num_distance_mismatches;
+    }
+  }
+  std::cout << "differences: " << num_hit_mismatches << " hit/miss, "
+      << num_distance_mismatches << " distance, max distance difference "
+      << max_difference << "\n";
+  if (reference.seconds > 0.0 && replay.seconds > 0.0)
+    std::cout << "speedup over reference: "
+        << reference.seconds / replay.seconds << "\n";
+}
+} // namespace ray
+
+int main(int argc, char** argv) {
+  ray::SetUsage(ray::kUsageString);
+  enum {
+    kReferencePolicyOption = 256, kSeedOption
+  };
+  static const option kOptions[] = {
+      { "accelerator", required_argument, NULL, 'a' },
+      { "policy", required_argument, NULL, 'p' },
+      { "reference", required_argument, NULL, 'r' },
+      { "reference-policy", required_argument, NULL, kReferencePolicyOption },
+      { "incoherent", required_argument, NULL, 'n' },
+      { "seed", required_argument, NULL, kSeedOption },
+      { "output", required_argument, NULL, 'o' },
+      { "threads", required_argument, NULL, 't' },
+      { NULL, 0, NULL, 0 } };
+  const char* type = "kdtree";
+  std::string policy;
+  const char* reference_type = NULL;
+  std::string reference_policy;
+  int num_incoherent = 0;
+  int seed = 1;
+  std::string output;
+  int num_threads = ray::WorkerPool::GetNumProcessors();
+  int c = 0;
+  while ((c = getopt_long(argc, argv, "a:p:r:n:o:t:", kOptions, NULL)) != -1) {
+    switch (c) {
+    case 'a':
+      type = optarg;
+      break;
+    case 'p':
+      policy = optarg;
+      break;
+    case 'r':
+      reference_type = optarg;
+      break;
+    case kReferencePolicyOption:
+      reference_policy = optarg;
+      break;
+    case 'n':
+      num_incoherent = ray::ParsePositive(optarg);
+      break;
+    case kSeedOption:
+      seed = ray::ParsePositive(optarg);
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 't':
+      num_threads = ray::ParsePositive(optarg);
+      break;
+    default:
+      ray::Die("");
+    }
+  }
+  int num_args = argc - optind;
+  if (num_args != (num_incoherent > 0 ? 1 : 2))
+    ray::Die("");
+  std::string scene_file = argv[optind];
+  ray::AcceleratorFactory factory;
+  ray::ConfigureFactory(type, policy, factory);
+  ray::AcceleratorFactory reference;
+  if (NULL != reference_type)
+    ray::ConfigureFactory(reference_type, reference_policy, reference);
+
+  ray::CoutSilencer silencer;
+  silencer.Mute();
+  ray::SceneLoader& loader = ray::SceneLoader::GetInstance();
+  loader.set_reorder_meshes(true);
+  ray::Scene scene;
+  std::string status = "";
+  bool loaded = loader.LoadScene(scene_file, scene, status);
+  silencer.Restore();
+  if (!loaded) {
+    std::cerr << "Cannot load " << scene_file << ": " << status << std::endl;
+    return -1;
+  }
+  std::vector<ray::CapturedRay> rays;
+  if (num_incoherent > 0) {
+    ray::BoundingBox bounds;
+    const std::vector<ray::SceneShape*>& shapes = scene.scene_objects();
+    for (size_t i = 0; i < shapes.size(); ++i) {
+      ray::Trimesh* trimesh = dynamic_cast<ray::Trimesh*>(shapes[i]);
+      if (NULL != trimesh)
+        bounds = bounds.Join(trimesh->GetBounds());
+    }
+    ray::RayCapture::GenerateIncoherent(bounds, num_incoherent, seed, rays);
+  } else if (!ray::RayCapture::Read(argv[optind + 1], rays, status)) {
+    std::cerr << status << std::endl;
+    return -1;
+  }
+  if (!output.empty() && !ray::RayCapture::Write(output, rays, status)) {
+    std::cerr << status << std::endl;
+    return -1;
+  }
+
+  silencer.Mute();
+  ray::Replay replay = ray::RunReplay(scene, factory, rays, num_threads);
+  ray::Replay reference_replay;
+  if (NULL != reference_type)
+    reference_replay = ray::RunReplay(scene, reference, rays, num_threads);
+  silencer.Restore();
+  ray::PrintReplay(type, rays, replay);
+  if (NULL != reference_type) {
+    ray::PrintReplay(reference_type, rays, reference_replay);
+    ray::PrintDifferences(replay, reference_replay);
+  }
+  return 0;
+}
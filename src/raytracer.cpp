@@ -4,24 +4,156 @@
  *  Created on: Nov 14, 2013
  *      Author: agrippa
  */
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "camera.hpp"
+#include "framebuffer.hpp"
 #include "io_utils.hpp"
+#include "morton.hpp"
 #include "raytracer.hpp"
 #include "scene.hpp"
+#include "worker_pool.hpp"
 namespace ray {
-static int hit_count = 0;
-static int miss_count = 0;
+RenderTile::RenderTile() :
+    view(0), x(0), y(0), width(0), height(0) {
+}
+
+RenderTile::RenderTile(int view, int x, int y, int width, int height) :
+    view(view), x(x), y(y), width(width), height(height) {
+}
+
+RenderPass::RenderPass(int stride, bool first, bool accumulate) :
+    stride(stride), first(first), accumulate(accumulate) {
+}
+
+RenderStats::RenderStats() :
+    hits(0), misses(0) {
+}
+
+void RenderStats::Reset() {
+  hits = 0;
+  misses = 0;
+}
+
+void RenderStats::AtomicAdd(const RenderStats& stats) {
+  __sync_fetch_and_add(&hits, stats.hits);
+  __sync_fetch_and_add(&misses, stats.misses);
+}
+
+RenderCallback::~RenderCallback() {
+}
+
+void RenderCallback::OnProgress(int percent) {
+  std::cout << " " << percent << std::flush;
+}
+
+void RenderCallback::OnPassComplete(const Image&, int, int) {
+}
+
+TileSink::~TileSink() {
+}
+
+// Traces one tile per work item.  Each tile writes a disjoint block of
+// pixels and keeps its own hit / miss counts, so the only shared state
+// touched by the workers is the progress counter; the render metrics, if
+// any, are kept per thread.  Once the deadline, if any, has expired the
+// remaining tiles are skipped.  With a sink, every thread traces into a
+// tile sized scratch framebuffer that is handed to the sink as soon as
+// the tile is done; the tiles after a failed write are skipped.
+class RayTracer::TileTask: public WorkerTask {
+public:
+  TileTask(RayTracer* ray_tracer, const std::vector<const Camera*>& cameras,
+      const std::vector<Framebuffer*>& framebuffers,
+      const std::vector<RenderTile>& tiles, const RenderPass& pass,
+      const timeval* deadline, int num_pixels) :
+      ray_tracer_(ray_tracer), cameras_(cameras), framebuffers_(framebuffers),
+          tiles_(tiles), pass_(pass), deadline_(deadline), sink_(NULL),
+          scratch_(), num_pixels_(num_pixels), pixels_done_(0),
+          expired_(false), failed_(false) {
+  }
+
+  TileTask(RayTracer* ray_tracer, const std::vector<const Camera*>& cameras,
+      TileSink* sink, const std::vector<RenderTile>& tiles, int num_threads,
+      int num_pixels) :
+      ray_tracer_(ray_tracer), cameras_(cameras), framebuffers_(),
+          tiles_(tiles), pass_(1, true, false), deadline_(NULL), sink_(sink),
+          scratch_(num_threads), num_pixels_(num_pixels), pixels_done_(0),
+          expired_(false), failed_(false) {
+  }
+
+  virtual void Execute(int item, int thread_index) {
+    if (expired_ || failed_
+        || (deadline_ && (expired_ = IsExpired(deadline_))))
+      return;
+    const RenderTile& tile = tiles_[item];
+    RenderMetrics* metrics = ray_tracer_->render_metrics_;
+    int64_t start = (NULL != metrics ? RenderMetrics::GetMicroseconds() : 0);
+    RenderStats stats;
+    if (NULL != sink_) {
+      Framebuffer& framebuffer = scratch_[thread_index];
+      framebuffer.Resize(tile.width, tile.height);
+      ray_tracer_->TraceTile(*cameras_[tile.view], tile, pass_, framebuffer,
+          tile.x, tile.y, thread_index, stats);
+      if (!sink_->WriteTile(tile, framebuffer))
+        failed_ = true;
+    } else {
+      ray_tracer_->TraceTile(*cameras_[tile.view], tile, pass_,
+          *framebuffers_[tile.view], 0, 0, thread_index, stats);
+    }
+    ray_tracer_->stats_.AtomicAdd(stats);
+    if (NULL != metrics)
+      metrics->AddTile(thread_index, tile.width * tile.height, stats.hits,
+          stats.misses, RenderMetrics::GetMicroseconds() - start);
+    int pixels_done = __sync_add_and_fetch(&pixels_done_,
+        tile.width * tile.height);
+    if (num_pixels_ > 0)
+      ray_tracer_->UpdateProgress(pixels_done, num_pixels_);
+  }
+
+  bool expired() const {
+    return expired_;
+  }
+
+  bool failed() const {
+    return failed_;
+  }
+private:
+  RayTracer* ray_tracer_;
+  const std::vector<const Camera*>& cameras_;
+  std::vector<Framebuffer*> framebuffers_;
+  const std::vector<RenderTile>& tiles_;
+  RenderPass pass_;
+  const timeval* deadline_;
+  TileSink* sink_;
+  std::vector<Framebuffer> scratch_;
+  int num_pixels_;
+  volatile int pixels_done_;
+  volatile bool expired_;
+  volatile bool failed_;
+};
 
 RayTracer::RayTracer() :
     scene_(NULL), camera_(NULL), background_color_(glm::vec3(0.0f)),
-        display_progress_(true), display_stats_(true) {
+        display_progress_(true), display_stats_(true),
+        num_threads_(WorkerPool::GetNumProcessors()), tile_size_(16),
+        pixel_order_(kRowMajor), min_samples_(1), max_samples_(1),
+        error_threshold_(0.01f), tone_mapping_(), render_callback_(NULL),
+        heatmap_counter_(TraversalStats::kNodesVisited), heatmap_counts_(NULL),
+        ray_capture_(NULL), render_metrics_(NULL), current_progress_(0),
+        stats_() {
 }
 
 RayTracer::RayTracer(Scene* scene, Camera* camera) :
     scene_(scene), camera_(camera), background_color_(glm::vec3(0.0f)),
-        display_progress_(true), display_stats_(true) {
+        display_progress_(true), display_stats_(true),
+        num_threads_(WorkerPool::GetNumProcessors()), tile_size_(16),
+        pixel_order_(kRowMajor), min_samples_(1), max_samples_(1),
+        error_threshold_(0.01f), tone_mapping_(), render_callback_(NULL),
+        heatmap_counter_(TraversalStats::kNodesVisited), heatmap_counts_(NULL),
+        ray_capture_(NULL), render_metrics_(NULL), current_progress_(0),
+        stats_() {
 }
 
 const glm::vec3& RayTracer::background_color() const {
@@ -33,34 +165,342 @@ void RayTracer::set_background_color(const glm::vec3& background_color) {
 }
 
 void RayTracer::Render(Image& image) {
-  hit_count = 0;
-  miss_count = 0;
+  std::vector<const Camera*> cameras(1, camera_);
+  std::vector<Image*> images(1, &image);
+  RenderViews(cameras, images);
+}
+
+void RayTracer::Render(Image& image, Image& heatmap) {
   int width = camera_->screen_width();
   int height = camera_->screen_height();
-  int img_size = width * height;
-  int count = 0;
-  int progress_increment = 1;
-  int current_progress = 0;
-  for (int i = 0; i < height; ++i) {
-    for (int j = 0; j < width; ++j) {
-      image(i, j) = TraceRay(j, i);
-      ++count;
-      int progress = round(
-          static_cast<float>(count) / static_cast<float>(img_size) * 100.0f);
-      if (display_progress_
-          && progress >= current_progress + progress_increment) {
-        std::cout << " " << progress << std::flush;
-        current_progress = progress;
-      }
+  std::vector<uint32_t> counts(width * height, 0);
+  heatmap_counts_ = &counts[0];
+  Render(image);
+  heatmap_counts_ = NULL;
+  uint32_t max_count = std::max(1u,
+      *std::max_element(counts.begin(), counts.end()));
+  Framebuffer framebuffer(width, height);
+  for (int i = 0; i < height; ++i)
+    for (int j = 0; j < width; ++j)
+      framebuffer.SetPixel(i, j,
+          HeatmapColor(static_cast<float>(counts[i * width + j]) / max_count));
+  framebuffer.Resolve(heatmap, ToneMapping());
+  if (display_stats_)
+    std::cout << "max traversal count = " << max_count << std::endl;
+}
+
+bool RayTracer::Render(TileSink& sink) {
+  return Render(sink,
+      RenderTile(0, 0, 0, camera_->screen_width(), camera_->screen_height()));
+}
+
+bool RayTracer::Render(TileSink& sink, const RenderTile& region) {
+  std::vector<const Camera*> cameras(1, camera_);
+  stats_.Reset();
+  current_progress_ = 0;
+  std::vector<RenderTile> all_tiles;
+  CreateTiles(cameras, all_tiles);
+  std::vector<RenderTile> tiles;
+  int num_pixels = 0;
+  for (uint32_t i = 0; i < all_tiles.size(); ++i) {
+    RenderTile tile = all_tiles[i];
+    int x_end = std::min(tile.x + tile.width, region.x + region.width);
+    int y_end = std::min(tile.y + tile.height, region.y + region.height);
+    tile.x = std::max(tile.x, region.x);
+    tile.y = std::max(tile.y, region.y);
+    tile.width = x_end - tile.x;
+    tile.height = y_end - tile.y;
+    if (tile.width > 0 && tile.height > 0) {
+      tiles.push_back(tile);
+      num_pixels += tile.width * tile.height;
     }
   }
+  TileTask task(this, cameras, &sink, tiles, std::max(num_threads_, 1),
+      num_pixels);
+  WorkerPool pool(num_threads_);
+  StartMetrics(tiles.size(), num_pixels);
+  pool.Run(task, tiles.size());
+  FinishMetrics();
+  if (display_stats_) {
+    std::cout << "\n";
+    std::cout << "hits = " << stats_.hits << " misses = " << stats_.misses
+        << std::endl;
+  }
+  return !task.failed();
+}
+
+RenderTile RayTracer::GetShard(int shard, int num_shards, int width,
+    int height) {
+  int y = static_cast<int64_t>(height) * shard / num_shards;
+  int y_end = static_cast<int64_t>(height) * (shard + 1) / num_shards;
+  return RenderTile(0, 0, y, width, y_end - y);
+}
+
+void RayTracer::Render(const std::vector<Camera*>& cameras,
+    std::vector<Image>& images) {
+  std::vector<const Camera*> views(cameras.begin(), cameras.end());
+  std::vector<Image*> view_images(cameras.size(), NULL);
+  images.resize(cameras.size());
+  for (uint32_t i = 0; i < cameras.size(); ++i)
+    view_images[i] = &images[i];
+  RenderViews(views, view_images);
+}
+
+void RayTracer::RenderSceneCameras(int width, int height,
+    std::vector<Image>& images) {
+  std::vector<int> camera_indices(scene_->cameras().size());
+  for (uint32_t i = 0; i < camera_indices.size(); ++i)
+    camera_indices[i] = i;
+  RenderSceneCameras(camera_indices, width, height, images);
+}
+
+void RayTracer::RenderSceneCameras(const std::vector<int>& camera_indices,
+    int width, int height, std::vector<Image>& images) {
+  // Imported cameras only carry an aspect ratio, so give each one the
+  // requested screen size before rendering.
+  std::vector<Camera> cameras(camera_indices.size());
+  std::vector<Camera*> views(camera_indices.size(), NULL);
+  for (uint32_t i = 0; i < camera_indices.size(); ++i) {
+    cameras[i] = scene_->cameras()[camera_indices[i]];
+    cameras[i].Resize(width, height);
+    views[i] = &cameras[i];
+  }
+  Render(views, images);
+}
+
+void RayTracer::Accumulate(Framebuffer& framebuffer) {
+  std::vector<const Camera*> cameras(1, camera_);
+  std::vector<Framebuffer*> framebuffers(1, &framebuffer);
+  stats_.Reset();
+  current_progress_ = 0;
+  int num_pixels = camera_->screen_width() * camera_->screen_height();
+  if (framebuffer.width() != static_cast<uint32_t>(camera_->screen_width())
+      || framebuffer.height()
+          != static_cast<uint32_t>(camera_->screen_height()))
+    framebuffer.Resize(camera_->screen_width(), camera_->screen_height());
+  std::vector<RenderTile> tiles;
+  CreateTiles(cameras, tiles);
+  StartMetrics(tiles.size(), num_pixels);
+  RunTiles(cameras, framebuffers, tiles, RenderPass(1, true, true), NULL,
+      num_pixels);
+  FinishMetrics();
+}
+
+bool RayTracer::RenderProgressive(Image& image, const timeval& deadline) {
+  std::vector<const Camera*> cameras(1, camera_);
+  if (framebuffers_.empty())
+    framebuffers_.resize(1);
+  Framebuffer& framebuffer = framebuffers_[0];
+  framebuffer.Resize(camera_->screen_width(), camera_->screen_height());
+  std::vector<Framebuffer*> framebuffers(1, &framebuffer);
+  stats_.Reset();
+  std::vector<RenderTile> tiles;
+  CreateTiles(cameras, tiles);
+  int num_passes = 1;
+  for (int stride = kMaxProgressiveStride; stride > 1; stride /= 2)
+    ++num_passes;
+  StartMetrics(num_passes * tiles.size(),
+      num_passes * camera_->screen_width() * camera_->screen_height());
+  int pass = 0;
+  for (int stride = kMaxProgressiveStride; stride >= 1; stride /= 2) {
+    bool finished = RunTiles(cameras, framebuffers, tiles,
+        RenderPass(stride, 0 == pass, false), &deadline, 0);
+    framebuffer.Resolve(image, tone_mapping_);
+    if (!finished)
+      break;
+    ++pass;
+    if (render_callback_)
+      render_callback_->OnPassComplete(image, pass, num_passes);
+  }
+  FinishMetrics();
   if (display_stats_) {
     std::cout << "\n";
-    std::cout << "hits = " << hit_count << " misses = " << miss_count
+    std::cout << "passes = " << pass << "/" << num_passes << " hits = "
+        << stats_.hits << " misses = " << stats_.misses << std::endl;
+  }
+  return pass == num_passes;
+}
+
+void RayTracer::RenderViews(const std::vector<const Camera*>& cameras,
+    const std::vector<Image*>& images) {
+  stats_.Reset();
+  current_progress_ = 0;
+  int num_pixels = 0;
+  if (framebuffers_.size() < cameras.size())
+    framebuffers_.resize(cameras.size());
+  std::vector<Framebuffer*> view_framebuffers(cameras.size(), NULL);
+  for (uint32_t i = 0; i < cameras.size(); ++i) {
+    framebuffers_[i].Resize(cameras[i]->screen_width(),
+        cameras[i]->screen_height());
+    view_framebuffers[i] = &framebuffers_[i];
+    num_pixels += cameras[i]->screen_width() * cameras[i]->screen_height();
+  }
+  std::vector<RenderTile> tiles;
+  CreateTiles(cameras, tiles);
+  StartMetrics(tiles.size(), num_pixels);
+  RunTiles(cameras, view_framebuffers, tiles, RenderPass(1, true, false), NULL,
+      num_pixels);
+  FinishMetrics();
+  for (uint32_t i = 0; i < cameras.size(); ++i)
+    framebuffers_[i].Resolve(*images[i], tone_mapping_);
+  if (display_stats_) {
+    std::cout << "\n";
+    std::cout << "hits = " << stats_.hits << " misses = " << stats_.misses
         << std::endl;
   }
 }
 
+// Returns false if the deadline expired before every tile was traced.
+bool RayTracer::RunTiles(const std::vector<const Camera*>& cameras,
+    const std::vector<Framebuffer*>& framebuffers,
+    const std::vector<RenderTile>& tiles, const RenderPass& pass,
+    const timeval* deadline, int num_pixels) {
+  TileTask task(this, cameras, framebuffers, tiles, pass, deadline,
+      num_pixels);
+  WorkerPool pool(num_threads_);
+  pool.Run(task, tiles.size());
+  return !task.expired();
+}
+
+// Tiles are listed in pixel_order_ per view and the views are interleaved
+// tile by tile, so all views progress together and the geometry touched
+// by neighbouring tiles of the same view stays warm.
+void RayTracer::CreateTiles(const std::vector<const Camera*>& cameras,
+    std::vector<RenderTile>& tiles) const {
+  std::vector<std::vector<RenderTile> > view_tiles(cameras.size());
+  uint32_t max_tiles = 0;
+  for (uint32_t v = 0; v < cameras.size(); ++v) {
+    int width = cameras[v]->screen_width();
+    int height = cameras[v]->screen_height();
+    int tiles_x = (width + tile_size_ - 1) / tile_size_;
+    int tiles_y = (height + tile_size_ - 1) / tile_size_;
+    uint32_t order = GetCurveOrder(std::max(tiles_x, tiles_y));
+    std::vector<std::pair<uint32_t, RenderTile> > keyed_tiles;
+    for (int ty = 0; ty < tiles_y; ++ty)
+      for (int tx = 0; tx < tiles_x; ++tx) {
+        uint32_t key = ty * tiles_x + tx;
+        if (kMorton == pixel_order_)
+          key = MortonEncode2(tx, ty);
+        else if (kHilbert == pixel_order_)
+          key = HilbertEncode2(order, tx, ty);
+        int x = tx * tile_size_;
+        int y = ty * tile_size_;
+        keyed_tiles.push_back(
+            std::make_pair(key,
+                RenderTile(v, x, y, std::min(tile_size_, width - x),
+                    std::min(tile_size_, height - y))));
+      }
+    std::sort(keyed_tiles.begin(), keyed_tiles.end(), CompareTileKeys);
+    for (uint32_t t = 0; t < keyed_tiles.size(); ++t)
+      view_tiles[v].push_back(keyed_tiles[t].second);
+    max_tiles = std::max(max_tiles,
+        static_cast<uint32_t>(view_tiles[v].size()));
+  }
+  tiles.clear();
+  for (uint32_t t = 0; t < max_tiles; ++t)
+    for (uint32_t v = 0; v < cameras.size(); ++v)
+      if (t < view_tiles[v].size())
+        tiles.push_back(view_tiles[v][t]);
+}
+
+// Also gives every render thread its buffer of the ray capture, if any.
+void RayTracer::StartMetrics(int num_tiles, int num_pixels) {
+  int num_threads = std::max(num_threads_, 1);
+  if (NULL != ray_capture_)
+    ray_capture_->Start(num_threads);
+  if (NULL != render_metrics_)
+    render_metrics_->Start(num_tiles, num_pixels, num_threads);
+}
+
+void RayTracer::FinishMetrics() {
+  if (NULL != render_metrics_)
+    render_metrics_->Finish();
+}
+
+bool RayTracer::CompareTileKeys(const std::pair<uint32_t, RenderTile>& a,
+    const std::pair<uint32_t, RenderTile>& b) {
+  return a.first < b.first;
+}
+
+// A pass with a stride s traces the pixels on the s-grid and fills the
+// s x s block below and to the right of each one.  Later passes skip the
+// pixels of the coarser grid, which were traced already, so a sequence of
+// passes with halving strides traces every pixel exactly once.  Blocks of
+// one pass never overlap, so tiles can fill across their boundaries.
+// An accumulating pass instead adds one more sample to every pixel.
+//
+// Pixel (i, j) of the image is pixel (i - origin_y, j - origin_x) of
+// framebuffer, which lets a framebuffer cover just the tile.
+void RayTracer::TraceTile(const Camera& camera, const RenderTile& tile,
+    const RenderPass& pass, Framebuffer& framebuffer, int origin_x,
+    int origin_y, int thread_index, RenderStats& stats) const {
+  int width = origin_x + framebuffer.width();
+  int height = origin_y + framebuffer.height();
+  int stride = pass.stride;
+  // Morton codes cover the enclosing power of two square; codes that
+  // fall outside of the tile are skipped.
+  bool morton = (kRowMajor != pixel_order_);
+  int side = 1 << GetCurveOrder(std::max(tile.width, tile.height));
+  int num_cells = (morton ? side * side : tile.width * tile.height);
+  for (int k = 0; k < num_cells; ++k) {
+    uint32_t dx = k % tile.width;
+    uint32_t dy = k / tile.width;
+    if (morton) {
+      MortonDecode2(k, dx, dy);
+      if (static_cast<int>(dx) >= tile.width
+          || static_cast<int>(dy) >= tile.height)
+        continue;
+    }
+    int i = tile.y + dy;
+    int j = tile.x + dx;
+    if (pass.accumulate) {
+      glm::vec2 offset = SampleOffset(
+          static_cast<int>(framebuffer.GetWeight(i - origin_y, j - origin_x)));
+      framebuffer.AddSample(i - origin_y, j - origin_x,
+          TraceRay(camera.GenerateRay(j + offset[0], i + offset[1]),
+              thread_index, stats));
+      continue;
+    }
+    if (i % stride != 0 || j % stride != 0
+        || (!pass.first && i % (2 * stride) == 0 && j % (2 * stride) == 0))
+      continue;
+    uint32_t count = GetThreadTraversalStats().counts[heatmap_counter_];
+    glm::vec3 color = TraceRay(camera, j, i, thread_index, stats);
+    if (NULL != heatmap_counts_)
+      heatmap_counts_[i * camera.screen_width() + j] =
+          GetThreadTraversalStats().counts[heatmap_counter_] - count;
+    for (int y = i; y < std::min(i + stride, height); ++y)
+      for (int x = j; x < std::min(j + stride, width); ++x)
+        framebuffer.SetPixel(y - origin_y, x - origin_x, color);
+  }
+}
+
+void RayTracer::UpdateProgress(int pixels_done, int num_pixels) {
+  if (!display_progress_ && !render_callback_)
+    return;
+  int progress_increment = 1;
+  int current_progress = current_progress_;
+  int progress = round(
+      static_cast<float>(pixels_done) / static_cast<float>(num_pixels)
+          * 100.0f);
+  // Only the thread that advances the counter reports.
+  if (progress >= current_progress + progress_increment
+      && __sync_bool_compare_and_swap(&current_progress_, current_progress,
+          progress)) {
+    if (render_callback_)
+      render_callback_->OnProgress(progress);
+    else
+      std::cout << " " << progress << std::flush;
+  }
+}
+
+bool RayTracer::IsExpired(const timeval* deadline) {
+  timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec > deadline->tv_sec
+      || (now.tv_sec == deadline->tv_sec && now.tv_usec >= deadline->tv_usec);
+}
+
 float RayTracer::Diffuse(const Isect& isect, const Light& light) const {
   glm::vec3 P = isect.ray(isect.t_hit);
   glm::vec3 L = Light::Direction(light, P); // direction to light source
@@ -99,16 +539,84 @@ glm::vec3 RayTracer::Shade(const Isect& isect) const {
   return color;
 }
 
-glm::vec3 RayTracer::TraceRay(int pixel_x, int pixel_y) const {
+glm::vec3 RayTracer::TraceRay(const Camera& camera, int pixel_x, int pixel_y,
+    int thread_index, RenderStats& stats) const {
   float x = pixel_x;
   float y = pixel_y;
-  Ray ray = camera_->GenerateRay(x, y);
-  //scene_->set_trace(x == 139 && y >= 0 && y <= 30);
-  return TraceRay(ray);
+  if (max_samples_ <= 1) {
+    Ray ray = camera.GenerateRay(x, y);
+    //scene_->set_trace(x == 139 && y >= 0 && y <= 30);
+    return TraceRay(ray, thread_index, stats);
+  }
+  // At least two samples are needed to estimate the variance.
+  int min_samples = std::max(2, std::min(min_samples_, max_samples_));
+  // The squared standard error of the mean is the sample variance / n.
+  float max_squared_error = error_threshold_ * error_threshold_;
+  glm::vec3 mean(0.0f);
+  glm::vec3 m2(0.0f);
+  int n = 0;
+  while (n < max_samples_) {
+    glm::vec2 offset = SampleOffset(n);
+    glm::vec3 color = TraceRay(
+        camera.GenerateRay(x + offset[0], y + offset[1]), thread_index, stats);
+    ++n;
+    // Welford's running mean and sum of squared deviations.
+    glm::vec3 delta = color - mean;
+    mean += delta / static_cast<float>(n);
+    m2 += delta * (color - mean);
+    if (n >= min_samples) {
+      glm::vec3 squared_error = m2 / static_cast<float>(n * (n - 1));
+      if (squared_error[0] <= max_squared_error
+          && squared_error[1] <= max_squared_error
+          && squared_error[2] <= max_squared_error)
+        break;
+    }
+  }
+  return mean;
+}
+
+// Offsets within [-0.5, 0.5)^2 of the pixel.  The first four samples form
+// a rotated grid, which already catches near-horizontal and near-vertical
+// edges; further samples follow the Halton (2, 3) sequence.  The pattern
+// is fixed, so renders are deterministic.
+glm::vec2 RayTracer::SampleOffset(int sample) {
+  static const float kRotatedGrid[4][2] = { { -0.125f, -0.375f }, { 0.375f,
+      -0.125f }, { 0.125f, 0.375f }, { -0.375f, 0.125f } };
+  if (sample < 4)
+    return glm::vec2(kRotatedGrid[sample][0], kRotatedGrid[sample][1]);
+  return glm::vec2(RadicalInverse(2, sample) - 0.5f,
+      RadicalInverse(3, sample) - 0.5f);
 }
 
-glm::vec3 RayTracer::TraceRay(const Ray& ray) const {
+float RayTracer::RadicalInverse(int base, int index) {
+  float inverse_base = 1.0f / base;
+  float digit_weight = inverse_base;
+  float result = 0.0f;
+  while (index > 0) {
+    result += (index % base) * digit_weight;
+    index /= base;
+    digit_weight *= inverse_base;
+  }
+  return result;
+}
+
+// Blue, cyan, green, yellow, red for t from 0 to 1.
+glm::vec3 RayTracer::HeatmapColor(float t) {
+  static const float kRamp[5][3] = { { 0.0f, 0.0f, 1.0f },
+      { 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }, {
+          1.0f, 0.0f, 0.0f } };
+  float x = glm::clamp(t, 0.0f, 1.0f) * 4.0f;
+  int k = std::min(static_cast<int>(x), 3);
+  float f = x - k;
+  return (1.0f - f) * glm::vec3(kRamp[k][0], kRamp[k][1], kRamp[k][2])
+      + f * glm::vec3(kRamp[k + 1][0], kRamp[k + 1][1], kRamp[k + 1][2]);
+}
+
+glm::vec3 RayTracer::TraceRay(const Ray& ray, int thread_index,
+    RenderStats& stats) const {
   glm::vec3 color = background_color_;
+  if (ray_capture_)
+    ray_capture_->Record(thread_index, ray, CapturedRay::kPrimary);
   Isect isect;
   bool hit = scene_->Intersect(ray, isect);
   if (hit) {
@@ -116,10 +624,10 @@ glm::vec3 RayTracer::TraceRay(const Ray& ray) const {
     if(scene_->trace()) color = glm::vec3(1.0f, 0.0f, 0.0f);
     //color = 0.5f * (isect.normal + 1.0f);
     //std::cout << "normal = " << isect.normal << std::endl;
-    ++hit_count;
+    ++stats.hits;
   } else
-    ++miss_count;
-  return 255.0f * color;
+    ++stats.misses;
+  return color;
 }
 
 bool RayTracer::display_progress() const {
@@ -138,6 +646,93 @@ void RayTracer::set_display_stats(bool display_stats) {
   display_stats_ = display_stats;
 }
 
+int RayTracer::num_threads() const {
+  return num_threads_;
+}
+
+void RayTracer::set_num_threads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
+int RayTracer::tile_size() const {
+  return tile_size_;
+}
+
+void RayTracer::set_tile_size(int tile_size) {
+  tile_size_ = std::max(1, tile_size);
+}
+
+void RayTracer::set_antialiasing(int min_samples, int max_samples,
+    float error_threshold) {
+  max_samples_ = std::max(1, max_samples);
+  min_samples_ = std::max(1, std::min(min_samples, max_samples_));
+  error_threshold_ = std::max(0.0f, error_threshold);
+}
+
+int RayTracer::min_samples() const {
+  return min_samples_;
+}
+
+int RayTracer::max_samples() const {
+  return max_samples_;
+}
+
+float RayTracer::error_threshold() const {
+  return error_threshold_;
+}
+
+TraversalStats::Counter RayTracer::heatmap_counter() const {
+  return heatmap_counter_;
+}
+
+void RayTracer::set_heatmap_counter(TraversalStats::Counter heatmap_counter) {
+  heatmap_counter_ = heatmap_counter;
+}
+
+RayTracer::PixelOrder RayTracer::pixel_order() const {
+  return pixel_order_;
+}
+
+void RayTracer::set_pixel_order(PixelOrder pixel_order) {
+  pixel_order_ = pixel_order;
+}
+
+const ToneMapping& RayTracer::tone_mapping() const {
+  return tone_mapping_;
+}
+
+void RayTracer::set_tone_mapping(const ToneMapping& tone_mapping) {
+  tone_mapping_ = tone_mapping;
+}
+
+RenderCallback* RayTracer::render_callback() const {
+  return render_callback_;
+}
+
+void RayTracer::set_render_callback(RenderCallback* render_callback) {
+  render_callback_ = render_callback;
+}
+
+RayCapture* RayTracer::ray_capture() const {
+  return ray_capture_;
+}
+
+void RayTracer::set_ray_capture(RayCapture* ray_capture) {
+  ray_capture_ = ray_capture;
+}
+
+RenderMetrics* RayTracer::render_metrics() const {
+  return render_metrics_;
+}
+
+void RayTracer::set_render_metrics(RenderMetrics* render_metrics) {
+  render_metrics_ = render_metrics;
+}
+
+const RenderStats& RayTracer::stats() const {
+  return stats_;
+}
+
 void RayTracer::set_scene(Scene* scene) {
   scene_ = scene;
 }
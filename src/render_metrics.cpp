@@ -0,0 +1,287 @@
+/*
+ * render_metrics.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "render_metrics.hpp"
+namespace ray {
+static const int kCacheLineSize = 64;
+
+MetricsSnapshot::MetricsSnapshot() :
+    running(false), elapsed_seconds(0.0), num_tiles(0), tiles_done(0),
+        num_pixels(0), pixels_done(0), hits(0), misses(0),
+        samples_per_second(0.0), eta_seconds(-1.0), resident_bytes(0),
+        thread_utilization() {
+}
+
+RenderMetrics::RenderMetrics() :
+    threads_(NULL), num_threads_(0), num_tiles_(0), num_pixels_(0),
+        start_microseconds_(0), finish_microseconds_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+RenderMetrics::~RenderMetrics() {
+  free(threads_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+// Each slot starts a cache line of its own, so the render threads never
+// write to the same line.
+void RenderMetrics::Start(int num_tiles, int num_pixels, int num_threads) {
+  num_threads = std::max(num_threads, 1);
+  pthread_mutex_lock(&mutex_);
+  if (num_threads != num_threads_) {
+    free(threads_);
+    void* memory = NULL;
+    if (posix_memalign(&memory, kCacheLineSize,
+        num_threads * sizeof(ThreadCounters)) != 0)
+      memory = NULL;
+    threads_ = static_cast<ThreadCounters*>(memory);
+    num_threads_ = (NULL != threads_ ? num_threads : 0);
+  }
+  if (NULL != threads_)
+    memset(threads_, 0, num_threads_ * sizeof(ThreadCounters));
+  num_tiles_ = num_tiles;
+  num_pixels_ = num_pixels;
+  finish_microseconds_ = 0;
+  start_microseconds_ = GetMicroseconds();
+  pthread_mutex_unlock(&mutex_);
+}
+
+void RenderMetrics::Finish() {
+  finish_microseconds_ = GetMicroseconds();
+}
+
+void RenderMetrics::AddTile(int thread_index, int num_pixels, int64_t hits,
+    int64_t misses, int64_t microseconds) {
+  if (thread_index >= num_threads_)
+    return;
+  ThreadCounters& counters = threads_[thread_index];
+  // The only writer of the slot, so the adds do not contend; they are
+  // atomic for GetSnapshot() reading them meanwhile.
+  __sync_fetch_and_add(&counters.tiles, 1);
+  __sync_fetch_and_add(&counters.pixels, num_pixels);
+  __sync_fetch_and_add(&counters.hits, hits);
+  __sync_fetch_and_add(&counters.misses, misses);
+  __sync_fetch_and_add(&counters.busy_microseconds, microseconds);
+}
+
+void RenderMetrics::GetSnapshot(MetricsSnapshot& snapshot) const {
+  pthread_mutex_lock(&mutex_);
+  int64_t start = start_microseconds_;
+  int64_t finish = finish_microseconds_;
+  snapshot = MetricsSnapshot();
+  snapshot.running = (start > 0 && 0 == finish);
+  int64_t now = (0 == finish ? GetMicroseconds() : finish);
+  int64_t elapsed = (start > 0 ? std::max<int64_t>(now - start, 1) : 0);
+  snapshot.elapsed_seconds = 1e-6 * elapsed;
+  snapshot.num_tiles = num_tiles_;
+  snapshot.num_pixels = num_pixels_;
+  snapshot.thread_utilization.resize(num_threads_, 0.0);
+  // Adding 0 reads a slot atomically while its thread may add to it.
+  for (int i = 0; i < num_threads_; ++i) {
+    ThreadCounters& counters = threads_[i];
+    snapshot.tiles_done += __sync_fetch_and_add(&counters.tiles, 0);
+    snapshot.pixels_done += __sync_fetch_and_add(&counters.pixels, 0);
+    snapshot.hits += __sync_fetch_and_add(&counters.hits, 0);
+    snapshot.misses += __sync_fetch_and_add(&counters.misses, 0);
+    int64_t busy = __sync_fetch_and_add(&counters.busy_microseconds, 0);
+    if (elapsed > 0)
+      snapshot.thread_utilization[i] = std::min(1.0,
+          static_cast<double>(busy) / elapsed);
+  }
+  pthread_mutex_unlock(&mutex_);
+  if (elapsed > 0)
+    snapshot.samples_per_second = (snapshot.hits + snapshot.misses)
+        / snapshot.elapsed_seconds;
+  if (!snapshot.running && start > 0)
+    snapshot.eta_seconds = 0.0;
+  else if (snapshot.pixels_done > 0)
+    snapshot.eta_seconds = snapshot.elapsed_seconds
+        * std::max<int64_t>(snapshot.num_pixels - snapshot.pixels_done, 0)
+        / snapshot.pixels_done;
+  snapshot.resident_bytes = GetResidentBytes();
+}
+
+int64_t RenderMetrics::GetMicroseconds() {
+  timeval now;
+  gettimeofday(&now, NULL);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_usec;
+}
+
+// The second field of /proc/self/statm is the resident set in pages.
+int64_t RenderMetrics::GetResidentBytes() {
+  std::ifstream in("/proc/self/statm");
+  int64_t size = 0;
+  int64_t resident = 0;
+  if (!(in >> size >> resident))
+    return 0;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+void WriteJson(std::ostream& out, const MetricsSnapshot& snapshot) {
+  out << "{\"running\": " << (snapshot.running ? "true" : "false")
+      << ", \"elapsed_seconds\": " << snapshot.elapsed_seconds
+      << ", \"tiles\": " << snapshot.num_tiles << ", \"tiles_done\": "
+      << snapshot.tiles_done << ", \"pixels\": " << snapshot.num_pixels
+      << ", \"pixels_done\": " << snapshot.pixels_done << ", \"hits\": "
+      << snapshot.hits << ", \"misses\": " << snapshot.misses
+      << ", \"samples_per_second\": " << snapshot.samples_per_second
+      << ", \"eta_seconds\": " << snapshot.eta_seconds
+      << ", \"resident_bytes\": " << snapshot.resident_bytes
+      << ", \"thread_utilization\": [";
+  for (size_t i = 0; i < snapshot.thread_utilization.size(); ++i)
+    out << (i > 0 ? ", " : "") << snapshot.thread_utilization[i];
+  out << "]}\n";
+}
+
+void WritePrometheus(std::ostream& out, const MetricsSnapshot& snapshot) {
+  static const struct {
+    const char* name;
+    const char* help;
+  } kGauges[] = {
+      { "ray_render_running", "1 while a render is running" },
+      { "ray_render_elapsed_seconds", "Time since the render started" },
+      { "ray_render_tiles", "Tiles of the render" },
+      { "ray_render_tiles_done", "Tiles traced" },
+      { "ray_render_pixels", "Pixels of the render" },
+      { "ray_render_pixels_done", "Pixels traced" },
+      { "ray_render_hits", "Pixel samples that hit" },
+      { "ray_render_misses", "Pixel samples that missed" },
+      { "ray_render_samples_per_second", "Pixel samples per second" },
+      { "ray_render_eta_seconds", "Estimated time left" },
+      { "ray_render_resident_bytes", "Resident memory of the process" } };
+  double values[] = { snapshot.running ? 1.0 : 0.0, snapshot.elapsed_seconds,
+      static_cast<double>(snapshot.num_tiles),
+      static_cast<double>(snapshot.tiles_done),
+      static_cast<double>(snapshot.num_pixels),
+      static_cast<double>(snapshot.pixels_done),
+      static_cast<double>(snapshot.hits),
+      static_cast<double>(snapshot.misses), snapshot.samples_per_second,
+      snapshot.eta_seconds, static_cast<double>(snapshot.resident_bytes) };
+  // Counts go out as doubles, with enough digits to stay exact.
+  std::streamsize precision = out.precision(15);
+  for (size_t i = 0; i < sizeof(values) / sizeof(double); ++i)
+    out << "# HELP " << kGauges[i].name << " " << kGauges[i].help << "\n"
+        << "# TYPE " << kGauges[i].name << " gauge\n" << kGauges[i].name << " "
+        << values[i] << "\n";
+  out << "# HELP ray_render_thread_utilization Fraction of the time a render"
+      " thread traced tiles\n"
+      << "# TYPE ray_render_thread_utilization gauge\n";
+  for (size_t i = 0; i < snapshot.thread_utilization.size(); ++i)
+    out << "ray_render_thread_utilization{thread=\"" << i << "\"} "
+        << snapshot.thread_utilization[i] << "\n";
+  out.precision(precision);
+}
+
+MetricsExporter::MetricsExporter(const RenderMetrics& metrics,
+    const std::string& file_name, double interval_seconds) :
+    metrics_(metrics), file_name_(file_name),
+        interval_seconds_(std::max(interval_seconds, 0.01)), stopping_(false),
+        started_(false), thread_() {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&changed_, NULL);
+}
+
+MetricsExporter::~MetricsExporter() {
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&changed_);
+  pthread_mutex_unlock(&mutex_);
+  if (started_)
+    pthread_join(thread_, NULL);
+  pthread_cond_destroy(&changed_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool MetricsExporter::Start(std::string& status) {
+  if (!Write(status))
+    return false;
+  pthread_mutex_lock(&mutex_);
+  stopping_ = false;
+  if (!started_)
+    started_ = (pthread_create(&thread_, NULL, &MetricsExporter::ExporterMain,
+        this) == 0);
+  bool started = started_;
+  pthread_mutex_unlock(&mutex_);
+  if (!started) {
+    status = "Cannot start the metrics thread";
+    return false;
+  }
+  status = "OK";
+  return true;
+}
+
+bool MetricsExporter::Stop(std::string& status) {
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&changed_);
+  pthread_mutex_unlock(&mutex_);
+  if (started_)
+    pthread_join(thread_, NULL);
+  started_ = false;
+  return Write(status);
+}
+
+bool MetricsExporter::Write(std::string& status) const {
+  MetricsSnapshot snapshot;
+  metrics_.GetSnapshot(snapshot);
+  std::string temporary_name = file_name_ + ".tmp";
+  std::ofstream out(temporary_name.c_str(), std::ios::out | std::ios::trunc);
+  size_t length = file_name_.size();
+  if (length >= 5 && file_name_.compare(length - 5, 5, ".prom") == 0)
+    WritePrometheus(out, snapshot);
+  else
+    WriteJson(out, snapshot);
+  out.close();
+  if (!out || rename(temporary_name.c_str(), file_name_.c_str()) != 0) {
+    remove(temporary_name.c_str());
+    status = "Cannot write " + file_name_;
+    return false;
+  }
+  status = "OK";
+  return true;
+}
+
+void* MetricsExporter::ExporterMain(void* arg) {
+  static_cast<MetricsExporter*>(arg)->Run();
+  return NULL;
+}
+
+// A failed write is simply tried again at the next interval.
+void MetricsExporter::Run() {
+  int64_t interval = static_cast<int64_t>(1e6 * interval_seconds_);
+  pthread_mutex_lock(&mutex_);
+  while (!stopping_) {
+    int64_t deadline = RenderMetrics::GetMicroseconds() + interval;
+    timespec timeout;
+    timeout.tv_sec = deadline / 1000000;
+    timeout.tv_nsec = (deadline % 1000000) * 1000;
+    while (!stopping_
+        && pthread_cond_timedwait(&changed_, &mutex_, &timeout) != ETIMEDOUT) {
+    }
+    if (stopping_)
+      break;
+    pthread_mutex_unlock(&mutex_);
+    std::string status;
+    Write(status);
+    pthread_mutex_lock(&mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+} // namespace ray
@@ -77,6 +77,7 @@ void Scene::AddMaterial(const std::string& name, const Material& material) {
 }
 
 void Scene::AddSceneShape(SceneShape* const & shape) {
+  shape->set_trace(trace_);
   scene_shapes_.push_back(shape);
 }
 
@@ -106,7 +107,6 @@ bool Scene::Intersect(const Ray& ray, Isect& isect) {
   Isect best;
   best.t_hit = std::numeric_limits<float>::max();
   for (uint32_t i = 0; i < scene_shapes_.size(); ++i) {
-    scene_shapes_[i]->set_trace(trace_);
     if (scene_shapes_[i]->Intersect(ray, current)
         && current.t_hit < best.t_hit) {
       best = current;
@@ -126,6 +126,8 @@ bool Scene::trace() const {
 
 void Scene::set_trace(bool trace) {
   trace_ = trace;
+  for (uint32_t i = 0; i < scene_shapes_.size(); ++i)
+    scene_shapes_[i]->set_trace(trace);
 }
 
 std::ostream& operator<<(std::ostream& out, const Scene& scene) {
@@ -4,9 +4,19 @@
  *  Created on: Oct 23, 2013
  *      Author: agrippa
  */
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
 #include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "obj_loader.hpp"
 #include "shape.hpp"
 #include "scene_utils.hpp"
+#include "transform.hpp"
 #include "types.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <assimp/Importer.hpp>
@@ -17,10 +27,14 @@
 #include <assimp/LogStream.hpp>
 
 namespace ray {
-SceneLoader::SceneLoader() {
+SceneLoader::SceneLoader() :
+    use_native_obj_(false), use_mesh_cache_(false),
+        compact_meshes_(false), reorder_meshes_(false), page_meshes_(false) {
 }
 
-SceneLoader::SceneLoader(const SceneLoader&) {
+SceneLoader::SceneLoader(const SceneLoader&) :
+    use_native_obj_(false), use_mesh_cache_(false),
+        compact_meshes_(false), reorder_meshes_(false), page_meshes_(false) {
 }
 
 SceneLoader& SceneLoader::GetInstance() {
@@ -35,8 +49,145 @@ SceneLoader& SceneLoader::GetInstance() {
 SceneLoader::~SceneLoader() {
 }
 
+bool SceneLoader::use_native_obj() const {
+  return use_native_obj_;
+}
+
+void SceneLoader::set_use_native_obj(bool use_native_obj) {
+  use_native_obj_ = use_native_obj;
+}
+
+bool SceneLoader::use_mesh_cache() const {
+  return use_mesh_cache_;
+}
+
+void SceneLoader::set_use_mesh_cache(bool use_mesh_cache) {
+  use_mesh_cache_ = use_mesh_cache;
+}
+
+bool SceneLoader::compact_meshes() const {
+  return compact_meshes_;
+}
+
+void SceneLoader::set_compact_meshes(bool compact_meshes) {
+  compact_meshes_ = compact_meshes;
+}
+
+bool SceneLoader::reorder_meshes() const {
+  return reorder_meshes_;
+}
+
+void SceneLoader::set_reorder_meshes(bool reorder_meshes) {
+  reorder_meshes_ = reorder_meshes;
+}
+
+bool SceneLoader::page_meshes() const {
+  return page_meshes_;
+}
+
+void SceneLoader::set_page_meshes(bool page_meshes) {
+  page_meshes_ = page_meshes;
+}
+
+// The Trimeshes among the shapes of scene from first_shape on.
+static std::vector<Trimesh*> GetTrimeshes(const Scene& scene,
+    size_t first_shape) {
+  std::vector<Trimesh*> trimeshes;
+  const std::vector<SceneShape*>& shapes = scene.scene_objects();
+  for (size_t i = first_shape; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    if (NULL != trimesh)
+      trimeshes.push_back(trimesh);
+  }
+  return trimeshes;
+}
+
 bool SceneLoader::LoadScene(const std::string& file_name, Scene& scene,
     std::string& status) {
+  MeshCache::SceneStart start(scene);
+  bool success = false;
+  std::string cache_file = MeshCache::GetCacheFileName(file_name);
+  MappedFile::Access access = (
+      page_meshes_ ? MappedFile::kOnDemand : MappedFile::kPreload);
+  if ((use_mesh_cache_ || page_meshes_)
+      && MeshCache::Load(cache_file, file_name, access, scene, status)) {
+    success = true;
+  } else if (page_meshes_ && ImportPaged(file_name, cache_file, scene)) {
+    success = true;
+    status = "OK";
+  } else if (Import(file_name, scene, NULL, status)) {
+    success = true;
+    // Cached meshes were reordered, if at all, before they were written.
+    std::vector<Trimesh*> trimeshes = GetTrimeshes(scene, start.num_shapes);
+    for (size_t i = 0; i < trimeshes.size() && reorder_meshes_; ++i)
+      trimeshes[i]->ImproveLocality();
+    // A cache that cannot be written only costs the next load its speed.
+    std::string cache_status;
+    if (use_mesh_cache_
+        && !MeshCache::Write(cache_file, file_name, scene, start,
+            cache_status))
+      std::cout << cache_status << std::endl;
+  }
+  if (success && compact_meshes_) {
+    std::vector<Trimesh*> trimeshes = GetTrimeshes(scene, start.num_shapes);
+    for (size_t i = 0; i < trimeshes.size(); ++i)
+      trimeshes[i]->Compact();
+  }
+  return success;
+}
+
+// Reorders the meshes of a paged import on their way into the cache.
+class SceneLoader::PagedSink: public MeshSink {
+public:
+  PagedSink(MeshSink& sink, bool reorder) :
+      sink_(sink), reorder_(reorder) {
+  }
+  virtual bool AddMesh(Trimesh& mesh, std::string& status) {
+    if (reorder_)
+      mesh.ImproveLocality();
+    return sink_.AddMesh(mesh, status);
+  }
+private:
+  MeshSink& sink_;
+  bool reorder_;
+};
+
+// Streams file_name into cache_file, each mesh written and freed as soon
+// as it is imported, and loads the cache into scene with the vertices
+// paged.  Only the cameras, lights and materials are kept in a scratch
+// scene.  Failures are reported on stdout and leave scene untouched, for
+// LoadScene() to fall back on a plain import.
+bool SceneLoader::ImportPaged(const std::string& file_name,
+    const std::string& cache_file, Scene& scene) {
+  Scene imported;
+  std::string status;
+  MeshCache::Writer writer;
+  PagedSink sink(writer, reorder_meshes_);
+  bool success = writer.Open(cache_file, file_name, imported,
+      MeshCache::SceneStart(), status)
+      && Import(file_name, imported, &sink, status) && writer.Close(status);
+  success = success
+      && MeshCache::Load(cache_file, file_name, MappedFile::kOnDemand, scene,
+          status);
+  if (!success)
+    std::cout << status << std::endl;
+  return success;
+}
+
+bool SceneLoader::Import(const std::string& file_name, Scene& scene,
+    MeshSink* sink, std::string& status) {
+  std::string extension = "";
+  size_t dot = file_name.find_last_of('.');
+  if (dot != std::string::npos)
+    extension = file_name.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+      ::tolower);
+  if (use_native_obj_ && "obj" == extension) {
+    ObjLoader loader;
+    if (NULL != sink)
+      return loader.Load(file_name, scene, *sink, status);
+    return loader.Load(file_name, scene, status);
+  }
   Assimp::Importer importer;
   importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE,
       aiPrimitiveType_POINT | aiPrimitiveType_LINE);
@@ -44,7 +195,8 @@ bool SceneLoader::LoadScene(const std::string& file_name, Scene& scene,
       aiProcess_Triangulate | aiProcess_JoinIdenticalVertices
           | aiProcess_FixInfacingNormals | aiProcess_FindDegenerates
           | aiProcess_ValidateDataStructure);
-  // | aiProcess_ImproveCacheLocality
+  // aiProcess_ImproveCacheLocality optimizes for GPU vertex caches;
+  // LoadScene() reorders meshes for ray traversal instead.
   //  | aiProcess_RemoveRedundantMaterials
   //  | aiProcess_FixInfacingNormals | aiProcess_FindDegenerates
   // | aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes);
@@ -65,7 +217,8 @@ bool SceneLoader::LoadScene(const std::string& file_name, Scene& scene,
   }
   std::cout << "mNumMeshes = " << assimp_scene->mNumMeshes << std::endl;
   for (uint32_t i = 0; i < assimp_scene->mNumMeshes; ++i) {
-    ImportMesh(scene, assimp_scene->mMeshes[i]);
+    if (!ImportMesh(scene, assimp_scene->mMeshes[i], sink, status))
+      return false;
   }
   return true;
 }
@@ -141,26 +294,37 @@ void SceneLoader::ImportMaterial(Scene& scene,
   mat.ns = shininess;
   scene.AddMaterial(name, mat);
 }
-void SceneLoader::ImportMesh(Scene& scene, const aiMesh* const mesh) {
+bool SceneLoader::ImportMesh(Scene& scene, const aiMesh* const mesh,
+    MeshSink* sink, std::string& status) {
   Trimesh* trimesh = new Trimesh();
-  for (uint32_t i = 0; i < mesh->mNumVertices; ++i) {
-    aiVector3D v = mesh->mVertices[i];
-    trimesh->AddVertex(glm::vec3(v[0], v[1], v[2]));
-  }
+  // aiVector3D is three floats, just like glm::vec3.
+  std::vector<glm::vec3> vertices(mesh->mNumVertices);
+  if (!vertices.empty())
+    memcpy(static_cast<void*>(&vertices[0]), mesh->mVertices,
+        vertices.size() * sizeof(glm::vec3));
+  trimesh->SetVertices(vertices);
   std::cout << "mNumVertices = " << mesh->mNumVertices << std::endl;
   if (NULL != mesh->mNormals) {
-    for (uint32_t i = 0; i < mesh->mNumVertices; ++i) {
-      aiVector3D n = mesh->mNormals[i];
-      trimesh->AddNormal(glm::vec3(n[0], n[1], n[2]));
-    }
+    std::vector<glm::vec3> normals(mesh->mNumVertices);
+    if (!normals.empty())
+      memcpy(static_cast<void*>(&normals[0]), mesh->mNormals,
+          normals.size() * sizeof(glm::vec3));
+    trimesh->SetNormals(normals);
   }
   std::cout << "mNumFaces = " << mesh->mNumFaces << std::endl;
+  std::vector<int32_t> indices;
+  indices.reserve(3 * mesh->mNumFaces);
   for (uint32_t i = 0; i < mesh->mNumFaces; ++i) {
-    aiFace f = mesh->mFaces[i];
+    const aiFace& f = mesh->mFaces[i];
     if (3 == f.mNumIndices) {
-      trimesh->AddFace(f.mIndices[0], f.mIndices[1], f.mIndices[2]);
+      indices.insert(indices.end(), f.mIndices, f.mIndices + 3);
     }
   }
+  if (!trimesh->SetFaces(indices)) {
+    delete trimesh;
+    status = "Face index out of range";
+    return false;
+  }
   std::cout << "materials.size() = " << scene.material_list().materials.size()
       << std::endl;
   Material* mat = &scene.material_list().materials[mesh->mMaterialIndex];
@@ -168,8 +332,32 @@ void SceneLoader::ImportMesh(Scene& scene, const aiMesh* const mesh) {
   if (NULL == mesh->mNormals) {
     trimesh->GenNormals();
   }
+  if (NULL != sink) {
+    bool success = sink->AddMesh(*trimesh, status);
+    delete trimesh;
+    return success;
+  }
   scene.AddSceneShape(static_cast<SceneShape*>(trimesh));
+  return true;
 }
 
+Camera FrameScene(const Scene& scene, int width, int height) {
+  BoundingBox bounds;
+  const std::vector<SceneShape*>& shapes = scene.scene_objects();
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Trimesh* trimesh = dynamic_cast<Trimesh*>(shapes[i]);
+    if (NULL != trimesh)
+      bounds = bounds.Join(trimesh->GetBounds());
+  }
+  glm::vec3 at = bounds.GetCenter();
+  float radius = std::max(0.5f * glm::length(bounds.max() - bounds.min()),
+      1e-3f);
+  float fovy = 0.785398f;
+  float distance = radius / sinf(0.5f * fovy);
+  glm::vec3 eye = at + glm::vec3(0.0f, 0.0f, distance);
+  return Camera(width, height,
+      Perspective(fovy, static_cast<float>(width) / height, 0.01f * distance,
+          distance + 2.0f * radius),
+      LookAt(eye, at, glm::vec3(0.0f, 1.0f, 0.0f)));
+}
 } // namespace ray
-
@@ -69,8 +69,14 @@ glm::vec3 BoundingBox::GetCenter() const {
 
 // Kay/Kajiya slabs algorithm based off PBRTv2 pp 194-195
 // Need IEEE floating point arithmetic for this to work
+// The far distance of every slab is rounded up by the bound on the error
+// of its computation, as in PBRTv3, so that a ray through an edge or a
+// corner of the box is not lost to rounding.
 bool BoundingBox::Intersect(const Ray& ray, float& t_near, float& t_far) const {
   //std::cout << "BoundingBox::Intersect ray = " << ray <<  std::endl;
+  static const float kEpsilon = 0.5f * std::numeric_limits<float>::epsilon();
+  static const float kRoundUp = 1.0f + 2.0f * 3.0f * kEpsilon
+      / (1.0f - 3.0f * kEpsilon);
   float t_min = -std::numeric_limits<float>::max();
   float t_max = std::numeric_limits<float>::max();
   for (int i = 0; i < 3; ++i) {
@@ -79,6 +85,7 @@ bool BoundingBox::Intersect(const Ray& ray, float& t_near, float& t_far) const {
     float t_b = (max_[i] - ray.origin()[i]) * inv;
     if (t_a > t_b)
       std::swap(t_a, t_b);
+    t_b *= kRoundUp;
     t_min = std::max(t_min, t_a);
     t_max = std::min(t_max, t_b);
     if (t_min > t_max)
@@ -87,7 +94,7 @@ bool BoundingBox::Intersect(const Ray& ray, float& t_near, float& t_far) const {
   t_near = t_min;
   t_far = t_max;
   //std::cout << "t_near = " << t_min << " t_far = " << t_max << std::endl;
-  return t_near < t_far;
+  return t_near <= t_far;
 }
 
 bool BoundingBox::Contains(const glm::vec3& point) const {
@@ -0,0 +1,244 @@
+/*
+ * tile_writer.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "framebuffer.hpp"
+#include "image.hpp"
+#include "raytracer.hpp"
+#include "tile_writer.hpp"
+namespace ray {
+// PPM rows are written straight from the pixels of an Image.
+typedef char PixelSizeCheck[sizeof(ucvec3) == 3 ? 1 : -1];
+
+TileWriter::TileWriter() :
+    fd_(-1), file_name_(), format_(kPPM), width_(0), height_(0),
+        header_size_(0), pixel_size_(0), tone_mapping_(), failed_(false) {
+}
+
+TileWriter::~TileWriter() {
+  std::string status;
+  Close(status);
+}
+
+bool TileWriter::is_open() const {
+  return fd_ >= 0;
+}
+
+const ToneMapping& TileWriter::tone_mapping() const {
+  return tone_mapping_;
+}
+
+void TileWriter::set_tone_mapping(const ToneMapping& tone_mapping) {
+  tone_mapping_ = tone_mapping;
+}
+
+bool TileWriter::Open(const std::string& file_name, int width, int height,
+    std::string& status) {
+  std::string extension = "";
+  size_t dot = file_name.find_last_of('.');
+  if (dot != std::string::npos)
+    extension = file_name.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+      ::tolower);
+  if ("ppm" == extension)
+    return Open(file_name, width, height, kPPM, status);
+  if ("pfm" == extension)
+    return Open(file_name, width, height, kPFM, status);
+  status = "Unsupported tile format: " + file_name;
+  return false;
+}
+
+bool TileWriter::Open(const std::string& file_name, int width, int height,
+    Format format, std::string& status) {
+  Close(status);
+  std::ostringstream header;
+  if (kPFM == format) {
+    // A negative scale marks little endian floats.
+    uint16_t byte_order = 1;
+    bool little_endian = (1 == *reinterpret_cast<uint8_t*>(&byte_order));
+    header << "PF\n" << width << " " << height << "\n"
+        << (little_endian ? "-1.0" : "1.0") << "\n";
+    pixel_size_ = 3 * sizeof(float);
+  } else {
+    header << "P6\n" << width << " " << height << "\n255\n";
+    pixel_size_ = 3;
+  }
+  fd_ = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    status = "Cannot open " + file_name + ": " + strerror(errno);
+    return false;
+  }
+  file_name_ = file_name;
+  format_ = format;
+  width_ = width;
+  height_ = height;
+  header_size_ = header.str().size();
+  failed_ = false;
+  off_t file_size = header_size_
+      + static_cast<off_t>(width) * height * pixel_size_;
+  if (write(fd_, header.str().data(), header_size_)
+      != static_cast<ssize_t>(header_size_)
+      || ftruncate(fd_, file_size) != 0) {
+    status = "Cannot write " + file_name + ": " + strerror(errno);
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  status = "OK";
+  return true;
+}
+
+bool TileWriter::Close(std::string& status) {
+  if (fd_ < 0) {
+    status = "OK";
+    return true;
+  }
+  bool success = (close(fd_) == 0 && !failed_);
+  fd_ = -1;
+  status = (success ? "OK" : "Cannot write " + file_name_);
+  return success;
+}
+
+off_t TileWriter::GetOffset(int row, int x) const {
+  // PFM stores its rows bottom to top.
+  int file_row = (kPFM == format_ ? height_ - 1 - row : row);
+  return header_size_
+      + (static_cast<off_t>(file_row) * width_ + x) * pixel_size_;
+}
+
+bool TileWriter::WriteRow(const void* data, size_t size, int row, int x) {
+  off_t offset = GetOffset(row, x);
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t written = pwrite(fd_, bytes, size, offset);
+    if (written < 0 && EINTR == errno)
+      continue;
+    if (written <= 0)
+      return false;
+    bytes += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+bool TileWriter::WriteTile(const RenderTile& tile,
+    const Framebuffer& framebuffer) {
+  if (fd_ < 0 || failed_ || tile.x < 0 || tile.y < 0
+      || tile.x + tile.width > width_ || tile.y + tile.height > height_)
+    return false;
+  bool success = true;
+  if (kPFM == format_) {
+    std::vector<float> row(3 * tile.width);
+    for (int i = 0; i < tile.height && success; ++i) {
+      for (int j = 0; j < tile.width; ++j) {
+        glm::vec3 color = framebuffer.GetColor(i, j);
+        for (int c = 0; c < 3; ++c)
+          row[3 * j + c] = color[c];
+      }
+      success = WriteRow(&row[0], row.size() * sizeof(float), tile.y + i,
+          tile.x);
+    }
+  } else {
+    Image image;
+    framebuffer.Resolve(image, tone_mapping_);
+    for (int i = 0; i < tile.height && success; ++i)
+      success = WriteRow(&image(i, 0), tile.width * pixel_size_, tile.y + i,
+          tile.x);
+  }
+  if (!success)
+    failed_ = true;
+  return success;
+}
+
+// Parses the three header lines that Open() writes.
+bool TileWriter::ReadHeader(int fd, Format& format, int& width, int& height,
+    size_t& header_size) {
+  char header[64];
+  ssize_t size = pread(fd, header, sizeof(header), 0);
+  int num_lines = 0;
+  header_size = 0;
+  while (static_cast<ssize_t>(header_size) < size && num_lines < 3)
+    if ('\n' == header[header_size++])
+      ++num_lines;
+  if (num_lines < 3)
+    return false;
+  std::istringstream in(std::string(header, header_size));
+  std::string magic;
+  in >> magic >> width >> height;
+  if ("PF" == magic)
+    format = kPFM;
+  else if ("P6" == magic)
+    format = kPPM;
+  else
+    return false;
+  return !in.fail() && width > 0 && height > 0;
+}
+
+bool TileWriter::Merge(const std::vector<std::string>& shard_files,
+    const std::string& file_name, std::string& status) {
+  int num_shards = shard_files.size();
+  std::vector<int> fds(num_shards, -1);
+  Format format = kPPM;
+  int width = 0;
+  int height = 0;
+  bool success = (num_shards > 0);
+  status = (success ? "OK" : "No shards to merge");
+  for (int i = 0; i < num_shards && success; ++i) {
+    fds[i] = open(shard_files[i].c_str(), O_RDONLY);
+    Format shard_format = kPPM;
+    int shard_width = 0;
+    int shard_height = 0;
+    size_t header_size = 0;
+    success = fds[i] >= 0
+        && ReadHeader(fds[i], shard_format, shard_width, shard_height,
+            header_size)
+        && (0 == i
+            || (shard_format == format && shard_width == width
+                && shard_height == height));
+    if (!success) {
+      status = "Not a shard of the same image: " + shard_files[i];
+      break;
+    }
+    format = shard_format;
+    width = shard_width;
+    height = shard_height;
+  }
+  TileWriter writer;
+  success = success && writer.Open(file_name, width, height, format, status);
+  std::vector<char> row(success ? width * writer.pixel_size_ : 0);
+  for (int i = 0; i < num_shards && success; ++i) {
+    RenderTile shard = RayTracer::GetShard(i, num_shards, width, height);
+    for (int y = shard.y; y < shard.y + shard.height && success; ++y) {
+      success = pread(fds[i], &row[0], row.size(), writer.GetOffset(y, 0))
+          == static_cast<ssize_t>(row.size())
+          && writer.WriteRow(&row[0], row.size(), y, 0);
+      if (!success)
+        status = "Cannot merge " + shard_files[i] + " into " + file_name;
+    }
+  }
+  for (int i = 0; i < num_shards; ++i)
+    if (fds[i] >= 0)
+      close(fds[i]);
+  std::string close_status;
+  if (!writer.Close(close_status) && success) {
+    success = false;
+    status = close_status;
+  }
+  return success;
+}
+} // namespace ray
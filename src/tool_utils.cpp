@@ -0,0 +1,70 @@
+/*
+ * tool_utils.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <sys/time.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "parse_utils.hpp"
+#include "tool_utils.hpp"
+namespace ray {
+static const char* usage_string = "";
+
+double GetSeconds() {
+  timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + 1e-6 * now.tv_usec;
+}
+
+void SetUsage(const char* usage) {
+  usage_string = usage;
+}
+
+void Die(const std::string& message) {
+  std::cerr << message << "\n" << usage_string;
+  exit(-1);
+}
+
+int ParsePositive(const char* str) {
+  int value = 0;
+  if (!ParseInt(str, &value) || value <= 0)
+    Die(std::string("Invalid number: ") + str);
+  return value;
+}
+
+double ParseNumber(const char* str, double min, double max) {
+  char* end = NULL;
+  double value = strtod(str, &end);
+  if (end == str || *end != '\0' || value < min || value > max)
+    Die(std::string("Invalid number: ") + str);
+  return value;
+}
+
+CoutSilencer::CoutSilencer() :
+    null_stream_("/dev/null"), format_(NULL), buffer_(std::cout.rdbuf()),
+        muted_(false) {
+  format_.copyfmt(std::cout);
+}
+
+CoutSilencer::~CoutSilencer() {
+  Restore();
+}
+
+void CoutSilencer::Mute() {
+  std::cout.rdbuf(null_stream_.rdbuf());
+  muted_ = true;
+}
+
+void CoutSilencer::Restore() {
+  if (!muted_)
+    return;
+  std::cout.rdbuf(buffer_);
+  std::cout.copyfmt(format_);
+  muted_ = false;
+}
+} // namespace ray
@@ -0,0 +1,165 @@
+/*
+ * tree_stats.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tree_stats.hpp"
+namespace ray {
+static float GetMean(double sum, uint32_t n) {
+  return (n > 0 ? sum / n : 0.0f);
+}
+
+static float GetStdev(double sum, double sum_squared, uint32_t n) {
+  if (0 == n)
+    return 0.0f;
+  double mean = sum / n;
+  // Rounding can take the variance of equal values slightly below 0.
+  return sqrt(std::max(0.0, sum_squared / n - mean * mean));
+}
+
+TreeLevelStats::TreeLevelStats() :
+    num_internal_nodes(0), num_leaves(0), sum_objects(0.0),
+        sum_objects_squared(0.0), sum_children(0.0), sum_children_squared(0.0) {
+}
+
+float TreeLevelStats::GetMeanObjects() const {
+  return GetMean(sum_objects, num_internal_nodes + num_leaves);
+}
+
+float TreeLevelStats::GetStdevObjects() const {
+  return GetStdev(sum_objects, sum_objects_squared,
+      num_internal_nodes + num_leaves);
+}
+
+float TreeLevelStats::GetMeanChildren() const {
+  return GetMean(sum_children, num_internal_nodes);
+}
+
+float TreeLevelStats::GetStdevChildren() const {
+  return GetStdev(sum_children, sum_children_squared, num_internal_nodes);
+}
+
+TreeStats::TreeStats() :
+    levels(), leaf_size_histogram(), num_objects(0), num_internal_nodes(0),
+        num_leaves(0), num_empty_leaves(0), num_object_refs(0), sah_cost(0.0f),
+        memory_bytes(0), profile() {
+}
+
+void TreeStats::Reset() {
+  *this = TreeStats();
+}
+
+void TreeStats::AddLeaf(uint32_t depth, uint32_t num_objects,
+    float area_ratio) {
+  if (levels.size() <= depth)
+    levels.resize(depth + 1);
+  TreeLevelStats& level = levels[depth];
+  ++level.num_leaves;
+  level.sum_objects += num_objects;
+  level.sum_objects_squared += static_cast<double>(num_objects) * num_objects;
+  uint32_t bin = GetHistogramBin(num_objects);
+  if (leaf_size_histogram.size() <= bin)
+    leaf_size_histogram.resize(bin + 1, 0);
+  ++leaf_size_histogram[bin];
+  ++num_leaves;
+  num_empty_leaves += (0 == num_objects);
+  num_object_refs += num_objects;
+  sah_cost += area_ratio * num_objects;
+}
+
+void TreeStats::AddInternal(uint32_t depth, uint32_t num_objects,
+    uint32_t num_children, float area_ratio) {
+  if (levels.size() <= depth)
+    levels.resize(depth + 1);
+  TreeLevelStats& level = levels[depth];
+  ++level.num_internal_nodes;
+  level.sum_objects += num_objects;
+  level.sum_objects_squared += static_cast<double>(num_objects) * num_objects;
+  level.sum_children += num_children;
+  level.sum_children_squared += static_cast<double>(num_children)
+      * num_children;
+  ++num_internal_nodes;
+  sah_cost += area_ratio;
+}
+
+float TreeStats::GetDuplicationFactor() const {
+  return (num_objects > 0 ?
+      static_cast<float>(num_object_refs) / num_objects : 0.0f);
+}
+
+float TreeStats::GetEmptyLeafRatio() const {
+  return (num_leaves > 0 ?
+      static_cast<float>(num_empty_leaves) / num_leaves : 0.0f);
+}
+
+uint32_t TreeStats::GetMaxDepth() const {
+  return (levels.empty() ? 0 : levels.size() - 1);
+}
+
+void TreeStats::Print(std::ostream& out) const {
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::setprecision(2) << std::fixed;
+  for (uint32_t i = 0; i < levels.size(); ++i) {
+    const TreeLevelStats& level = levels[i];
+    out << "level = " << i << "  internal: " << level.num_internal_nodes
+        << " num_leaves = " << level.num_leaves << " mean obj: "
+        << level.GetMeanObjects() << " stdev: " << level.GetStdevObjects()
+        << " mean child: " << level.GetMeanChildren() << " stdev: "
+        << level.GetStdevChildren() << "\n";
+  }
+  out << "num internal nodes = " << num_internal_nodes << "\n";
+  out << "num leaves = " << num_leaves << "\n";
+  out << "num object refs = " << num_object_refs << "\n";
+  out << "duplication = " << GetDuplicationFactor() << " empty leaves = "
+      << GetEmptyLeafRatio() << " SAH cost = " << sah_cost << "\n";
+  out.flags(flags);
+  out.precision(precision);
+  if (kProfileBuild)
+    profile.Print(out);
+}
+
+std::string TreeStats::ToJson() const {
+  std::ostringstream out;
+  out << "{\"num_objects\": " << num_objects << ", \"num_internal_nodes\": "
+      << num_internal_nodes << ", \"num_leaves\": " << num_leaves
+      << ", \"num_empty_leaves\": " << num_empty_leaves
+      << ", \"num_object_refs\": " << num_object_refs
+      << ", \"duplication_factor\": " << GetDuplicationFactor()
+      << ", \"empty_leaf_ratio\": " << GetEmptyLeafRatio()
+      << ", \"max_depth\": " << GetMaxDepth() << ", \"sah_cost\": "
+      << sah_cost << ", \"memory_bytes\": " << memory_bytes
+      << ", \"leaf_size_histogram\": [";
+  for (uint32_t i = 0; i < leaf_size_histogram.size(); ++i)
+    out << (i > 0 ? ", " : "") << leaf_size_histogram[i];
+  out << "], \"levels\": [";
+  for (uint32_t i = 0; i < levels.size(); ++i) {
+    const TreeLevelStats& level = levels[i];
+    out << (i > 0 ? ", " : "") << "{\"num_internal_nodes\": "
+        << level.num_internal_nodes << ", \"num_leaves\": "
+        << level.num_leaves << ", \"mean_objects\": "
+        << level.GetMeanObjects() << ", \"stdev_objects\": "
+        << level.GetStdevObjects() << ", \"mean_children\": "
+        << level.GetMeanChildren() << ", \"stdev_children\": "
+        << level.GetStdevChildren() << "}";
+  }
+  out << "], \"profile\": " << profile.ToJson() << "}";
+  return out.str();
+}
+
+uint32_t TreeStats::GetHistogramBin(uint32_t num_objects) {
+  uint32_t bin = 0;
+  for (; num_objects > 0; num_objects >>= 1)
+    ++bin;
+  return bin;
+}
+} // namespace ray
@@ -0,0 +1,83 @@
+/*
+ * worker_pool.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <unistd.h>
+#include <pthread.h>
+#include <vector>
+#include "worker_pool.hpp"
+namespace ray {
+WorkerTask::~WorkerTask() {
+}
+
+WorkerPool::WorkerPool() :
+    num_threads_(GetNumProcessors()), task_(NULL), num_items_(0),
+        next_item_(0) {
+}
+
+WorkerPool::WorkerPool(int num_threads) :
+    num_threads_(num_threads > 0 ? num_threads : 1), task_(NULL),
+        num_items_(0), next_item_(0) {
+}
+
+WorkerPool::~WorkerPool() {
+}
+
+int WorkerPool::num_threads() const {
+  return num_threads_;
+}
+
+void WorkerPool::set_num_threads(int num_threads) {
+  num_threads_ = (num_threads > 0 ? num_threads : 1);
+}
+
+int WorkerPool::GetNumProcessors() {
+  long num_processors = sysconf(_SC_NPROCESSORS_ONLN);
+  return (num_processors > 0 ? static_cast<int>(num_processors) : 1);
+}
+
+void WorkerPool::Run(WorkerTask& task, int num_items) {
+  task_ = &task;
+  num_items_ = num_items;
+  next_item_ = 0;
+  int num_threads = (num_threads_ < num_items ? num_threads_ : num_items);
+  if (num_threads <= 1) {
+    Work(0);
+    task_ = NULL;
+    return;
+  }
+  // The calling thread is worker 0, so only num_threads - 1 threads are
+  // spawned.  If a thread cannot be created, the remaining workers simply
+  // pick up its share of the items.
+  std::vector<pthread_t> threads(num_threads - 1);
+  std::vector<WorkerInfo> infos(num_threads - 1);
+  std::vector<bool> started(num_threads - 1, false);
+  for (int i = 0; i < num_threads - 1; ++i) {
+    infos[i].pool = this;
+    infos[i].thread_index = i + 1;
+    started[i] = (pthread_create(&threads[i], NULL, &WorkerPool::WorkerMain,
+        &infos[i]) == 0);
+  }
+  Work(0);
+  for (int i = 0; i < num_threads - 1; ++i)
+    if (started[i])
+      pthread_join(threads[i], NULL);
+  task_ = NULL;
+}
+
+void* WorkerPool::WorkerMain(void* arg) {
+  WorkerInfo* info = static_cast<WorkerInfo*>(arg);
+  info->pool->Work(info->thread_index);
+  return NULL;
+}
+
+void WorkerPool::Work(int thread_index) {
+  int item = __sync_fetch_and_add(&next_item_, 1);
+  while (item < num_items_) {
+    task_->Execute(item, thread_index);
+    item = __sync_fetch_and_add(&next_item_, 1);
+  }
+}
+} // namespace ray
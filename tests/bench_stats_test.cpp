@@ -0,0 +1,108 @@
+/*
+ * bench_stats_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "bench_stats.hpp"
+#include "parse_utils.hpp"
+
+namespace ray {
+static std::vector<double> MakeRuns(const double* values, int num_values) {
+  return std::vector<double>(values, values + num_values);
+}
+
+TEST(BenchStatsTest, StudentQuantile) {
+  EXPECT_DOUBLE_EQ(12.706, GetStudentQuantile(0.5));
+  EXPECT_DOUBLE_EQ(12.706, GetStudentQuantile(1.0));
+  // Rounded down to the wider interval of the smaller df.
+  EXPECT_DOUBLE_EQ(4.303, GetStudentQuantile(2.9));
+  EXPECT_DOUBLE_EQ(2.042, GetStudentQuantile(30.0));
+  EXPECT_DOUBLE_EQ(2.000, GetStudentQuantile(45.0));
+  EXPECT_DOUBLE_EQ(1.980, GetStudentQuantile(100.0));
+  EXPECT_DOUBLE_EQ(1.960, GetStudentQuantile(1000.0));
+}
+
+TEST(BenchStatsTest, WelchDegreesOfFreedom) {
+  // Equal variances and sizes give the df of the pooled t test.
+  EXPECT_DOUBLE_EQ(8.0, GetWelchDegreesOfFreedom(1.0, 5, 1.0, 5));
+  // (1/3 + 4/10)^2 / ((1/3)^2 / 2 + (4/10)^2 / 9)
+  EXPECT_NEAR(7.3333, GetWelchDegreesOfFreedom(1.0, 3, 4.0, 10), 1e-4);
+}
+
+TEST(BenchStatsTest, ClearRegression) {
+  const double baseline[] = { 100.0, 101.0, 99.0, 100.0 };
+  const double candidate[] = { 80.0, 81.0, 79.0, 80.0 };
+  Comparison comparison = Compare(MakeRuns(baseline, 4),
+      MakeRuns(candidate, 4), true);
+  EXPECT_NEAR(0.8, comparison.speedup, 1e-3);
+  EXPECT_TRUE(comparison.has_interval);
+  EXPECT_LT(comparison.low, comparison.speedup);
+  EXPECT_GT(comparison.high, comparison.speedup);
+  EXPECT_LT(comparison.high, 1.0);
+  EXPECT_TRUE(IsRegression(comparison, 0.05));
+  // Not beyond a threshold of 25%.
+  EXPECT_FALSE(IsRegression(comparison, 0.25));
+  // Times are oriented the other way: the same runs are a speedup.
+  comparison = Compare(MakeRuns(baseline, 4), MakeRuns(candidate, 4), false);
+  EXPECT_NEAR(1.25, comparison.speedup, 1e-3);
+  EXPECT_FALSE(IsRegression(comparison, 0.05));
+}
+
+TEST(BenchStatsTest, NoisyNonRegression) {
+  const double baseline[] = { 100.0, 140.0, 70.0, 110.0 };
+  const double candidate[] = { 90.0, 130.0, 60.0, 100.0 };
+  Comparison comparison = Compare(MakeRuns(baseline, 4),
+      MakeRuns(candidate, 4), true);
+  // Slower by more than the threshold, but within the noise.
+  EXPECT_LT(comparison.speedup, 0.95);
+  EXPECT_TRUE(comparison.has_interval);
+  EXPECT_LT(comparison.low, comparison.speedup);
+  EXPECT_GT(comparison.high, 1.0);
+  EXPECT_FALSE(IsRegression(comparison, 0.05));
+}
+
+TEST(BenchStatsTest, SingleRuns) {
+  const double baseline[] = { 100.0, 100.0 };
+  const double candidate[] = { 90.0, 97.0 };
+  Comparison comparison = Compare(MakeRuns(baseline, 1),
+      MakeRuns(candidate, 1), true);
+  EXPECT_FALSE(comparison.has_interval);
+  EXPECT_DOUBLE_EQ(0.9, comparison.speedup);
+  EXPECT_DOUBLE_EQ(comparison.speedup, comparison.low);
+  EXPECT_DOUBLE_EQ(comparison.speedup, comparison.high);
+  EXPECT_TRUE(IsRegression(comparison, 0.05));
+  comparison = Compare(MakeRuns(baseline, 1), MakeRuns(candidate + 1, 1),
+      true);
+  EXPECT_FALSE(IsRegression(comparison, 0.05));
+  // Two runs against one still give no interval.
+  comparison = Compare(MakeRuns(baseline, 2), MakeRuns(candidate, 1), true);
+  EXPECT_FALSE(comparison.has_interval);
+  // Neither does no noise at all.
+  comparison = Compare(MakeRuns(baseline, 2), MakeRuns(baseline, 2), true);
+  EXPECT_TRUE(comparison.has_interval);
+  EXPECT_DOUBLE_EQ(1.0, comparison.low);
+  EXPECT_DOUBLE_EQ(1.0, comparison.high);
+}
+
+TEST(BenchStatsTest, CaseName) {
+  std::vector<JsonValue> runs;
+  std::string status;
+  ASSERT_TRUE(ParseJson("["
+      "{\"scene\": \"bunny.obj\", \"accelerator\": \"kdtree\","
+      " \"width\": 256, \"height\": 128, \"threads\": 4, \"faces\": 69451},"
+      "{\"scene\": \"bunny.obj\", \"accelerator\": \"kdtree\","
+      " \"width\": 256, \"height\": 128, \"threads\": 8, \"faces\": 69451},"
+      "{\"kernel\": \"intersect_boxes\", \"iterations\": 1024}]",
+      runs, status));
+  ASSERT_EQ(3u, runs[0].elements.size());
+  EXPECT_EQ("bunny.obj kdtree width=256 height=128 threads=4",
+      GetCaseName(runs[0].elements[0]));
+  EXPECT_NE(GetCaseName(runs[0].elements[0]),
+      GetCaseName(runs[0].elements[1]));
+  EXPECT_EQ("intersect_boxes", GetCaseName(runs[0].elements[2]));
+}
+} // namespace ray
@@ -0,0 +1,74 @@
+/*
+ * framebuffer_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+
+#include <cmath>
+#include "gtest/gtest.h"
+#include "framebuffer.hpp"
+#include "image.hpp"
+
+namespace ray {
+TEST(FramebufferTest, AccumulateTest) {
+  Framebuffer framebuffer(3, 2);
+  EXPECT_EQ(3u, framebuffer.width());
+  EXPECT_EQ(2u, framebuffer.height());
+  EXPECT_EQ(0.0f, framebuffer.GetWeight(1, 2));
+  EXPECT_TRUE(glm::vec3(0.0f) == framebuffer.GetColor(1, 2));
+  framebuffer.AddSample(1, 2, glm::vec3(1.0f, 0.0f, 0.5f));
+  framebuffer.AddSample(1, 2, glm::vec3(0.0f, 1.0f, 0.5f), 3.0f);
+  EXPECT_EQ(4.0f, framebuffer.GetWeight(1, 2));
+  glm::vec3 color = framebuffer.GetColor(1, 2);
+  EXPECT_FLOAT_EQ(0.25f, color[0]);
+  EXPECT_FLOAT_EQ(0.75f, color[1]);
+  EXPECT_FLOAT_EQ(0.5f, color[2]);
+  framebuffer.SetPixel(1, 2, glm::vec3(0.125f));
+  EXPECT_EQ(1.0f, framebuffer.GetWeight(1, 2));
+  framebuffer.Clear();
+  EXPECT_EQ(0.0f, framebuffer.GetWeight(1, 2));
+}
+
+TEST(FramebufferTest, ResolveTest) {
+  Framebuffer framebuffer(4, 1);
+  framebuffer.SetPixel(0, 0, glm::vec3(0.0f, 0.5f, 1.0f));
+  framebuffer.SetPixel(0, 1, glm::vec3(-1.0f, 2.0f, 0.3f));
+  framebuffer.AddSample(0, 2, glm::vec3(1.0f), 2.0f);
+  framebuffer.AddSample(0, 2, glm::vec3(0.0f), 2.0f);
+  Image image;
+  framebuffer.Resolve(image, ToneMapping());
+  EXPECT_EQ(4u, image.width());
+  EXPECT_EQ(1u, image.height());
+  // The default matches truncating 255 * color, clamped to a byte.
+  EXPECT_EQ(ucvec3(0, 127, 255), image(0, 0));
+  EXPECT_EQ(ucvec3(0, 255, static_cast<unsigned char>(255.0f * 0.3f)),
+      image(0, 1));
+  EXPECT_EQ(ucvec3(127, 127, 127), image(0, 2));
+  // A pixel without samples is black.
+  EXPECT_EQ(ucvec3(0, 0, 0), image(0, 3));
+
+  framebuffer.Resolve(image,
+      ToneMapping(ToneMapping::kReinhard, 1.0f, 1.0f));
+  EXPECT_EQ(ucvec3(0, 85, 127), image(0, 0));
+  EXPECT_EQ(170, image(0, 1)[1]);
+
+  framebuffer.Resolve(image, ToneMapping(ToneMapping::kClamp, 1.0f, 2.2f));
+  EXPECT_EQ(0, image(0, 0)[0]);
+  EXPECT_NEAR(255.0f * powf(0.5f, 1.0f / 2.2f), image(0, 0)[1], 1.0f);
+  EXPECT_EQ(255, image(0, 0)[2]);
+
+  // Every value, down to the darkest, is within a level of the exact
+  // encoding.
+  Framebuffer ramp(256, 1);
+  for (int j = 0; j < 256; ++j)
+    ramp.SetPixel(0, j, glm::vec3(powf(j / 255.0f, 3.0f)));
+  ramp.Resolve(image, ToneMapping(ToneMapping::kClamp, 1.0f, 2.2f));
+  for (int j = 0; j < 256; ++j)
+    EXPECT_NEAR(255.0f * powf(powf(j / 255.0f, 3.0f), 1.0f / 2.2f),
+        image(0, j)[0], 1.0f) << j;
+
+  framebuffer.Resolve(image, ToneMapping(ToneMapping::kClamp, 2.0f, 1.0f));
+  EXPECT_EQ(ucvec3(0, 255, 255), image(0, 0));
+}
+} // namespace ray
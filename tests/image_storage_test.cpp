@@ -8,10 +8,13 @@
 #include <climits>
 #include <cstdlib>
 #include <cstdio>
+#include <unistd.h>
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 #include "gtest/gtest.h"
+#include "async_image_writer.hpp"
 #include "image.hpp"
 #include "types.hpp"
 namespace ray {
@@ -83,5 +86,50 @@ TEST(ImageStorageTest, ImageReadWrite) {
     }
     EXPECT_LT(error, thresh);
 }
-} // namespace ray
+// Records what it encodes instead of writing files, slowly enough for
+// the queue to fill up.
+class RecordingWriter: public AsyncImageWriter {
+public:
+    RecordingWriter() :
+            AsyncImageWriter(1), file_names(), widths() {
+    }
+    virtual ~RecordingWriter() {
+        std::string status;
+        Flush(status);
+    }
+    std::vector<std::string> file_names;
+    std::vector<uint32_t> widths;
+protected:
+    virtual bool Encode(const std::string& file_name, const Image& image,
+            std::string& status) {
+        usleep(10000);
+        file_names.push_back(file_name);
+        widths.push_back(image.width());
+        status = ("bad.jpg" == file_name ? "Error:bad" : "OK");
+        return "bad.jpg" != file_name;
+    }
+};
 
+TEST(ImageStorageTest, AsyncWriteTest) {
+    RecordingWriter writer;
+    EXPECT_EQ(1, writer.max_queued());
+    std::string status = "";
+    for (int k = 1; k <= 4; ++k) {
+        Image image(k, 2);
+        image(1, k - 1) = ucvec3(k, 0u, 0u);
+        writer.WriteImage(k == 3 ? "bad.jpg" : "frame.jpg", image);
+        // The writer owns the pixels now.
+        EXPECT_EQ(0u, image.width());
+        EXPECT_TRUE(image.pixels().empty());
+    }
+    EXPECT_FALSE(writer.Flush(status));
+    EXPECT_EQ("Error:bad", status);
+    ASSERT_EQ(4u, writer.file_names.size());
+    for (uint32_t k = 0; k < 4; ++k)
+        EXPECT_EQ(k + 1, writer.widths[k]);
+    EXPECT_EQ("bad.jpg", writer.file_names[2]);
+    // Failures are reported once.
+    EXPECT_TRUE(writer.Flush(status));
+    EXPECT_EQ("OK", status);
+}
+} // namespace ray
@@ -6,6 +6,7 @@
  */
 #include <sys/time.h>
 
+#include <algorithm>
 #include <climits>
 #include <cstdlib>
 #include <cstdio>
@@ -24,10 +25,12 @@ using ::testing::ElementsAre;
 #include "mesh.hpp"
 #include "kdnode64.hpp"
 #include "kdtree64.hpp"
+#include "perf_counters.hpp"
 #include "raytracer.hpp"
 #include "scene.hpp"
 #include "scene_utils.hpp"
 #include "transform.hpp"
+#include "tree_stats.hpp"
 
 namespace ray {
 
@@ -217,6 +220,190 @@ TEST(KdtreeTest, LeafNodeEncodeTest) {
   }
 }
 
+TEST(KdtreeTest, TreeStatsTest) {
+  EXPECT_EQ(0u, TreeStats::GetHistogramBin(0));
+  EXPECT_EQ(1u, TreeStats::GetHistogramBin(1));
+  EXPECT_EQ(2u, TreeStats::GetHistogramBin(3));
+  EXPECT_EQ(3u, TreeStats::GetHistogramBin(4));
+  TreeStats level_stats;
+  level_stats.AddInternal(0, 10, 2, 1.0f);
+  level_stats.AddInternal(0, 10, 4, 1.0f);
+  EXPECT_FLOAT_EQ(3.0f, level_stats.levels[0].GetMeanChildren());
+  EXPECT_FLOAT_EQ(1.0f, level_stats.levels[0].GetStdevChildren());
+  EXPECT_FLOAT_EQ(0.0f, level_stats.levels[0].GetStdevObjects());
+
+  Scene scene;
+  std::string status = "";
+  ASSERT_TRUE(
+      SceneLoader::GetInstance().LoadScene("../assets/bunny.obj", scene,
+          status));
+  Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+  for (int i = 0; i < 2; ++i) {
+    TestKdtree kdtree;
+    kdtree.set_split_policy(static_cast<TestKdtree::SplitPolicy>(i));
+    kdtree.set_max_leaf_size(max_leaf_size);
+    kdtree.set_max_depth(max_depth);
+    const TreeStats& stats = kdtree.Build(trimesh->faces());
+    EXPECT_EQ(&kdtree.stats(), &stats);
+    EXPECT_EQ(trimesh->faces().size(), stats.num_objects);
+    EXPECT_GE(static_cast<uint32_t>(max_depth), stats.GetMaxDepth());
+    uint32_t num_internal_nodes = 0, num_leaves = 0, num_binned = 0;
+    for (uint32_t j = 0; j < stats.levels.size(); ++j) {
+      num_internal_nodes += stats.levels[j].num_internal_nodes;
+      num_leaves += stats.levels[j].num_leaves;
+    }
+    for (uint32_t j = 0; j < stats.leaf_size_histogram.size(); ++j)
+      num_binned += stats.leaf_size_histogram[j];
+    EXPECT_EQ(stats.num_internal_nodes, num_internal_nodes);
+    EXPECT_EQ(stats.num_leaves, num_leaves);
+    EXPECT_EQ(stats.num_leaves, num_binned);
+    EXPECT_LE(1.0f, stats.GetDuplicationFactor());
+    EXPECT_LE(0.0f, stats.GetEmptyLeafRatio());
+    EXPECT_GT(1.0f, stats.GetEmptyLeafRatio());
+    EXPECT_LT(0.0f, stats.sah_cost);
+    // Both trees are much cheaper than testing every triangle.
+    EXPECT_GT(0.1f * stats.num_objects, stats.sah_cost);
+    EXPECT_EQ(kdtree.GetMemoryUsage(), stats.memory_bytes);
+    std::string json = stats.ToJson();
+    EXPECT_EQ('{', json[0]);
+    EXPECT_NE(std::string::npos, json.find("\"sah_cost\": "));
+    EXPECT_NE(std::string::npos, json.find("\"levels\": [{"));
+  }
+}
+
+// Exposes the plane sweep of the full SAH policy.
+class SweepKdtree: public TestKdtree {
+public:
+  typedef TestKdtree::Event Event;
+  typedef TestKdtree::EventList EventList;
+  void FindBestPlane(const EventList& events, float& best_cost,
+      float& best_value) const {
+    PlanarSplitSide side = kPlanarLeft;
+    // Unit extents in the other dimensions, 0 to 5 in this one.
+    FindBestPlaneInList(events, 1.0f, 1.0f, 0.0f, 5.0f, 3, 22.0f, best_cost,
+        best_value, side);
+  }
+};
+
+TEST(KdtreeTest, FullSahSweepTest) {
+  // Objects over [0, 1], [2, 3] and [4, 5].  Splitting off the middle one
+  // at 2 or 3 is cheapest, with one object on one side and two on the
+  // other: 1 + (10 * 1 + 14 * 2) / 22.
+  TrimeshFace objects[3];
+  SweepKdtree::EventList events;
+  for (int i = 0; i < 3; ++i) {
+    events.push_back(SweepKdtree::Event(2.0f * i,
+        SweepKdtree::Event::kStart, &objects[i]));
+    events.push_back(SweepKdtree::Event(2.0f * i + 1.0f,
+        SweepKdtree::Event::kEnd, &objects[i]));
+  }
+  std::sort(events.begin(), events.end());
+  SweepKdtree kdtree;
+  float best_cost = 0.0f, best_value = 0.0f;
+  kdtree.FindBestPlane(events, best_cost, best_value);
+  EXPECT_FLOAT_EQ(1.0f + 38.0f / 22.0f, best_cost);
+  EXPECT_EQ(2.0f, best_value);
+}
+
+TEST(KdtreeTest, FullSahSplitTest) {
+  // The triangles of the sphere share their edges, so most splits touch
+  // some of them.  Those go to one side, as the sweep counted them; sent
+  // to both they would be copied at every level down to the maximum depth.
+  Scene scene;
+  std::string status = "";
+  ASSERT_TRUE(
+      SceneLoader::GetInstance().LoadScene("../assets/sphere.obj", scene,
+          status));
+  Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+  TestKdtree kdtree;
+  kdtree.set_split_policy(TestKdtree::kFullSAH);
+  kdtree.set_max_leaf_size(max_leaf_size);
+  kdtree.set_max_depth(max_depth);
+  TreeStats stats = kdtree.Build(trimesh->faces());
+  EXPECT_GT(2u * trimesh->num_faces(), stats.num_object_refs);
+  EXPECT_GT(static_cast<float>(trimesh->num_faces()), stats.sah_cost);
+}
+
+TEST(KdtreeTest, FullSahTraverseTest) {
+  // A ray through an edge of a split plane enters both children at the
+  // same t and may hit farther in the first; the nearer hit in the second
+  // must still be found.  Rays in random directions through the vertices
+  // and the midpoints of the edges of the sphere, against the mesh without
+  // a tree.  Exactly at an edge either may miss, so only hits count.
+  Scene scene;
+  std::string status = "";
+  ASSERT_TRUE(
+      SceneLoader::GetInstance().LoadScene("../assets/sphere.obj", scene,
+          status));
+  Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+  TestKdtree kdtree;
+  kdtree.set_split_policy(TestKdtree::kFullSAH);
+  kdtree.set_max_leaf_size(max_leaf_size);
+  kdtree.set_max_depth(max_depth);
+  kdtree.Build(trimesh->faces());
+  const std::vector<TrimeshFace>& faces = trimesh->faces();
+  uint32_t state = 1;
+  int num_hits = 0;
+  int num_farther = 0;
+  for (size_t i = 0; i < faces.size(); ++i) {
+    for (int j = 0; j < 6; ++j) {
+      glm::vec3 a = trimesh->GetVertex(faces[i][j / 2]);
+      glm::vec3 b = trimesh->GetVertex(faces[i][(j / 2 + 1) % 3]);
+      glm::vec3 point = (j % 2 == 0 ? a : 0.5f * (a + b));
+      for (int k = 0; k < 16; ++k) {
+        glm::vec3 direction;
+        for (int d = 0; d < 3; ++d) {
+          state = state * 1664525u + 1013904223u;
+          direction[d] = (state >> 8) / 8388608.0f - 1.0f;
+        }
+        if (glm::length(direction) == 0.0f)
+          continue;
+        direction = glm::normalize(direction);
+        Ray ray(point - 3.0f * direction, direction);
+        Isect expected, actual;
+        if (!trimesh->IntersectUnaccelerated(ray, expected)
+            || !kdtree.Intersect(ray, actual))
+          continue;
+        ++num_hits;
+        num_farther += (actual.t_hit > expected.t_hit + 1e-4f);
+      }
+    }
+  }
+  EXPECT_LT(0, num_hits);
+  EXPECT_EQ(0, num_farther);
+}
+
+TEST(KdtreeTest, BuildProfileTest) {
+  ASSERT_TRUE(kProfileBuild);
+  Scene scene;
+  std::string status = "";
+  ASSERT_TRUE(
+      SceneLoader::GetInstance().LoadScene("../assets/sphere.obj", scene,
+          status));
+  Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+  TestKdtree kdtree;
+  kdtree.set_split_policy(TestKdtree::kFullSAH);
+  kdtree.set_max_leaf_size(max_leaf_size);
+  kdtree.set_max_depth(max_depth);
+  const BuildProfile& profile = kdtree.Build(trimesh->faces()).profile;
+  EXPECT_EQ(1u, profile.calls[BuildProfile::kBounds]);
+  EXPECT_EQ(1u, profile.calls[BuildProfile::kCreateEvents]);
+  EXPECT_LT(0u, profile.calls[BuildProfile::kFindBestPlane]);
+  EXPECT_LT(0u, profile.calls[BuildProfile::kDistributeEvents]);
+  EXPECT_LT(0u, profile.calls[BuildProfile::kDistributeObjects]);
+  // Nodes are encoded when pushed and again once their children are known.
+  EXPECT_EQ(2 * (kdtree.stats().num_internal_nodes + kdtree.stats().num_leaves),
+      profile.calls[BuildProfile::kEncodeNode]);
+  EXPECT_EQ(0u, profile.calls[BuildProfile::kEvaluateBinnedCost]);
+  EXPECT_LE(0.0, profile.seconds[BuildProfile::kCreateEvents]);
+  EXPECT_NE(std::string::npos,
+      kdtree.stats().ToJson().find("\"profile\": {\"bounds\": "));
+  // A second build starts from a fresh profile.
+  kdtree.Build(trimesh->faces());
+  EXPECT_EQ(1u, profile.calls[BuildProfile::kCreateEvents]);
+  profile.Print(std::cout);
+}
+
 TEST(RayTracerTest, SphereMeshTest) {
   std::string path = "../assets/sphere.obj";
   std::string output = "sphere_kdtree.bmp";
@@ -497,6 +684,53 @@ TEST(RayTracerTest, FairyForestMeshTest) {
   SetupAndRun(path, output, &lights[0], num_lights, eye, at, up, auto_camera);
 }
 
+// Renders the dragon in every pixel order and reports the rate of primary
+// rays and the cache hit rates, if the machine exposes its counters.
+TEST(RayTracerTest, DragonPixelOrderTest) {
+  std::string path = "../assets/dragon.obj";
+  glm::vec3 eye, at, up;
+  Light light;
+  light.kd = glm::vec3(0.8f, 0.8f, 0.8f);
+  light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  light.type = Light::kDirectional;
+
+  Scene scene;
+  Camera camera;
+  LoadScene(path, scene, camera, &light, 1, eye, at, up, true);
+  RayTracer ray_tracer;
+  TestKdtree kdtree;
+  SetupRayTracer(ray_tracer, scene, camera, kdtree);
+  ray_tracer.set_display_progress(false);
+  ray_tracer.set_display_stats(false);
+
+  static const char* kOrderNames[RayTracer::kNumPixelOrders] = { "row-major",
+      "morton", "hilbert" };
+  PerfCounters counters;
+  Image reference;
+  for (int order = 0; order < RayTracer::kNumPixelOrders; ++order) {
+    ray_tracer.set_pixel_order(static_cast<RayTracer::PixelOrder>(order));
+    Image image;
+    timeval t_start, t_finish;
+    gettimeofday(&t_start, NULL);
+    counters.Start();
+    ray_tracer.Render(image);
+    counters.Stop();
+    gettimeofday(&t_finish, NULL);
+    float sec = t_finish.tv_sec - t_start.tv_sec
+        + t_finish.tv_usec / 1000000.0f - t_start.tv_usec / 1000000.0f;
+    int64_t num_rays = ray_tracer.stats().hits + ray_tracer.stats().misses;
+    std::cout << kOrderNames[order] << ": time = " << sec << " rays/sec = "
+        << num_rays / sec << " l1d hit rate = " << counters.L1DHitRate()
+        << " llc hit rate = " << counters.LLCHitRate() << std::endl;
+    counters.Print(std::cout);
+    std::cout << std::endl;
+    if (0 == order)
+      reference = image;
+    else
+      EXPECT_TRUE(reference.pixels() == image.pixels());
+  }
+}
+
 /**
 TEST(RayTracerTest, SanMiguelMeshTest) {
   std::string path = "../assets/san_miguel.obj";
@@ -0,0 +1,73 @@
+/*
+ * morton_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+
+#include <cstdlib>
+#include <set>
+#include <vector>
+#include "gtest/gtest.h"
+#include "morton.hpp"
+
+namespace ray {
+TEST(MortonTest, EncodeDecodeTest) {
+  EXPECT_EQ(0u, MortonEncode2(0, 0));
+  EXPECT_EQ(1u, MortonEncode2(1, 0));
+  EXPECT_EQ(2u, MortonEncode2(0, 1));
+  EXPECT_EQ(3u, MortonEncode2(1, 1));
+  EXPECT_EQ(0xffffffffu, MortonEncode2(0xffff, 0xffff));
+  for (uint32_t y = 0; y < 300; y += 7)
+    for (uint32_t x = 0; x < 300; x += 3) {
+      uint32_t dx = 0, dy = 0;
+      MortonDecode2(MortonEncode2(x, y), dx, dy);
+      EXPECT_EQ(x, dx);
+      EXPECT_EQ(y, dy);
+    }
+}
+
+TEST(MortonTest, Encode3Test) {
+  EXPECT_EQ(0u, MortonEncode3(0, 0, 0));
+  EXPECT_EQ(1u, MortonEncode3(1, 0, 0));
+  EXPECT_EQ(2u, MortonEncode3(0, 1, 0));
+  EXPECT_EQ(4u, MortonEncode3(0, 0, 1));
+  EXPECT_EQ(0x3fffffffu, MortonEncode3(1023, 1023, 1023));
+  EXPECT_EQ(MortonEncode3(1023, 0, 0), MortonEncode3(2047, 1024, 0));
+  for (uint32_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(1u << (3 * i), MortonEncode3(1 << i, 0, 0));
+    EXPECT_EQ(1u << (3 * i + 2), MortonEncode3(0, 0, 1 << i));
+  }
+}
+
+TEST(MortonTest, HilbertTest) {
+  // Every cell gets a distinct index and consecutive indices are
+  // neighbouring cells.
+  uint32_t order = 4;
+  uint32_t side = 1 << order;
+  std::vector<uint32_t> xs(side * side), ys(side * side);
+  std::set<uint32_t> codes;
+  for (uint32_t y = 0; y < side; ++y)
+    for (uint32_t x = 0; x < side; ++x) {
+      uint32_t code = HilbertEncode2(order, x, y);
+      ASSERT_LT(code, side * side);
+      codes.insert(code);
+      xs[code] = x;
+      ys[code] = y;
+    }
+  EXPECT_EQ(side * side, codes.size());
+  for (uint32_t i = 1; i < side * side; ++i)
+    EXPECT_EQ(1, abs(static_cast<int>(xs[i]) - static_cast<int>(xs[i - 1]))
+        + abs(static_cast<int>(ys[i]) - static_cast<int>(ys[i - 1])));
+  EXPECT_EQ(0u, HilbertEncode2(order, 0, 0));
+}
+
+TEST(MortonTest, CurveOrderTest) {
+  EXPECT_EQ(0u, GetCurveOrder(0));
+  EXPECT_EQ(0u, GetCurveOrder(1));
+  EXPECT_EQ(1u, GetCurveOrder(2));
+  EXPECT_EQ(2u, GetCurveOrder(3));
+  EXPECT_EQ(4u, GetCurveOrder(16));
+  EXPECT_EQ(5u, GetCurveOrder(17));
+}
+} // namespace ray
@@ -9,6 +9,7 @@
 #include <cstdlib>
 #include <cstdio>
 #include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "parse_utils.hpp"
 
@@ -88,4 +89,71 @@ TEST(ParseIntTest, Overflow) {
     EXPECT_FALSE(result);
 }
 
+TEST(ParseJsonTest, BenchmarkOutput) {
+    std::string text = "[\n {\"scene\": \"bunny.obj\", \"faces\": 69451,"
+            " \"build_seconds\": 1.5e-1, \"ok\": true, \"note\": null},\n"
+            " {\"scene\": \"a\\\"b\\u00e9\", \"list\": [-0.5, {}, []]}\n]\n";
+    std::vector<JsonValue> values;
+    std::string status;
+    EXPECT_TRUE(ParseJson(text, values, status));
+    EXPECT_EQ("OK", status);
+    ASSERT_EQ(1u, values.size());
+    ASSERT_EQ(JsonValue::kArray, values[0].type);
+    ASSERT_EQ(2u, values[0].elements.size());
+    const JsonValue& first = values[0].elements[0];
+    ASSERT_EQ(JsonValue::kObject, first.type);
+    ASSERT_TRUE(NULL != first.Find("scene"));
+    EXPECT_EQ("bunny.obj", first.Find("scene")->string);
+    EXPECT_EQ(69451.0, first.Find("faces")->number);
+    EXPECT_DOUBLE_EQ(0.15, first.Find("build_seconds")->number);
+    EXPECT_TRUE(first.Find("ok")->boolean);
+    EXPECT_EQ(JsonValue::kNull, first.Find("note")->type);
+    EXPECT_TRUE(NULL == first.Find("missing"));
+    const JsonValue& second = values[0].elements[1];
+    EXPECT_EQ("a\"b\xc3\xa9", second.Find("scene")->string);
+    const JsonValue* list = second.Find("list");
+    ASSERT_EQ(3u, list->elements.size());
+    EXPECT_EQ(-0.5, list->elements[0].number);
+    EXPECT_EQ(JsonValue::kObject, list->elements[1].type);
+    EXPECT_EQ(JsonValue::kArray, list->elements[2].type);
+}
+
+TEST(ParseJsonTest, NonAscii) {
+    std::vector<JsonValue> values;
+    std::string status;
+    EXPECT_TRUE(ParseJson("[\"caf\xc3\xa9\"]", values, status));
+    EXPECT_EQ("caf\xc3\xa9", values[0].elements[0].string);
+    EXPECT_FALSE(ParseJson("[\xe9]", values, status));
+    EXPECT_FALSE(ParseJson("[1e\xb9]", values, status));
+    EXPECT_FALSE(ParseJson("\"\\u00\xe9\xe9\"", values, status));
+    int value;
+    EXPECT_FALSE(ParseInt("1\xb9", &value));
+}
+
+TEST(ParseJsonTest, RepeatedRuns) {
+    std::vector<JsonValue> values;
+    std::string status;
+    EXPECT_TRUE(ParseJson("[1]\n[2, 3]\n", values, status));
+    ASSERT_EQ(2u, values.size());
+    EXPECT_EQ(2u, values[1].elements.size());
+    values.clear();
+    EXPECT_TRUE(ParseJson(" \n", values, status));
+    EXPECT_TRUE(values.empty());
+}
+
+TEST(ParseJsonTest, Malformed) {
+    const char* texts[] = { "[1, 2", "{\"a\" 1}", "[01]", "[1.]", "-",
+            "\"abc", "[tru]", "{\"a\": 1,}", "\"\\x\"", "\"\\u12g4\"" };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        std::vector<JsonValue> values;
+        std::string status;
+        EXPECT_FALSE(ParseJson(texts[i], values, status)) << texts[i];
+        EXPECT_NE("OK", status);
+    }
+    std::string deep(1000, '[');
+    std::vector<JsonValue> values;
+    std::string status;
+    EXPECT_FALSE(ParseJson(deep, values, status));
+}
+
 } // namespace ray
@@ -0,0 +1,54 @@
+/*
+ * quantize_test.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agrippa
+ */
+
+#include <cmath>
+#include <limits>
+#include "gtest/gtest.h"
+#include "quantize.hpp"
+#include "types.hpp"
+
+namespace ray {
+TEST(QuantizeTest, HalfTest) {
+  EXPECT_EQ(0x0000, FloatToHalf(0.0f));
+  EXPECT_EQ(0x8000, FloatToHalf(-0.0f));
+  EXPECT_EQ(0x3c00, FloatToHalf(1.0f));
+  EXPECT_EQ(0xc000, FloatToHalf(-2.0f));
+  EXPECT_EQ(0x7bff, FloatToHalf(65504.0f));
+  EXPECT_EQ(0x7c00, FloatToHalf(1.0e6f));
+  EXPECT_EQ(0x0001, FloatToHalf(5.9604645e-8f));
+  EXPECT_TRUE(HalfToFloat(FloatToHalf(std::numeric_limits<float>::quiet_NaN()))
+      != HalfToFloat(FloatToHalf(std::numeric_limits<float>::quiet_NaN())));
+  // Every finite half survives the round trip.
+  for (uint32_t half = 0; half < 0x10000; ++half) {
+    if ((half & 0x7c00) == 0x7c00)
+      continue;
+    ASSERT_EQ(half, FloatToHalf(HalfToFloat(half)));
+  }
+  // Texture coordinates in [0, 1] keep 11 significant bits.
+  for (float u = 0.0f; u <= 1.0f; u += 0.001f)
+    EXPECT_NEAR(u, HalfToFloat(FloatToHalf(u)), u / 2048.0f + 1e-7f);
+}
+
+TEST(QuantizeTest, OctahedralTest) {
+  EXPECT_EQ(glm::vec3(0.0f, 0.0f, 1.0f),
+      DecodeOctahedral(EncodeOctahedral(glm::vec3(0.0f, 0.0f, 1.0f))));
+  EXPECT_EQ(glm::vec3(0.0f, 0.0f, -1.0f),
+      DecodeOctahedral(EncodeOctahedral(glm::vec3(0.0f, 0.0f, -1.0f))));
+  float min_cosine = 1.0f;
+  for (int i = 0; i <= 64; ++i)
+    for (int j = 0; j < 128; ++j) {
+      float theta = M_PI * i / 64.0f;
+      float phi = 2.0f * M_PI * j / 128.0f;
+      glm::vec3 normal(sinf(theta) * cosf(phi), sinf(theta) * sinf(phi),
+          cosf(theta));
+      glm::vec3 decoded = DecodeOctahedral(EncodeOctahedral(normal));
+      EXPECT_NEAR(1.0f, glm::length(decoded), 1e-5f);
+      min_cosine = std::min(min_cosine, glm::dot(normal, decoded));
+    }
+  EXPECT_LT(cosf(0.01f * M_PI / 180.0f) - 1e-6f, min_cosine);
+}
+} // namespace ray
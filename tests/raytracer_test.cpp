@@ -5,24 +5,167 @@
  *      Author: agrippa
  */
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <climits>
 #include <cstdlib>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <string>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
+#include "accelerator_factory.hpp"
 #include "camera.hpp"
+#include "framebuffer.hpp"
 #include "geometry.hpp"
+#include "image_compare.hpp"
+#include "intersection_check.hpp"
 #include "io_utils.hpp"
 #include "light.hpp"
 #include "material.hpp"
+#include "parse_utils.hpp"
+#include "ray_capture.hpp"
 #include "raytracer.hpp"
+#include "render_metrics.hpp"
 #include "scene_utils.hpp"
+#include "tile_writer.hpp"
 #include "transform.hpp"
 namespace ray {
+// Size of the reference images in assets/golden, small enough to keep in
+// the repository.
+static const int kGoldenSize = 128;
+
+// The lights of the sphere, triangle and mesh tests: a red point light at
+// point_light_position and a dim directional light.
+static void AddTestLights(const glm::vec3& point_light_position,
+    Scene& scene) {
+  Light point_light;
+  glm::vec3 point_light_color = glm::vec3(1.0f, 0.3f, 0.3f);
+  point_light.ka = point_light_color;
+  point_light.kd = point_light_color;
+  point_light.ks = point_light_color;
+  point_light.ray = Ray(point_light_position, glm::vec3(0.0f));
+  point_light.type = Light::kPoint;
+  point_light.attenuation_coefficients = glm::vec3(0.25f, 0.003372407f,
+      0.000045492f);
+  Light directional_light;
+  glm::vec3 directional_light_color = glm::vec3(0.2f, 0.2f, 0.2f);
+  directional_light.ka = directional_light_color;
+  directional_light.kd = directional_light_color;
+  directional_light.ks = directional_light_color;
+  directional_light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  directional_light.type = Light::kDirectional;
+  scene.AddLight(point_light);
+  scene.AddLight(directional_light);
+}
+
+// The scene of the rendering tests: a sphere, lit from behind the camera,
+// filling most of the view of an orthographic width by height camera, and
+// a ray tracer of it that prints nothing.
+class SphereScene {
+public:
+  SphereScene(int width, int height) :
+      sphere(glm::vec3(0.0f, 0.0f, 2.0f), 1.0f), shape(&sphere, &material),
+      camera(width, height, Orthographic(0.0f, 1.0f),
+          LookAt(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(0.0f, 0.0f, 2.0f),
+              glm::vec3(0.0f, 1.0f, 0.0f))), ray_tracer(&scene, &camera) {
+    material.kd = glm::vec3(0.4f, 0.8f, 0.2f);
+    scene.AddSceneShape(&shape);
+    Light directional_light;
+    directional_light.kd = glm::vec3(1.0f);
+    directional_light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    directional_light.type = Light::kDirectional;
+    scene.AddLight(directional_light);
+    ray_tracer.set_display_progress(false);
+    ray_tracer.set_display_stats(false);
+  }
+  Scene scene;
+  Sphere sphere;
+  Material material;
+  MaterialShape shape;
+  Camera camera;
+  RayTracer ray_tracer;
+};
+
+// Loads the mesh of assets/sphere.obj into scene, lit by a directional
+// light toward -z, the direction the cameras of its tests look in.
+static void LoadSphereMesh(Scene& scene) {
+  SceneLoader& loader = SceneLoader::GetInstance();
+  std::string status = "";
+  ASSERT_TRUE(loader.LoadScene("../assets/sphere.obj", scene, status))
+      << status;
+  Light directional_light;
+  directional_light.kd = glm::vec3(1.0f);
+  directional_light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+  directional_light.type = Light::kDirectional;
+  scene.AddLight(directional_light);
+}
+
+// Renders scene with camera and compares the image to the reference
+// assets/golden/<name>.ppm.  After a change meant to change the images,
+// run with RAY_UPDATE_GOLDEN set to write new references, and check them;
+// renders with may_update false are compared regardless.
+static void ExpectGoldenImage(const std::string& name, Scene& scene,
+    Camera& camera, bool may_update) {
+  // Rounding differences between the trees, or compilers, flip a few
+  // pixels at silhouettes; anything more is a regression.
+  const ImageBudget budget(40.0, 8, 0.002);
+  Image image;
+  image.Resize(camera.screen_width(), camera.screen_height());
+  RayTracer ray_tracer(&scene, &camera);
+  ray_tracer.set_display_progress(false);
+  ray_tracer.set_display_stats(false);
+  ray_tracer.Render(image);
+  std::string reference = "../assets/golden/" + name + ".ppm";
+  std::string status;
+  if (may_update && NULL != getenv("RAY_UPDATE_GOLDEN")) {
+    EXPECT_TRUE(ImageStorage::GetInstance().WriteImage(reference, image,
+        status)) << status;
+    return;
+  }
+  ImageDifference difference;
+  ASSERT_TRUE(difference.Compare(image, reference, status)) << status;
+  std::cout << name << ": " << difference << std::endl;
+  EXPECT_TRUE(budget.Accepts(difference)) << name << ": " << difference;
+}
+
+// Renders the mesh at path without an accelerator and with each kind of
+// tree, against the same reference, that of the render without an
+// accelerator.
+static void ExpectGoldenMesh(const std::string& name, const std::string& path,
+    const glm::vec3& eye_pos) {
+  SceneLoader& loader = SceneLoader::GetInstance();
+  std::string status = "";
+  Scene scene;
+  bool success = loader.LoadScene(path, scene, status);
+  ASSERT_TRUE(success) << status;
+  EXPECT_EQ("OK", status);
+  AddTestLights(glm::vec3(0.0f, 1.0f, 2.0f), scene);
+  glm::vec3 at_pos = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 up_dir = glm::vec3(0.0f, 1.0f, 0.0f);
+  Camera camera(kGoldenSize, kGoldenSize, Orthographic(0.0f, 1.0f),
+      LookAt(eye_pos, at_pos, up_dir));
+  for (int i = 0; i < AcceleratorFactory::kNumTypes; ++i) {
+    AcceleratorFactory factory;
+    factory.set_type(static_cast<AcceleratorFactory::Type>(i));
+    std::vector<Accelerator*> accelerators;
+    factory.Accelerate(scene, accelerators);
+    ExpectGoldenImage(name, scene, camera,
+        AcceleratorFactory::kNone == factory.type());
+    Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+    trimesh->set_accelerator(NULL);
+    for (size_t j = 0; j < accelerators.size(); ++j)
+      delete accelerators[j];
+  }
+}
+
 TEST(RayTracerTest, SphereTest) {
   Scene scene;
 
@@ -44,44 +187,13 @@ TEST(RayTracerTest, SphereTest) {
   glm::vec3 at_pos = glm::vec3(0.0f, 0.0f, 0.0f);
   glm::vec3 up_dir = glm::vec3(0.0f, 1.0f, 0.0f);
   glm::mat4x4 look_at = LookAt(eye_pos, at_pos, up_dir);
-  std::cout << "look_at = " << look_at << std::endl;
-  std::cout << "transform = " << glm::inverse(look_at) << std::endl;
-  Camera camera(512, 512, Orthographic(0.0f, 1.0f), look_at);
-  std::cout << "direction = "
-      << glm::inverse(look_at) * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f) << std::endl;
-
-  Light point_light;
-  glm::vec3 point_light_color = glm::vec3(1.0f, 0.3f, 0.3f);
-  point_light.ka = point_light_color;
-  point_light.kd = point_light_color;
-  point_light.ks = point_light_color;
-  point_light.ray = Ray(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(0.0f));
-  point_light.type = Light::kPoint;
-  point_light.attenuation_coefficients = glm::vec3(0.25f, 0.003372407f,
-      0.000045492f);
-
-  Light directional_light;
-  glm::vec3 directional_light_color = glm::vec3(0.2f, 0.2f, 0.2f);
-  directional_light.ka = directional_light_color;
-  directional_light.kd = directional_light_color;
-  directional_light.ks = directional_light_color;
-  directional_light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-  directional_light.type = Light::kDirectional;
+  Camera camera(kGoldenSize, kGoldenSize, Orthographic(0.0f, 1.0f), look_at);
 
   MaterialShape sphere_shape(&sphere, &sphere_material);
   scene.AddSceneShape(&sphere_shape);
-  scene.AddLight(point_light);
-  scene.AddLight(directional_light);
+  AddTestLights(glm::vec3(-2.0f, 2.0f, -2.0f), scene);
   scene.AddMaterial("sphere_material", sphere_material);
-
-  Image image;
-  image.Resize(512, 512);
-  RayTracer ray_tracer(&scene, &camera);
-  ray_tracer.Render(image);
-
-  std::string status;
-  ImageStorage& storage = ImageStorage::GetInstance();
-  storage.WriteImage("sphere.jpg", image, status);
+  ExpectGoldenImage("sphere", scene, camera, true);
 }
 TEST(RayTracerTest, TriangleTest) {
   Scene scene;
@@ -108,141 +220,637 @@ TEST(RayTracerTest, TriangleTest) {
   glm::vec3 at_pos = glm::vec3(0.0f, 0.0f, 0.0f);
   glm::vec3 up_dir = glm::vec3(0.0f, 1.0f, 0.0f);
   glm::mat4x4 look_at = LookAt(eye_pos, at_pos, up_dir);
-  Camera camera(512, 512, Orthographic(0.0f, 1.0f), look_at);
-
-  Light point_light;
-  glm::vec3 point_light_color = glm::vec3(1.0f, 0.3f, 0.3f);
-  point_light.ka = point_light_color;
-  point_light.kd = point_light_color;
-  point_light.ks = point_light_color;
-  point_light.ray = Ray(glm::vec3(0.25f, -0.25f, -2.0f), glm::vec3(0.0f));
-  point_light.type = Light::kPoint;
-  point_light.attenuation_coefficients = glm::vec3(0.25f, 0.003372407f,
-      0.000045492f);
-
-  Light directional_light;
-  glm::vec3 directional_light_color = glm::vec3(0.2f, 0.2f, 0.2f);
-  directional_light.ka = directional_light_color;
-  directional_light.kd = directional_light_color;
-  directional_light.ks = directional_light_color;
-  directional_light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-  directional_light.type = Light::kDirectional;
+  Camera camera(kGoldenSize, kGoldenSize, Orthographic(0.0f, 1.0f), look_at);
 
   MaterialShape triangle_shape(&triangle, &triangle_material);
   scene.AddSceneShape(&triangle_shape);
-  scene.AddLight(point_light);
-  scene.AddLight(directional_light);
+  AddTestLights(glm::vec3(0.25f, -0.25f, -2.0f), scene);
   scene.AddMaterial("triangle_material", triangle_material);
-
-  Image image;
-  image.Resize(512, 512);
-  RayTracer ray_tracer(&scene, &camera);
-  ray_tracer.Render(image);
-
-  std::string status;
-  ImageStorage& storage = ImageStorage::GetInstance();
-  storage.WriteImage("triangle.jpg", image, status);
+  ExpectGoldenImage("triangle", scene, camera, true);
 }
 TEST(RayTracerTest, SphereMeshTest) {
-  SceneLoader& loader = SceneLoader::GetInstance();
-  std::string path = "../assets/sphere.obj";
-  std::string status = "";
+  ExpectGoldenMesh("sphere_mesh", "../assets/sphere.obj",
+      glm::vec3(0.0f, 0.1f, 2.0f));
+}
+
+TEST(RayTracerTest, BunnyMeshTest) {
+  ExpectGoldenMesh("bunny", "../assets/bunny.obj",
+      glm::vec3(0.0f, 0.1f, 0.5f));
+}
+
+TEST(RayTracerTest, MultiCameraTest) {
   Scene scene;
-  std::cout << "loading" << std::endl;
-  bool success = loader.LoadScene(path, scene, status);
-  EXPECT_TRUE(success);
-  EXPECT_EQ("OK", status);
-  int image_width = 512;
-  int image_height = 512;
-  glm::vec3 eye_pos = glm::vec3(0.0f, 0.1f, 2.0f);
-  glm::vec3 at_pos = glm::vec3(0.0f, 0.0f, 0.0f);
-  glm::vec3 up_dir = glm::vec3(0.0f, 1.0f, 0.0f);
-  glm::mat4x4 look_at = LookAt(eye_pos, at_pos, up_dir);
-  Camera camera(image_width, image_height, Orthographic(0.0f, 1.0f), look_at);
+  Sphere sphere(glm::vec3(0.0f, 0.0f, 2.0f), 1.0f);
+  Material sphere_material;
+  sphere_material.kd = glm::vec3(0.4f, 0.8f, 0.2f);
+  sphere_material.ks = glm::vec3(1.0f, 1.0f, 0.0f);
+  sphere_material.ns = 64;
+  MaterialShape sphere_shape(&sphere, &sphere_material);
+  scene.AddSceneShape(&sphere_shape);
 
   Light point_light;
-  glm::vec3 point_light_color = glm::vec3(1.0f, 0.3f, 0.3f);
-  point_light.ka = point_light_color;
-  point_light.kd = point_light_color;
-  point_light.ks = point_light_color;
-  point_light.ray = Ray(glm::vec3(0.0, 1.0, 2.0f), glm::vec3(0.0f));
+  point_light.kd = glm::vec3(1.0f, 0.3f, 0.3f);
+  point_light.ks = glm::vec3(1.0f, 0.3f, 0.3f);
+  point_light.ray = Ray(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(0.0f));
   point_light.type = Light::kPoint;
   point_light.attenuation_coefficients = glm::vec3(0.25f, 0.003372407f,
       0.000045492f);
+  scene.AddLight(point_light);
 
-  Light directional_light;
-  glm::vec3 directional_light_color = glm::vec3(0.2f, 0.2f, 0.2f);
-  directional_light.ka = directional_light_color;
-  directional_light.kd = directional_light_color;
-  directional_light.ks = directional_light_color;
-  directional_light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-  directional_light.type = Light::kDirectional;
+  glm::vec3 up_dir = glm::vec3(0.0f, 1.0f, 0.0f);
+  glm::vec3 at_pos = glm::vec3(0.0f, 0.0f, 2.0f);
+  Camera front(160, 120, Orthographic(0.0f, 1.0f),
+      LookAt(glm::vec3(0.0f, 0.0f, -3.0f), at_pos, up_dir));
+  Camera side(100, 130, Orthographic(0.0f, 1.0f),
+      LookAt(glm::vec3(-5.0f, 1.0f, 2.0f), at_pos, up_dir));
+  std::vector<Camera*> cameras;
+  cameras.push_back(&front);
+  cameras.push_back(&side);
+
+  RayTracer ray_tracer(&scene, NULL);
+  ray_tracer.set_display_progress(false);
+  ray_tracer.set_display_stats(false);
+  ray_tracer.set_num_threads(4);
+  ray_tracer.set_tile_size(7);
+  std::vector<Image> images;
+  ray_tracer.Render(cameras, images);
+  ASSERT_EQ(2u, images.size());
+
+  // Each view has to match a plain single-threaded render of that camera.
+  RayTracer reference(&scene, NULL);
+  reference.set_display_progress(false);
+  reference.set_display_stats(false);
+  reference.set_num_threads(1);
+  for (uint32_t i = 0; i < cameras.size(); ++i) {
+    Image image;
+    reference.set_camera(cameras[i]);
+    reference.Render(image);
+    EXPECT_EQ(image.width(), images[i].width());
+    EXPECT_EQ(image.height(), images[i].height());
+    EXPECT_TRUE(image.pixels() == images[i].pixels());
+  }
+}
 
-  scene.AddLight(point_light);
-  scene.AddLight(directional_light);
+class PassCounter: public RenderCallback {
+public:
+  PassCounter() :
+      passes(0), num_passes(0) {
+  }
+  virtual void OnPassComplete(const Image&, int pass, int num_passes) {
+    passes = pass;
+    this->num_passes = num_passes;
+  }
+  int passes;
+  int num_passes;
+};
+
+TEST(RayTracerTest, ProgressiveTest) {
+  SphereScene sphere_scene(75, 50);
+  const Camera& camera = sphere_scene.camera;
+  RayTracer& ray_tracer = sphere_scene.ray_tracer;
+  ray_tracer.set_num_threads(3);
+  ray_tracer.set_tile_size(10);
+  PassCounter counter;
+  ray_tracer.set_render_callback(&counter);
+
+  // With enough time every pixel is traced exactly once.
+  timeval deadline;
+  gettimeofday(&deadline, NULL);
+  deadline.tv_sec += 3600;
+  Image progressive;
+  EXPECT_TRUE(ray_tracer.RenderProgressive(progressive, deadline));
+  EXPECT_EQ(counter.num_passes, counter.passes);
+  EXPECT_EQ(camera.screen_width() * camera.screen_height(),
+      ray_tracer.stats().hits + ray_tracer.stats().misses);
+  Image full;
+  ray_tracer.Render(full);
+  EXPECT_TRUE(full.pixels() == progressive.pixels());
+
+  // An expired deadline leaves no complete pass.
+  counter.passes = 0;
+  gettimeofday(&deadline, NULL);
+  deadline.tv_sec -= 1;
+  EXPECT_FALSE(ray_tracer.RenderProgressive(progressive, deadline));
+  EXPECT_EQ(0, counter.passes);
+}
+
+TEST(RayTracerTest, AdaptiveSamplingTest) {
+  SphereScene sphere_scene(64, 48);
+  const Camera& camera = sphere_scene.camera;
+  int num_pixels = camera.screen_width() * camera.screen_height();
+  RayTracer& ray_tracer = sphere_scene.ray_tracer;
+
+  // A fixed sample count traces exactly that many rays per pixel.
+  Image full;
+  ray_tracer.set_antialiasing(16, 16, 0.0f);
+  ray_tracer.Render(full);
+  EXPECT_EQ(16 * num_pixels,
+      ray_tracer.stats().hits + ray_tracer.stats().misses);
+
+  // Adaptive sampling only refines pixels with contrast, so it stays well
+  // below the full count and close to the fully supersampled image.
+  Image adaptive;
+  ray_tracer.set_antialiasing(4, 16, 0.01f);
+  ray_tracer.Render(adaptive);
+  int64_t num_rays = ray_tracer.stats().hits + ray_tracer.stats().misses;
+  EXPECT_LE(4 * num_pixels, num_rays);
+  EXPECT_GT(8 * num_pixels, num_rays);
+  // The threshold of 0.01 is 2.55 levels of 255; stopping every pixel at
+  // its first four samples instead errs by up to 17 levels.
+  int max_error = 0;
+  int num_large_errors = 0;
+  for (uint32_t i = 0; i < adaptive.height(); ++i)
+    for (uint32_t j = 0; j < adaptive.width(); ++j) {
+      int error = 0;
+      for (int k = 0; k < 3; ++k)
+        error = std::max(error,
+            std::abs(static_cast<int>(adaptive(i, j)[k])
+                - static_cast<int>(full(i, j)[k])));
+      max_error = std::max(max_error, error);
+      num_large_errors += (error > 2);
+    }
+  EXPECT_GE(8, max_error);
+  EXPECT_GE(8, num_large_errors);
+  EXPECT_TRUE(adaptive(0, 0) == full(0, 0));
+}
 
-  //std::cout << "scene:" << scene << std::endl;
+TEST(RayTracerTest, PixelOrderTest) {
+  SphereScene sphere_scene(93, 61);
+  const Camera& camera = sphere_scene.camera;
+  RayTracer& ray_tracer = sphere_scene.ray_tracer;
+  ray_tracer.set_num_threads(2);
+  ray_tracer.set_tile_size(12);
+  Image row_major;
+  ray_tracer.Render(row_major);
+
+  // The order only changes when pixels are traced, never their color.
+  for (int order = RayTracer::kMorton; order < RayTracer::kNumPixelOrders;
+      ++order) {
+    ray_tracer.set_pixel_order(static_cast<RayTracer::PixelOrder>(order));
+    Image image;
+    ray_tracer.Render(image);
+    EXPECT_EQ(camera.screen_width() * camera.screen_height(),
+        ray_tracer.stats().hits + ray_tracer.stats().misses);
+    EXPECT_TRUE(row_major.pixels() == image.pixels());
+  }
+}
 
-  Image image;
-  image.Resize(image_width, image_height);
+TEST(RayTracerTest, AccumulateTest) {
+  SphereScene sphere_scene(40, 30);
+  const Camera& camera = sphere_scene.camera;
+  RayTracer& ray_tracer = sphere_scene.ray_tracer;
+
+  // Accumulating the samples of the fixed pattern one pass at a time gives
+  // the same image as tracing them all at once.
+  int num_samples = 8;
+  Framebuffer framebuffer;
+  for (int k = 0; k < num_samples; ++k)
+    ray_tracer.Accumulate(framebuffer);
+  EXPECT_EQ(static_cast<uint32_t>(camera.screen_width()), framebuffer.width());
+  EXPECT_EQ(static_cast<float>(num_samples), framebuffer.GetWeight(12, 17));
+  Image accumulated;
+  framebuffer.Resolve(accumulated, ray_tracer.tone_mapping());
+
+  Image supersampled;
+  ray_tracer.set_antialiasing(num_samples, num_samples, 0.0f);
+  ray_tracer.Render(supersampled);
+  int max_error = 0;
+  for (uint32_t i = 0; i < accumulated.height(); ++i)
+    for (uint32_t j = 0; j < accumulated.width(); ++j)
+      for (int k = 0; k < 3; ++k)
+        max_error = std::max(max_error,
+            std::abs(static_cast<int>(accumulated(i, j)[k])
+                - static_cast<int>(supersampled(i, j)[k])));
+  EXPECT_GE(1, max_error);
+}
+TEST(RayTracerTest, AcceleratorFactoryTest) {
+  AcceleratorFactory::Type type;
+  EXPECT_TRUE(AcceleratorFactory::ParseType("sah-octree", type));
+  EXPECT_EQ(AcceleratorFactory::kSahOctree, type);
+  EXPECT_FALSE(AcceleratorFactory::ParseType("bvh", type));
+  for (int i = 0; i < AcceleratorFactory::kNumTypes; ++i) {
+    AcceleratorFactory::Type t = static_cast<AcceleratorFactory::Type>(i);
+    EXPECT_TRUE(AcceleratorFactory::ParseType(
+        AcceleratorFactory::GetTypeName(t), type));
+    EXPECT_EQ(t, type);
+  }
+  AcceleratorFactory::KdtreeType::SplitPolicy kdtree_policy;
+  EXPECT_TRUE(AcceleratorFactory::ParseKdtreePolicy("median", kdtree_policy));
+  EXPECT_EQ(AcceleratorFactory::KdtreeType::kSpatialMedian, kdtree_policy);
+  AcceleratorFactory::SahOctreeType::EvaluationPolicy octree_policy;
+  EXPECT_TRUE(AcceleratorFactory::ParseSahOctreePolicy("bounded128",
+      octree_policy));
+  EXPECT_EQ(AcceleratorFactory::SahOctreeType::kBounded128, octree_policy);
+  EXPECT_FALSE(AcceleratorFactory::ParseSahOctreePolicy("sah",
+      octree_policy));
+  // A policy is set only for the type that has it.
+  AcceleratorFactory policy_factory;
+  policy_factory.set_type(AcceleratorFactory::kSahOctree);
+  EXPECT_TRUE(policy_factory.SetPolicy("bounded64"));
+  EXPECT_EQ(AcceleratorFactory::SahOctreeType::kBounded64,
+      policy_factory.sah_octree_policy());
+  EXPECT_FALSE(policy_factory.SetPolicy("sah"));
+  policy_factory.set_type(AcceleratorFactory::kKdtree);
+  EXPECT_TRUE(policy_factory.SetPolicy("sah"));
+  EXPECT_EQ(AcceleratorFactory::KdtreeType::kFullSAH,
+      policy_factory.kdtree_policy());
+  policy_factory.set_type(AcceleratorFactory::kOctree);
+  EXPECT_FALSE(policy_factory.SetPolicy("median"));
+
+  // Every accelerator renders what the plain mesh renders.
+  Scene scene;
+  ASSERT_NO_FATAL_FAILURE(LoadSphereMesh(scene));
+  Camera camera(64, 48, Orthographic(0.0f, 1.0f),
+      LookAt(glm::vec3(0.0f, 0.1f, 2.0f), glm::vec3(0.0f),
+          glm::vec3(0.0f, 1.0f, 0.0f)));
   RayTracer ray_tracer(&scene, &camera);
-  std::cout << "rendering" << std::endl;
-  ray_tracer.Render(image);
-  std::cout << "output image" << std::endl;
-  ImageStorage& storage = ImageStorage::GetInstance();
-  success = storage.WriteImage("sphere_mesh.jpg", image, status);
-  EXPECT_TRUE(success);
-  EXPECT_EQ("OK", status);
-  std::cout << "done" << std::endl;
+  ray_tracer.set_display_progress(false);
+  ray_tracer.set_display_stats(false);
+  Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+  Image reference;
+  ray_tracer.Render(reference);
+  AcceleratorFactory factory;
+  for (int i = AcceleratorFactory::kKdtree; i < AcceleratorFactory::kNumTypes;
+      ++i) {
+    factory.set_type(static_cast<AcceleratorFactory::Type>(i));
+    std::vector<Accelerator*> accelerators;
+    factory.Accelerate(scene, accelerators);
+    ASSERT_EQ(1u, accelerators.size());
+    EXPECT_EQ(accelerators[0], trimesh->accelerator());
+    Image image;
+    ray_tracer.Render(image);
+    trimesh->set_accelerator(NULL);
+    delete accelerators[0];
+    int num_different = 0;
+    for (uint32_t y = 0; y < image.height(); ++y)
+      for (uint32_t x = 0; x < image.width(); ++x)
+        if (image(y, x) != reference(y, x))
+          ++num_different;
+    EXPECT_GE(10, num_different) << AcceleratorFactory::GetTypeName(
+        factory.type());
+  }
+  factory.set_type(AcceleratorFactory::kNone);
+  EXPECT_TRUE(NULL == factory.Create(*trimesh));
 }
+TEST(RayTracerTest, TileWriterTest) {
+  SphereScene sphere_scene(93, 61);
+  RayTracer& ray_tracer = sphere_scene.ray_tracer;
+  ray_tracer.set_num_threads(3);
+  ray_tracer.set_tile_size(12);
+  Image image;
+  ray_tracer.Render(image);
 
-TEST(RayTracerTest, BunnyMeshTest) {
-  SceneLoader& loader = SceneLoader::GetInstance();
-  std::string path = "../assets/bunny.obj";
+  // Tiles arrive out of order; the file must still match the image.
+  ray_tracer.set_pixel_order(RayTracer::kHilbert);
   std::string status = "";
-  Scene scene;
-  std::cout << "loading" << std::endl;
-  bool success = loader.LoadScene(path, scene, status);
-  EXPECT_TRUE(success);
+  TileWriter writer;
+  EXPECT_FALSE(writer.Open("tile_writer_test.png", 93, 61, status));
+  ASSERT_TRUE(writer.Open("tile_writer_test.ppm", 93, 61, status));
+  EXPECT_TRUE(ray_tracer.Render(writer));
+  EXPECT_TRUE(writer.Close(status));
   EXPECT_EQ("OK", status);
-  int image_width = 512;
-  int image_height = 512;
-  glm::vec3 eye_pos = glm::vec3(0.0f, 0.1f, 0.5f);
-  glm::vec3 at_pos = glm::vec3(0.0f, 0.0f, 0.0f);
-  glm::vec3 up_dir = glm::vec3(0.0f, 1.0f, 0.0f);
-  glm::mat4x4 look_at = LookAt(eye_pos, at_pos, up_dir);
-  Camera camera(image_width, image_height, Orthographic(0.0f, 1.0f), look_at);
-
-  Light point_light;
-  glm::vec3 point_light_color = glm::vec3(1.0f, 0.3f, 0.3f);
-  point_light.ka = point_light_color;
-  point_light.kd = point_light_color;
-  point_light.ks = point_light_color;
-  point_light.ray = Ray(glm::vec3(0.0, 1.0, 2.0f), glm::vec3(0.0f));
-  point_light.type = Light::kPoint;
-  point_light.attenuation_coefficients = glm::vec3(0.25f, 0.003372407f,
-      0.000045492f);
+  ASSERT_TRUE(writer.Open("tile_writer_test.pfm", 93, 61, status));
+  EXPECT_TRUE(ray_tracer.Render(writer));
+  EXPECT_TRUE(writer.Close(status));
+
+  std::string ppm_header = "P6\n93 61\n255\n";
+  std::vector<unsigned char> ppm(ppm_header.size() + 3 * 93 * 61 + 1);
+  FILE* file = fopen("tile_writer_test.ppm", "rb");
+  ASSERT_TRUE(file != NULL);
+  EXPECT_EQ(ppm.size() - 1, fread(&ppm[0], 1, ppm.size(), file));
+  fclose(file);
+  std::string pfm_header = "PF\n93 61\n-1.0\n";
+  std::vector<float> pfm(3 * 93 * 61 + 1);
+  file = fopen("tile_writer_test.pfm", "rb");
+  ASSERT_TRUE(file != NULL);
+  std::vector<char> header(pfm_header.size());
+  EXPECT_EQ(header.size(), fread(&header[0], 1, header.size(), file));
+  EXPECT_EQ(pfm_header, std::string(header.begin(), header.end()));
+  EXPECT_EQ(pfm.size() - 1, fread(&pfm[0], sizeof(float), pfm.size(), file));
+  fclose(file);
+  EXPECT_EQ(ppm_header,
+      std::string(ppm.begin(), ppm.begin() + ppm_header.size()));
+  for (uint32_t i = 0; i < image.height(); ++i)
+    for (uint32_t j = 0; j < image.width(); ++j)
+      for (int k = 0; k < 3; ++k) {
+        int value = image(i, j)[k];
+        ASSERT_EQ(value, ppm[ppm_header.size() + 3 * (i * 93 + j) + k]);
+        // PFM rows go bottom to top.
+        float radiance = pfm[3 * ((60 - i) * 93 + j) + k];
+        ASSERT_EQ(value,
+            static_cast<int>(255.0f * std::min(std::max(radiance, 0.0f),
+                1.0f)));
+      }
+  remove("tile_writer_test.ppm");
+  remove("tile_writer_test.pfm");
+}
+static std::string ReadFile(const std::string& file_name) {
+  std::ifstream in(file_name.c_str(), std::ios::in | std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in),
+      std::istreambuf_iterator<char>());
+}
 
-  Light directional_light;
-  glm::vec3 directional_light_color = glm::vec3(0.2f, 0.2f, 0.2f);
-  directional_light.ka = directional_light_color;
-  directional_light.kd = directional_light_color;
-  directional_light.ks = directional_light_color;
-  directional_light.ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-  directional_light.type = Light::kDirectional;
+TEST(RayTracerTest, ShardTest) {
+  SphereScene sphere_scene(75, 53);
+  RayTracer& ray_tracer = sphere_scene.ray_tracer;
+  ray_tracer.set_antialiasing(2, 8, 0.01f);
+  const char* extensions[] = { ".ppm", ".pfm" };
+  for (int e = 0; e < 2; ++e) {
+    std::string status = "";
+    std::string full_file = std::string("shard_test") + extensions[e];
+    TileWriter writer;
+    ASSERT_TRUE(writer.Open(full_file, 75, 53, status));
+    EXPECT_TRUE(ray_tracer.Render(writer));
+    EXPECT_TRUE(writer.Close(status));
+
+    // Each shard is rendered by its own process, with its own tiling.
+    int num_shards = 3;
+    std::vector<std::string> shard_files;
+    std::vector<pid_t> children;
+    for (int i = 0; i < num_shards; ++i) {
+      std::ostringstream shard_file;
+      shard_file << "shard_test_" << i << extensions[e];
+      shard_files.push_back(shard_file.str());
+      pid_t pid = fork();
+      ASSERT_LE(0, pid);
+      if (0 == pid) {
+        ray_tracer.set_tile_size(5 + 4 * i);
+        ray_tracer.set_pixel_order(static_cast<RayTracer::PixelOrder>(i));
+        ray_tracer.set_num_threads(1 + i);
+        TileWriter shard_writer;
+        bool success = shard_writer.Open(shard_files[i], 75, 53, status)
+            && ray_tracer.Render(shard_writer,
+                RayTracer::GetShard(i, num_shards, 75, 53));
+        success = shard_writer.Close(status) && success;
+        _exit(success ? 0 : 1);
+      }
+      children.push_back(pid);
+    }
+    for (int i = 0; i < num_shards; ++i) {
+      int child_status = -1;
+      EXPECT_EQ(children[i], waitpid(children[i], &child_status, 0));
+      EXPECT_TRUE(WIFEXITED(child_status) && 0 == WEXITSTATUS(child_status));
+    }
+    std::string merged_file = std::string("shard_test_merged")
+        + extensions[e];
+    EXPECT_TRUE(TileWriter::Merge(shard_files, merged_file, status));
+    EXPECT_EQ("OK", status);
+    std::string full = ReadFile(full_file);
+    EXPECT_LT(75u * 53u * 3u, full.size());
+    EXPECT_TRUE(full == ReadFile(merged_file));
+    // The whole image merges with its own shards.
+    shard_files.push_back(full_file);
+    EXPECT_TRUE(TileWriter::Merge(shard_files, merged_file, status));
+    // Shards of different images do not merge.
+    ASSERT_TRUE(writer.Open(full_file, 75, 54, status));
+    EXPECT_TRUE(writer.Close(status));
+    EXPECT_FALSE(TileWriter::Merge(shard_files, merged_file, status));
+    for (int i = 0; i < num_shards; ++i)
+      remove(shard_files[i].c_str());
+    remove(full_file.c_str());
+    remove(merged_file.c_str());
+  }
+}
 
-  scene.AddLight(point_light);
-  scene.AddLight(directional_light);
+TEST(RayTracerTest, HeatmapTest) {
+  // raytracer_test builds with RAY_TRAVERSAL_STATS.
+  ASSERT_TRUE(kCountTraversal);
+  Scene scene;
+  ASSERT_NO_FATAL_FAILURE(LoadSphereMesh(scene));
+  AcceleratorFactory factory;
+  std::vector<Accelerator*> accelerators;
+  factory.Accelerate(scene, accelerators);
+  ASSERT_EQ(1u, accelerators.size());
+  Camera camera(64, 48, Orthographic(0.0f, 1.0f),
+      LookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f),
+          glm::vec3(0.0f, 1.0f, 0.0f)));
+  // A ray through the sphere tests boxes and triangles.
+  TraversalStats before = GetThreadTraversalStats();
+  Isect isect;
+  ASSERT_TRUE(scene.Intersect(camera.GenerateRay(32.0f, 24.0f), isect));
+  TraversalStats after = GetThreadTraversalStats();
+  for (int i = 0; i < TraversalStats::kNumCounters; ++i)
+    EXPECT_LT(before.counts[i], after.counts[i]) << i;
 
-  Image image;
-  image.Resize(image_width, image_height);
   RayTracer ray_tracer(&scene, &camera);
+  ray_tracer.set_display_progress(false);
+  ray_tracer.set_display_stats(false);
+  Image reference;
+  ray_tracer.Render(reference);
+  for (int i = 0; i < TraversalStats::kNumCounters; ++i) {
+    ray_tracer.set_heatmap_counter(static_cast<TraversalStats::Counter>(i));
+    Image image;
+    Image heatmap;
+    ray_tracer.Render(image, heatmap);
+    ASSERT_EQ(reference.width(), heatmap.width());
+    ASSERT_EQ(reference.height(), heatmap.height());
+    int num_different = 0;
+    int num_red = 0;
+    for (uint32_t y = 0; y < image.height(); ++y)
+      for (uint32_t x = 0; x < image.width(); ++x) {
+        num_different += (image(y, x) != reference(y, x));
+        num_red += (heatmap(y, x) == ucvec3(255, 0, 0));
+      }
+    EXPECT_EQ(0, num_different);
+    // The largest count maps to red; the corners miss the sphere's
+    // box and take the least work of all.
+    EXPECT_LT(0, num_red) << i;
+    EXPECT_EQ(0, heatmap(0, 0)[0]) << i;
+    EXPECT_EQ(255, heatmap(0, 0)[2]) << i;
+  }
+  static_cast<Trimesh*>(scene.scene_objects()[0])->set_accelerator(NULL);
+  delete accelerators[0];
+}
 
+TEST(RayTracerTest, RayCaptureTest) {
+  Scene scene;
+  ASSERT_NO_FATAL_FAILURE(LoadSphereMesh(scene));
+  std::string status = "";
+  Camera camera(32, 24, Orthographic(0.0f, 1.0f),
+      LookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f),
+          glm::vec3(0.0f, 1.0f, 0.0f)));
+  RayTracer ray_tracer(&scene, &camera);
+  ray_tracer.set_display_progress(false);
+  ray_tracer.set_display_stats(false);
+  ray_tracer.set_num_threads(4);
+  RayCapture capture;
+  ray_tracer.set_ray_capture(&capture);
+  Image image;
   ray_tracer.Render(image);
-  ImageStorage& storage = ImageStorage::GetInstance();
-  success = storage.WriteImage("bunny.jpg", image, status);
-  EXPECT_TRUE(success);
+  std::vector<CapturedRay> rays;
+  capture.GetRays(rays);
+  ASSERT_EQ(32u * 24u, rays.size());
+  // Replaying the rays gives the hits of the render.
+  int num_hits = 0;
+  for (size_t i = 0; i < rays.size(); ++i) {
+    EXPECT_EQ(CapturedRay::kPrimary, rays[i].type);
+    Isect isect;
+    num_hits += scene.Intersect(rays[i].GetRay(), isect);
+  }
+  EXPECT_EQ(ray_tracer.stats().hits, num_hits);
+  // The rays of later renders, on fewer threads or on more, which moves
+  // the buffers, are added.
+  ray_tracer.set_num_threads(2);
+  ray_tracer.Render(image);
+  ray_tracer.set_num_threads(6);
+  ray_tracer.Render(image);
+  capture.GetRays(rays);
+  ASSERT_EQ(3u * 32u * 24u, rays.size());
+
+  BoundingBox bounds =
+      static_cast<Trimesh*>(scene.scene_objects()[0])->GetBounds();
+  std::vector<CapturedRay> incoherent;
+  RayCapture::GenerateIncoherent(bounds, 100, 7, incoherent);
+  ASSERT_EQ(100u, incoherent.size());
+  EXPECT_NEAR(1.0f, glm::length(incoherent[99].direction), 1e-5f);
+  std::vector<CapturedRay> again;
+  RayCapture::GenerateIncoherent(bounds, 100, 7, again);
+  EXPECT_EQ(incoherent[99].origin, again[99].origin);
+
+  std::string file_name = "ray_capture_test.rays";
+  ASSERT_TRUE(capture.Write(file_name, status));
   EXPECT_EQ("OK", status);
+  std::vector<CapturedRay> read_rays(incoherent);
+  ASSERT_TRUE(RayCapture::Read(file_name, read_rays, status));
+  ASSERT_EQ(rays.size(), read_rays.size());
+  for (size_t i = 0; i < rays.size(); ++i) {
+    EXPECT_EQ(rays[i].origin, read_rays[i].origin);
+    EXPECT_EQ(rays[i].direction, read_rays[i].direction);
+    EXPECT_EQ(rays[i].type, read_rays[i].type);
+  }
+  // A truncated file is rejected and leaves the rays alone.
+  truncate(file_name.c_str(), 100);
+  EXPECT_FALSE(RayCapture::Read(file_name, read_rays, status));
+  EXPECT_EQ(rays.size(), read_rays.size());
+  remove(file_name.c_str());
+  EXPECT_FALSE(RayCapture::Read(file_name, read_rays, status));
 }
-} // namespace ray
 
+// Every accelerator must find the hits of the brute force test.  The
+// default fires few rays at each of the many accelerators; set
+// RAY_DIFFERENTIAL_RAYS to fire more rays per accelerator, e.g. millions
+// after changing traversal code.
+TEST(RayTracerTest, DifferentialTest) {
+  int num_rays = 4000;
+  const char* env_rays = getenv("RAY_DIFFERENTIAL_RAYS");
+  if (NULL != env_rays)
+    ASSERT_TRUE(ParseInt(env_rays, &num_rays));
+  const char* scene_files[] = { "../assets/sphere.obj",
+      "../assets/bunny.obj" };
+  // Every kd-tree split policy, the octree and every SAH octree
+  // evaluation policy.
+  std::vector<AcceleratorFactory> factories;
+  std::vector<std::string> names;
+  for (int i = 0; i < AcceleratorFactory::KdtreeType::kNumPolicies; ++i) {
+    AcceleratorFactory factory;
+    factory.set_type(AcceleratorFactory::kKdtree);
+    factory.set_kdtree_policy(
+        static_cast<AcceleratorFactory::KdtreeType::SplitPolicy>(i));
+    factories.push_back(factory);
+    names.push_back(std::string("kdtree ")
+        + AcceleratorFactory::GetKdtreePolicyName(factory.kdtree_policy()));
+  }
+  AcceleratorFactory octree_factory;
+  octree_factory.set_type(AcceleratorFactory::kOctree);
+  factories.push_back(octree_factory);
+  names.push_back("octree");
+  for (int i = 0; i < AcceleratorFactory::SahOctreeType::kNumPolicies; ++i) {
+    AcceleratorFactory factory;
+    factory.set_type(AcceleratorFactory::kSahOctree);
+    factory.set_sah_octree_policy(
+        static_cast<AcceleratorFactory::SahOctreeType::EvaluationPolicy>(i));
+    factories.push_back(factory);
+    names.push_back(std::string("sah-octree ")
+        + AcceleratorFactory::GetSahOctreePolicyName(
+            factory.sah_octree_policy()));
+  }
+  // Ambiguous rays are not checked, so a bug could hide among them; only
+  // grazing rays should be ambiguous at all often.
+  const double kMaxAmbiguous[IntersectionChecker::kNumRayKinds] = { 0.001,
+      0.05, 0.001, 0.001 };
+  SceneLoader& loader = SceneLoader::GetInstance();
+  for (int i = 0; i < 2; ++i) {
+    std::string status = "";
+    Scene scene;
+    ASSERT_TRUE(loader.LoadScene(scene_files[i], scene, status));
+    Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+    for (size_t j = 0; j < factories.size(); ++j) {
+      Accelerator* accelerator = factories[j].Create(*trimesh);
+      ASSERT_TRUE(NULL != accelerator);
+      IntersectionChecker checker(*trimesh, *accelerator);
+      int num_mismatches = checker.Run(num_rays, i + 1, 5);
+      std::cout << scene_files[i] << " " << names[j] << "\n";
+      checker.Print(std::cout);
+      EXPECT_EQ(0, num_mismatches) << scene_files[i] << " " << names[j];
+      for (int k = 0; k < IntersectionChecker::kNumRayKinds; ++k) {
+        IntersectionChecker::RayKind kind =
+            static_cast<IntersectionChecker::RayKind>(k);
+        EXPECT_GE(kMaxAmbiguous[k] * checker.num_rays(kind),
+            checker.num_ambiguous(kind)) << scene_files[i] << " "
+            << names[j] << " " << IntersectionChecker::GetRayKindName(kind);
+      }
+      delete accelerator;
+    }
+  }
+}
+
+TEST(RayTracerTest, RenderMetricsTest) {
+  Scene scene;
+  ASSERT_NO_FATAL_FAILURE(LoadSphereMesh(scene));
+  std::string status = "";
+  Camera camera(40, 24, Orthographic(0.0f, 1.0f),
+      LookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f),
+          glm::vec3(0.0f, 1.0f, 0.0f)));
+  RenderMetrics metrics;
+  MetricsSnapshot snapshot;
+  metrics.GetSnapshot(snapshot);
+  EXPECT_FALSE(snapshot.running);
+  EXPECT_EQ(0, snapshot.tiles_done);
+  EXPECT_GT(0.0, snapshot.eta_seconds);
+
+  RayTracer ray_tracer(&scene, &camera);
+  ray_tracer.set_display_progress(false);
+  ray_tracer.set_display_stats(false);
+  ray_tracer.set_num_threads(3);
+  ray_tracer.set_tile_size(16);
+  ray_tracer.set_render_metrics(&metrics);
+  Image image;
+  ray_tracer.Render(image);
+  metrics.GetSnapshot(snapshot);
+  EXPECT_FALSE(snapshot.running);
+  EXPECT_EQ(6, snapshot.num_tiles);
+  EXPECT_EQ(6, snapshot.tiles_done);
+  EXPECT_EQ(40 * 24, snapshot.num_pixels);
+  EXPECT_EQ(40 * 24, snapshot.pixels_done);
+  EXPECT_EQ(ray_tracer.stats().hits, snapshot.hits);
+  EXPECT_EQ(ray_tracer.stats().misses, snapshot.misses);
+  EXPECT_EQ(0.0, snapshot.eta_seconds);
+  EXPECT_LT(0.0, snapshot.samples_per_second);
+  ASSERT_EQ(3u, snapshot.thread_utilization.size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_LE(0.0, snapshot.thread_utilization[i]);
+    EXPECT_GE(1.0, snapshot.thread_utilization[i]);
+  }
+
+  std::ostringstream tiles_done;
+  tiles_done << "\"tiles_done\": " << snapshot.tiles_done << ",";
+  std::ostringstream prometheus_tiles_done;
+  prometheus_tiles_done << "\nray_render_tiles_done " << snapshot.tiles_done
+      << "\n";
+  const char* file_names[] = { "render_metrics_test.json",
+      "render_metrics_test.prom" };
+  const std::string expected[] = { tiles_done.str(),
+      prometheus_tiles_done.str() };
+  for (int i = 0; i < 2; ++i) {
+    MetricsExporter exporter(metrics, file_names[i], 0.01);
+    ASSERT_TRUE(exporter.Start(status)) << status;
+    usleep(30000);
+    ASSERT_TRUE(exporter.Stop(status)) << status;
+    std::ifstream in(file_names[i]);
+    std::string text((std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+    EXPECT_NE(std::string::npos, text.find(expected[i])) << text;
+    remove(file_names[i]);
+  }
+}
+} // namespace ray
@@ -227,6 +227,76 @@ TEST(OctreeTest, OctantToOrientationTest) {
   }
 }
 
+TEST(OctreeTest, FullSahTraverseTest) {
+  // A ray through an edge or a corner of the split planes enters several
+  // children at the same t and may hit farther in the first; the nearer
+  // hit in another must still be found.  Rays in random directions through
+  // the vertices and the midpoints of the edges of the sphere, against the
+  // mesh without a tree.  Exactly at an edge either may miss, so only hits
+  // count.
+  Scene scene;
+  std::string status = "";
+  ASSERT_TRUE(
+      SceneLoader::GetInstance().LoadScene("../assets/sphere.obj", scene,
+          status));
+  Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+  TestOctree octree;
+  octree.set_evaluation_policy(TestOctree::kFullSAH);
+  octree.Build(trimesh->faces());
+  const std::vector<TrimeshFace>& faces = trimesh->faces();
+  uint32_t state = 1;
+  int num_hits = 0;
+  int num_farther = 0;
+  for (size_t i = 0; i < faces.size(); ++i) {
+    for (int j = 0; j < 6; ++j) {
+      glm::vec3 a = trimesh->GetVertex(faces[i][j / 2]);
+      glm::vec3 b = trimesh->GetVertex(faces[i][(j / 2 + 1) % 3]);
+      glm::vec3 point = (j % 2 == 0 ? a : 0.5f * (a + b));
+      for (int k = 0; k < 16; ++k) {
+        glm::vec3 direction;
+        for (int d = 0; d < 3; ++d) {
+          state = state * 1664525u + 1013904223u;
+          direction[d] = (state >> 8) / 8388608.0f - 1.0f;
+        }
+        if (glm::length(direction) == 0.0f)
+          continue;
+        direction = glm::normalize(direction);
+        Ray ray(point - 3.0f * direction, direction);
+        Isect expected, actual;
+        if (!trimesh->IntersectUnaccelerated(ray, expected)
+            || !octree.Intersect(ray, actual))
+          continue;
+        ++num_hits;
+        num_farther += (actual.t_hit > expected.t_hit + 1e-4f);
+      }
+    }
+  }
+  EXPECT_LT(0, num_hits);
+  EXPECT_EQ(0, num_farther);
+}
+
+TEST(OctreeTest, BuildProfileTest) {
+  ASSERT_TRUE(kProfileBuild);
+  Scene scene;
+  std::string status = "";
+  ASSERT_TRUE(
+      SceneLoader::GetInstance().LoadScene("../assets/sphere.obj", scene,
+          status));
+  Trimesh* trimesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+  TestOctree octree;
+  octree.set_evaluation_policy(TestOctree::kBinnedSAH);
+  const BuildProfile& profile = octree.Build(trimesh->faces()).profile;
+  EXPECT_EQ(1u, profile.calls[BuildProfile::kBounds]);
+  EXPECT_LT(0u, profile.calls[BuildProfile::kEvaluateBinnedCost]);
+  EXPECT_EQ(profile.calls[BuildProfile::kEvaluateBinnedCost],
+      profile.calls[BuildProfile::kImageIntegral]);
+  EXPECT_GE(profile.seconds[BuildProfile::kEvaluateBinnedCost],
+      profile.seconds[BuildProfile::kImageIntegral]);
+  EXPECT_LT(0u, profile.calls[BuildProfile::kEncodeNode]);
+  EXPECT_EQ(0u, profile.calls[BuildProfile::kCreateEvents]);
+  profile.Print(std::cout);
+}
+
 TEST(RayTracerTest, SphereMeshTest) {
   std::string path = "../assets/sphere.obj";
   std::string output = "sphere_octree.bmp";
@@ -5,15 +5,20 @@
  *      Author: agrippa
  */
 
+#include <algorithm>
 #include <climits>
 #include <cstdlib>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "io_utils.hpp"
 #include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "obj_loader.hpp"
 #include "scene.hpp"
 #include "scene_utils.hpp"
 using ::testing::AnyOf;
@@ -61,5 +66,454 @@ TEST(SceneLoaderTest, BlenderReadTest) {
     EXPECT_TRUE(success);
     EXPECT_EQ("OK", status);
 }
-} // namespace ray
 
+TEST(SceneLoaderTest, NativeObjReadTest) {
+    SceneLoader& loader = SceneLoader::GetInstance();
+    EXPECT_FALSE(loader.use_native_obj());
+    loader.set_use_native_obj(true);
+    std::string status = "";
+    Scene scene;
+    bool success = loader.LoadScene("../assets/bunny.obj", scene, status);
+    loader.set_use_native_obj(false);
+    EXPECT_TRUE(success);
+    EXPECT_EQ("OK", status);
+    ASSERT_EQ(1u, scene.scene_objects().size());
+    Trimesh* mesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+    EXPECT_EQ(2503, mesh->num_vertices());
+    EXPECT_EQ(4968, mesh->num_faces());
+    ASSERT_EQ(1u, scene.material_list().materials.size());
+    EXPECT_EQ(mesh->material(), &scene.material_list().materials[0]);
+    EXPECT_EQ(glm::vec3(0.6f, 0.6f, 0.6f), mesh->material()->kd);
+}
+
+TEST(SceneLoaderTest, NativeObjMaterialTest) {
+    SceneLoader& loader = SceneLoader::GetInstance();
+    loader.set_use_native_obj(true);
+    std::string status = "";
+    Scene sphere_scene;
+    EXPECT_TRUE(loader.LoadScene("../assets/sphere.obj", sphere_scene,
+            status));
+    EXPECT_EQ("OK", status);
+    ASSERT_EQ(1u, sphere_scene.scene_objects().size());
+    Trimesh* mesh = static_cast<Trimesh*>(sphere_scene.scene_objects()[0]);
+    EXPECT_EQ(62, mesh->num_vertices());
+    EXPECT_EQ(120, mesh->num_faces());
+    EXPECT_EQ(glm::vec3(0.4f, 0.8f, 0.2f), mesh->material()->kd);
+    EXPECT_EQ(glm::vec3(1.0f, 1.0f, 0.0f), mesh->material()->ks);
+    EXPECT_EQ(64.0f, mesh->material()->ns);
+
+    // Relative indices, quads and one mesh per material.
+    Scene box_scene;
+    EXPECT_TRUE(loader.LoadScene("../assets/CornellBox-Original.obj",
+            box_scene, status));
+    EXPECT_EQ("OK", status);
+    EXPECT_EQ(8u, box_scene.material_list().materials.size());
+    ASSERT_EQ(8u, box_scene.scene_objects().size());
+    int num_faces = 0;
+    int num_vertices = 0;
+    for (uint32_t i = 0; i < box_scene.scene_objects().size(); ++i) {
+        mesh = static_cast<Trimesh*>(box_scene.scene_objects()[i]);
+        num_faces += mesh->num_faces();
+        num_vertices += mesh->num_vertices();
+    }
+    EXPECT_EQ(36, num_faces);
+    EXPECT_EQ(64, num_vertices);
+    loader.set_use_native_obj(false);
+}
+
+TEST(SceneLoaderTest, NativeObjSyntaxTest) {
+    std::string path = "obj_syntax_test.obj";
+    FILE* file = fopen(path.c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    fprintf(file, "# corners in every syntax\r\n"
+            "v 0 0 0\r\nv 1.0 0 0\r\nv 0 1e0 0 # comment\r\n"
+            "v -1.5E-1 +2 .5\n"
+            "vt 0 0\nvt 1 0\nvt 0 1\nvt 1 1\n"
+            "vn 0 0 1\n"
+            "g group\ns off\n"
+            "f 1/1/1 2/2/1 3/3/1\n"
+            "f -4/-4/-1 -2/-2/-1 -1/-1/-1\n"
+            "f\t1/1/1   3/3/1 4/4/1\n");
+    fclose(file);
+    ObjLoader obj_loader;
+    Scene scene;
+    std::string status = "";
+    EXPECT_TRUE(obj_loader.Load(path, scene, status));
+    EXPECT_EQ("OK", status);
+    ASSERT_EQ(1u, scene.scene_objects().size());
+    Trimesh* mesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+    EXPECT_EQ(3, mesh->num_faces());
+    EXPECT_EQ(4, mesh->num_vertices());
+    EXPECT_EQ(glm::vec3(-0.15f, 2.0f, 0.5f), mesh->vertices()[3]);
+    EXPECT_EQ(0, mesh->faces()[1][0]);
+    EXPECT_EQ(2, mesh->faces()[1][1]);
+    EXPECT_EQ(3, mesh->faces()[1][2]);
+
+    file = fopen(path.c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    fprintf(file, "v 0 0 0\nv 1 0 0\nf 1 2 3\n");
+    fclose(file);
+    Scene bad_scene;
+    EXPECT_FALSE(obj_loader.Load(path, bad_scene, status));
+    EXPECT_NE("OK", status);
+    EXPECT_EQ(0u, bad_scene.scene_objects().size());
+
+    // A truncated vertex or normal at the very end of the file, where a
+    // stray record would write past the attribute arrays.
+    const char* truncated[] = { "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nv",
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nv 1 2",
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//1 3//1\nvn",
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//1 3//1\nvn 0 " };
+    const char* expected[] = { "Malformed vertex", "Malformed vertex",
+            "Malformed normal", "Malformed normal" };
+    for (int i = 0; i < 4; ++i) {
+        file = fopen(path.c_str(), "w");
+        ASSERT_TRUE(file != NULL);
+        fputs(truncated[i], file);
+        fclose(file);
+        Scene truncated_scene;
+        EXPECT_FALSE(obj_loader.Load(path, truncated_scene, status)) << i;
+        EXPECT_NE(std::string::npos, status.find(expected[i])) << status;
+        EXPECT_EQ(0u, truncated_scene.scene_objects().size());
+    }
+    remove(path.c_str());
+}
+
+TEST(SceneLoaderTest, NativeObjThreadsTest) {
+    // The dragon is split into many chunks; the result must not depend
+    // on how they are spread across threads.
+    ObjLoader obj_loader;
+    std::string status = "";
+    Scene serial_scene;
+    obj_loader.set_num_threads(1);
+    EXPECT_TRUE(obj_loader.Load("../assets/dragon.obj", serial_scene, status));
+    Scene parallel_scene;
+    obj_loader.set_num_threads(8);
+    EXPECT_TRUE(obj_loader.Load("../assets/dragon.obj", parallel_scene,
+            status));
+    ASSERT_EQ(1u, serial_scene.scene_objects().size());
+    ASSERT_EQ(1u, parallel_scene.scene_objects().size());
+    Trimesh* serial = static_cast<Trimesh*>(serial_scene.scene_objects()[0]);
+    Trimesh* parallel =
+            static_cast<Trimesh*>(parallel_scene.scene_objects()[0]);
+    EXPECT_EQ(serial->num_vertices(), parallel->num_vertices());
+    EXPECT_EQ(serial->num_faces(), parallel->num_faces());
+    EXPECT_TRUE(serial->vertices() == parallel->vertices());
+    for (int i = 0; i < serial->num_faces(); ++i)
+        for (int j = 0; j < 3; ++j)
+            ASSERT_EQ(serial->faces()[i][j], parallel->faces()[i][j]);
+}
+TEST(SceneLoaderTest, MeshCacheTest) {
+    std::string status = "";
+    Scene scene;
+    ObjLoader obj_loader;
+    ASSERT_TRUE(obj_loader.Load("../assets/CornellBox-Original.obj", scene,
+            status));
+    std::string source = "mesh_cache_test.obj";
+    FILE* file = fopen(source.c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    fprintf(file, "v 0 0 0\n");
+    fclose(file);
+    std::string cache = MeshCache::GetCacheFileName(source);
+    EXPECT_TRUE(MeshCache::Write(cache, source, scene, status));
+    EXPECT_EQ("OK", status);
+
+    Scene cached_scene;
+    EXPECT_TRUE(MeshCache::Load(cache, source, cached_scene, status));
+    EXPECT_EQ("OK", status);
+    EXPECT_EQ(scene.material_list().materials.size(),
+            cached_scene.material_list().materials.size());
+    ASSERT_EQ(scene.scene_objects().size(),
+            cached_scene.scene_objects().size());
+    for (uint32_t i = 0; i < scene.scene_objects().size(); ++i) {
+        Trimesh* mesh = static_cast<Trimesh*>(scene.scene_objects()[i]);
+        Trimesh* cached =
+                static_cast<Trimesh*>(cached_scene.scene_objects()[i]);
+        EXPECT_TRUE(cached->vertices().is_mapped());
+        EXPECT_TRUE(mesh->vertices() == cached->vertices());
+        EXPECT_TRUE(mesh->normals() == cached->normals());
+        ASSERT_EQ(mesh->num_faces(), cached->num_faces());
+        for (int j = 0; j < mesh->num_faces(); ++j)
+            for (int k = 0; k < 3; ++k)
+                ASSERT_EQ(mesh->faces()[j][k], cached->faces()[j][k]);
+        EXPECT_EQ(mesh->GetBounds(), cached->GetBounds());
+        EXPECT_EQ(mesh->material()->kd, cached->material()->kd);
+        EXPECT_EQ(
+                &cached_scene.material_list().materials[mesh->material()->id],
+                cached->material());
+    }
+
+    // Streamed into a writer as the loader builds the meshes, a few at a
+    // time, the cache comes out the same.
+    MeshCache::Writer writer;
+    Scene streamed_scene;
+    ASSERT_TRUE(writer.Open(cache, source, streamed_scene,
+            MeshCache::SceneStart(), status));
+    obj_loader.set_num_threads(3);
+    EXPECT_TRUE(obj_loader.Load("../assets/CornellBox-Original.obj",
+            streamed_scene, writer, status));
+    EXPECT_EQ("OK", status);
+    EXPECT_EQ(0u, streamed_scene.scene_objects().size());
+    EXPECT_EQ(8u, streamed_scene.material_list().materials.size());
+    EXPECT_TRUE(writer.Close(status));
+    Scene restored_scene;
+    EXPECT_TRUE(MeshCache::Load(cache, source, restored_scene, status));
+    ASSERT_EQ(scene.scene_objects().size(),
+            restored_scene.scene_objects().size());
+    for (uint32_t i = 0; i < scene.scene_objects().size(); ++i) {
+        Trimesh* mesh = static_cast<Trimesh*>(scene.scene_objects()[i]);
+        Trimesh* restored =
+                static_cast<Trimesh*>(restored_scene.scene_objects()[i]);
+        EXPECT_TRUE(mesh->vertices() == restored->vertices());
+        ASSERT_EQ(mesh->num_faces(), restored->num_faces());
+        EXPECT_EQ(mesh->material()->kd, restored->material()->kd);
+    }
+
+    // A file loaded into a scene that already holds another is cached
+    // without the meshes and materials of the first.
+    MeshCache::SceneStart start(scene);
+    ASSERT_TRUE(obj_loader.Load("../assets/sphere.obj", scene, status));
+    EXPECT_TRUE(MeshCache::Write(cache, source, scene, start, status));
+    EXPECT_EQ("OK", status);
+    Scene sphere_scene;
+    EXPECT_TRUE(MeshCache::Load(cache, source, sphere_scene, status));
+    ASSERT_EQ(1u, sphere_scene.scene_objects().size());
+    EXPECT_EQ(1u, sphere_scene.material_list().materials.size());
+    Trimesh* sphere = static_cast<Trimesh*>(sphere_scene.scene_objects()[0]);
+    EXPECT_EQ(120, sphere->num_faces());
+    ASSERT_TRUE(sphere->material() != NULL);
+    EXPECT_EQ(glm::vec3(0.4f, 0.8f, 0.2f), sphere->material()->kd);
+
+    // Changing the source makes the cache stale.
+    file = fopen(source.c_str(), "a");
+    ASSERT_TRUE(file != NULL);
+    fprintf(file, "v 1 0 0\n");
+    fclose(file);
+    Scene stale_scene;
+    EXPECT_FALSE(MeshCache::Load(cache, source, stale_scene, status));
+    EXPECT_NE("OK", status);
+    EXPECT_EQ(0u, stale_scene.scene_objects().size());
+    remove(cache.c_str());
+    remove(source.c_str());
+}
+TEST(SceneLoaderTest, PagedMeshTest) {
+    std::string source = "paged_mesh_test.obj";
+    {
+        std::ifstream in("../assets/bunny.obj");
+        std::ofstream out(source.c_str());
+        out << in.rdbuf();
+    }
+    std::string cache = MeshCache::GetCacheFileName(source);
+    remove(cache.c_str());
+    SceneLoader& loader = SceneLoader::GetInstance();
+    std::string status = "";
+    Scene scene;
+    ASSERT_TRUE(loader.LoadScene(source, scene, status));
+    loader.set_page_meshes(true);
+    Scene imported_scene;
+    EXPECT_TRUE(loader.LoadScene(source, imported_scene, status));
+    EXPECT_EQ("OK", status);
+    Scene cached_scene;
+    EXPECT_TRUE(loader.LoadScene(source, cached_scene, status));
+    EXPECT_EQ("OK", status);
+    loader.set_page_meshes(false);
+    ASSERT_EQ(1u, scene.scene_objects().size());
+    ASSERT_EQ(1u, imported_scene.scene_objects().size());
+    ASSERT_EQ(1u, cached_scene.scene_objects().size());
+    Trimesh* mesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+    for (int i = 0; i < 2; ++i) {
+        Trimesh* paged = static_cast<Trimesh*>(
+                (0 == i ? imported_scene : cached_scene).scene_objects()[0]);
+        EXPECT_FALSE(mesh->vertices().is_mapped());
+        EXPECT_TRUE(paged->vertices().is_mapped());
+        EXPECT_TRUE(paged->normals().is_mapped());
+        // Only the faces stay in memory, 24 bytes each.
+        EXPECT_GE(24u * paged->num_faces(), paged->GetMemoryUsage());
+        EXPECT_LE(paged->GetMemoryUsage()
+                + 2 * paged->num_vertices() * sizeof(glm::vec3),
+                mesh->GetMemoryUsage());
+        EXPECT_TRUE(mesh->vertices() == paged->vertices());
+        EXPECT_TRUE(mesh->normals() == paged->normals());
+        ASSERT_EQ(mesh->num_faces(), paged->num_faces());
+        for (int j = 0; j < mesh->num_faces(); ++j)
+            for (int k = 0; k < 3; ++k)
+                ASSERT_EQ(mesh->faces()[j][k], paged->faces()[j][k]);
+        EXPECT_EQ(mesh->GetBounds(), paged->GetBounds());
+    }
+    remove(cache.c_str());
+    remove(source.c_str());
+}
+TEST(SceneLoaderTest, TrimeshBulkTest) {
+    std::vector<glm::vec3> points;
+    for (int i = 0; i < 7; ++i)
+        points.push_back(glm::vec3(i, -2 * i, (i % 3) - 1.0f));
+    // Seven points cover both the vectorized part and the remainder.
+    BoundingBox bounds = Trimesh::ComputeBounds(&points[0], points.size());
+    EXPECT_EQ(glm::vec3(0.0f, -12.0f, -1.0f), bounds.min());
+    EXPECT_EQ(glm::vec3(6.0f, 0.0f, 1.0f), bounds.max());
+
+    Trimesh one_by_one;
+    for (int i = 0; i < 7; ++i)
+        one_by_one.AddVertex(points[i]);
+    one_by_one.AddFace(0, 1, 2);
+    one_by_one.AddFace(2, 3, 4);
+    Trimesh bulk;
+    std::vector<glm::vec3> vertices(points);
+    bulk.SetVertices(vertices);
+    EXPECT_TRUE(vertices.empty());
+    int32_t face_indices[] = { 0, 1, 2, 2, 3, 4 };
+    std::vector<int32_t> indices(face_indices, face_indices + 6);
+    EXPECT_TRUE(bulk.SetFaces(indices));
+    EXPECT_EQ(7, bulk.num_vertices());
+    ASSERT_EQ(2, bulk.num_faces());
+    EXPECT_EQ(3, bulk.faces()[1][1]);
+    // Vertices 5 and 6 are unused and must not count.
+    EXPECT_EQ(one_by_one.GetBounds(), bulk.GetBounds());
+
+    indices.push_back(4);
+    indices.push_back(5);
+    indices.push_back(6);
+    EXPECT_TRUE(bulk.SetFaces(indices));
+    EXPECT_EQ(3, bulk.num_faces());
+    EXPECT_EQ(bounds, bulk.GetBounds());
+
+    // Bad indices fail the call and keep the faces.
+    std::vector<int32_t> bad_indices(indices);
+    bad_indices.back() = 7;
+    EXPECT_FALSE(bulk.SetFaces(bad_indices));
+    bad_indices.back() = -1;
+    EXPECT_FALSE(bulk.SetFaces(bad_indices));
+    bad_indices.pop_back();
+    bad_indices.pop_back();
+    EXPECT_FALSE(bulk.SetFaces(bad_indices));
+    EXPECT_EQ(3, bulk.num_faces());
+    EXPECT_EQ(6, bulk.faces()[2][2]);
+    EXPECT_EQ(bounds, bulk.GetBounds());
+}
+TEST(SceneLoaderTest, CompactMeshTest) {
+    ObjLoader obj_loader;
+    std::string status = "";
+    Scene scene;
+    ASSERT_TRUE(obj_loader.Load("../assets/bunny.obj", scene, status));
+    ASSERT_EQ(1u, scene.scene_objects().size());
+    Trimesh* mesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+    Trimesh original(*mesh);
+    BoundingBox bounds = mesh->GetBounds();
+    glm::vec3 extent = bounds.max() - bounds.min();
+    mesh->Compact();
+    EXPECT_TRUE(mesh->is_compact());
+    EXPECT_TRUE(mesh->vertices().empty());
+    EXPECT_EQ(original.num_vertices(), mesh->num_vertices());
+    ASSERT_TRUE(mesh->has_normals());
+    for (int i = 0; i < mesh->num_vertices(); ++i) {
+        for (int k = 0; k < 3; ++k)
+            ASSERT_NEAR(original.GetVertex(i)[k], mesh->GetVertex(i)[k],
+                    extent[k] / 65535.0f);
+        ASSERT_LT(0.9999f, glm::dot(original.GetNormal(i),
+                mesh->GetNormal(i)));
+    }
+    for (int k = 0; k < 3; ++k) {
+        EXPECT_NEAR(bounds.min()[k], mesh->GetBounds().min()[k],
+                extent[k] / 65535.0f);
+        EXPECT_NEAR(bounds.max()[k], mesh->GetBounds().max()[k],
+                extent[k] / 65535.0f);
+    }
+    // Rays just above the original triangles hit the compact mesh about
+    // where the original triangles are.
+    float max_extent = std::max(std::max(extent[0], extent[1]), extent[2]);
+    float offset = 1e-3f * max_extent;
+    for (int i = 0; i < mesh->num_faces(); i += 97) {
+        const TrimeshFace& face = original.faces()[i];
+        glm::vec3 center = (original.GetVertex(face[0])
+                + original.GetVertex(face[1]) + original.GetVertex(face[2]))
+                / 3.0f;
+        glm::vec3 normal = original.GetPatch(i).GetNormal();
+        Ray ray(center + offset * normal, -normal);
+        Isect isect;
+        EXPECT_TRUE(mesh->Intersect(ray, isect));
+        EXPECT_NEAR(offset, isect.t_hit, 1e-4f * max_extent);
+    }
+}
+// Mean distance between the centroids of consecutive faces.
+static float MeanFaceStep(const Trimesh& mesh) {
+    float sum = 0.0f;
+    glm::vec3 last_center;
+    for (int i = 0; i < mesh.num_faces(); ++i) {
+        const TrimeshFace& face = mesh.faces()[i];
+        glm::vec3 center = (mesh.GetVertex(face[0]) + mesh.GetVertex(face[1])
+                + mesh.GetVertex(face[2])) / 3.0f;
+        if (i > 0)
+            sum += glm::length(center - last_center);
+        last_center = center;
+    }
+    return sum / std::max(mesh.num_faces() - 1, 1);
+}
+
+TEST(SceneLoaderTest, ImproveLocalityTest) {
+    ObjLoader obj_loader;
+    std::string status = "";
+    Scene scene;
+    ASSERT_TRUE(obj_loader.Load("../assets/bunny.obj", scene, status));
+    ASSERT_EQ(1u, scene.scene_objects().size());
+    Trimesh* mesh = static_cast<Trimesh*>(scene.scene_objects()[0]);
+    Trimesh original(*mesh);
+    mesh->ImproveLocality();
+    ASSERT_EQ(original.num_faces(), mesh->num_faces());
+    ASSERT_EQ(original.num_vertices(), mesh->num_vertices());
+    EXPECT_EQ(original.GetBounds().min(), mesh->GetBounds().min());
+    EXPECT_EQ(original.GetBounds().max(), mesh->GetBounds().max());
+    // Vertices are numbered in order of first use.
+    int next_vertex = 0;
+    for (int i = 0; i < mesh->num_faces(); ++i) {
+        const TrimeshFace& face = mesh->faces()[i];
+        for (int j = 0; j < 3; ++j) {
+            ASSERT_LE(face[j], next_vertex);
+            if (face[j] == next_vertex)
+                ++next_vertex;
+        }
+    }
+    // The same triangles, with the same attributes, in another order.
+    std::vector<std::vector<float> > before;
+    std::vector<std::vector<float> > after;
+    for (int i = 0; i < mesh->num_faces(); ++i) {
+        std::vector<float> a;
+        std::vector<float> b;
+        for (int j = 0; j < 3; ++j) {
+            int u = original.faces()[i][j];
+            int v = mesh->faces()[i][j];
+            for (int k = 0; k < 3; ++k) {
+                a.push_back(original.GetVertex(u)[k]);
+                a.push_back(original.GetNormal(u)[k]);
+                b.push_back(mesh->GetVertex(v)[k]);
+                b.push_back(mesh->GetNormal(v)[k]);
+            }
+        }
+        before.push_back(a);
+        after.push_back(b);
+    }
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    EXPECT_TRUE(before == after);
+    // Consecutive faces are closer together than before.
+    EXPECT_GT(0.5f * MeanFaceStep(original), MeanFaceStep(*mesh));
+
+    // SceneLoader keeps the order of the file unless told to reorder.
+    SceneLoader& loader = SceneLoader::GetInstance();
+    EXPECT_FALSE(loader.reorder_meshes());
+    bool use_native_obj = loader.use_native_obj();
+    loader.set_use_native_obj(true);
+    loader.set_reorder_meshes(true);
+    Scene reordered_scene;
+    bool success = loader.LoadScene("../assets/bunny.obj", reordered_scene,
+            status);
+    loader.set_reorder_meshes(false);
+    loader.set_use_native_obj(use_native_obj);
+    ASSERT_TRUE(success) << status;
+    const Trimesh* reordered =
+            static_cast<Trimesh*>(reordered_scene.scene_objects()[0]);
+    ASSERT_EQ(mesh->num_faces(), reordered->num_faces());
+    for (int i = 0; i < mesh->num_faces(); ++i)
+        for (int j = 0; j < 3; ++j)
+            ASSERT_EQ(mesh->faces()[i][j], reordered->faces()[i][j]);
+}
+} // namespace ray